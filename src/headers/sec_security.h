@@ -177,6 +177,30 @@ Sec_Result SecProcessor_GetDeviceId(Sec_ProcessorHandle* secProcHandle,
  */
 Sec_Result SecProcessor_Release(Sec_ProcessorHandle* secProcHandle);
 
+/**
+ * @brief Set how many released cipher and mac handles the processor keeps for reuse
+ *
+ * Released handles keep their reset OpenSSL contexts and are handed out again by
+ * SecCipher_GetInstance and SecMac_GetInstance for the same algorithm.  Handles
+ * above a lowered capacity are freed right away.
+ *
+ * @param secProcHandle secure processor handle
+ * @param capacity maximum number of pooled handles of each kind, 0 disables pooling
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecProcessor_SetHandlePoolSize(Sec_ProcessorHandle* secProcHandle, SEC_SIZE capacity);
+
+/**
+ * @brief Get the occupancy of the cipher and mac handle pools
+ *
+ * @param secProcHandle secure processor handle
+ * @param stats pointer to the statistics structure to fill
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecProcessor_GetHandlePoolStats(Sec_ProcessorHandle* secProcHandle, Sec_HandlePoolStats* stats);
+
 /**
  * @brief Initialize cipher object
  *
@@ -195,6 +219,30 @@ Sec_Result SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_CipherAlgorithm algorithm, Sec_CipherMode mode, Sec_KeyHandle* key,
         SEC_BYTE* iv, Sec_CipherHandle** cipherHandle);
 
+/**
+ * @brief Initialize a cipher object in caller provided storage
+ *
+ * The object must be finished with SecCipher_Cleanup instead of SecCipher_Release.
+ * RSA and ElGamal ciphers do not allocate; AES ciphers still allocate their
+ * OpenSSL cipher context.
+ *
+ * @param secProcHandle secure processor handle
+ * @param algorithm cipher algorithm to use
+ * @param mode cipher mode to use
+ * @param key handle to use
+ * @param iv initialization vector value.  Can be set to NULL is the cipher
+ * algorithm chosen does not require it.
+ * @param storage SEC_HANDLE_STORAGE_ALIGN aligned buffer of SEC_CIPHERHANDLE_STORAGE_SIZE bytes
+ * @param storageSize size of the storage buffer
+ * @param cipherHandle output cipher handle, pointing into storage
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecCipher_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_CipherAlgorithm algorithm, Sec_CipherMode mode, Sec_KeyHandle* key,
+        SEC_BYTE* iv, void *storage, SEC_SIZE storageSize,
+        Sec_CipherHandle** cipherHandle);
+
 /**
  * @brief Update the IV on the cipher handle
  */
@@ -268,6 +316,25 @@ Sec_Result SecCipher_ProcessCtrWithOpaqueDataShift(Sec_CipherHandle* cipherHandl
  * @param SEC_BYTE expected expected value used for comparison
  */
 Sec_Result SecCipher_KeyCheckOpaque(Sec_CipherHandle* cipherHandle, Sec_OpaqueBufferHandle* inputHandle, SEC_SIZE checkLength, SEC_BYTE* expected);
+/**
+ * @brief Decrypt an RSA encrypted TLS premaster secret
+ *
+ * The PKCS#1 v1.5 padding and the version bytes are checked in constant time.  If either is
+ * wrong a random premaster secret is returned instead of an error, so that the peer cannot
+ * use the key as a padding oracle.  The first two bytes always hold clientVersion.
+ *
+ * @param key RSA private key handle
+ * @param input encrypted premaster secret, exactly the size of the modulus
+ * @param inputSize the length of input in bytes
+ * @param clientVersion protocol version from the ClientHello
+ * @param altVersion second accepted version, or 0
+ * @param premaster output buffer of SEC_TLS_PREMASTER_LEN bytes
+ *
+ * @return The status of the operation, which does not depend on the decrypted value
+ */
+Sec_Result SecCipher_DecryptTlsPremaster(Sec_KeyHandle* key, SEC_BYTE* input, SEC_SIZE inputSize,
+        SEC_SIZE clientVersion, SEC_SIZE altVersion, SEC_BYTE* premaster);
+
 /**
  * @brief Release the cipher object
  *
@@ -277,6 +344,28 @@ Sec_Result SecCipher_KeyCheckOpaque(Sec_CipherHandle* cipherHandle, Sec_OpaqueBu
  */
 Sec_Result SecCipher_Release(Sec_CipherHandle* cipherHandle);
 
+/**
+ * @brief Finish a cipher object created with SecCipher_Init
+ *
+ * @param cipherHandle cipher handle
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecCipher_Cleanup(Sec_CipherHandle* cipherHandle);
+
+/*
+ * caller provided storage for the *_Init functions must be at least this large.  The sizes
+ * cover the largest platform layout, e.g. the MAC handle embeds an HMAC_CTX before OpenSSL 1.1.
+ */
+#define SEC_CIPHERHANDLE_STORAGE_SIZE 128
+#define SEC_DIGESTHANDLE_STORAGE_SIZE 256
+#define SEC_SIGNATUREHANDLE_STORAGE_SIZE 320
+#define SEC_MACHANDLE_STORAGE_SIZE 384
+#define SEC_RANDOMHANDLE_STORAGE_SIZE 16
+#define SEC_KEYHANDLE_STORAGE_SIZE (SEC_KEYCONTAINER_MAX_LEN + 64)
+/* and aligned to this many bytes */
+#define SEC_HANDLE_STORAGE_ALIGN 16
+
 /**
  * @brief Obtain a digest object handle
  *
@@ -289,6 +378,23 @@ Sec_Result SecCipher_Release(Sec_CipherHandle* cipherHandle);
 Sec_Result SecDigest_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_DigestAlgorithm algorithm, Sec_DigestHandle** digestHandle);
 
+/**
+ * @brief Construct a digest object in caller provided storage
+ *
+ * The object must be finished with SecDigest_Cleanup instead of SecDigest_Release.
+ *
+ * @param secProcHandle secure processor handle
+ * @param algorithm digest algorithm to use
+ * @param storage SEC_HANDLE_STORAGE_ALIGN aligned buffer of SEC_DIGESTHANDLE_STORAGE_SIZE bytes
+ * @param storageSize size of the storage buffer
+ * @param digestHandle output digest object handle, pointing into storage
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecDigest_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_DigestAlgorithm algorithm, void *storage, SEC_SIZE storageSize,
+        Sec_DigestHandle** digestHandle);
+
 /**
  * @brief Update the digest value with the specified input
  *
@@ -322,6 +428,19 @@ Sec_Result SecDigest_UpdateWithKey(Sec_DigestHandle* digestHandle, Sec_KeyHandle
  */
 Sec_Result SecDigest_Release(Sec_DigestHandle* digestHandle, SEC_BYTE* digestOutput, SEC_SIZE* digestSize);
 
+/**
+ * @brief Calculate the resulting digest value of an object created with SecDigest_Init
+ *
+ * The storage is wiped and may be reused afterwards.
+ *
+ * @param digestHandle digest handle
+ * @param digestOutput pointer to an output buffer of SEC_DIGEST_MAX_LEN bytes
+ * @param digestSize pointer to a value that will be set to actual size of the digest value
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecDigest_Cleanup(Sec_DigestHandle* digestHandle, SEC_BYTE* digestOutput, SEC_SIZE* digestSize);
+
 /**
  * @brief Obtian a handle to the signature calculator
  *
@@ -337,6 +456,26 @@ Sec_Result SecSignature_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_SignatureAlgorithm algorithm, Sec_SignatureMode mode,
         Sec_KeyHandle* key, Sec_SignatureHandle** signatureHandle);
 
+/**
+ * @brief Construct a signature calculator in caller provided storage
+ *
+ * The object must be finished with SecSignature_Cleanup instead of SecSignature_Release.
+ *
+ * @param secProcHandle secure processor handle
+ * @param algorithm signing algorithm
+ * @param mode signing mode
+ * @param key key used for signing operations
+ * @param storage SEC_HANDLE_STORAGE_ALIGN aligned buffer of SEC_SIGNATUREHANDLE_STORAGE_SIZE bytes
+ * @param storageSize size of the storage buffer
+ * @param signatureHandle output signature handle, pointing into storage
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecSignature_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_SignatureAlgorithm algorithm, Sec_SignatureMode mode,
+        Sec_KeyHandle* key, void *storage, SEC_SIZE storageSize,
+        Sec_SignatureHandle** signatureHandle);
+
 /**
  * @brief Sign/Verify Signature of the input data
  *
@@ -352,6 +491,81 @@ Sec_Result SecSignature_Process(Sec_SignatureHandle* signatureHandle,
         SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* signature,
         SEC_SIZE *signatureSize);
 
+/**
+ * @brief Feed a chunk of the message into the signature calculator
+ *
+ * Only valid for signature algorithms that compute the digest internally (non *_DIGEST variants).
+ * The signature is produced or checked by SecSignature_Finalize.
+ *
+ * @param signatureHandle signature handle
+ * @param input pointer to the next chunk of the input data
+ * @param inputSize the length of the chunk
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecSignature_Update(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* input, SEC_SIZE inputSize);
+
+/**
+ * @brief Sign/Verify the data accumulated with SecSignature_Update
+ *
+ * @param signatureHandle signature handle
+ * @param signature buffer where signature is/will be stored
+ * @param signatureSize output variable that will be set to the signature size
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecSignature_Finalize(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* signature, SEC_SIZE *signatureSize);
+
+#define SEC_SIGNATURE_BATCH_MAX_THREADS 16
+
+/**
+ * @brief Sign a batch of inputs with a single key
+ *
+ * The private key is loaded once and the signatures are spread across a pool of worker
+ * threads, each with its own copy of the key.
+ *
+ * @param key key used for signing operations
+ * @param algorithm signing algorithm
+ * @param inputs array of pointers to the input buffers (digests for *_DIGEST algorithms)
+ * @param inputSizes array of input lengths
+ * @param signatures array of pointers to the output signature buffers
+ * @param signatureSizes array of output variables that will be set to the signature sizes
+ * @param results array of per item status values
+ * @param count number of items in the batch
+ * @param numThreads number of worker threads, 0 for the number of online cpus
+ *
+ * @return SEC_RESULT_SUCCESS if every item was signed, SEC_RESULT_FAILURE otherwise
+ */
+Sec_Result SecSignature_ProcessBatch(Sec_KeyHandle* key,
+        Sec_SignatureAlgorithm algorithm, SEC_BYTE** inputs, SEC_SIZE* inputSizes,
+        SEC_BYTE** signatures, SEC_SIZE* signatureSizes, Sec_Result* results,
+        SEC_SIZE count, SEC_SIZE numThreads);
+
+/**
+ * @brief Verify a batch of signatures made with a single key
+ *
+ * The public key is extracted once and the verifications are spread across a pool of worker
+ * threads sharing the cached public key object.
+ *
+ * @param key key used for verification
+ * @param algorithm signing algorithm
+ * @param inputs array of pointers to the input buffers (digests for *_DIGEST algorithms)
+ * @param inputSizes array of input lengths
+ * @param signatures array of pointers to the signatures to verify
+ * @param signatureSizes array of signature lengths
+ * @param results array of per item status values
+ * @param count number of items in the batch
+ * @param numThreads number of worker threads, 0 for the number of online cpus
+ *
+ * @return SEC_RESULT_SUCCESS if every signature verified, SEC_RESULT_FAILURE otherwise
+ */
+Sec_Result SecSignature_VerifyBatch(Sec_KeyHandle* key,
+        Sec_SignatureAlgorithm algorithm, SEC_BYTE** inputs, SEC_SIZE* inputSizes,
+        SEC_BYTE** signatures, SEC_SIZE* signatureSizes, Sec_Result* results,
+        SEC_SIZE count, SEC_SIZE numThreads);
+
 /**
  * @brief Release the signature object
  *
@@ -361,6 +575,15 @@ Sec_Result SecSignature_Process(Sec_SignatureHandle* signatureHandle,
  */
 Sec_Result SecSignature_Release(Sec_SignatureHandle* signatureHandle);
 
+/**
+ * @brief Finish a signature object created with SecSignature_Init
+ *
+ * @param signatureHandle signature handle
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecSignature_Cleanup(Sec_SignatureHandle* signatureHandle);
+
 /**
  * @brief Obtain a handle for the MAC calculator
  *
@@ -375,6 +598,27 @@ Sec_Result SecMac_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_MacAlgorithm algorithm, Sec_KeyHandle* key,
         Sec_MacHandle** macHandle);
 
+/**
+ * @brief Construct a MAC calculator in caller provided storage
+ *
+ * The object must be finished with SecMac_Cleanup instead of SecMac_Release.
+ * The OpenSSL MAC contexts are borrowed from the processor's handle pool, so
+ * only calls that find the pool empty allocate them.  Allocations made by
+ * OpenSSL itself while keying the context are not covered.
+ *
+ * @param secProcHandle secure processor handle
+ * @param algorithm MAC algorithm to use for MAC calculation
+ * @param key key to use for the MAC calculation
+ * @param storage SEC_HANDLE_STORAGE_ALIGN aligned buffer of SEC_MACHANDLE_STORAGE_SIZE bytes
+ * @param storageSize size of the storage buffer
+ * @param macHandle output MAC calculator handle, pointing into storage
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecMac_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_MacAlgorithm algorithm, Sec_KeyHandle* key,
+        void *storage, SEC_SIZE storageSize, Sec_MacHandle** macHandle);
+
 /**
  * @brief Updates the digest value with the input data
  *
@@ -409,6 +653,19 @@ Sec_Result SecMac_UpdateWithKey(Sec_MacHandle* macHandle, Sec_KeyHandle *keyHand
  */
 Sec_Result SecMac_Release(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer, SEC_SIZE* macSize);
 
+/**
+ * @brief Calculate the resulting MAC value of an object created with SecMac_Init
+ *
+ * The storage is wiped and may be reused afterwards.
+ *
+ * @param macHandle mac handle
+ * @param macBuffer pointer to an output buffer of SEC_MAC_MAX_LEN bytes
+ * @param macSize pointer to a value that will be set to actual size of the MAC value
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecMac_Cleanup(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer, SEC_SIZE* macSize);
+
 /**
  * @brief Obtain a handle to the random number generator
  *
@@ -421,6 +678,21 @@ Sec_Result SecMac_Release(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer, SEC_SIZ
 Sec_Result SecRandom_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_RandomAlgorithm algorithm, Sec_RandomHandle** randomHandle);
 
+/**
+ * @brief Construct a random number generator in caller provided storage
+ *
+ * @param secProcHandle secure processor handle
+ * @param algorithm random number algorithm to use
+ * @param storage SEC_HANDLE_STORAGE_ALIGN aligned buffer of SEC_RANDOMHANDLE_STORAGE_SIZE bytes
+ * @param storageSize size of the storage buffer
+ * @param randomHandle output handle for the random number generator, pointing into storage
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecRandom_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_RandomAlgorithm algorithm, void *storage, SEC_SIZE storageSize,
+        Sec_RandomHandle** randomHandle);
+
 /**
  * @brief Generate random data
  *
@@ -442,6 +714,15 @@ Sec_Result SecRandom_Process(Sec_RandomHandle* randomHandle, SEC_BYTE* output,
  */
 Sec_Result SecRandom_Release(Sec_RandomHandle* randomHandle);
 
+/**
+ * @brief Finish a random object created with SecRandom_Init
+ *
+ * @param randomHandle random handle
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecRandom_Cleanup(Sec_RandomHandle* randomHandle);
+
 /**
  * @brief Obtain a handle to the provisioned certificate
  *
@@ -540,6 +821,53 @@ Sec_Result SecCertificate_VerifyWithRawRSAPublicKey(Sec_CertificateHandle* cert_
 Sec_Result SecCertificate_VerifyWithRawECCPublicKey(Sec_CertificateHandle* cert_handle,
         Sec_ECCRawPublicKey* public_key);
 
+/**
+ * @brief Find provisioned certificates by subject, issuer or subject key identifier
+ *
+ * The lookup uses an index maintained by SecCertificate_Provision/Delete and does not load any
+ * certificates.  The persisted index is authenticated with the certificate store key.  Certificates
+ * added or removed without going through the API are picked up by rescanning the store.
+ *
+ * @param secProcHandle secure processor handle
+ * @param type which certificate attribute to match
+ * @param value DER encoded name for SUBJECT/ISSUER, or the raw key identifier octets for SKI
+ * @param value_len length of the value
+ * @param items output buffer for the matching object ids
+ * @param maxNumItems the maximum number of ids to write
+ * @param numItems output number of ids written
+ *
+ * @return SEC_RESULT_NO_SUCH_ITEM if no certificate matches, otherwise the status of the operation
+ */
+Sec_Result SecCertificate_Find(Sec_ProcessorHandle* secProcHandle,
+        Sec_CertificateIndexType type, SEC_BYTE *value, SEC_SIZE value_len,
+        SEC_OBJECTID *items, SEC_SIZE maxNumItems, SEC_SIZE *numItems);
+
+#define SEC_CERTCHAIN_MAX_LEN 8
+
+/* flags for SecCertificate_VerifyChain */
+#define SEC_CERTCHAIN_FLAG_DEFAULT 0x0
+#define SEC_CERTCHAIN_FLAG_IGNORE_VALIDITY 0x1
+#define SEC_CERTCHAIN_FLAG_SEQUENTIAL 0x2
+
+/**
+ * @brief Verify a chain of provisioned certificates
+ *
+ * The certificates are ordered from the leaf to the top most certificate.  Each certificate
+ * must be issued by the next one, which must be a CA (basicConstraints CA:TRUE, keyCertSign
+ * and a large enough pathLen), and the last one is verified with the root key.  The signature
+ * checks run concurrently and successful results are cached for subsequent calls.
+ *
+ * @param secProcHandle secure processor handle
+ * @param certIds ids of the certificates in the chain, leaf first
+ * @param numCerts number of certificates in the chain, up to SEC_CERTCHAIN_MAX_LEN
+ * @param rootKey key that signed the last certificate, NULL if the last certificate is self signed
+ * @param flags combination of SEC_CERTCHAIN_FLAG_* values
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecCertificate_VerifyChain(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID *certIds, SEC_SIZE numCerts, Sec_KeyHandle* rootKey, SEC_SIZE flags);
+
 /**
  * @brief Obtain the certificate data in clear text DER format
  *
@@ -615,6 +943,23 @@ Sec_KeyType SecKey_GetKeyType(Sec_KeyHandle* keyHandle);
 Sec_Result SecKey_GetInstance(Sec_ProcessorHandle* secProcHandle,
         SEC_OBJECTID object_id, Sec_KeyHandle** keyHandle);
 
+/**
+ * @brief Obtain a handle to a provisioned key in caller provided storage
+ *
+ * The handle must be finished with SecKey_Cleanup instead of SecKey_Release.
+ *
+ * @param secProcHandle secure processor handle
+ * @param object_id id of the provisioned key
+ * @param storage SEC_HANDLE_STORAGE_ALIGN aligned buffer of SEC_KEYHANDLE_STORAGE_SIZE bytes
+ * @param storageSize size of the storage buffer
+ * @param keyHandle pointer to the output key handle, pointing into storage
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_Init(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID object_id, void *storage, SEC_SIZE storageSize,
+        Sec_KeyHandle** keyHandle);
+
 /**
  * @brief Extract an RSA public key from a specified private key handle
  *
@@ -637,6 +982,17 @@ Sec_Result SecKey_ExtractRSAPublicKey(Sec_KeyHandle* key_handle,
 Sec_Result SecKey_ExtractECCPublicKey(Sec_KeyHandle* key_handle,
         Sec_ECCRawPublicKey *public_key);
 
+/**
+ * @brief Extract the raw public key from an X25519 or Ed25519 key handle
+ *
+ * @param key_handle handle of the X25519/Ed25519 key
+ * @param public_key output buffer of SEC_CURVE25519_KEY_LEN bytes
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_ExtractCurve25519PublicKey(Sec_KeyHandle* key_handle,
+        SEC_BYTE *public_key);
+
 
 /**
  * @brief Generate and provision a new key.
@@ -667,6 +1023,24 @@ Sec_Result SecKey_Provision(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID obj
         Sec_StorageLoc location, Sec_KeyContainer data_type, SEC_BYTE *data,
         SEC_SIZE data_len);
 
+/**
+ * @brief Obtain a handle to a key that is not provisioned under any object id
+ *
+ * The handle owns its key material and wipes it in SecKey_Release.  Raw symmetric
+ * key containers are kept in clear and skip the key store.
+ *
+ * @param secProcHandle secure processor handle
+ * @param data_type type of input key container that is being used
+ * @param data pointer to the input key container
+ * @param data_len the size of the input key container
+ * @param keyHandle pointer to the output key handle
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_CreateTransient(Sec_ProcessorHandle* secProcHandle,
+        Sec_KeyContainer data_type, SEC_BYTE *data, SEC_SIZE data_len,
+        Sec_KeyHandle** keyHandle);
+
 /**
  * @brief Derive and provision a key using the HKDF algorithm
  *
@@ -707,6 +1081,27 @@ Sec_Result SecKey_Derive_ConcatKDF(Sec_ProcessorHandle* secProcHandle,
         SEC_BYTE *nonce,
         SEC_BYTE *otherInfo, SEC_SIZE otherInfoSize);
 
+/**
+ * @brief Derive and provision a key using the PBEKDF2 algorithm keyed with the base key
+ *
+ * @param secProcHandle secure processor handle
+ * @param object_id_derived id of the key to provision
+ * @param type_derived derived key type
+ * @param loc_derived storage location where the derived key should be provisioned
+ * @param macAlgorithm mac algorithm to use in the key derivation process
+ * @param nonce pointer to the nonce used to derive the base key
+ * @param salt pointer to the salt value to use in key derivation process
+ * @param saltSize the length of the salt buffer in bytes
+ * @param numIterations number of mac iterations per output block
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_Derive_PBEKDF(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID object_id_derived, Sec_KeyType type_derived,
+        Sec_StorageLoc loc_derived, Sec_MacAlgorithm macAlgorithm,
+        SEC_BYTE *nonce,
+        SEC_BYTE *salt, SEC_SIZE saltSize, SEC_SIZE numIterations);
+
 /**
  * @brief Derive and provision an AES 128-bit key a vendor specific key ladder algorithm.
  *
@@ -772,6 +1167,20 @@ Sec_Result SecKey_Derive_CMAC_AES128(
  */
 Sec_Result SecKey_Delete(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID object_id);
 
+/**
+ * @brief Keep the key of the handle parsed for the lifetime of the handle
+ *
+ * Later signature and cipher operations on the handle use the parsed key instead of
+ * loading it from the key store each time, and the key validity and output protection
+ * are checked on every use.  Only RSA and ECC keys can be pinned.  The handle
+ * must not be in use by other threads while it is being pinned.
+ *
+ * @param keyHandle key handle
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_Pin(Sec_KeyHandle* keyHandle);
+
 /**
  * @brief Release the key object
  *
@@ -781,6 +1190,15 @@ Sec_Result SecKey_Delete(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID object
  */
 Sec_Result SecKey_Release(Sec_KeyHandle* keyHandle);
 
+/**
+ * @brief Finish a key handle obtained with SecKey_Init
+ *
+ * @param keyHandle key handle
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_Cleanup(Sec_KeyHandle* keyHandle);
+
 /**
  * @brief Obtain a digest value computed over the base key contents
  *
@@ -830,6 +1248,31 @@ Sec_Result SecKey_ECDHKeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
         Sec_DigestAlgorithm digestAlgorithm, SEC_BYTE *otherInfo,
         SEC_SIZE otherInfoSize);
 
+/**
+ * @brief Derive and provision a key using X25519 and the Concat KDF
+ *
+ * Same as SecKey_ECDHKeyAgreementWithKDF, but the shared secret is computed
+ * with X25519 (RFC 7748) from a SEC_KEYTYPE_X25519 key and the raw 32 byte
+ * public key of the other party.
+ *
+ * @param keyHandle Handle of my private X25519 key
+ * @param otherPublicKey Raw public key of the other party
+ * @param otherPublicKeySize Size of otherPublicKey, must be SEC_CURVE25519_KEY_LEN
+ * @param type_derived Type of key to generate. Only symmetric keys can be derived
+ * @param id_derived 64-bit object id identifying the key to be generated
+ * @param loc_derived Location where the resulting key will be stored
+ * @param kdf Key derivation function, only SEC_KDF_CONCAT is supported
+ * @param digestAlgorithm Digest algorithm to use in KDF (typically SEC_DIGESTALGORITHM_SHA256)
+ * @param otherInfo Input keying material
+ * @param otherInfoSize Size of otherInfo (in bytes)
+ */
+Sec_Result SecKey_X25519KeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
+        SEC_BYTE* otherPublicKey, SEC_SIZE otherPublicKeySize,
+        Sec_KeyType type_derived, SEC_OBJECTID id_derived,
+        Sec_StorageLoc loc_derived, Sec_Kdf kdf,
+        Sec_DigestAlgorithm digestAlgorithm, SEC_BYTE *otherInfo,
+        SEC_SIZE otherInfoSize);
+
 /**
  * @brief Obtain a handle to a provisioned bundle
  *
@@ -937,6 +1380,87 @@ Sec_Result SecKeyExchange_ComputeSecret(Sec_KeyExchangeHandle* keyExchangeHandle
 
 Sec_Result SecKeyExchange_Release(Sec_KeyExchangeHandle* keyExchangeHandle);
 
+/**
+ * @brief Start a background pool of pre-generated ephemeral key pairs
+ *
+ * A low priority thread keeps up to depth key pairs ready for the given
+ * exchange type (and DH parameters), so SecKeyExchange_GetInstance can take
+ * one instead of generating it in SecKeyExchange_GenerateKeys.  The refill
+ * target grows when the pool runs dry and shrinks when it sits unused.
+ * Calling it again for the same type and parameters changes the depth.
+ *
+ * @param exchangeType SEC_KEYEXCHANGE_DH, SEC_KEYEXCHANGE_ECDH or SEC_KEYEXCHANGE_X25519
+ * @param exchangeParameters Sec_DHParameters for DH, ignored otherwise
+ * @param depth maximum number of ready key pairs
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKeyExchange_StartPool(Sec_KeyExchangeAlgorithm exchangeType, void* exchangeParameters, SEC_SIZE depth);
+
+/**
+ * @brief Stop the key pair pool thread and destroy all pooled key pairs
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKeyExchange_StopPool(void);
+
+/**
+ * @brief Completion callback for SecKey_GenerateAsync
+ *
+ * @param result status of the generation and provisioning
+ * @param object_id id of the generated key
+ * @param userData value passed to SecKey_GenerateAsync
+ */
+typedef void (*SecKey_GenerateCallback)(Sec_Result result, SEC_OBJECTID object_id, void *userData);
+
+/**
+ * @brief Start a background pool of pre-generated RSA key pairs
+ *
+ * Low priority threads keep up to depth key pairs of the given modulus size
+ * ready, so SecKey_Generate does not have to wait for the prime search.
+ * Calling it again for the same key type changes the depth.
+ *
+ * @param keyType SEC_KEYTYPE_RSA_1024, SEC_KEYTYPE_RSA_2048 or SEC_KEYTYPE_RSA_3072
+ * @param depth maximum number of ready key pairs
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_StartPool(Sec_KeyType keyType, SEC_SIZE depth);
+
+/**
+ * @brief Stop the RSA pool threads and destroy all pooled key pairs
+ *
+ * Pending SecKey_GenerateAsync requests complete with SEC_RESULT_FAILURE.
+ * Must not be called from a SecKey_GenerateAsync callback, which runs on a
+ * pool thread; SEC_RESULT_FAILURE is returned in that case.
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecKey_StopPool(void);
+
+/**
+ * @brief Generate and provision a key without blocking the caller
+ *
+ * The request is queued and completed by SecKey_Generate on a pool thread,
+ * which then invokes callback from that thread.  The processor handle is
+ * used from the pool thread, so callers must not use it concurrently from
+ * other threads until the callback has run.  Requests for the same processor
+ * are completed one at a time, in the order they were queued.
+ * SecProcessor_Release waits for a request of the processor that is running
+ * and completes the queued ones with SEC_RESULT_FAILURE from its own thread.
+ *
+ * @param secProcHandle secure processor handle
+ * @param object_id id of the key to generate
+ * @param keyType type of the key to generate
+ * @param location storage location where the key should be stored
+ * @param callback completion callback, may be NULL
+ * @param userData value passed to the callback
+ *
+ * @return The status of queueing the request
+ */
+Sec_Result SecKey_GenerateAsync(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID object_id,
+        Sec_KeyType keyType, Sec_StorageLoc location, SecKey_GenerateCallback callback, void *userData);
+
 Sec_Result SecKey_Derive_BaseKey(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID idDerived, Sec_KeyType keytype, Sec_StorageLoc loc, SEC_BYTE *nonce);
 
 Sec_Result SecKey_Derive_HKDF_BaseKey(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID idDerived, Sec_KeyType typeDerived, Sec_StorageLoc locDerived, Sec_MacAlgorithm macAlgorithm, SEC_BYTE *salt, SEC_SIZE saltSize, SEC_BYTE *info, SEC_SIZE infoSize, SEC_OBJECTID baseKeyId);
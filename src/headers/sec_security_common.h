@@ -449,6 +449,24 @@ SEC_BOOL SecKey_IsPrivEcc(Sec_KeyType type);
  */
 SEC_BOOL SecKey_IsPubEcc(Sec_KeyType type);
 
+/**
+ * @brief Checks if a passed in key type is X25519 or Ed25519
+ *
+ * @param type key type
+ *
+ * @return 1 if key type is X25519 or Ed25519, 0 otherwise
+ */
+SEC_BOOL SecKey_IsCurve25519(Sec_KeyType type);
+
+/**
+ * @brief Checks if a passed in key type is a private X25519 or Ed25519 key
+ *
+ * @param type key type
+ *
+ * @return 1 if key type is priv X25519 or Ed25519, 0 otherwise
+ */
+SEC_BOOL SecKey_IsPrivCurve25519(Sec_KeyType type);
+
 /**
  * @brief Obtain a key length in bytes for a specified key type.
  *
@@ -569,11 +587,91 @@ void Sec_DefaultLoggerCb(const char *fmt, ...);
  */
 void Sec_NOPLoggerCb(const char *fmt, ...);
 
+/**
+ * @brief Asynchronous logger implementation
+ *
+ * Records the format pointer and arguments in a per-thread ring and returns.  A
+ * background thread formats the records, collapses repeated lines and limits the
+ * rate of messages from each call site.  The format must be a string literal.
+ */
+void Sec_AsyncLoggerCb(const char *fmt, ...);
+
+/**
+ * @brief Write out all records buffered by Sec_AsyncLoggerCb
+ */
+void Sec_AsyncLoggerFlush(void);
+
 /**
  * @brief Print a hexadecimal value
  */
 void Sec_PrintHex(void* data, SEC_SIZE numBytes);
 
+/**
+ * @brief Merge the statistics of all threads since the last SecStats_Reset
+ *
+ * @param stats destination of the merged counters and histograms
+ *
+ * @return SEC_RESULT_UNIMPLEMENTED_FEATURE if statistics are compiled out
+ */
+Sec_Result SecStats_Snapshot(Sec_Stats *stats);
+
+/**
+ * @brief Start a new statistics interval for all threads
+ */
+Sec_Result SecStats_Reset(void);
+
+/**
+ * @brief Latency in nanoseconds below which the given percentage of calls completed
+ *
+ * @param data operation statistics from a snapshot
+ * @param percentile 0 to 100
+ *
+ * @return upper bound of the histogram bucket holding the percentile, 0 if there were no calls
+ */
+uint64_t SecStats_GetPercentile(const Sec_StatsOpData *data, double percentile);
+
+/**
+ * @brief Copy the counters of this process into its slot of the shared metrics segment
+ *
+ * @return SEC_RESULT_UNIMPLEMENTED_FEATURE if statistics are compiled out
+ */
+Sec_Result SecMetrics_Publish(void);
+
+/**
+ * @brief Publish the counters of this process from a background thread
+ *
+ * @param intervalMs time between updates in milliseconds
+ */
+Sec_Result SecMetrics_StartExport(SEC_SIZE intervalMs);
+
+/**
+ * @brief Stop the background export and release the slot of this process
+ */
+Sec_Result SecMetrics_StopExport(void);
+
+/**
+ * @brief Switch recording of tracepoints into the in-process ring buffer on or off
+ *
+ * Static USDT probes fire regardless of this setting.
+ *
+ * @return SEC_RESULT_UNIMPLEMENTED_FEATURE if tracepoints are compiled out
+ */
+Sec_Result SecTrace_Enable(SEC_BOOL enable);
+
+/**
+ * @brief Copy the most recent trace records, oldest first
+ *
+ * @param records destination buffer
+ * @param maxRecords number of records that fit in the buffer
+ * @param written number of records copied
+ */
+Sec_Result SecTrace_Dump(Sec_TraceRecord *records, SEC_SIZE maxRecords, SEC_SIZE *written);
+
+/**
+ * @brief Print the trace ring buffer through the logger
+ */
+void SecTrace_Print(void);
+
 #if !defined(SEC_PUBOPS_TOMCRYPT)
 /**
  * Print OpenSSL version information
@@ -608,9 +706,51 @@ X509 * SecCertificate_DerToX509(void *mem, SEC_SIZE len);
 
 /**
  * @brief Obtain an OpenSSL X509 certificate from the Security API cert handle.
+ *
+ * The caller owns one reference and must release it with X509_free.  On platforms
+ * that cache the parsed certificate on the handle the returned object is shared
+ * with the handle and must not be modified; otherwise a new object is returned.
  */
 X509* SecCertificate_ToX509(Sec_CertificateHandle *cert);
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/evp.h>
+
+#define SEC_PROVIDER_NAME "secapi"
+#define SEC_PROVIDER_PROPQ "provider=" SEC_PROVIDER_NAME
+
+/**
+ * @brief Register and load the Security API OpenSSL provider into a library context.
+ *
+ * The provider implements key management, RSA/ECDSA signatures and RSA decryption on
+ * top of Security API key handles.  If no other provider is active in the library context
+ * the default provider is loaded as well, so that non key operations keep working.
+ *
+ * @param libctx library context, NULL for the default one
+ *
+ * @return The status of the operation
+ */
+Sec_Result SecProvider_Load(OSSL_LIB_CTX *libctx);
+
+/**
+ * @brief Obtain an OpenSSL EVP_PKEY for a provisioned RSA or ECC private key.
+ *
+ * Private key operations on the returned EVP_PKEY (e.g. TLS handshake signatures) are
+ * performed by the Security API.  The key is loaded once and stays pinned while any
+ * EVP_PKEY referring to it is alive, further calls for the same processor and object id
+ * share it.  Provisioning or deleting the key drops the pinned copy, EVP_PKEY objects
+ * created before that keep using the old key until they are freed.  All EVP_PKEY objects
+ * must be freed before the processor is released.
+ *
+ * @param proc secure processor handle
+ * @param object_id id of the provisioned key
+ * @param libctx library context, NULL for the default one
+ *
+ * @return EVP_PKEY or NULL on failure
+ */
+EVP_PKEY* SecKey_ToProviderPKey(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id, OSSL_LIB_CTX *libctx);
+#endif
+
 #endif
 
 /**
@@ -675,6 +815,76 @@ Sec_Result SecDigest_SingleInput(Sec_ProcessorHandle *proc, Sec_DigestAlgorithm
  */
 Sec_Result SecDigest_SingleInputWithKeyId(Sec_ProcessorHandle *proc, Sec_DigestAlgorithm alg, SEC_OBJECTID key_id, SEC_BYTE *digest, SEC_SIZE *digest_len);
 
+#define SEC_TREEHASH_DIGEST_LEN 32
+#define SEC_TREEHASH_DEFAULT_LEAF_SIZE (1024*1024)
+#define SEC_TREEHASH_MAX_THREADS 16
+
+/**
+ * @brief Compute a SHA-256 Merkle tree root over a buffer
+ *
+ * The input is split into fixed size leaves which are hashed in parallel.  Leaf digests are
+ * SHA256(0x00 || leaf) and interior nodes are SHA256(0x01 || left || right), with an odd
+ * trailing node promoted to the next level unchanged.
+ *
+ * @param proc secure processor handle
+ * @param input input data
+ * @param input_len size of input data in bytes
+ * @param leaf_size leaf size in bytes, 0 for SEC_TREEHASH_DEFAULT_LEAF_SIZE
+ * @param num_threads number of worker threads, 0 for the number of online cpus
+ * @param leaves optional output buffer for the leaf manifest (SEC_TREEHASH_DIGEST_LEN bytes per leaf)
+ * @param leaves_len size of the leaves buffer
+ * @param num_leaves optional output for the number of leaves
+ * @param root optional output buffer of SEC_TREEHASH_DIGEST_LEN bytes for the tree root
+ *
+ * @return status of the operation
+ */
+Sec_Result SecDigest_TreeHashBuffer(Sec_ProcessorHandle *proc,
+        SEC_BYTE *input, SEC_SIZE input_len, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE leaves_len, SEC_SIZE *num_leaves, SEC_BYTE *root);
+
+/**
+ * @brief Compute a SHA-256 Merkle tree root over a memory mapped file
+ *
+ * @see SecDigest_TreeHashBuffer
+ */
+Sec_Result SecDigest_TreeHashFile(Sec_ProcessorHandle *proc,
+        const char *path, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE leaves_len, SEC_SIZE *num_leaves, SEC_BYTE *root);
+
+/**
+ * @brief Verify a region of a buffer against a stored leaf manifest
+ *
+ * The manifest is first checked against the trusted root, then only the leaves overlapping
+ * [offset, offset + length) are re-hashed and compared.
+ *
+ * @param proc secure processor handle
+ * @param input input data
+ * @param input_len size of input data in bytes
+ * @param leaf_size leaf size used to build the manifest, 0 for SEC_TREEHASH_DEFAULT_LEAF_SIZE
+ * @param num_threads number of worker threads, 0 for the number of online cpus
+ * @param leaves leaf manifest produced by SecDigest_TreeHashBuffer/File
+ * @param num_leaves number of leaves in the manifest
+ * @param root trusted tree root
+ * @param offset start of the region to verify
+ * @param length length of the region to verify, 0 to verify the whole input
+ *
+ * @return SEC_RESULT_SUCCESS if the region matches, SEC_RESULT_VERIFICATION_FAILED otherwise
+ */
+Sec_Result SecDigest_TreeHashVerifyBuffer(Sec_ProcessorHandle *proc,
+        SEC_BYTE *input, SEC_SIZE input_len, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE num_leaves, SEC_BYTE *root,
+        uint64_t offset, uint64_t length);
+
+/**
+ * @brief Verify a region of a memory mapped file against a stored leaf manifest
+ *
+ * @see SecDigest_TreeHashVerifyBuffer
+ */
+Sec_Result SecDigest_TreeHashVerifyFile(Sec_ProcessorHandle *proc,
+        const char *path, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE num_leaves, SEC_BYTE *root,
+        uint64_t offset, uint64_t length);
+
 /**
  * @brief Utility function for filling out a random value
  *
@@ -80,9 +80,18 @@ extern "C"
 /* length of an NIST_P256 ECC key */
 #define SEC_ECC_NISTP256_KEY_LEN 32
 
+/* length of an X25519 or Ed25519 key (private scalar or public point) */
+#define SEC_CURVE25519_KEY_LEN 32
+
+/* length of an Ed25519 signature */
+#define SEC_ED25519_SIGNATURE_LEN 64
+
 /* maximum length of an ECC point coordinate (in bytes) */
 #define SEC_EC_KEY_MAX_LEN 80
 
+/* length of an RSA key exchange TLS premaster secret */
+#define SEC_TLS_PREMASTER_LEN 48
+
 /* maximum length of a signature value (in bytes) */
 #define SEC_SIGNATURE_MAX_LEN SEC_RSA_KEY_MAX_LEN
 
@@ -222,6 +231,10 @@ typedef enum
     SEC_KEYTYPE_ECC_NISTP256_PUBLIC,
     SEC_KEYTYPE_RSA_3072,
     SEC_KEYTYPE_RSA_3072_PUBLIC,
+    SEC_KEYTYPE_X25519,
+    SEC_KEYTYPE_X25519_PUBLIC,
+    SEC_KEYTYPE_ED25519,
+    SEC_KEYTYPE_ED25519_PUBLIC,
     SEC_KEYTYPE_NUM
 } Sec_KeyType;
 
@@ -283,6 +296,14 @@ typedef enum
     SEC_KEYCONTAINER_SOC_INTERNAL_13,
     SEC_KEYCONTAINER_SOC_INTERNAL_14,
     SEC_KEYCONTAINER_SOC_INTERNAL_15,
+    SEC_KEYCONTAINER_RAW_X25519,
+    SEC_KEYCONTAINER_RAW_X25519_PUBLIC,
+    SEC_KEYCONTAINER_DER_X25519,
+    SEC_KEYCONTAINER_DER_X25519_PUBLIC,
+    SEC_KEYCONTAINER_RAW_ED25519,
+    SEC_KEYCONTAINER_RAW_ED25519_PUBLIC,
+    SEC_KEYCONTAINER_DER_ED25519,
+    SEC_KEYCONTAINER_DER_ED25519_PUBLIC,
     SEC_KEYCONTAINER_NUM
 } Sec_KeyContainer;
 
@@ -312,6 +333,16 @@ typedef enum {
     SEC_STORAGELOC_NUM
 } Sec_StorageLoc;
 
+/**
+ * @brief Certificate index types
+ */
+typedef enum {
+    SEC_CERTIFICATEINDEX_SUBJECT = 0,
+    SEC_CERTIFICATEINDEX_ISSUER,
+    SEC_CERTIFICATEINDEX_SKI,
+    SEC_CERTIFICATEINDEX_NUM
+} Sec_CertificateIndexType;
+
 /**
  * @brief Cipher modes
  *
@@ -341,6 +372,7 @@ typedef enum
     SEC_SIGNATUREALGORITHM_RSA_SHA256_PSS_DIGEST,
     SEC_SIGNATUREALGORITHM_ECDSA_NISTP256,
     SEC_SIGNATUREALGORITHM_ECDSA_NISTP256_DIGEST,
+    SEC_SIGNATUREALGORITHM_ED25519,
     SEC_SIGNATUREALGORITHM_NUM
 } Sec_SignatureAlgorithm;
 
@@ -563,6 +595,7 @@ typedef struct {
 typedef enum {
     SEC_KEYEXCHANGE_DH = 0,
     SEC_KEYEXCHANGE_ECDH,
+    SEC_KEYEXCHANGE_X25519,
     SEC_KEYEXCHANGE_NUM
 } Sec_KeyExchangeAlgorithm;
 
@@ -577,6 +610,119 @@ typedef struct {
     SEC_BYTE version[256];
 } Sec_ProcessorInfo;
 
+/**
+ * @brief Operations with call counts and latency histograms in Sec_Stats
+ *
+ */
+typedef enum {
+    SEC_STATS_OP_CIPHER_GETINSTANCE = 0,
+    SEC_STATS_OP_CIPHER_PROCESS,
+    SEC_STATS_OP_CIPHER_RELEASE,
+    SEC_STATS_OP_DIGEST_GETINSTANCE,
+    SEC_STATS_OP_DIGEST_UPDATE,
+    SEC_STATS_OP_DIGEST_RELEASE,
+    SEC_STATS_OP_MAC_GETINSTANCE,
+    SEC_STATS_OP_MAC_UPDATE,
+    SEC_STATS_OP_MAC_RELEASE,
+    SEC_STATS_OP_SIGNATURE_GETINSTANCE,
+    SEC_STATS_OP_SIGNATURE_PROCESS,
+    SEC_STATS_OP_SIGNATURE_RELEASE,
+    SEC_STATS_OP_KEY_GETINSTANCE,
+    SEC_STATS_OP_STORE_RETRIEVE,
+    SEC_STATS_OP_FILE_READ,
+    SEC_STATS_OP_FILE_WRITE,
+    SEC_STATS_OP_NUM
+} Sec_StatsOp;
+
+/**
+ * @brief Caches with hit/miss counts in Sec_Stats
+ *
+ */
+typedef enum {
+    SEC_STATS_CACHE_RAM_KEY = 0,
+    SEC_STATS_CACHE_PUBOPS_KEY,
+    SEC_STATS_CACHE_CERT_VERIFY,
+    SEC_STATS_CACHE_DH_PARAMS,
+    SEC_STATS_CACHE_KEYEXCHANGE_POOL,
+    SEC_STATS_CACHE_RSA_POOL,
+    SEC_STATS_CACHE_CIPHER_POOL,
+    SEC_STATS_CACHE_MAC_POOL,
+    SEC_STATS_CACHE_NUM
+} Sec_StatsCache;
+
+/* log-linear latency buckets: 4 per power of two, up to 2^40 ns */
+#define SEC_STATS_HISTOGRAM_BUCKETS 160
+
+typedef struct {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t bytes;
+    uint64_t total_ns;
+    uint64_t histogram[SEC_STATS_HISTOGRAM_BUCKETS];
+} Sec_StatsOpData;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+} Sec_StatsCacheData;
+
+typedef struct {
+    Sec_StatsOpData ops[SEC_STATS_OP_NUM];
+    Sec_StatsCacheData caches[SEC_STATS_CACHE_NUM];
+    /* recorded calls by returned Sec_Result */
+    uint64_t results[SEC_RESULT_NUM];
+    /* keys refused by the output protection checks */
+    uint64_t outprot_denials;
+} Sec_Stats;
+
+/**
+ * @brief Occupancy of the cipher and mac handle pools of a processor
+ *
+ */
+typedef struct {
+    /* limit on pooled handles of each kind */
+    SEC_SIZE capacity;
+    SEC_SIZE ciphers_pooled;
+    SEC_SIZE ciphers_high_water;
+    SEC_SIZE macs_pooled;
+    SEC_SIZE macs_high_water;
+    /* released handles freed because the pool was full */
+    uint64_t discarded;
+} Sec_HandlePoolStats;
+
+/**
+ * @brief Tracepoint event types
+ *
+ */
+typedef enum {
+    SEC_TRACE_EVENT_API_ENTER = 0,
+    SEC_TRACE_EVENT_API_EXIT,
+    SEC_TRACE_EVENT_KEY_LOAD,
+    SEC_TRACE_EVENT_STORE_DECRYPT,
+    SEC_TRACE_EVENT_MUTEX_LOCK,
+    SEC_TRACE_EVENT_MUTEX_LOCKED,
+    SEC_TRACE_EVENT_MUTEX_UNLOCK,
+    SEC_TRACE_EVENT_NUM
+} Sec_TraceEvent;
+
+/**
+ * @brief One entry of the tracepoint ring buffer
+ *
+ */
+typedef struct {
+    /* CLOCK_MONOTONIC in ns */
+    uint64_t timestamp;
+    /* key or store key id, mutex address for mutex events */
+    SEC_OBJECTID object_id;
+    /* Sec_Result for API exits, byte count for store decrypts, Sec_StorageLoc for key loads */
+    uint64_t arg;
+    uint32_t tid;
+    /* Sec_TraceEvent */
+    uint16_t event;
+    /* Sec_StatsOp for API events */
+    uint16_t op;
+} Sec_TraceRecord;
+
 /**
  * @brief Opaque processor initialization parameters
  *
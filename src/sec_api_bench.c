@@ -0,0 +1,644 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* sec_api_bench: measures sec_api throughput and latency and reports the results as JSON */
+
+#include "sec_security.h"
+#include "sec_security_store.h"
+#include "sec_security_utils.h"
+#include "sec_security_comcastids.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_DIR "/tmp/sec_api_bench"
+#define BENCH_DEFAULT_MS 200
+/* latency samples kept per case, later iterations only count towards the totals */
+#define BENCH_MAX_SAMPLES 200000
+#define BENCH_MAX_INPUT (64 * 1024)
+/* keep in sync with the pbekdf case name */
+#define BENCH_PBEKDF_ITERATIONS 1000
+
+#define BENCH_ID_AES_128 (SEC_OBJECTID_USER_BASE + 0x100)
+#define BENCH_ID_HMAC_256 (SEC_OBJECTID_USER_BASE + 0x101)
+#define BENCH_ID_RSA_2048 (SEC_OBJECTID_USER_BASE + 0x102)
+#define BENCH_ID_ECC (SEC_OBJECTID_USER_BASE + 0x103)
+#define BENCH_ID_ED25519 (SEC_OBJECTID_USER_BASE + 0x104)
+#define BENCH_ID_FILE_KEY (SEC_OBJECTID_USER_BASE + 0x105)
+#define BENCH_ID_RAM_KEY (SEC_OBJECTID_USER_BASE + 0x106)
+#define BENCH_ID_DERIVED (SEC_OBJECTID_USER_BASE + 0x107)
+#define BENCH_ID_JTYPE (SEC_OBJECTID_USER_BASE + 0x108)
+
+typedef Sec_Result (*BenchFn)(void *arg);
+
+typedef struct
+{
+    FILE *out;
+    SEC_SIZE duration_ms;
+    SEC_SIZE num_results;
+    char dir[256];
+    Sec_ProcessorHandle *proc;
+    uint64_t *samples;
+    SEC_BYTE input[BENCH_MAX_INPUT];
+    SEC_BYTE output[BENCH_MAX_INPUT + 512];
+} Bench;
+
+typedef struct
+{
+    Bench *bench;
+    SEC_SIZE size;
+    int alg;
+    SEC_OBJECTID key;
+    Sec_KeyHandle *key_handle;
+    SEC_BYTE store[BENCH_MAX_INPUT + 512];
+    SEC_SIZE store_len;
+    SEC_BYTE *token;
+    SEC_SIZE token_len;
+} BenchCase;
+
+static const SEC_SIZE g_bench_sizes[] = { 16, 256, 1024, 16 * 1024, 64 * 1024 };
+#define BENCH_NUM_SIZES (sizeof(g_bench_sizes) / sizeof(g_bench_sizes[0]))
+
+static const char *g_cipher_names[SEC_CIPHERALGORITHM_NUM] = {
+    "aes_ecb_no_padding", "aes_ecb_pkcs7_padding", "aes_cbc_no_padding", "aes_cbc_pkcs7_padding",
+    "aes_ctr", "rsa_pkcs1_padding", "rsa_oaep_padding", "ecc_elgamal",
+};
+
+static const char *g_digest_names[SEC_DIGESTALGORITHM_NUM] = { "sha1", "sha256" };
+
+static const char *g_mac_names[SEC_MACALGORITHM_NUM] = { "hmac_sha1", "hmac_sha256", "cmac_aes_128" };
+
+static const char *g_signature_names[SEC_SIGNATUREALGORITHM_NUM] = {
+    "rsa_sha1_pkcs", "rsa_sha256_pkcs", "rsa_sha1_pkcs_digest", "rsa_sha256_pkcs_digest",
+    "rsa_sha1_pss", "rsa_sha256_pss", "rsa_sha1_pss_digest", "rsa_sha256_pss_digest",
+    "ecdsa_nistp256", "ecdsa_nistp256_digest", "ed25519",
+};
+
+static uint64_t _Bench_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static int _Bench_Compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t _Bench_Percentile(const uint64_t *sorted, SEC_SIZE count, double percentile)
+{
+    SEC_SIZE idx = (SEC_SIZE) (count * percentile / 100.0);
+
+    return sorted[SEC_MIN(idx, count - 1)];
+}
+
+/* Runs fn repeatedly for the configured duration and writes one JSON result object.
+ * group and name identify the case, size is the number of payload bytes per call. */
+static void _Bench_Run(Bench *bench, const char *group, const char *name, SEC_SIZE size, BenchFn fn, void *arg)
+{
+    uint64_t deadline;
+    uint64_t start;
+    uint64_t total_ns = 0;
+    SEC_SIZE count = 0;
+    SEC_SIZE iterations = 0;
+    Sec_Result res;
+
+    fprintf(bench->out, "%s\n    { \"group\": \"%s\", \"name\": \"%s\", \"size\": %u, ",
+            bench->num_results++ > 0 ? "," : "", group, name, size);
+
+    /* warm up caches and lazily created state */
+    res = fn(arg);
+    if (SEC_RESULT_SUCCESS != res)
+    {
+        fprintf(bench->out, "\"error\": %d }", res);
+        return;
+    }
+
+    deadline = _Bench_Now() + (uint64_t) bench->duration_ms * 1000000ULL;
+    do
+    {
+        uint64_t ns;
+
+        start = _Bench_Now();
+        res = fn(arg);
+        ns = _Bench_Now() - start;
+
+        if (SEC_RESULT_SUCCESS != res)
+        {
+            fprintf(bench->out, "\"error\": %d }", res);
+            return;
+        }
+
+        total_ns += ns;
+        iterations++;
+        if (count < BENCH_MAX_SAMPLES)
+            bench->samples[count++] = ns;
+    } while (start < deadline);
+
+    qsort(bench->samples, count, sizeof(uint64_t), _Bench_Compare);
+
+    fprintf(bench->out, "\"iterations\": %u, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.3f, "
+            "\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu }",
+            iterations,
+            iterations * 1e9 / total_ns,
+            (double) iterations * size * 1e9 / total_ns / (1024.0 * 1024.0),
+            (unsigned long long) _Bench_Percentile(bench->samples, count, 50),
+            (unsigned long long) _Bench_Percentile(bench->samples, count, 90),
+            (unsigned long long) _Bench_Percentile(bench->samples, count, 99),
+            (unsigned long long) bench->samples[count - 1]);
+    fflush(bench->out);
+}
+
+static Sec_Result _Bench_Startup(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    Sec_ProcessorHandle *proc = NULL;
+    char app_dir[300];
+    Sec_Result res;
+
+    snprintf(app_dir, sizeof(app_dir), "%s/app/", c->bench->dir);
+
+    res = SecProcessor_GetInstance_Directories(&proc, c->bench->dir, app_dir);
+    if (SEC_RESULT_SUCCESS == res)
+        res = SecProcessor_Release(proc);
+
+    return res;
+}
+
+static Sec_Result _Bench_Cipher(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_BYTE iv[SEC_AES_BLOCK_SIZE] = { 0 };
+    SEC_SIZE written;
+
+    return SecCipher_SingleInput(c->bench->proc, (Sec_CipherAlgorithm) c->alg, SEC_CIPHERMODE_ENCRYPT,
+            c->key_handle, iv, c->bench->input, c->size, c->bench->output, sizeof(c->bench->output), &written);
+}
+
+static Sec_Result _Bench_Digest(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_SIZE written;
+
+    return SecDigest_SingleInput(c->bench->proc, (Sec_DigestAlgorithm) c->alg, c->bench->input, c->size,
+            c->bench->output, &written);
+}
+
+static Sec_Result _Bench_Mac(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_SIZE written;
+
+    return SecMac_SingleInput(c->bench->proc, (Sec_MacAlgorithm) c->alg, c->key_handle, c->bench->input, c->size,
+            c->bench->output, &written);
+}
+
+static Sec_Result _Bench_Signature(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_SIZE written;
+
+    return SecSignature_SingleInput(c->bench->proc, (Sec_SignatureAlgorithm) c->alg, SEC_SIGNATUREMODE_SIGN,
+            c->key_handle, c->bench->input, c->size, c->bench->output, &written);
+}
+
+static Sec_Result _Bench_KeyLoad(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    Sec_KeyHandle *key = NULL;
+    Sec_Result res;
+
+    res = SecKey_GetInstance(c->bench->proc, c->key, &key);
+    if (SEC_RESULT_SUCCESS == res)
+        res = SecKey_Release(key);
+
+    return res;
+}
+
+static Sec_Result _Bench_StoreData(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_BYTE magic[SEC_STORE_USERHEADERMAGIC_LEN] = { 'B', 'N', 'C', 'H' };
+
+    return SecStore_StoreData(c->bench->proc, SEC_TRUE, SEC_TRUE, magic, NULL, 0,
+            c->bench->input, c->size, c->store, c->store_len);
+}
+
+static Sec_Result _Bench_RetrieveData(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+
+    return SecStore_RetrieveData(c->bench->proc, SEC_TRUE, NULL, 0,
+            c->bench->output, c->size, c->store, c->store_len);
+}
+
+static Sec_Result _Bench_HKDF(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_BYTE nonce[SEC_NONCE_LEN] = { 0 };
+    SEC_BYTE salt[32] = { 1 };
+    SEC_BYTE info[32] = { 2 };
+    Sec_Result res;
+
+    res = SecKey_Derive_HKDF(c->bench->proc, BENCH_ID_DERIVED, SEC_KEYTYPE_AES_128, SEC_STORAGELOC_RAM,
+            SEC_MACALGORITHM_HMAC_SHA256, nonce, salt, sizeof(salt), info, sizeof(info));
+    SecKey_Delete(c->bench->proc, BENCH_ID_DERIVED);
+
+    return res;
+}
+
+static Sec_Result _Bench_ConcatKDF(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_BYTE nonce[SEC_NONCE_LEN] = { 0 };
+    SEC_BYTE other_info[32] = { 3 };
+    Sec_Result res;
+
+    res = SecKey_Derive_ConcatKDF(c->bench->proc, BENCH_ID_DERIVED, SEC_KEYTYPE_AES_128, SEC_STORAGELOC_RAM,
+            SEC_DIGESTALGORITHM_SHA256, nonce, other_info, sizeof(other_info));
+    SecKey_Delete(c->bench->proc, BENCH_ID_DERIVED);
+
+    return res;
+}
+
+static Sec_Result _Bench_PBEKDF(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    SEC_BYTE nonce[SEC_NONCE_LEN] = { 0 };
+    SEC_BYTE salt[32] = { 4 };
+    Sec_Result res;
+
+    res = SecKey_Derive_PBEKDF(c->bench->proc, BENCH_ID_DERIVED, SEC_KEYTYPE_AES_128, SEC_STORAGELOC_RAM,
+            SEC_MACALGORITHM_HMAC_SHA256, nonce, salt, sizeof(salt), BENCH_PBEKDF_ITERATIONS);
+    SecKey_Delete(c->bench->proc, BENCH_ID_DERIVED);
+
+    return res;
+}
+
+static Sec_Result _Bench_JType(void *arg)
+{
+    BenchCase *c = (BenchCase *) arg;
+    Sec_Result res;
+
+    res = SecKey_Provision(c->bench->proc, BENCH_ID_JTYPE, SEC_STORAGELOC_RAM, SEC_KEYCONTAINER_JTYPE,
+            c->token, c->token_len);
+    SecKey_Delete(c->bench->proc, BENCH_ID_JTYPE);
+
+    return res;
+}
+
+static Sec_Result _Bench_Base64Url(const char *input, SEC_BYTE *output, SEC_SIZE max_output, SEC_SIZE *written)
+{
+    return SecUtils_Base64UrlEncode((const SEC_BYTE *) input, strlen(input), output, max_output, written);
+}
+
+/* builds a version 2 JTYPE container signed with the session mac key */
+static Sec_Result _Bench_MakeJType(Bench *bench, BenchCase *c)
+{
+    const char *header = "{\"alg\":\"HS256\",\"kid\":\"bench\"}";
+    SEC_BYTE mac_key[32];
+    SEC_BYTE content_key[16];
+    SEC_BYTE rights[SEC_KEYOUTPUTRIGHT_NUM] = { 0 };
+    char content_key_b64[64] = { 0 };
+    char rights_b64[64] = { 0 };
+    char payload[1024];
+    SEC_BYTE mac[SEC_MAC_MAX_LEN];
+    SEC_SIZE mac_len;
+    SEC_SIZE written;
+    SEC_SIZE len;
+
+    SecRandom_SingleInput(bench->proc, SEC_RANDOMALGORITHM_PRNG, mac_key, sizeof(mac_key));
+    SecRandom_SingleInput(bench->proc, SEC_RANDOMALGORITHM_PRNG, content_key, sizeof(content_key));
+
+    if (SEC_RESULT_SUCCESS != SecKey_Provision(bench->proc, SEC_OBJECTID_COMCAST_XCALSESSIONMACKEY,
+            SEC_STORAGELOC_RAM, SEC_KEYCONTAINER_RAW_HMAC_256, mac_key, sizeof(mac_key)))
+        return SEC_RESULT_FAILURE;
+
+    SecUtils_Base64Encode(content_key, sizeof(content_key), (SEC_BYTE *) content_key_b64, sizeof(content_key_b64) - 1, &written);
+    SecUtils_Base64Encode(rights, sizeof(rights), (SEC_BYTE *) rights_b64, sizeof(rights_b64) - 1, &written);
+
+    snprintf(payload, sizeof(payload), "{\"contentKeyContainerVersion\":\"2\",\"contentKeyId\":\"bench\","
+            "\"contentKeyNotBefore\":\"2010-01-01T00:00:00Z\",\"contentKeyNotOnOrAfter\":\"2037-01-01T00:00:00Z\","
+            "\"contentKeyRights\":\"%s\",\"contentKeyUsage\":\"%d\",\"contentKeyCacheable\":\"true\","
+            "\"contentKey\":\"%s\",\"contentKeyLength\":\"16\",\"contentKeyTransportAlgorithm\":\"aesEcbNone\"}",
+            rights_b64, SEC_KEYUSAGE_DATA, content_key_b64);
+
+    c->token = (SEC_BYTE *) calloc(1, 4096);
+    if (NULL == c->token)
+        return SEC_RESULT_FAILURE;
+
+    if (SEC_RESULT_SUCCESS != _Bench_Base64Url(header, c->token, 4096, &written))
+        return SEC_RESULT_FAILURE;
+    len = written;
+    c->token[len++] = '.';
+    if (SEC_RESULT_SUCCESS != _Bench_Base64Url(payload, c->token + len, 4096 - len, &written))
+        return SEC_RESULT_FAILURE;
+    len += written;
+
+    if (SEC_RESULT_SUCCESS != SecMac_SingleInputId(bench->proc, SEC_MACALGORITHM_HMAC_SHA256,
+            SEC_OBJECTID_COMCAST_XCALSESSIONMACKEY, c->token, len, mac, &mac_len))
+        return SEC_RESULT_FAILURE;
+
+    c->token[len++] = '.';
+    if (SEC_RESULT_SUCCESS != SecUtils_Base64UrlEncode(mac, mac_len, c->token + len, 4096 - len, &written))
+        return SEC_RESULT_FAILURE;
+    c->token_len = len + written;
+
+    return SEC_RESULT_SUCCESS;
+}
+
+static void _Bench_Ciphers(Bench *bench, BenchCase *c, Sec_KeyHandle *aes, Sec_KeyHandle *rsa, Sec_KeyHandle *ecc)
+{
+    SEC_SIZE i;
+    int alg;
+
+    for (alg = 0; alg < SEC_CIPHERALGORITHM_NUM; ++alg)
+    {
+        c->alg = alg;
+
+        if (SecCipher_IsAES((Sec_CipherAlgorithm) alg))
+        {
+            c->key_handle = aes;
+            for (i = 0; i < BENCH_NUM_SIZES; ++i)
+            {
+                c->size = g_bench_sizes[i];
+                _Bench_Run(bench, "cipher", g_cipher_names[alg], c->size, _Bench_Cipher, c);
+            }
+        }
+        else if (SecCipher_IsRsa((Sec_CipherAlgorithm) alg))
+        {
+            c->key_handle = rsa;
+            c->size = 32;
+            _Bench_Run(bench, "cipher", g_cipher_names[alg], c->size, _Bench_Cipher, c);
+        }
+        else
+        {
+            SEC_SIZE tries;
+
+            /* only about half of the inputs map to a curve point, pick one that does */
+            c->key_handle = ecc;
+            c->size = 32;
+            for (tries = 0; tries < 64 && NULL != ecc; ++tries)
+            {
+                SecRandom_SingleInput(bench->proc, SEC_RANDOMALGORITHM_PRNG, bench->input, c->size);
+                if (SEC_RESULT_SUCCESS == _Bench_Cipher(c))
+                    break;
+            }
+            _Bench_Run(bench, "cipher", g_cipher_names[alg], c->size, _Bench_Cipher, c);
+        }
+    }
+}
+
+static void _Bench_Algorithms(Bench *bench, BenchCase *c, Sec_KeyHandle *aes, Sec_KeyHandle *hmac,
+        Sec_KeyHandle *rsa, Sec_KeyHandle *ecc, Sec_KeyHandle *ed25519)
+{
+    SEC_SIZE i;
+    int alg;
+
+    for (alg = 0; alg < SEC_DIGESTALGORITHM_NUM; ++alg)
+    {
+        c->alg = alg;
+        for (i = 0; i < BENCH_NUM_SIZES; ++i)
+        {
+            c->size = g_bench_sizes[i];
+            _Bench_Run(bench, "digest", g_digest_names[alg], c->size, _Bench_Digest, c);
+        }
+    }
+
+    for (alg = 0; alg < SEC_MACALGORITHM_NUM; ++alg)
+    {
+        c->alg = alg;
+        c->key_handle = alg == SEC_MACALGORITHM_CMAC_AES_128 ? aes : hmac;
+        for (i = 0; i < BENCH_NUM_SIZES; ++i)
+        {
+            c->size = g_bench_sizes[i];
+            _Bench_Run(bench, "mac", g_mac_names[alg], c->size, _Bench_Mac, c);
+        }
+    }
+
+    for (alg = 0; alg < SEC_SIGNATUREALGORITHM_NUM; ++alg)
+    {
+        Sec_SignatureAlgorithm sig_alg = (Sec_SignatureAlgorithm) alg;
+
+        c->alg = alg;
+        if (sig_alg == SEC_SIGNATUREALGORITHM_ED25519)
+            c->key_handle = ed25519;
+        else if (SecSignature_IsEcc(sig_alg))
+            c->key_handle = ecc;
+        else
+            c->key_handle = rsa;
+
+        /* the _DIGEST variants sign a precomputed digest */
+        switch (sig_alg)
+        {
+            case SEC_SIGNATUREALGORITHM_RSA_SHA1_PKCS_DIGEST:
+            case SEC_SIGNATUREALGORITHM_RSA_SHA256_PKCS_DIGEST:
+            case SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS_DIGEST:
+            case SEC_SIGNATUREALGORITHM_RSA_SHA256_PSS_DIGEST:
+            case SEC_SIGNATUREALGORITHM_ECDSA_NISTP256_DIGEST:
+                c->size = SecDigest_GetDigestLenForAlgorithm(SecSignature_GetDigestAlgorithm(sig_alg));
+                break;
+            default:
+                c->size = 1024;
+                break;
+        }
+
+        if (NULL == c->key_handle)
+        {
+            fprintf(bench->out, "%s\n    { \"group\": \"signature\", \"name\": \"%s\", \"size\": %u, \"error\": %d }",
+                    bench->num_results++ > 0 ? "," : "", g_signature_names[alg], c->size, SEC_RESULT_NO_SUCH_ITEM);
+            continue;
+        }
+
+        _Bench_Run(bench, "signature", g_signature_names[alg], c->size, _Bench_Signature, c);
+    }
+}
+
+static Sec_KeyHandle *_Bench_GenerateKey(Bench *bench, SEC_OBJECTID id, Sec_KeyType type)
+{
+    Sec_KeyHandle *key = NULL;
+
+    if (SEC_RESULT_SUCCESS != SecKey_Generate(bench->proc, id, type, SEC_STORAGELOC_RAM)
+            || SEC_RESULT_SUCCESS != SecKey_GetInstance(bench->proc, id, &key))
+    {
+        fprintf(stderr, "could not generate a key of type %d\n", type);
+        return NULL;
+    }
+
+    return key;
+}
+
+static void _Bench_Usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-d work_dir] [-t ms_per_case] [-o output.json]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    Bench *bench;
+    BenchCase *c;
+    Sec_KeyHandle *aes = NULL;
+    Sec_KeyHandle *hmac = NULL;
+    Sec_KeyHandle *rsa = NULL;
+    Sec_KeyHandle *ecc = NULL;
+    Sec_KeyHandle *ed25519 = NULL;
+    char app_dir[300];
+    const char *output = NULL;
+    SEC_SIZE i;
+    int opt;
+    int ret = 1;
+
+    bench = (Bench *) calloc(1, sizeof(Bench));
+    c = (BenchCase *) calloc(1, sizeof(BenchCase));
+    if (NULL == bench || NULL == c)
+        return 1;
+
+    bench->out = stdout;
+    bench->duration_ms = BENCH_DEFAULT_MS;
+    snprintf(bench->dir, sizeof(bench->dir), "%s", BENCH_DEFAULT_DIR);
+    c->bench = bench;
+
+    while ((opt = getopt(argc, argv, "d:t:o:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                snprintf(bench->dir, sizeof(bench->dir), "%s", optarg);
+                break;
+            case 't':
+                bench->duration_ms = (SEC_SIZE) atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                _Bench_Usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (bench->duration_ms == 0)
+    {
+        _Bench_Usage(argv[0]);
+        return 1;
+    }
+
+    bench->samples = (uint64_t *) malloc(sizeof(uint64_t) * BENCH_MAX_SAMPLES);
+    if (NULL == bench->samples)
+        return 1;
+
+    if (NULL != output && NULL == (bench->out = fopen(output, "w")))
+    {
+        fprintf(stderr, "could not open %s\n", output);
+        return 1;
+    }
+
+    /* keep expected failures out of the timings */
+    Sec_SetLogger(Sec_NOPLoggerCb);
+
+    fprintf(bench->out, "{\n  \"duration_ms\": %u,\n  \"results\": [", bench->duration_ms);
+
+    /* only one processor can be active at a time, so startup is measured first */
+    _Bench_Run(bench, "processor", "startup", 0, _Bench_Startup, c);
+
+    snprintf(app_dir, sizeof(app_dir), "%s/app/", bench->dir);
+    if (SEC_RESULT_SUCCESS != SecProcessor_GetInstance_Directories(&bench->proc, bench->dir, app_dir))
+    {
+        fprintf(stderr, "SecProcessor_GetInstance_Directories failed\n");
+        goto done;
+    }
+
+    SecRandom_SingleInput(bench->proc, SEC_RANDOMALGORITHM_PRNG, bench->input, sizeof(bench->input));
+
+    aes = _Bench_GenerateKey(bench, BENCH_ID_AES_128, SEC_KEYTYPE_AES_128);
+    hmac = _Bench_GenerateKey(bench, BENCH_ID_HMAC_256, SEC_KEYTYPE_HMAC_256);
+    rsa = _Bench_GenerateKey(bench, BENCH_ID_RSA_2048, SEC_KEYTYPE_RSA_2048);
+    ecc = _Bench_GenerateKey(bench, BENCH_ID_ECC, SEC_KEYTYPE_ECC_NISTP256);
+    ed25519 = _Bench_GenerateKey(bench, BENCH_ID_ED25519, SEC_KEYTYPE_ED25519);
+
+    _Bench_Ciphers(bench, c, aes, rsa, ecc);
+    _Bench_Algorithms(bench, c, aes, hmac, rsa, ecc, ed25519);
+
+    /* file keys are read from disk on every load, RAM keys are served from the processor */
+    if (SEC_RESULT_SUCCESS == SecKey_Generate(bench->proc, BENCH_ID_FILE_KEY, SEC_KEYTYPE_AES_128, SEC_STORAGELOC_FILE))
+    {
+        c->key = BENCH_ID_FILE_KEY;
+        _Bench_Run(bench, "key_load", "file", 0, _Bench_KeyLoad, c);
+    }
+    if (SEC_RESULT_SUCCESS == SecKey_Generate(bench->proc, BENCH_ID_RAM_KEY, SEC_KEYTYPE_AES_128, SEC_STORAGELOC_RAM))
+    {
+        c->key = BENCH_ID_RAM_KEY;
+        _Bench_Run(bench, "key_load", "ram", 0, _Bench_KeyLoad, c);
+    }
+
+    for (i = 0; i < BENCH_NUM_SIZES; ++i)
+    {
+        c->size = g_bench_sizes[i];
+        c->store_len = SecStore_CalculateRequiredStoreLen(0, c->size);
+        _Bench_Run(bench, "store", "store", c->size, _Bench_StoreData, c);
+        _Bench_Run(bench, "store", "retrieve", c->size, _Bench_RetrieveData, c);
+    }
+
+    _Bench_Run(bench, "kdf", "hkdf", 0, _Bench_HKDF, c);
+    _Bench_Run(bench, "kdf", "concat_kdf", 0, _Bench_ConcatKDF, c);
+    _Bench_Run(bench, "kdf", "pbekdf_1000", 0, _Bench_PBEKDF, c);
+
+    if (SEC_RESULT_SUCCESS == _Bench_MakeJType(bench, c))
+        _Bench_Run(bench, "jtype", "provision", c->token_len, _Bench_JType, c);
+
+    ret = 0;
+
+done:
+    fprintf(bench->out, "\n  ]\n}\n");
+
+    if (NULL != aes)
+        SecKey_Release(aes);
+    if (NULL != hmac)
+        SecKey_Release(hmac);
+    if (NULL != rsa)
+        SecKey_Release(rsa);
+    if (NULL != ecc)
+        SecKey_Release(ecc);
+    if (NULL != ed25519)
+        SecKey_Release(ed25519);
+
+    if (NULL != bench->proc)
+    {
+        SecKey_Delete(bench->proc, BENCH_ID_FILE_KEY);
+        SecProcessor_Release(bench->proc);
+    }
+
+    if (bench->out != stdout)
+        fclose(bench->out);
+
+    SEC_FREE(c->token);
+    SEC_FREE(bench->samples);
+    SEC_FREE(c);
+    SEC_FREE(bench);
+
+    return ret;
+}
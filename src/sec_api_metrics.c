@@ -0,0 +1,238 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Prints the sec_api counters published by all processes to the shared metrics segment */
+
+#include "sec_security_metrics.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+/* number of attempts to get a consistent copy of a slot that is being updated */
+#define SEC_METRICS_READ_RETRIES 1000
+
+static const char *g_op_names[SEC_STATS_OP_NUM] = {
+    "cipher_getinstance",
+    "cipher_process",
+    "cipher_release",
+    "digest_getinstance",
+    "digest_update",
+    "digest_release",
+    "mac_getinstance",
+    "mac_update",
+    "mac_release",
+    "signature_getinstance",
+    "signature_process",
+    "signature_release",
+    "key_getinstance",
+    "store_retrieve",
+    "file_read",
+    "file_write",
+};
+
+static const char *g_cache_names[SEC_STATS_CACHE_NUM] = {
+    "ram_key",
+    "pubops_key",
+    "cert_verify",
+    "dh_params",
+    "keyexchange_pool",
+    "rsa_pool",
+    "cipher_pool",
+    "mac_pool",
+};
+
+static const char *g_result_names[SEC_RESULT_NUM] = {
+    "success",
+    "failure",
+    "invalid_parameters",
+    "no_such_item",
+    "buffer_too_small",
+    "invalid_input_size",
+    "invalid_handle",
+    "invalid_padding",
+    "unimplemented_feature",
+    "item_already_provisioned",
+    "item_non_removable",
+    "verification_failed",
+    "no_keyslots_available",
+    "svp_not_engaged",
+    "opl_not_engaged",
+    "invalid_svp_data",
+    "allocation_failed",
+};
+
+static int _ReadSlot(const Sec_MetricsSlot *slot, Sec_MetricsSlot *copy)
+{
+    int i;
+
+    for (i = 0; i < SEC_METRICS_READ_RETRIES; ++i)
+    {
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq & 1)
+            continue;
+
+        memcpy(copy, slot, sizeof(Sec_MetricsSlot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void _Add(Sec_MetricsSlot *total, const Sec_MetricsSlot *slot)
+{
+    int i;
+
+    for (i = 0; i < SEC_STATS_OP_NUM; ++i)
+    {
+        total->ops[i].count += slot->ops[i].count;
+        total->ops[i].errors += slot->ops[i].errors;
+        total->ops[i].bytes += slot->ops[i].bytes;
+        total->ops[i].total_ns += slot->ops[i].total_ns;
+    }
+
+    for (i = 0; i < SEC_STATS_CACHE_NUM; ++i)
+    {
+        total->caches[i].hits += slot->caches[i].hits;
+        total->caches[i].misses += slot->caches[i].misses;
+    }
+
+    for (i = 0; i < SEC_RESULT_NUM; ++i)
+        total->results[i] += slot->results[i];
+
+    total->outprot_denials += slot->outprot_denials;
+}
+
+static void _Print(const Sec_MetricsSlot *slot)
+{
+    int i;
+
+    for (i = 0; i < SEC_STATS_OP_NUM; ++i)
+    {
+        const Sec_MetricsOp *op = &slot->ops[i];
+
+        if (op->count == 0)
+            continue;
+
+        printf("  %-22s count %llu errors %llu bytes %llu avg_ns %llu\n", g_op_names[i],
+                (unsigned long long) op->count, (unsigned long long) op->errors,
+                (unsigned long long) op->bytes, (unsigned long long) (op->total_ns / op->count));
+    }
+
+    for (i = 0; i < SEC_STATS_CACHE_NUM; ++i)
+    {
+        const Sec_StatsCacheData *cache = &slot->caches[i];
+
+        if (cache->hits == 0 && cache->misses == 0)
+            continue;
+
+        printf("  cache %-16s hits %llu misses %llu\n", g_cache_names[i],
+                (unsigned long long) cache->hits, (unsigned long long) cache->misses);
+    }
+
+    for (i = 0; i < SEC_RESULT_NUM; ++i)
+    {
+        if (slot->results[i] == 0)
+            continue;
+
+        printf("  result %-15s %llu\n", g_result_names[i], (unsigned long long) slot->results[i]);
+    }
+
+    printf("  outprot_denials %llu\n", (unsigned long long) slot->outprot_denials);
+}
+
+int main(int argc, char **argv)
+{
+    const Sec_MetricsSegment *seg;
+    const Sec_MetricsHeader *header;
+    Sec_MetricsSlot copy;
+    Sec_MetricsSlot total;
+    int shmId;
+    int procs = 0;
+    int i;
+
+    shmId = shmget(SEC_METRICS_SHM_KEY, 0, 0);
+    if (shmId < 0)
+    {
+        if (errno == ENOENT)
+        {
+            printf("no process has published metrics\n");
+            return 0;
+        }
+
+        fprintf(stderr, "shmget failed, errno=%d\n", errno);
+        return 1;
+    }
+
+    seg = (const Sec_MetricsSegment *) shmat(shmId, NULL, SHM_RDONLY);
+    if (seg == (void *) -1)
+    {
+        fprintf(stderr, "shmat failed, errno=%d\n", errno);
+        return 1;
+    }
+    header = &seg->header;
+
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SEC_METRICS_SHM_MAGIC
+            || header->version != SEC_METRICS_SHM_VERSION || header->slot_size != sizeof(Sec_MetricsSlot)
+            || header->num_slots > SEC_METRICS_MAX_PROCS)
+    {
+        fprintf(stderr, "unsupported metrics segment, version %u slot size %u\n", header->version, header->slot_size);
+        shmdt(seg);
+        return 1;
+    }
+
+    memset(&total, 0, sizeof(total));
+
+    for (i = 0; i < (int) header->num_slots; ++i)
+    {
+        if (__atomic_load_n(&seg->slots[i].pid, __ATOMIC_ACQUIRE) == 0)
+            continue;
+
+        if (!_ReadSlot(&seg->slots[i], &copy))
+        {
+            fprintf(stderr, "slot %d is being updated, skipped\n", i);
+            continue;
+        }
+
+        if (copy.pid == 0)
+            continue;
+
+        /* a process that was killed never releases its slot */
+        if (kill(copy.pid, 0) != 0 && errno == ESRCH)
+            continue;
+
+        printf("pid %d\n", copy.pid);
+        _Print(&copy);
+        _Add(&total, &copy);
+        procs++;
+    }
+
+    printf("total of %d processes\n", procs);
+    _Print(&total);
+
+    shmdt(seg);
+
+    return 0;
+}
@@ -27,6 +27,10 @@ extern "C"
 {
 #endif
 
+#ifndef SEC_PUBOPS_KEYCACHE_SIZE
+    #define SEC_PUBOPS_KEYCACHE_SIZE 16
+#endif
+
 Sec_Result _Pubops_VerifyWithPubRsa(Sec_RSARawPublicKey *pub_key, Sec_SignatureAlgorithm alg, SEC_BYTE *digest, SEC_SIZE digest_len, SEC_BYTE *sig, SEC_SIZE sig_len, int salt_len);
 Sec_Result _Pubops_VerifyWithPubEcc(Sec_ECCRawPublicKey *pub_key, Sec_SignatureAlgorithm alg, SEC_BYTE *digest, SEC_SIZE digest_len, SEC_BYTE *sig, SEC_SIZE sig_len);
 Sec_Result _Pubops_EncryptWithPubRsa(Sec_RSARawPublicKey *pub_key, Sec_CipherAlgorithm alg, SEC_BYTE *in, SEC_SIZE in_len, SEC_BYTE *out, SEC_SIZE out_len);
@@ -35,10 +39,18 @@ Sec_Result _Pubops_VerifyX509WithPubRsa(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_R
 Sec_Result _Pubops_VerifyX509WithPubEcc(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_ECCRawPublicKey *pub);
 Sec_Result _Pubops_ExtractRSAPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_RSARawPublicKey *pub);
 Sec_Result _Pubops_ExtractECCPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_ECCRawPublicKey *pub);
+Sec_Result _Pubops_VerifyX509ObjWithPubRsa(X509 *x509, Sec_RSARawPublicKey *pub);
+Sec_Result _Pubops_VerifyX509ObjWithPubEcc(X509 *x509, Sec_ECCRawPublicKey *pub);
+Sec_Result _Pubops_ExtractRSAPubFromX509(X509 *x509, Sec_RSARawPublicKey *pub);
+Sec_Result _Pubops_ExtractECCPubFromX509(X509 *x509, Sec_ECCRawPublicKey *pub);
 Sec_Result _Pubops_ExtractRSAPubFromPUBKEYDer(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_RSARawPublicKey *pub);
 Sec_Result _Pubops_ExtractECCPubFromPUBKEYDer(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_ECCRawPublicKey *pub);
 Sec_Result _Pubops_Random(SEC_BYTE* out, SEC_SIZE out_len);
 Sec_Result _Pubops_RandomPrng(SEC_BYTE* out, SEC_SIZE out_len);
+void _Pubops_FlushKeyCache(void);
+/* SHA-256 identifying a raw public key, as used by the parsed key cache */
+void _Pubops_HashRsaPub(Sec_RSARawPublicKey *binary, SEC_BYTE *hash);
+void _Pubops_HashEccPub(Sec_ECCRawPublicKey *binary, SEC_BYTE *hash);
 Sec_Result _Pubops_HMAC(Sec_MacAlgorithm alg, SEC_BYTE *key, SEC_SIZE key_len, SEC_BYTE *input, SEC_SIZE input_len, SEC_BYTE *mac, SEC_SIZE mac_len);
 
 typedef struct _Pubops_DH_struct _Pubops_DH;
@@ -19,6 +19,7 @@
 
 #include "sec_pubops.h"
 #include "sec_security_common.h"
+#include "sec_security_stats.h"
 #include <string.h>
 #include <openssl/rsa.h>
 #include <openssl/err.h>
@@ -28,6 +29,8 @@
 #include <openssl/rand.h>
 #include <openssl/hmac.h>
 #include <openssl/cmac.h>
+#include <openssl/sha.h>
+#include <pthread.h>
 
 static Sec_Result _SecUtils_BigNumToBuffer(const BIGNUM *bignum, SEC_BYTE *buffer, SEC_SIZE buffer_len)
 {
@@ -100,6 +103,195 @@ done:
     return ec_key;
 }
 
+/* parsed public key cache, keyed by a digest of the significant raw key bytes */
+typedef struct
+{
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    SEC_BOOL valid;
+    uint64_t last_used;
+    RSA *rsa;
+    EC_KEY *ec_key;
+} _Pubops_KeyCacheEntry;
+
+static _Pubops_KeyCacheEntry g_key_cache[SEC_PUBOPS_KEYCACHE_SIZE];
+static uint64_t g_key_cache_tick = 0;
+static pthread_mutex_t g_key_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* only the significant bytes of the raw key are hashed so that unused trailing bytes do not matter */
+void _Pubops_HashRsaPub(Sec_RSARawPublicKey *binary, SEC_BYTE *hash)
+{
+    SHA256_CTX ctx;
+    SEC_SIZE len = Sec_BEBytesToUint32(binary->modulus_len_be);
+    SEC_BYTE tag = 'R';
+
+    if (len > SEC_RSA_KEY_MAX_LEN)
+        len = SEC_RSA_KEY_MAX_LEN;
+
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, &tag, 1);
+    SHA256_Update(&ctx, binary->modulus_len_be, sizeof(binary->modulus_len_be));
+    SHA256_Update(&ctx, binary->e, sizeof(binary->e));
+    SHA256_Update(&ctx, binary->n, len);
+    SHA256_Final(hash, &ctx);
+}
+
+void _Pubops_HashEccPub(Sec_ECCRawPublicKey *binary, SEC_BYTE *hash)
+{
+    SHA256_CTX ctx;
+    SEC_SIZE len = Sec_BEBytesToUint32(binary->key_len);
+    SEC_BYTE tag = 'E';
+    SEC_BYTE type_be[4];
+
+    if (len > SEC_EC_KEY_MAX_LEN)
+        len = SEC_EC_KEY_MAX_LEN;
+
+    Sec_Uint32ToBEBytes((uint32_t) binary->type, type_be);
+
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, &tag, 1);
+    SHA256_Update(&ctx, type_be, sizeof(type_be));
+    SHA256_Update(&ctx, binary->key_len, sizeof(binary->key_len));
+    SHA256_Update(&ctx, binary->x, len);
+    SHA256_Update(&ctx, binary->y, len);
+    SHA256_Final(hash, &ctx);
+}
+
+/* must be called with g_key_cache_mutex held */
+static _Pubops_KeyCacheEntry *_Pubops_KeyCacheFind(SEC_BYTE *hash)
+{
+    int i;
+
+    for (i = 0; i < SEC_PUBOPS_KEYCACHE_SIZE; ++i)
+    {
+        if (g_key_cache[i].valid && 0 == memcmp(g_key_cache[i].hash, hash, SHA256_DIGEST_LENGTH))
+        {
+            g_key_cache[i].last_used = ++g_key_cache_tick;
+            return &g_key_cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* must be called with g_key_cache_mutex held, evicts the least recently used entry */
+static _Pubops_KeyCacheEntry *_Pubops_KeyCacheSlot(SEC_BYTE *hash)
+{
+    _Pubops_KeyCacheEntry *slot = &g_key_cache[0];
+    int i;
+
+    for (i = 0; i < SEC_PUBOPS_KEYCACHE_SIZE; ++i)
+    {
+        if (!g_key_cache[i].valid)
+        {
+            slot = &g_key_cache[i];
+            break;
+        }
+
+        if (g_key_cache[i].last_used < slot->last_used)
+            slot = &g_key_cache[i];
+    }
+
+    SEC_RSA_FREE(slot->rsa);
+    SEC_ECC_FREE(slot->ec_key);
+    memset(slot, 0, sizeof(_Pubops_KeyCacheEntry));
+
+    memcpy(slot->hash, hash, SHA256_DIGEST_LENGTH);
+    slot->valid = SEC_TRUE;
+    slot->last_used = ++g_key_cache_tick;
+
+    return slot;
+}
+
+/* returns a referenced RSA object that the caller releases with SEC_RSA_FREE */
+static RSA *_Pubops_GetRsaPub(Sec_RSARawPublicKey *binary)
+{
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    _Pubops_KeyCacheEntry *entry;
+    RSA *rsa = NULL;
+
+    _Pubops_HashRsaPub(binary, hash);
+
+    pthread_mutex_lock(&g_key_cache_mutex);
+    entry = _Pubops_KeyCacheFind(hash);
+    if (entry != NULL && entry->rsa != NULL)
+    {
+        rsa = entry->rsa;
+        RSA_up_ref(rsa);
+    }
+    pthread_mutex_unlock(&g_key_cache_mutex);
+
+    SEC_STATS_CACHE(SEC_STATS_CACHE_PUBOPS_KEY, rsa != NULL);
+    if (rsa != NULL)
+        return rsa;
+
+    rsa = _SecUtils_RSAFromPubBinary(binary);
+    if (rsa == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&g_key_cache_mutex);
+    if (NULL == _Pubops_KeyCacheFind(hash))
+    {
+        entry = _Pubops_KeyCacheSlot(hash);
+        RSA_up_ref(rsa);
+        entry->rsa = rsa;
+    }
+    pthread_mutex_unlock(&g_key_cache_mutex);
+
+    return rsa;
+}
+
+/* returns a referenced EC_KEY object that the caller releases with SEC_ECC_FREE */
+static EC_KEY *_Pubops_GetEccPub(Sec_ECCRawPublicKey *binary)
+{
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    _Pubops_KeyCacheEntry *entry;
+    EC_KEY *ec_key = NULL;
+
+    _Pubops_HashEccPub(binary, hash);
+
+    pthread_mutex_lock(&g_key_cache_mutex);
+    entry = _Pubops_KeyCacheFind(hash);
+    if (entry != NULL && entry->ec_key != NULL)
+    {
+        ec_key = entry->ec_key;
+        EC_KEY_up_ref(ec_key);
+    }
+    pthread_mutex_unlock(&g_key_cache_mutex);
+
+    SEC_STATS_CACHE(SEC_STATS_CACHE_PUBOPS_KEY, ec_key != NULL);
+    if (ec_key != NULL)
+        return ec_key;
+
+    ec_key = _SecUtils_ECCFromPubBinary(binary);
+    if (ec_key == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&g_key_cache_mutex);
+    if (NULL == _Pubops_KeyCacheFind(hash))
+    {
+        entry = _Pubops_KeyCacheSlot(hash);
+        EC_KEY_up_ref(ec_key);
+        entry->ec_key = ec_key;
+    }
+    pthread_mutex_unlock(&g_key_cache_mutex);
+
+    return ec_key;
+}
+
+void _Pubops_FlushKeyCache(void)
+{
+    int i;
+
+    pthread_mutex_lock(&g_key_cache_mutex);
+    for (i = 0; i < SEC_PUBOPS_KEYCACHE_SIZE; ++i)
+    {
+        SEC_RSA_FREE(g_key_cache[i].rsa);
+        SEC_ECC_FREE(g_key_cache[i].ec_key);
+        memset(&g_key_cache[i], 0, sizeof(_Pubops_KeyCacheEntry));
+    }
+    pthread_mutex_unlock(&g_key_cache_mutex);
+}
+
 static int _SecUtils_ElGamal_Encrypt_Rand(EC_KEY *ec_key,
                                   SEC_BYTE* input, SEC_SIZE inputSize,
                                   SEC_BYTE* output, SEC_SIZE outputSize,
@@ -317,7 +509,7 @@ static Sec_Result _SecUtils_VerifyX509WithRawRSAPublicKey(X509 *x509,
     EVP_PKEY *evp_key = NULL;
     int verify_res;
 
-    rsa = _SecUtils_RSAFromPubBinary(public_key);
+    rsa = _Pubops_GetRsaPub(public_key);
     if (rsa == NULL)
     {
         SEC_LOG_ERROR("_Sec_ReadRSAPublic failed");
@@ -354,11 +546,11 @@ error: if (rsa != NULL)
 }
 
 Sec_Result _Pubops_VerifyWithPubRsa(Sec_RSARawPublicKey *pub_key, Sec_SignatureAlgorithm alg, SEC_BYTE *digest, SEC_SIZE digest_len, SEC_BYTE *sig, SEC_SIZE sig_len, int salt_len) {
-	RSA *rsa = _SecUtils_RSAFromPubBinary(pub_key);
+	RSA *rsa = _Pubops_GetRsaPub(pub_key);
 	Sec_Result res = SEC_RESULT_FAILURE;
 
 	if (rsa == NULL) {
-		SEC_LOG_ERROR("_SecUtils_RSAFromPubBinary failed");
+		SEC_LOG_ERROR("_Pubops_GetRsaPub failed");
 		goto done;
 	}
 
@@ -412,12 +604,12 @@ done:
 }
 
 Sec_Result _Pubops_VerifyWithPubEcc(Sec_ECCRawPublicKey *pub_key, Sec_SignatureAlgorithm alg, SEC_BYTE *digest, SEC_SIZE digest_len, SEC_BYTE *sig, SEC_SIZE sig_len) {
-	EC_KEY *ec_key = _SecUtils_ECCFromPubBinary(pub_key);
+	EC_KEY *ec_key = _Pubops_GetEccPub(pub_key);
 	Sec_Result res = SEC_RESULT_FAILURE;
 
 	if (NULL == ec_key)
 	{
-	    SEC_LOG_ERROR("_SecUtils_ECCFromPubBinary failed");
+	    SEC_LOG_ERROR("_Pubops_GetEccPub failed");
 	    goto done;
 	}
 
@@ -456,11 +648,11 @@ done:
 }
 
 Sec_Result _Pubops_EncryptWithPubRsa(Sec_RSARawPublicKey *pub_key, Sec_CipherAlgorithm alg, SEC_BYTE *in, SEC_SIZE in_len, SEC_BYTE *out, SEC_SIZE out_len) {
-	RSA *rsa = _SecUtils_RSAFromPubBinary(pub_key);
+	RSA *rsa = _Pubops_GetRsaPub(pub_key);
 	Sec_Result res = SEC_RESULT_FAILURE;
 
 	if (rsa == NULL) {
-		SEC_LOG_ERROR("_SecUtils_RSAFromPubBinary failed");
+		SEC_LOG_ERROR("_Pubops_GetRsaPub failed");
 		goto done;
 	}
 
@@ -505,10 +697,10 @@ static Sec_Result _SecUtils_VerifyX509WithRawECCPublicKey(X509 *x509,
     EVP_PKEY *evp_key = NULL;
     int verify_res;
 
-    ec_key = _SecUtils_ECCFromPubBinary(public_key);
+    ec_key = _Pubops_GetEccPub(public_key);
     if (ec_key == NULL)
     {
-        SEC_LOG_ERROR("_SecUtils_ECCFromPubBinary failed");
+        SEC_LOG_ERROR("_Pubops_GetEccPub failed");
         goto error;
     }
 
@@ -541,12 +733,12 @@ error:
 }
 
 Sec_Result _Pubops_EncryptWithPubEcc(Sec_ECCRawPublicKey *pub_key, Sec_CipherAlgorithm alg, SEC_BYTE *in, SEC_SIZE in_len, SEC_BYTE *out, SEC_SIZE out_len) {
-	EC_KEY *ec_key = _SecUtils_ECCFromPubBinary(pub_key);
+	EC_KEY *ec_key = _Pubops_GetEccPub(pub_key);
 	Sec_Result res = SEC_RESULT_FAILURE;
 
 	if (NULL == ec_key)
 	{
-	    SEC_LOG_ERROR("_SecUtils_ECCFromPubBinary failed");
+	    SEC_LOG_ERROR("_Pubops_GetEccPub failed");
 	    goto done;
 	}
 
@@ -569,6 +761,14 @@ done:
 	return res;
 }
 
+Sec_Result _Pubops_VerifyX509ObjWithPubRsa(X509 *x509, Sec_RSARawPublicKey *pub) {
+    return _SecUtils_VerifyX509WithRawRSAPublicKey(x509, pub);
+}
+
+Sec_Result _Pubops_VerifyX509ObjWithPubEcc(X509 *x509, Sec_ECCRawPublicKey *pub) {
+    return _SecUtils_VerifyX509WithRawECCPublicKey(x509, pub);
+}
+
 Sec_Result _Pubops_VerifyX509WithPubRsa(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_RSARawPublicKey *pub) {
     X509 *x509 = SecCertificate_DerToX509(cert, cert_len);
 	Sec_Result res = SEC_RESULT_FAILURE;
@@ -611,17 +811,11 @@ done:
 	return res;
 }
 
-Sec_Result _Pubops_ExtractRSAPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_RSARawPublicKey *pub) {
-    X509 *x509 = SecCertificate_DerToX509(cert, cert_len);
+Sec_Result _Pubops_ExtractRSAPubFromX509(X509 *x509, Sec_RSARawPublicKey *pub) {
     EVP_PKEY *evp_key = NULL;
     RSA *rsa = NULL;
 	Sec_Result res = SEC_RESULT_FAILURE;
 
-    if (NULL == x509) {
-    	SEC_LOG_ERROR("SecCertificate_DerToX509 failed");
-    	goto done;
-    }
-
     evp_key = X509_get_pubkey(x509);
     if (evp_key == NULL)
     {
@@ -641,13 +835,28 @@ Sec_Result _Pubops_ExtractRSAPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, S
 
     res = SEC_RESULT_SUCCESS;
 done:
-	SEC_X509_FREE(x509);
 	SEC_EVPPKEY_FREE(evp_key);
 	SEC_RSA_FREE(rsa);
 
 	return res;
 }
 
+Sec_Result _Pubops_ExtractRSAPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_RSARawPublicKey *pub) {
+    X509 *x509 = SecCertificate_DerToX509(cert, cert_len);
+	Sec_Result res = SEC_RESULT_FAILURE;
+
+    if (NULL == x509) {
+    	SEC_LOG_ERROR("SecCertificate_DerToX509 failed");
+    	goto done;
+    }
+
+    res = _Pubops_ExtractRSAPubFromX509(x509, pub);
+done:
+	SEC_X509_FREE(x509);
+
+	return res;
+}
+
 static Sec_Result _SecUtils_Extract_EC_KEY_X_Y(const EC_KEY *ec_key, BIGNUM **xp, BIGNUM **yp, Sec_KeyType *keyTypep)
 {
     const EC_GROUP *group = NULL;
@@ -728,8 +937,7 @@ error:
     return res;
 }
 
-Sec_Result _Pubops_ExtractECCPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_ECCRawPublicKey *pub) {
-    X509 *x509 = SecCertificate_DerToX509(cert, cert_len);
+Sec_Result _Pubops_ExtractECCPubFromX509(X509 *x509, Sec_ECCRawPublicKey *pub) {
     EVP_PKEY *evp_key = NULL;
     EC_KEY *ec_key = NULL;
     BIGNUM *x = NULL;
@@ -737,11 +945,6 @@ Sec_Result _Pubops_ExtractECCPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, S
     Sec_KeyType key_type;
 	Sec_Result res = SEC_RESULT_FAILURE;
 
-    if (NULL == x509) {
-    	SEC_LOG_ERROR("SecCertificate_DerToX509 failed");
-    	goto done;
-    }
-
     evp_key = X509_get_pubkey(x509);
     if (evp_key == NULL)
     {
@@ -775,13 +978,28 @@ done:
 	if (y != NULL) {
 	    BN_clear_free(y);
 	}
-	SEC_X509_FREE(x509);
 	SEC_EVPPKEY_FREE(evp_key);
 	SEC_ECC_FREE(ec_key);
 
 	return res;
 }
 
+Sec_Result _Pubops_ExtractECCPubFromX509Der(SEC_BYTE *cert, SEC_SIZE cert_len, Sec_ECCRawPublicKey *pub) {
+    X509 *x509 = SecCertificate_DerToX509(cert, cert_len);
+	Sec_Result res = SEC_RESULT_FAILURE;
+
+    if (NULL == x509) {
+    	SEC_LOG_ERROR("SecCertificate_DerToX509 failed");
+    	goto done;
+    }
+
+    res = _Pubops_ExtractECCPubFromX509(x509, pub);
+done:
+	SEC_X509_FREE(x509);
+
+	return res;
+}
+
 static RSA *_SecUtils_RSAFromDERPub(SEC_BYTE *der, SEC_SIZE der_len)
 {
     const unsigned char *p = (const unsigned char *) der;
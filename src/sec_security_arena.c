@@ -0,0 +1,167 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "sec_security_arena.h"
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#if SEC_ARENA_SLAB_OBJECTS > 32
+    #error "SEC_ARENA_SLAB_OBJECTS does not fit the slab bitmap"
+#endif
+
+typedef struct
+{
+    SEC_BYTE *base;
+    SEC_SIZE len;
+    /* a set bit marks an object as handed out */
+    uint32_t used;
+} _Sec_ArenaSlab;
+
+#define SEC_ARENA_SLAB_FULL ((uint32_t) (((uint64_t) 1 << SEC_ARENA_SLAB_OBJECTS) - 1))
+
+static pthread_mutex_t g_arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Sec_ArenaSlab g_arena_slabs[SEC_ARENA_MAX_SLABS];
+static SEC_SIZE g_arena_slabs_num = 0;
+
+/* called with g_arena_mutex held */
+static _Sec_ArenaSlab *_SecArena_AddSlab(void)
+{
+    _Sec_ArenaSlab *slab;
+    long page = sysconf(_SC_PAGESIZE);
+    SEC_SIZE len = SEC_ARENA_SLAB_OBJECTS * SEC_ARENA_OBJECT_SIZE;
+    void *base;
+
+    if (g_arena_slabs_num >= SEC_ARENA_MAX_SLABS)
+        return NULL;
+
+    if (page > 0)
+        len = (len + page - 1) / page * page;
+
+    base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == base)
+    {
+        SEC_LOG_ERROR("mmap failed with errno %d", errno);
+        return NULL;
+    }
+
+    /* an unlocked slab still keeps the keys out of core dumps */
+    if (0 != mlock(base, len))
+        SEC_LOG_ERROR("mlock failed with errno %d, key buffers may be swapped", errno);
+
+#ifdef MADV_DONTDUMP
+    if (0 != madvise(base, len, MADV_DONTDUMP))
+        SEC_LOG_ERROR("madvise failed with errno %d", errno);
+#endif
+
+    slab = &g_arena_slabs[g_arena_slabs_num++];
+    slab->base = (SEC_BYTE *) base;
+    slab->len = len;
+    slab->used = 0;
+
+    return slab;
+}
+
+/* called with g_arena_mutex held */
+static _Sec_ArenaSlab *_SecArena_FindSlab(const void *ptr)
+{
+    SEC_SIZE i;
+
+    for (i = 0; i < g_arena_slabs_num; ++i)
+    {
+        const SEC_BYTE *base = g_arena_slabs[i].base;
+
+        if ((const SEC_BYTE *) ptr >= base && (const SEC_BYTE *) ptr < base + SEC_ARENA_SLAB_OBJECTS * SEC_ARENA_OBJECT_SIZE)
+            return &g_arena_slabs[i];
+    }
+
+    return NULL;
+}
+
+void *SecArena_Alloc(void)
+{
+    _Sec_ArenaSlab *slab = NULL;
+    SEC_SIZE i;
+    SEC_SIZE obj;
+
+    pthread_mutex_lock(&g_arena_mutex);
+
+    for (i = 0; i < g_arena_slabs_num; ++i)
+    {
+        if (g_arena_slabs[i].used != SEC_ARENA_SLAB_FULL)
+        {
+            slab = &g_arena_slabs[i];
+            break;
+        }
+    }
+
+    if (NULL == slab)
+        slab = _SecArena_AddSlab();
+
+    if (NULL == slab)
+    {
+        i = g_arena_slabs_num;
+        pthread_mutex_unlock(&g_arena_mutex);
+
+        /* key material never falls back to unlocked heap memory */
+        SEC_LOG_ERROR("Arena exhausted with %d slabs", (int) i);
+        return NULL;
+    }
+
+    obj = (SEC_SIZE) __builtin_ctz(~slab->used);
+    slab->used |= (uint32_t) 1 << obj;
+
+    pthread_mutex_unlock(&g_arena_mutex);
+
+    /* objects are zeroed when they are freed */
+    return slab->base + obj * SEC_ARENA_OBJECT_SIZE;
+}
+
+void SecArena_Free(void *ptr)
+{
+    _Sec_ArenaSlab *slab;
+    SEC_SIZE offset;
+
+    if (NULL == ptr)
+        return;
+
+    Sec_Memset(ptr, 0, SEC_ARENA_OBJECT_SIZE);
+
+    pthread_mutex_lock(&g_arena_mutex);
+
+    slab = _SecArena_FindSlab(ptr);
+    if (NULL == slab)
+    {
+        pthread_mutex_unlock(&g_arena_mutex);
+        SEC_LOG_ERROR("Invalid arena object %p", ptr);
+        return;
+    }
+
+    offset = (SEC_SIZE) ((SEC_BYTE *) ptr - slab->base);
+    if (0 != offset % SEC_ARENA_OBJECT_SIZE || 0 == (slab->used & ((uint32_t) 1 << (offset / SEC_ARENA_OBJECT_SIZE))))
+        SEC_LOG_ERROR("Invalid arena object %p", ptr);
+    else
+        slab->used &= ~((uint32_t) 1 << (offset / SEC_ARENA_OBJECT_SIZE));
+
+    pthread_mutex_unlock(&g_arena_mutex);
+}
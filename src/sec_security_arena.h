@@ -0,0 +1,53 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SEC_SECURITY_ARENA_H_
+#define SEC_SECURITY_ARENA_H_
+
+#include "sec_security.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* every object holds one key container */
+#define SEC_ARENA_OBJECT_SIZE SEC_KEYCONTAINER_MAX_LEN
+
+/* objects per locked slab, at most 32 */
+#ifndef SEC_ARENA_SLAB_OBJECTS
+    #define SEC_ARENA_SLAB_OBJECTS 16
+#endif
+
+/* slabs are never unmapped, allocations fail once all of them are in use */
+#ifndef SEC_ARENA_MAX_SLABS
+    #define SEC_ARENA_MAX_SLABS 16
+#endif
+
+/* SEC_ARENA_OBJECT_SIZE bytes of locked memory kept out of core dumps, NULL if the arena is exhausted */
+void *SecArena_Alloc(void);
+/* zero an object from SecArena_Alloc and return it to the arena, NULL is ignored */
+void SecArena_Free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEC_SECURITY_ARENA_H_ */
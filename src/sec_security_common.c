@@ -49,9 +49,9 @@ int Sec_Memcmp(const void* ptr1, const void* ptr2, const size_t num)
 
 void *Sec_Memset(void *ptr, int value, size_t num)
 {
-	volatile SEC_BYTE *p = (SEC_BYTE *) ptr;
-	while (num--)
-		*p++ = value;
+	memset(ptr, value, num);
+	/* the barrier keeps the compiler from dropping a memset of memory that is not read again */
+	__asm__ __volatile__("" : : "r"(ptr) : "memory");
 	return ptr;
 }
 
@@ -541,6 +541,23 @@ Sec_Result SecSignature_IsValidKey(Sec_KeyType key_type,
 				return SEC_RESULT_FAILURE;
 		}
 		break;
+	case SEC_SIGNATUREALGORITHM_ED25519:
+		if (mode == SEC_SIGNATUREMODE_SIGN)
+		{
+			if (key_type == SEC_KEYTYPE_ED25519)
+				return SEC_RESULT_SUCCESS;
+			else
+				return SEC_RESULT_FAILURE;
+		}
+		else
+		{
+			if (key_type == SEC_KEYTYPE_ED25519
+					|| key_type == SEC_KEYTYPE_ED25519_PUBLIC)
+				return SEC_RESULT_SUCCESS;
+			else
+				return SEC_RESULT_FAILURE;
+		}
+		break;
 
 
 		/* NEW: add new key types and signature algorithms */
@@ -989,6 +1006,11 @@ SEC_SIZE SecKey_GetKeyLenForKeyType(Sec_KeyType keyType)
 	case SEC_KEYTYPE_ECC_NISTP256:
 	case SEC_KEYTYPE_ECC_NISTP256_PUBLIC:
 		return SEC_ECC_NISTP256_KEY_LEN;
+	case SEC_KEYTYPE_X25519:
+	case SEC_KEYTYPE_X25519_PUBLIC:
+	case SEC_KEYTYPE_ED25519:
+	case SEC_KEYTYPE_ED25519_PUBLIC:
+		return SEC_CURVE25519_KEY_LEN;
 
 		/* NEW: add new key types here */
 	default:
@@ -1142,6 +1164,38 @@ SEC_BOOL SecKey_IsPrivEcc(Sec_KeyType type)
 	return 0;
 }
 
+SEC_BOOL SecKey_IsCurve25519(Sec_KeyType type)
+{
+	switch (type)
+	{
+	case SEC_KEYTYPE_X25519:
+	case SEC_KEYTYPE_X25519_PUBLIC:
+	case SEC_KEYTYPE_ED25519:
+	case SEC_KEYTYPE_ED25519_PUBLIC:
+		return 1;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+SEC_BOOL SecKey_IsPrivCurve25519(Sec_KeyType type)
+{
+	switch (type)
+	{
+	case SEC_KEYTYPE_X25519:
+	case SEC_KEYTYPE_ED25519:
+		return 1;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
 SEC_BOOL SecKey_IsProvisioned(Sec_ProcessorHandle* secProcHandle,
 		SEC_OBJECTID object_id)
 {
@@ -1300,6 +1354,10 @@ SEC_BOOL SecKey_IsClearKeyContainer(Sec_KeyContainer kct)
 	case SEC_KEYCONTAINER_PEM_RSA_3072_PUBLIC:
 	case SEC_KEYCONTAINER_RAW_ECC_NISTP256:
 	case SEC_KEYCONTAINER_RAW_ECC_NISTP256_PUBLIC:
+	case SEC_KEYCONTAINER_RAW_X25519:
+	case SEC_KEYCONTAINER_RAW_X25519_PUBLIC:
+	case SEC_KEYCONTAINER_RAW_ED25519:
+	case SEC_KEYCONTAINER_RAW_ED25519_PUBLIC:
 		return SEC_TRUE;
 		break;
 
@@ -1340,6 +1398,14 @@ Sec_KeyContainer SecKey_GetClearContainer(Sec_KeyType key_type)
 		return SEC_KEYCONTAINER_RAW_ECC_NISTP256;
 	case SEC_KEYTYPE_ECC_NISTP256_PUBLIC:
 		return SEC_KEYCONTAINER_RAW_ECC_NISTP256_PUBLIC;
+	case SEC_KEYTYPE_X25519:
+		return SEC_KEYCONTAINER_RAW_X25519;
+	case SEC_KEYTYPE_X25519_PUBLIC:
+		return SEC_KEYCONTAINER_RAW_X25519_PUBLIC;
+	case SEC_KEYTYPE_ED25519:
+		return SEC_KEYCONTAINER_RAW_ED25519;
+	case SEC_KEYTYPE_ED25519_PUBLIC:
+		return SEC_KEYCONTAINER_RAW_ED25519_PUBLIC;
 	default:
 		break;
 	}
@@ -1406,6 +1472,22 @@ Sec_KeyType SecKey_GetKeyTypeForClearKeyContainer(Sec_KeyContainer kc)
     case SEC_KEYCONTAINER_DER_ECC_NISTP256_PUBLIC:
     	return SEC_KEYTYPE_ECC_NISTP256_PUBLIC;
 
+    case SEC_KEYCONTAINER_RAW_X25519:
+    case SEC_KEYCONTAINER_DER_X25519:
+    	return SEC_KEYTYPE_X25519;
+
+    case SEC_KEYCONTAINER_RAW_X25519_PUBLIC:
+    case SEC_KEYCONTAINER_DER_X25519_PUBLIC:
+    	return SEC_KEYTYPE_X25519_PUBLIC;
+
+    case SEC_KEYCONTAINER_RAW_ED25519:
+    case SEC_KEYCONTAINER_DER_ED25519:
+    	return SEC_KEYTYPE_ED25519;
+
+    case SEC_KEYCONTAINER_RAW_ED25519_PUBLIC:
+    case SEC_KEYCONTAINER_DER_ED25519_PUBLIC:
+    	return SEC_KEYTYPE_ED25519_PUBLIC;
+
     default:
     	return SEC_KEYTYPE_NUM;
 	}
@@ -20,6 +20,7 @@
 #if !defined(SEC_PUBOPS_TOMCRYPT)
 
 #include "sec_security.h"
+#include "sec_security_utils.h"
 #include <pthread.h>
 #include <openssl/engine.h>
 
@@ -28,6 +29,8 @@ static SEC_BOOL g_sec_openssl_inited = 0;
 static int _Sec_OpenSSLPrivSign(int type, const unsigned char *m, unsigned int m_len,
     unsigned char *sigret, unsigned int *siglen, const RSA *rsa)
 {
+    SEC_BYTE sigStorage[SEC_SIGNATUREHANDLE_STORAGE_SIZE] __attribute__((aligned(SEC_HANDLE_STORAGE_ALIGN)));
+    Sec_SignatureHandle *sig = NULL;
     Sec_KeyHandle *key = NULL;
     Sec_SignatureAlgorithm alg;
     int ret = -1;
@@ -53,16 +56,26 @@ static int _Sec_OpenSSLPrivSign(int type, const unsigned char *m, unsigned int m
         goto cleanup;
     }
 
-    if (SEC_RESULT_SUCCESS != SecSignature_SingleInput(SecKey_GetProcessor(key),
-            alg, SEC_SIGNATUREMODE_SIGN, key, (SEC_BYTE*) m, m_len,
+    /* the key is pinned, so signing neither allocates nor goes back to the key store */
+    if (SEC_RESULT_SUCCESS != SecSignature_Init(SecKey_GetProcessor(key),
+            alg, SEC_SIGNATUREMODE_SIGN, key, sigStorage, sizeof(sigStorage), &sig))
+    {
+        SEC_LOG_ERROR("SecSignature_Init failed");
+        goto cleanup;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecSignature_Process(sig, (SEC_BYTE*) m, m_len,
             (SEC_BYTE*) sigret, siglen))
     {
-        SEC_LOG_ERROR("SecSignature_SingleInput failed");
+        SEC_LOG_ERROR("SecSignature_Process failed");
         goto cleanup;
     }
 
     ret = 1;
 cleanup:
+    if (NULL != sig)
+        SecSignature_Cleanup(sig);
+
     return ret;
 }
 
@@ -74,6 +87,8 @@ static int _Sec_OpenSSLPubVerify(int type, const unsigned char *m, unsigned int
     const unsigned char *sigret, unsigned int siglen, const RSA *rsa)
 #endif
 {
+    SEC_BYTE sigStorage[SEC_SIGNATUREHANDLE_STORAGE_SIZE] __attribute__((aligned(SEC_HANDLE_STORAGE_ALIGN)));
+    Sec_SignatureHandle *sig = NULL;
     Sec_KeyHandle *key = NULL;
     Sec_SignatureAlgorithm alg;
     int ret = -1;
@@ -99,16 +114,25 @@ static int _Sec_OpenSSLPubVerify(int type, const unsigned char *m, unsigned int
         goto cleanup;
     }
 
-    if (SEC_RESULT_SUCCESS != SecSignature_SingleInput(SecKey_GetProcessor(key),
-            alg, SEC_SIGNATUREMODE_VERIFY, key, (SEC_BYTE*) m, m_len,
+    if (SEC_RESULT_SUCCESS != SecSignature_Init(SecKey_GetProcessor(key),
+            alg, SEC_SIGNATUREMODE_VERIFY, key, sigStorage, sizeof(sigStorage), &sig))
+    {
+        SEC_LOG_ERROR("SecSignature_Init failed");
+        goto cleanup;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecSignature_Process(sig, (SEC_BYTE*) m, m_len,
             (SEC_BYTE*) sigret, &siglen))
     {
-        SEC_LOG_ERROR("SecSignature_SingleInput failed");
+        SEC_LOG_ERROR("SecSignature_Process failed");
         goto cleanup;
     }
 
     ret = 1;
 cleanup:
+    if (NULL != sig)
+        SecSignature_Cleanup(sig);
+
     return ret;
 }
 
@@ -120,6 +144,8 @@ static int _Sec_OpenSSLPubEncrypt(int flen, const unsigned char *from,
         unsigned char *to, RSA *rsa, int padding)
 #endif
 {
+    SEC_BYTE cipherStorage[SEC_CIPHERHANDLE_STORAGE_SIZE] __attribute__((aligned(SEC_HANDLE_STORAGE_ALIGN)));
+    Sec_CipherHandle *cipher = NULL;
     Sec_KeyHandle *key = NULL;
     Sec_CipherAlgorithm alg;
     SEC_SIZE written;
@@ -146,16 +172,25 @@ static int _Sec_OpenSSLPubEncrypt(int flen, const unsigned char *from,
         goto cleanup;
     }
 
-    if (SEC_RESULT_SUCCESS != SecCipher_SingleInput(SecKey_GetProcessor(key),
-            alg, SEC_CIPHERMODE_ENCRYPT, key, NULL,
-            (SEC_BYTE*) from, flen, (SEC_BYTE*) to, SecKey_GetKeyLen(key), &written))
+    if (SEC_RESULT_SUCCESS != SecCipher_Init(SecKey_GetProcessor(key),
+            alg, SEC_CIPHERMODE_ENCRYPT, key, NULL, cipherStorage, sizeof(cipherStorage), &cipher))
+    {
+        SEC_LOG_ERROR("SecCipher_Init failed");
+        goto cleanup;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecCipher_Process(cipher, (SEC_BYTE*) from, flen, SEC_TRUE,
+            (SEC_BYTE*) to, SecKey_GetKeyLen(key), &written))
     {
-        SEC_LOG_ERROR("SecSignature_SingleInput failed");
+        SEC_LOG_ERROR("SecCipher_Process failed");
         goto cleanup;
     }
 
     ret = written;
 cleanup:
+    if (NULL != cipher)
+        SecCipher_Cleanup(cipher);
+
     return ret;
 }
 
@@ -167,6 +202,8 @@ static int _Sec_OpenSSLPrivDecrypt(int flen, const unsigned char *from,
         unsigned char *to, RSA *rsa, int padding)
 #endif
 {
+    SEC_BYTE cipherStorage[SEC_CIPHERHANDLE_STORAGE_SIZE] __attribute__((aligned(SEC_HANDLE_STORAGE_ALIGN)));
+    Sec_CipherHandle *cipher = NULL;
     Sec_KeyHandle *key = NULL;
     Sec_CipherAlgorithm alg;
     SEC_SIZE written;
@@ -193,16 +230,25 @@ static int _Sec_OpenSSLPrivDecrypt(int flen, const unsigned char *from,
         goto cleanup;
     }
 
-    if (SEC_RESULT_SUCCESS != SecCipher_SingleInput(SecKey_GetProcessor(key),
-            alg, SEC_CIPHERMODE_DECRYPT, key, NULL,
-            (SEC_BYTE*) from, flen, (SEC_BYTE*) to, SecKey_GetKeyLen(key), &written))
+    if (SEC_RESULT_SUCCESS != SecCipher_Init(SecKey_GetProcessor(key),
+            alg, SEC_CIPHERMODE_DECRYPT, key, NULL, cipherStorage, sizeof(cipherStorage), &cipher))
     {
-        SEC_LOG_ERROR("SecSignature_SingleInput failed");
+        SEC_LOG_ERROR("SecCipher_Init failed");
+        goto cleanup;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecCipher_Process(cipher, (SEC_BYTE*) from, flen, SEC_TRUE,
+            (SEC_BYTE*) to, SecKey_GetKeyLen(key), &written))
+    {
+        SEC_LOG_ERROR("SecCipher_Process failed");
         goto cleanup;
     }
 
     ret = written;
 cleanup:
+    if (NULL != cipher)
+        SecCipher_Cleanup(cipher);
+
     return ret;
 }
 
@@ -307,9 +353,8 @@ void Sec_PrintOpenSSLVersion()
     SEC_PRINT("Running against: %s\n", SSLeay_version(SSLEAY_VERSION));
 }
 
-RSA* SecKey_ToEngineRSA(Sec_KeyHandle *key)
+static RSA* _Sec_ToEngineRSA(Sec_KeyHandle *key, Sec_RSARawPublicKey *pubKey)
 {
-    Sec_RSARawPublicKey pubKey;
     RSA *rsa = NULL;
     ENGINE* engine = NULL;
 
@@ -320,9 +365,10 @@ RSA* SecKey_ToEngineRSA(Sec_KeyHandle *key)
         return NULL;
     }
 
-    if (SEC_RESULT_SUCCESS != SecKey_ExtractRSAPublicKey(key, &pubKey))
+    /* keep the key parsed for the handshakes made with the engine key */
+    if (SEC_RESULT_SUCCESS != SecKey_Pin(key))
     {
-        SEC_LOG_ERROR("SecKey_ExtractRSAPublicKey failed");
+        SEC_LOG_ERROR("SecKey_Pin failed");
         return NULL;
     }
 
@@ -334,12 +380,12 @@ RSA* SecKey_ToEngineRSA(Sec_KeyHandle *key)
     }
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
-    rsa->n = BN_bin2bn(pubKey.n, Sec_BEBytesToUint32(pubKey.modulus_len_be), NULL);
-    rsa->e = BN_bin2bn(pubKey.e, 4, NULL);
+    rsa->n = BN_bin2bn(pubKey->n, Sec_BEBytesToUint32(pubKey->modulus_len_be), NULL);
+    rsa->e = BN_bin2bn(pubKey->e, 4, NULL);
 #else
     RSA_set0_key(rsa,
-        BN_bin2bn(pubKey.n, Sec_BEBytesToUint32(pubKey.modulus_len_be), NULL),
-        BN_bin2bn(pubKey.e, 4, NULL),
+        BN_bin2bn(pubKey->n, Sec_BEBytesToUint32(pubKey->modulus_len_be), NULL),
+        BN_bin2bn(pubKey->e, 4, NULL),
         NULL);
 #endif
 
@@ -348,45 +394,30 @@ RSA* SecKey_ToEngineRSA(Sec_KeyHandle *key)
     return rsa;
 }
 
-RSA* SecKey_ToEngineRSAWithCert(Sec_KeyHandle *key, Sec_CertificateHandle *cert)
+RSA* SecKey_ToEngineRSA(Sec_KeyHandle *key)
 {
     Sec_RSARawPublicKey pubKey;
-    RSA *rsa = NULL;
-    ENGINE* engine = NULL;
 
-    engine = ENGINE_by_id("securityapi");
-    if (NULL == engine)
+    if (SEC_RESULT_SUCCESS != SecKey_ExtractRSAPublicKey(key, &pubKey))
     {
-        SEC_LOG_ERROR("ENGINE_by_id failed");
+        SEC_LOG_ERROR("SecKey_ExtractRSAPublicKey failed");
         return NULL;
     }
 
+    return _Sec_ToEngineRSA(key, &pubKey);
+}
+
+RSA* SecKey_ToEngineRSAWithCert(Sec_KeyHandle *key, Sec_CertificateHandle *cert)
+{
+    Sec_RSARawPublicKey pubKey;
+
     if (SEC_RESULT_SUCCESS != SecCertificate_ExtractRSAPublicKey(cert, &pubKey))
     {
         SEC_LOG_ERROR("SecKey_ExtractRSAPublicKey failed");
         return NULL;
     }
 
-    rsa = RSA_new_method(engine);
-    if (NULL == rsa)
-    {
-        SEC_LOG_ERROR("RSA_new_method failed");
-        return NULL;
-    }
-
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-    rsa->n = BN_bin2bn(pubKey.n, Sec_BEBytesToUint32(pubKey.modulus_len_be), NULL);
-    rsa->e = BN_bin2bn(pubKey.e, 4, NULL);
-#else
-    RSA_set0_key(rsa,
-        BN_bin2bn(pubKey.n, Sec_BEBytesToUint32(pubKey.modulus_len_be), NULL),
-        BN_bin2bn(pubKey.e, 4, NULL),
-        NULL);
-#endif
-
-    RSA_set_app_data(rsa, key);
-
-    return rsa;
+    return _Sec_ToEngineRSA(key, &pubKey);
 }
 
 EC_KEY* SecKey_ToEngineEcc(Sec_KeyHandle *key)
@@ -407,6 +438,10 @@ X509* SecCertificate_ToX509(Sec_CertificateHandle *cert)
 {
     SEC_BYTE exportedCert[1024*64];
     SEC_SIZE exportedCertLen;
+    X509 *x509 = SecCertificate_GetCachedX509(cert);
+
+    if (NULL != x509)
+        return x509;
 
     if (SEC_RESULT_SUCCESS != SecCertificate_Export(cert, exportedCert, sizeof(exportedCert), &exportedCertLen))
     {
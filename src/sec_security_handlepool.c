@@ -0,0 +1,283 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "sec_security_openssl.h"
+#include "sec_security_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+static pthread_mutex_t g_handle_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void _SecHandlePool_FreeCipher(Sec_CipherHandle *handle)
+{
+    if (NULL != handle->evp_ctx)
+        EVP_CIPHER_CTX_free(handle->evp_ctx);
+
+    SEC_FREE(handle);
+}
+
+static void _SecHandlePool_FreeMac(Sec_MacHandle *handle)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    /* before 1.1 the HMAC_CTX is embedded in the handle */
+    if (NULL != handle->hmac_ctx)
+        HMAC_CTX_free(handle->hmac_ctx);
+#endif
+    if (NULL != handle->cmac_ctx)
+        CMAC_CTX_free(handle->cmac_ctx);
+
+    SEC_FREE(handle);
+}
+
+/* called with g_handle_pool_mutex held, frees pooled handles above limit */
+static void _SecHandlePool_Trim(_Sec_HandlePool *pool, SEC_SIZE limit)
+{
+    SEC_SIZE i;
+
+    for (i = 0; i < SEC_CIPHERALGORITHM_NUM && pool->ciphers_num > limit; ++i)
+    {
+        while (NULL != pool->ciphers[i] && pool->ciphers_num > limit)
+        {
+            Sec_CipherHandle *handle = pool->ciphers[i];
+
+            pool->ciphers[i] = handle->pool_next;
+            pool->ciphers_num--;
+            _SecHandlePool_FreeCipher(handle);
+        }
+    }
+
+    for (i = 0; i < SEC_MACALGORITHM_NUM && pool->macs_num > limit; ++i)
+    {
+        while (NULL != pool->macs[i] && pool->macs_num > limit)
+        {
+            Sec_MacHandle *handle = pool->macs[i];
+
+            pool->macs[i] = handle->pool_next;
+            pool->macs_num--;
+            _SecHandlePool_FreeMac(handle);
+        }
+    }
+}
+
+/* called with g_handle_pool_mutex held, SEC_TRUE if the last reference is gone and the caller frees the pool */
+static SEC_BOOL _SecHandlePool_Unref(_Sec_HandlePool *pool)
+{
+    return --pool->refs == 0;
+}
+
+_Sec_HandlePool *_SecHandlePool_New(void)
+{
+    _Sec_HandlePool *pool = calloc(1, sizeof(_Sec_HandlePool));
+
+    if (NULL == pool)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return NULL;
+    }
+
+    pool->capacity = SEC_HANDLEPOOL_SIZE;
+    pool->refs = 1;
+
+    return pool;
+}
+
+_Sec_HandlePool *_SecHandlePool_Ref(_Sec_HandlePool *pool)
+{
+    pthread_mutex_lock(&g_handle_pool_mutex);
+    ++pool->refs;
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    return pool;
+}
+
+Sec_CipherHandle *_SecHandlePool_TakeCipher(_Sec_HandlePool *pool, Sec_CipherAlgorithm algorithm)
+{
+    Sec_CipherHandle *handle = NULL;
+
+    if ((SEC_SIZE) algorithm >= SEC_CIPHERALGORITHM_NUM)
+        return NULL;
+
+    pthread_mutex_lock(&g_handle_pool_mutex);
+
+    if (NULL != pool->ciphers[algorithm])
+    {
+        handle = pool->ciphers[algorithm];
+        pool->ciphers[algorithm] = handle->pool_next;
+        pool->ciphers_num--;
+        handle->pool_next = NULL;
+    }
+
+    if (pool->capacity > 0)
+        SEC_STATS_CACHE(SEC_STATS_CACHE_CIPHER_POOL, NULL != handle);
+
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    return handle;
+}
+
+SEC_BOOL _SecHandlePool_PutCipher(_Sec_HandlePool *pool, Sec_CipherHandle *handle)
+{
+    SEC_BOOL pooled = SEC_FALSE;
+    SEC_BOOL last;
+
+    pthread_mutex_lock(&g_handle_pool_mutex);
+
+    if ((SEC_SIZE) handle->algorithm < SEC_CIPHERALGORITHM_NUM && pool->ciphers_num < pool->capacity)
+    {
+        handle->pool_next = pool->ciphers[handle->algorithm];
+        pool->ciphers[handle->algorithm] = handle;
+        pool->ciphers_num++;
+        pool->ciphers_high_water = SEC_MAX(pool->ciphers_high_water, pool->ciphers_num);
+        pooled = SEC_TRUE;
+    }
+    else if (pool->capacity > 0)
+    {
+        pool->discarded++;
+    }
+
+    last = _SecHandlePool_Unref(pool);
+
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    if (last)
+        SEC_FREE(pool);
+
+    return pooled;
+}
+
+Sec_MacHandle *_SecHandlePool_TakeMac(_Sec_HandlePool *pool, Sec_MacAlgorithm algorithm)
+{
+    Sec_MacHandle *handle = NULL;
+
+    if ((SEC_SIZE) algorithm >= SEC_MACALGORITHM_NUM)
+        return NULL;
+
+    pthread_mutex_lock(&g_handle_pool_mutex);
+
+    if (NULL != pool->macs[algorithm])
+    {
+        handle = pool->macs[algorithm];
+        pool->macs[algorithm] = handle->pool_next;
+        pool->macs_num--;
+        handle->pool_next = NULL;
+    }
+
+    if (pool->capacity > 0)
+        SEC_STATS_CACHE(SEC_STATS_CACHE_MAC_POOL, NULL != handle);
+
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    return handle;
+}
+
+SEC_BOOL _SecHandlePool_PutMac(_Sec_HandlePool *pool, Sec_MacHandle *handle)
+{
+    SEC_BOOL pooled = SEC_FALSE;
+    SEC_BOOL last;
+
+    pthread_mutex_lock(&g_handle_pool_mutex);
+
+    if ((SEC_SIZE) handle->algorithm < SEC_MACALGORITHM_NUM && pool->macs_num < pool->capacity)
+    {
+        handle->pool_next = pool->macs[handle->algorithm];
+        pool->macs[handle->algorithm] = handle;
+        pool->macs_num++;
+        pool->macs_high_water = SEC_MAX(pool->macs_high_water, pool->macs_num);
+        pooled = SEC_TRUE;
+    }
+    else if (pool->capacity > 0)
+    {
+        pool->discarded++;
+    }
+
+    last = _SecHandlePool_Unref(pool);
+
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    if (last)
+        SEC_FREE(pool);
+
+    return pooled;
+}
+
+void _SecHandlePool_Release(_Sec_HandlePool *pool)
+{
+    SEC_BOOL last;
+
+    if (NULL == pool)
+        return;
+
+    /* handles still alive are freed instead of pooled when they are released */
+    pthread_mutex_lock(&g_handle_pool_mutex);
+    pool->capacity = 0;
+    _SecHandlePool_Trim(pool, 0);
+    last = _SecHandlePool_Unref(pool);
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    if (last)
+        SEC_FREE(pool);
+}
+
+Sec_Result SecProcessor_SetHandlePoolSize(Sec_ProcessorHandle* secProcHandle, SEC_SIZE capacity)
+{
+    if (NULL == secProcHandle)
+    {
+        SEC_LOG_ERROR("Invalid handle");
+        return SEC_RESULT_INVALID_HANDLE;
+    }
+
+    pthread_mutex_lock(&g_handle_pool_mutex);
+    secProcHandle->handle_pool->capacity = capacity;
+    _SecHandlePool_Trim(secProcHandle->handle_pool, capacity);
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecProcessor_GetHandlePoolStats(Sec_ProcessorHandle* secProcHandle, Sec_HandlePoolStats* stats)
+{
+    _Sec_HandlePool *pool;
+
+    if (NULL == secProcHandle)
+    {
+        SEC_LOG_ERROR("Invalid handle");
+        return SEC_RESULT_INVALID_HANDLE;
+    }
+
+    if (NULL == stats)
+    {
+        SEC_LOG_ERROR("Invalid stats");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    pool = secProcHandle->handle_pool;
+
+    pthread_mutex_lock(&g_handle_pool_mutex);
+    stats->capacity = pool->capacity;
+    stats->ciphers_pooled = pool->ciphers_num;
+    stats->ciphers_high_water = pool->ciphers_high_water;
+    stats->macs_pooled = pool->macs_num;
+    stats->macs_high_water = pool->macs_high_water;
+    stats->discarded = pool->discarded;
+    pthread_mutex_unlock(&g_handle_pool_mutex);
+
+    return SEC_RESULT_SUCCESS;
+}
@@ -0,0 +1,410 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* needed for SCHED_IDLE */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "sec_security_openssl.h"
+#include "sec_security_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <openssl/dh.h>
+#include <openssl/err.h>
+
+/* number of distinct (algorithm, parameters) pools */
+#ifndef SEC_KEYPOOL_MAX_POOLS
+    #define SEC_KEYPOOL_MAX_POOLS 4
+#endif
+
+/* maximum number of pre-generated key pairs per pool */
+#ifndef SEC_KEYPOOL_MAX_DEPTH
+    #define SEC_KEYPOOL_MAX_DEPTH 64
+#endif
+
+/* seconds without consumption after which a pool's refill target is halved */
+#ifndef SEC_KEYPOOL_IDLE_SECS
+    #define SEC_KEYPOOL_IDLE_SECS 30
+#endif
+
+typedef struct
+{
+    Sec_KeyExchangeAlgorithm alg;
+    Sec_DHParameters dh_params;
+    void *keys[SEC_KEYPOOL_MAX_DEPTH];
+    SEC_SIZE count;
+    SEC_SIZE depth;
+    SEC_SIZE target;
+    SEC_SIZE taken;
+} _Sec_KeyPool;
+
+static _Sec_KeyPool g_key_pools[SEC_KEYPOOL_MAX_POOLS];
+static SEC_SIZE g_key_pools_num = 0;
+static pthread_mutex_t g_key_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_key_pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_key_pool_thread;
+static SEC_BOOL g_key_pool_running = SEC_FALSE;
+static SEC_BOOL g_key_pool_stop = SEC_FALSE;
+
+static void _SecKeyPool_FreeKey(Sec_KeyExchangeAlgorithm alg, void *key)
+{
+    if (NULL == key)
+        return;
+
+    /* the OpenSSL free functions clear the private values */
+    switch (alg)
+    {
+    case SEC_KEYEXCHANGE_DH:
+        DH_free((DH *) key);
+        break;
+
+    case SEC_KEYEXCHANGE_ECDH:
+        EC_KEY_free((EC_KEY *) key);
+        break;
+
+    case SEC_KEYEXCHANGE_X25519:
+        EVP_PKEY_free((EVP_PKEY *) key);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static DH *_SecKeyPool_GenerateDH(const Sec_DHParameters *params)
+{
+    const _Sec_DHParamsEntry *entry = _Sec_DHParamsGet(params);
+    DH *dh = NULL;
+
+    if (NULL == entry)
+    {
+        SEC_LOG_ERROR("_Sec_DHParamsGet failed");
+        return NULL;
+    }
+
+    dh = DHparams_dup(entry->params);
+    if (NULL == dh)
+    {
+        SEC_LOG_ERROR("DHparams_dup failed");
+        return NULL;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_DHGenerateKey(entry, dh))
+    {
+        SEC_LOG_ERROR("_Sec_DHGenerateKey failed");
+        DH_free(dh);
+        return NULL;
+    }
+
+    return dh;
+}
+
+static void *_SecKeyPool_Generate(Sec_KeyExchangeAlgorithm alg, const Sec_DHParameters *params)
+{
+    EC_KEY *ec_key = NULL;
+
+    switch (alg)
+    {
+    case SEC_KEYEXCHANGE_DH:
+        return _SecKeyPool_GenerateDH(params);
+
+    case SEC_KEYEXCHANGE_ECDH:
+        ec_key = _Sec_NewP256Key();
+        if (NULL == ec_key || 1 != EC_KEY_generate_key(ec_key))
+        {
+            SEC_LOG_ERROR("EC_KEY_generate_key failed");
+            SEC_ECC_FREE(ec_key);
+            return NULL;
+        }
+        return ec_key;
+
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+    case SEC_KEYEXCHANGE_X25519:
+    {
+        EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, NULL);
+        EVP_PKEY *evp_key = NULL;
+
+        if (NULL == pctx || 1 != EVP_PKEY_keygen_init(pctx) || 1 != EVP_PKEY_keygen(pctx, &evp_key))
+        {
+            SEC_LOG_ERROR("EVP_PKEY_keygen failed");
+            SEC_EVPPKEY_FREE(evp_key);
+        }
+        if (NULL != pctx)
+            EVP_PKEY_CTX_free(pctx);
+        return evp_key;
+    }
+#endif
+
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
+static _Sec_KeyPool *_SecKeyPool_Find(Sec_KeyExchangeAlgorithm alg, const Sec_DHParameters *params)
+{
+    SEC_SIZE i;
+
+    for (i = 0; i < g_key_pools_num; ++i)
+    {
+        _Sec_KeyPool *pool = &g_key_pools[i];
+
+        if (pool->alg != alg)
+            continue;
+
+        if (alg != SEC_KEYEXCHANGE_DH)
+            return pool;
+
+        if (pool->dh_params.pLen == params->pLen && pool->dh_params.gLen == params->gLen
+                && 0 == memcmp(pool->dh_params.p, params->p, params->pLen)
+                && 0 == memcmp(pool->dh_params.g, params->g, params->gLen))
+            return pool;
+    }
+
+    return NULL;
+}
+
+/* called with the pool mutex held after SEC_KEYPOOL_IDLE_SECS without a refill */
+static void _SecKeyPool_Decay(void)
+{
+    SEC_SIZE i;
+
+    for (i = 0; i < g_key_pools_num; ++i)
+    {
+        _Sec_KeyPool *pool = &g_key_pools[i];
+
+        if (pool->taken == 0 && pool->target > 1)
+            pool->target /= 2;
+
+        pool->taken = 0;
+    }
+}
+
+static void *_SecKeyPool_Worker(void *arg)
+{
+    struct timespec ts;
+#ifdef SCHED_IDLE
+    struct sched_param param;
+
+    /* only run on otherwise idle cores */
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    pthread_mutex_lock(&g_key_pool_mutex);
+
+    while (!g_key_pool_stop)
+    {
+        _Sec_KeyPool *pool = NULL;
+        Sec_KeyExchangeAlgorithm alg;
+        Sec_DHParameters params;
+        void *key;
+        SEC_SIZE i;
+
+        for (i = 0; i < g_key_pools_num; ++i)
+        {
+            if (g_key_pools[i].count < g_key_pools[i].target)
+            {
+                pool = &g_key_pools[i];
+                break;
+            }
+        }
+
+        if (NULL == pool)
+        {
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += SEC_KEYPOOL_IDLE_SECS;
+            if (ETIMEDOUT == pthread_cond_timedwait(&g_key_pool_cond, &g_key_pool_mutex, &ts))
+                _SecKeyPool_Decay();
+            continue;
+        }
+
+        alg = pool->alg;
+        memcpy(&params, &pool->dh_params, sizeof(params));
+
+        /* the expensive part runs without the lock */
+        pthread_mutex_unlock(&g_key_pool_mutex);
+        key = _SecKeyPool_Generate(alg, &params);
+        pthread_mutex_lock(&g_key_pool_mutex);
+
+        if (NULL == key)
+        {
+            /* back off instead of spinning on a persistent failure */
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            pthread_cond_timedwait(&g_key_pool_cond, &g_key_pool_mutex, &ts);
+            continue;
+        }
+
+        if (pool->count < pool->depth)
+            pool->keys[pool->count++] = key;
+        else
+            _SecKeyPool_FreeKey(alg, key);
+    }
+
+    pthread_mutex_unlock(&g_key_pool_mutex);
+    return NULL;
+}
+
+void *_SecKeyPool_Take(Sec_KeyExchangeAlgorithm alg, const Sec_DHParameters *params)
+{
+    _Sec_KeyPool *pool;
+    void *key = NULL;
+
+    pthread_mutex_lock(&g_key_pool_mutex);
+
+    pool = _SecKeyPool_Find(alg, params);
+    if (NULL != pool)
+    {
+        if (pool->count > 0)
+        {
+            key = pool->keys[--pool->count];
+            pool->keys[pool->count] = NULL;
+            pool->taken++;
+        }
+        else if (pool->target < pool->depth)
+        {
+            /* ran dry, consumption is outpacing the refill target */
+            pool->target = SEC_MIN(pool->depth, pool->target * 2);
+        }
+
+        if (pool->count < pool->target)
+            pthread_cond_signal(&g_key_pool_cond);
+    }
+
+    pthread_mutex_unlock(&g_key_pool_mutex);
+
+    /* only exchanges with a started pool are counted */
+    if (NULL != pool)
+        SEC_STATS_CACHE(SEC_STATS_CACHE_KEYEXCHANGE_POOL, NULL != key);
+
+    return key;
+}
+
+Sec_Result SecKeyExchange_StartPool(Sec_KeyExchangeAlgorithm exchangeType, void* exchangeParameters, SEC_SIZE depth)
+{
+    Sec_DHParameters *params = (Sec_DHParameters *) exchangeParameters;
+    _Sec_KeyPool *pool;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    if (depth == 0 || depth > SEC_KEYPOOL_MAX_DEPTH)
+    {
+        SEC_LOG_ERROR("Invalid pool depth %d, max is %d", depth, SEC_KEYPOOL_MAX_DEPTH);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    switch (exchangeType)
+    {
+    case SEC_KEYEXCHANGE_DH:
+        if (NULL == params || params->pLen > sizeof(params->p) || params->gLen > sizeof(params->g))
+        {
+            SEC_LOG_ERROR("Invalid DH parameters");
+            return SEC_RESULT_INVALID_PARAMETERS;
+        }
+        break;
+
+    case SEC_KEYEXCHANGE_ECDH:
+        break;
+
+    case SEC_KEYEXCHANGE_X25519:
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+        break;
+#else
+        return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+#endif
+
+    default:
+        SEC_LOG_ERROR("Unknown exchange_type encountered: %d", exchangeType);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    pthread_mutex_lock(&g_key_pool_mutex);
+
+    pool = _SecKeyPool_Find(exchangeType, params);
+    if (NULL == pool)
+    {
+        if (g_key_pools_num >= SEC_KEYPOOL_MAX_POOLS)
+        {
+            SEC_LOG_ERROR("Too many key exchange pools");
+            goto done;
+        }
+
+        pool = &g_key_pools[g_key_pools_num++];
+        memset(pool, 0, sizeof(_Sec_KeyPool));
+        pool->alg = exchangeType;
+        if (exchangeType == SEC_KEYEXCHANGE_DH)
+            memcpy(&pool->dh_params, params, sizeof(Sec_DHParameters));
+    }
+
+    /* extra keys above a reduced depth are handed out before new ones are made */
+    pool->depth = depth;
+    pool->target = depth;
+
+    if (!g_key_pool_running)
+    {
+        if (0 != pthread_create(&g_key_pool_thread, NULL, _SecKeyPool_Worker, NULL))
+        {
+            SEC_LOG_ERROR("pthread_create failed");
+            goto done;
+        }
+        g_key_pool_running = SEC_TRUE;
+    }
+
+    pthread_cond_signal(&g_key_pool_cond);
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    pthread_mutex_unlock(&g_key_pool_mutex);
+    return res;
+}
+
+Sec_Result SecKeyExchange_StopPool(void)
+{
+    SEC_BOOL running;
+    SEC_SIZE i, j;
+
+    pthread_mutex_lock(&g_key_pool_mutex);
+    running = g_key_pool_running;
+    g_key_pool_stop = SEC_TRUE;
+    pthread_cond_broadcast(&g_key_pool_cond);
+    pthread_mutex_unlock(&g_key_pool_mutex);
+
+    if (running)
+        pthread_join(g_key_pool_thread, NULL);
+
+    pthread_mutex_lock(&g_key_pool_mutex);
+    for (i = 0; i < g_key_pools_num; ++i)
+    {
+        for (j = 0; j < g_key_pools[i].count; ++j)
+            _SecKeyPool_FreeKey(g_key_pools[i].alg, g_key_pools[i].keys[j]);
+    }
+    Sec_Memset(g_key_pools, 0, sizeof(g_key_pools));
+    g_key_pools_num = 0;
+    g_key_pool_running = SEC_FALSE;
+    g_key_pool_stop = SEC_FALSE;
+    pthread_mutex_unlock(&g_key_pool_mutex);
+
+    return SEC_RESULT_SUCCESS;
+}
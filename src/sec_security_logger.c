@@ -69,6 +69,6 @@ void Sec_PrintHex(void* data, SEC_SIZE numBytes)
         }
     }
 
-    SEC_PRINT(buffer);
+    SEC_PRINT("%s", buffer);
 }
 
@@ -0,0 +1,627 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sec_security.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+
+/* records buffered per logging thread, must be a power of two */
+#ifndef SEC_ASYNCLOG_RING_SIZE
+    #define SEC_ASYNCLOG_RING_SIZE 64
+#endif
+
+/* maximum number of conversion arguments kept per record */
+#ifndef SEC_ASYNCLOG_MAX_ARGS
+    #define SEC_ASYNCLOG_MAX_ARGS 12
+#endif
+
+/* space for copies of %s arguments per record */
+#ifndef SEC_ASYNCLOG_STRINGS_LEN
+    #define SEC_ASYNCLOG_STRINGS_LEN 384
+#endif
+
+/* how often the background thread looks for new records */
+#ifndef SEC_ASYNCLOG_POLL_MS
+    #define SEC_ASYNCLOG_POLL_MS 10
+#endif
+
+/* messages printed per call site and window, the rest are counted */
+#ifndef SEC_ASYNCLOG_RATE_LIMIT
+    #define SEC_ASYNCLOG_RATE_LIMIT 20
+#endif
+
+#ifndef SEC_ASYNCLOG_RATE_WINDOW_MS
+    #define SEC_ASYNCLOG_RATE_WINDOW_MS 1000
+#endif
+
+/* number of call sites tracked by the rate limiter, must be a power of two */
+#define SEC_ASYNCLOG_SITES 256
+
+#define SEC_ASYNCLOG_LINE_LEN 1024
+
+#if (SEC_ASYNCLOG_RING_SIZE & (SEC_ASYNCLOG_RING_SIZE - 1)) != 0
+#error SEC_ASYNCLOG_RING_SIZE must be a power of two
+#endif
+
+typedef enum
+{
+    SEC_ASYNCLOG_ARG_INT = 0,
+    SEC_ASYNCLOG_ARG_LONG,
+    SEC_ASYNCLOG_ARG_LLONG,
+    SEC_ASYNCLOG_ARG_SIZE,
+    SEC_ASYNCLOG_ARG_DOUBLE,
+    SEC_ASYNCLOG_ARG_LDOUBLE,
+    SEC_ASYNCLOG_ARG_PTR,
+    SEC_ASYNCLOG_ARG_STR
+} _Sec_AsyncLogArgType;
+
+typedef union
+{
+    long long i;
+    size_t z;
+    double d;
+    long double ld;
+    const void *p;
+    /* offset into the record strings */
+    SEC_SIZE str;
+} _Sec_AsyncLogArg;
+
+/* a log call before formatting: the format must be a string literal, which all SEC_LOG callers use */
+typedef struct
+{
+    const char *fmt;
+    uint64_t timestamp;
+    SEC_SIZE num_args;
+    SEC_SIZE strings_len;
+    SEC_BYTE types[SEC_ASYNCLOG_MAX_ARGS];
+    _Sec_AsyncLogArg args[SEC_ASYNCLOG_MAX_ARGS];
+    char strings[SEC_ASYNCLOG_STRINGS_LEN];
+} _Sec_AsyncLogRecord;
+
+/* single producer (the owning thread), single consumer (the formatting thread) */
+typedef struct _Sec_AsyncLogRing_struct
+{
+    uint32_t head;
+    uint32_t tail;
+    uint64_t dropped;
+    uint64_t dropped_reported;
+    int exited;
+    struct _Sec_AsyncLogRing_struct *next;
+    _Sec_AsyncLogRecord records[SEC_ASYNCLOG_RING_SIZE];
+} _Sec_AsyncLogRing;
+
+typedef struct
+{
+    const char *fmt;
+    uint64_t window_start;
+    SEC_SIZE count;
+    SEC_SIZE suppressed;
+} _Sec_AsyncLogSite;
+
+static pthread_once_t g_alog_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_alog_key;
+/* protects the ring list, rings are only added and removed under it */
+static pthread_mutex_t g_alog_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* held while records are formatted, by the background thread or Sec_AsyncLoggerFlush */
+static pthread_mutex_t g_alog_consumer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Sec_AsyncLogRing *g_alog_rings = NULL;
+static _Sec_AsyncLogSite g_alog_sites[SEC_ASYNCLOG_SITES];
+static char g_alog_last_line[SEC_ASYNCLOG_LINE_LEN];
+static SEC_SIZE g_alog_repeats = 0;
+static __thread _Sec_AsyncLogRing *t_alog_ring = NULL;
+/* set once the ring has been handed to the consumer at thread exit */
+static __thread SEC_BOOL t_alog_exited = SEC_FALSE;
+
+static uint64_t _SecAsyncLog_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/* Scans one conversion specification starting after '%'.  Returns the number of
+ * characters consumed, the argument type of the conversion and the number of
+ * '*' width or precision arguments in front of it.  type is -1 for "%%" and for
+ * conversions that take no argument. */
+static SEC_SIZE _SecAsyncLog_ParseSpec(const char *spec, int *type, SEC_SIZE *stars)
+{
+    const char *p = spec;
+    int longs = 0;
+    SEC_BOOL is_long_double = SEC_FALSE;
+    SEC_BOOL is_size = SEC_FALSE;
+
+    *stars = 0;
+    *type = -1;
+
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL)
+        ++p;
+
+    while ((*p >= '0' && *p <= '9') || *p == '.' || *p == '*')
+    {
+        if (*p == '*')
+            (*stars)++;
+        ++p;
+    }
+
+    for (;; ++p)
+    {
+        if (*p == 'l')
+            longs++;
+        else if (*p == 'L')
+            is_long_double = SEC_TRUE;
+        else if (*p == 'z' || *p == 'j' || *p == 't')
+            is_size = SEC_TRUE;
+        else if (*p != 'h')
+            break;
+    }
+
+    switch (*p)
+    {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (is_size)
+                *type = SEC_ASYNCLOG_ARG_SIZE;
+            else if (longs >= 2)
+                *type = SEC_ASYNCLOG_ARG_LLONG;
+            else if (longs == 1)
+                *type = SEC_ASYNCLOG_ARG_LONG;
+            else
+                *type = SEC_ASYNCLOG_ARG_INT;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            *type = is_long_double ? SEC_ASYNCLOG_ARG_LDOUBLE : SEC_ASYNCLOG_ARG_DOUBLE;
+            break;
+        case 'p': case 'n':
+            *type = SEC_ASYNCLOG_ARG_PTR;
+            break;
+        case 's':
+            *type = SEC_ASYNCLOG_ARG_STR;
+            break;
+        case '\0':
+            return (SEC_SIZE) (p - spec);
+        default:
+            break;
+    }
+
+    return (SEC_SIZE) (p - spec) + 1;
+}
+
+static void _SecAsyncLog_Capture(_Sec_AsyncLogRecord *record, const char *fmt, va_list args)
+{
+    const char *p = fmt;
+
+    record->fmt = fmt;
+    record->timestamp = _SecAsyncLog_Now();
+    record->num_args = 0;
+    record->strings_len = 0;
+
+    while (NULL != (p = strchr(p, '%')))
+    {
+        int type;
+        SEC_SIZE stars;
+        SEC_SIZE i;
+
+        p += 1 + _SecAsyncLog_ParseSpec(p + 1, &type, &stars);
+
+        for (i = 0; i < stars; ++i)
+        {
+            int value = va_arg(args, int);
+
+            if (record->num_args < SEC_ASYNCLOG_MAX_ARGS)
+            {
+                record->types[record->num_args] = SEC_ASYNCLOG_ARG_INT;
+                record->args[record->num_args++].i = value;
+            }
+        }
+
+        if (type < 0)
+            continue;
+
+        if (record->num_args >= SEC_ASYNCLOG_MAX_ARGS)
+            break;
+
+        record->types[record->num_args] = (SEC_BYTE) type;
+        switch (type)
+        {
+            case SEC_ASYNCLOG_ARG_INT:
+                record->args[record->num_args].i = va_arg(args, int);
+                break;
+            case SEC_ASYNCLOG_ARG_LONG:
+                record->args[record->num_args].i = va_arg(args, long);
+                break;
+            case SEC_ASYNCLOG_ARG_LLONG:
+                record->args[record->num_args].i = va_arg(args, long long);
+                break;
+            case SEC_ASYNCLOG_ARG_SIZE:
+                record->args[record->num_args].z = va_arg(args, size_t);
+                break;
+            case SEC_ASYNCLOG_ARG_DOUBLE:
+                record->args[record->num_args].d = va_arg(args, double);
+                break;
+            case SEC_ASYNCLOG_ARG_LDOUBLE:
+                record->args[record->num_args].ld = va_arg(args, long double);
+                break;
+            case SEC_ASYNCLOG_ARG_PTR:
+                record->args[record->num_args].p = va_arg(args, void *);
+                break;
+            case SEC_ASYNCLOG_ARG_STR:
+            {
+                /* the string may not outlive the call, keep a (truncated) copy */
+                const char *str = va_arg(args, const char *);
+                SEC_SIZE space = SEC_ASYNCLOG_STRINGS_LEN - record->strings_len;
+                SEC_SIZE len;
+
+                if (NULL == str)
+                    str = "(null)";
+
+                len = SEC_MIN((SEC_SIZE) strlen(str), space - 1);
+                memcpy(&record->strings[record->strings_len], str, len);
+                record->strings[record->strings_len + len] = '\0';
+                record->args[record->num_args].str = record->strings_len;
+                record->strings_len += len + 1;
+                if (record->strings_len >= SEC_ASYNCLOG_STRINGS_LEN)
+                    record->strings_len = SEC_ASYNCLOG_STRINGS_LEN - 1;
+                break;
+            }
+        }
+        record->num_args++;
+    }
+}
+
+#define SEC_ASYNCLOG_PRINT_SPEC(value) \
+    (stars == 0 ? snprintf(out, space, spec, value) \
+    : stars == 1 ? snprintf(out, space, spec, star[0], value) \
+    : snprintf(out, space, spec, star[0], star[1], value))
+
+/* formats a record the same way vsnprintf would have */
+static void _SecAsyncLog_Format(const _Sec_AsyncLogRecord *record, char *line, SEC_SIZE lineLen)
+{
+    const char *p = record->fmt;
+    SEC_SIZE arg = 0;
+    SEC_SIZE written = 0;
+
+    line[0] = '\0';
+
+    while (*p != '\0' && written + 1 < lineLen)
+    {
+        char spec[32];
+        int star[2] = { 0, 0 };
+        char *out = line + written;
+        SEC_SIZE space = lineLen - written;
+        SEC_SIZE spec_len;
+        SEC_SIZE stars;
+        SEC_SIZE i;
+        int type;
+        int res = 0;
+
+        if (*p != '%')
+        {
+            line[written++] = *p++;
+            line[written] = '\0';
+            continue;
+        }
+
+        spec_len = 1 + _SecAsyncLog_ParseSpec(p + 1, &type, &stars);
+        if (spec_len >= sizeof(spec) || stars > 2)
+            break;
+
+        memcpy(spec, p, spec_len);
+        spec[spec_len] = '\0';
+        p += spec_len;
+
+        for (i = 0; i < stars && arg < record->num_args; ++i)
+            star[i] = (int) record->args[arg++].i;
+
+        if (type < 0)
+        {
+            if (spec[spec_len - 1] == '%')
+                line[written++] = '%';
+            line[written] = '\0';
+            continue;
+        }
+
+        if (arg >= record->num_args)
+            break;
+
+        switch (record->types[arg])
+        {
+            case SEC_ASYNCLOG_ARG_INT:
+                res = SEC_ASYNCLOG_PRINT_SPEC((int) record->args[arg].i);
+                break;
+            case SEC_ASYNCLOG_ARG_LONG:
+                res = SEC_ASYNCLOG_PRINT_SPEC((long) record->args[arg].i);
+                break;
+            case SEC_ASYNCLOG_ARG_LLONG:
+                res = SEC_ASYNCLOG_PRINT_SPEC(record->args[arg].i);
+                break;
+            case SEC_ASYNCLOG_ARG_SIZE:
+                res = SEC_ASYNCLOG_PRINT_SPEC(record->args[arg].z);
+                break;
+            case SEC_ASYNCLOG_ARG_DOUBLE:
+                res = SEC_ASYNCLOG_PRINT_SPEC(record->args[arg].d);
+                break;
+            case SEC_ASYNCLOG_ARG_LDOUBLE:
+                res = SEC_ASYNCLOG_PRINT_SPEC(record->args[arg].ld);
+                break;
+            case SEC_ASYNCLOG_ARG_PTR:
+                /* %n would write into memory the caller no longer owns */
+                if (spec[spec_len - 1] != 'n')
+                    res = SEC_ASYNCLOG_PRINT_SPEC(record->args[arg].p);
+                break;
+            case SEC_ASYNCLOG_ARG_STR:
+                res = SEC_ASYNCLOG_PRINT_SPEC(&record->strings[record->args[arg].str]);
+                break;
+        }
+        arg++;
+
+        if (res > 0)
+            written += SEC_MIN((SEC_SIZE) res, space - 1);
+    }
+}
+
+static void _SecAsyncLog_FlushRepeats(void)
+{
+    if (g_alog_repeats > 0)
+    {
+        fprintf(stdout, "[last message repeated %u times]\n", g_alog_repeats);
+        g_alog_repeats = 0;
+    }
+}
+
+/* called with g_alog_consumer_mutex held */
+static SEC_BOOL _SecAsyncLog_Allowed(const char *fmt, uint64_t now)
+{
+    _Sec_AsyncLogSite *site = &g_alog_sites[((uintptr_t) fmt >> 3) & (SEC_ASYNCLOG_SITES - 1)];
+
+    if (site->fmt != fmt || now - site->window_start >= SEC_ASYNCLOG_RATE_WINDOW_MS * 1000000ULL)
+    {
+        if (site->suppressed > 0)
+            fprintf(stdout, "[%u messages suppressed: %.64s]\n", site->suppressed, site->fmt);
+
+        site->fmt = fmt;
+        site->window_start = now;
+        site->count = 0;
+        site->suppressed = 0;
+    }
+
+    if (site->count >= SEC_ASYNCLOG_RATE_LIMIT)
+    {
+        site->suppressed++;
+        return SEC_FALSE;
+    }
+
+    site->count++;
+    return SEC_TRUE;
+}
+
+/* called with g_alog_consumer_mutex held */
+static void _SecAsyncLog_Output(const _Sec_AsyncLogRecord *record)
+{
+    char line[SEC_ASYNCLOG_LINE_LEN];
+
+    _SecAsyncLog_Format(record, line, sizeof(line));
+
+    if (0 == strcmp(line, g_alog_last_line))
+    {
+        g_alog_repeats++;
+        return;
+    }
+
+    if (!_SecAsyncLog_Allowed(record->fmt, _SecAsyncLog_Now()))
+        return;
+
+    _SecAsyncLog_FlushRepeats();
+    fputs(line, stdout);
+    memcpy(g_alog_last_line, line, sizeof(line));
+}
+
+/* called with g_alog_consumer_mutex held, returns the number of records written */
+static SEC_SIZE _SecAsyncLog_Drain(void)
+{
+    _Sec_AsyncLogRing *ring;
+    _Sec_AsyncLogRing **link;
+    SEC_SIZE total = 0;
+
+    /* print in timestamp order across threads */
+    for (;;)
+    {
+        _Sec_AsyncLogRecord *oldest = NULL;
+        _Sec_AsyncLogRing *oldest_ring = NULL;
+
+        pthread_mutex_lock(&g_alog_rings_mutex);
+        for (ring = g_alog_rings; ring != NULL; ring = ring->next)
+        {
+            uint32_t tail = ring->tail;
+            _Sec_AsyncLogRecord *record;
+
+            if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+                continue;
+
+            record = &ring->records[tail & (SEC_ASYNCLOG_RING_SIZE - 1)];
+            if (NULL == oldest || record->timestamp < oldest->timestamp)
+            {
+                oldest = record;
+                oldest_ring = ring;
+            }
+        }
+        pthread_mutex_unlock(&g_alog_rings_mutex);
+
+        if (NULL == oldest)
+            break;
+
+        _SecAsyncLog_Output(oldest);
+        __atomic_store_n(&oldest_ring->tail, oldest_ring->tail + 1, __ATOMIC_RELEASE);
+        total++;
+    }
+
+    pthread_mutex_lock(&g_alog_rings_mutex);
+    link = &g_alog_rings;
+    while (NULL != (ring = *link))
+    {
+        uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+
+        if (dropped != ring->dropped_reported)
+        {
+            _SecAsyncLog_FlushRepeats();
+            fprintf(stdout, "[%llu messages dropped, log buffer full]\n",
+                    (unsigned long long) (dropped - ring->dropped_reported));
+            ring->dropped_reported = dropped;
+            g_alog_last_line[0] = '\0';
+        }
+
+        /* rings of exited threads are freed once they are empty */
+        if (__atomic_load_n(&ring->exited, __ATOMIC_ACQUIRE)
+                && ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+        {
+            *link = ring->next;
+            SEC_FREE(ring);
+            continue;
+        }
+
+        link = &ring->next;
+    }
+    pthread_mutex_unlock(&g_alog_rings_mutex);
+
+    return total;
+}
+
+static void *_SecAsyncLog_Thread(void *arg)
+{
+    SEC_SIZE idle = 0;
+
+    for (;;)
+    {
+        SEC_SIZE written;
+
+        pthread_mutex_lock(&g_alog_consumer_mutex);
+        written = _SecAsyncLog_Drain();
+        /* report collapsed repeats once the storm is over */
+        if (written == 0 && ++idle * SEC_ASYNCLOG_POLL_MS >= SEC_ASYNCLOG_RATE_WINDOW_MS)
+        {
+            _SecAsyncLog_FlushRepeats();
+            g_alog_last_line[0] = '\0';
+            idle = 0;
+        }
+        else if (written > 0)
+        {
+            idle = 0;
+        }
+        pthread_mutex_unlock(&g_alog_consumer_mutex);
+
+        if (written > 0)
+            fflush(stdout);
+
+        usleep(SEC_ASYNCLOG_POLL_MS * 1000);
+    }
+
+    return NULL;
+}
+
+static void _SecAsyncLog_ThreadExit(void *arg)
+{
+    _Sec_AsyncLogRing *ring = (_Sec_AsyncLogRing *) arg;
+
+    /* later log calls from other destructors must not create a new ring */
+    t_alog_ring = NULL;
+    t_alog_exited = SEC_TRUE;
+
+    __atomic_store_n(&ring->exited, 1, __ATOMIC_RELEASE);
+}
+
+static void _SecAsyncLog_Init(void)
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    pthread_key_create(&g_alog_key, _SecAsyncLog_ThreadExit);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (0 != pthread_create(&thread, &attr, _SecAsyncLog_Thread, NULL))
+    {
+        /* records are still written out by Sec_AsyncLoggerFlush */
+        fprintf(stdout, "Could not start the logging thread\n");
+    }
+    pthread_attr_destroy(&attr);
+
+    atexit(Sec_AsyncLoggerFlush);
+}
+
+static _Sec_AsyncLogRing *_SecAsyncLog_Ring(void)
+{
+    _Sec_AsyncLogRing *ring = t_alog_ring;
+
+    if (NULL != ring || t_alog_exited)
+        return ring;
+
+    pthread_once(&g_alog_once, _SecAsyncLog_Init);
+
+    ring = (_Sec_AsyncLogRing *) calloc(1, sizeof(_Sec_AsyncLogRing));
+    if (NULL == ring)
+        return NULL;
+
+    pthread_mutex_lock(&g_alog_rings_mutex);
+    ring->next = g_alog_rings;
+    g_alog_rings = ring;
+    pthread_mutex_unlock(&g_alog_rings_mutex);
+
+    pthread_setspecific(g_alog_key, ring);
+    t_alog_ring = ring;
+
+    return ring;
+}
+
+void Sec_AsyncLoggerCb(const char *fmt, ...)
+{
+    _Sec_AsyncLogRing *ring = _SecAsyncLog_Ring();
+    uint32_t head;
+    va_list args;
+
+    if (NULL == ring || NULL == fmt)
+        return;
+
+    head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= SEC_ASYNCLOG_RING_SIZE)
+    {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    va_start(args, fmt);
+    _SecAsyncLog_Capture(&ring->records[head & (SEC_ASYNCLOG_RING_SIZE - 1)], fmt, args);
+    va_end(args);
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void Sec_AsyncLoggerFlush(void)
+{
+    pthread_mutex_lock(&g_alog_consumer_mutex);
+    _SecAsyncLog_Drain();
+    _SecAsyncLog_FlushRepeats();
+    pthread_mutex_unlock(&g_alog_consumer_mutex);
+
+    fflush(stdout);
+}
@@ -0,0 +1,325 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sec_security_metrics.h"
+#include "sec_security_shm.h"
+#include "sec_security_stats.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if SEC_ENABLE_STATS
+
+/* how long to wait for the creator of the segment to fill in the header */
+#define SEC_METRICS_ATTACH_WAIT_MS 100
+
+static pthread_mutex_t g_metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_metrics_cond = PTHREAD_COND_INITIALIZER;
+static Sec_MetricsSegment *g_metrics_seg = NULL;
+static Sec_MetricsSlot *g_metrics_slot = NULL;
+static pid_t g_metrics_pid = 0;
+static pthread_t g_metrics_thread;
+static SEC_BOOL g_metrics_running = SEC_FALSE;
+static SEC_BOOL g_metrics_stop = SEC_FALSE;
+static SEC_SIZE g_metrics_interval_ms = 0;
+
+static Sec_MetricsSegment *_SecMetrics_Attach(void)
+{
+    Sec_MetricsSegment *seg;
+    Sec_MetricsHeader *header;
+    SEC_BOOL created = SEC_FALSE;
+    SEC_SIZE waited;
+
+    seg = (Sec_MetricsSegment *) SecShm_InitSegment(SEC_METRICS_SHM_KEY, sizeof(Sec_MetricsSegment), &created);
+    if (NULL == seg)
+    {
+        SEC_LOG_ERROR("SecShm_InitSegment failed");
+        return NULL;
+    }
+    header = &seg->header;
+
+    if (created)
+    {
+        /* a new segment is zero filled, so all slots are free */
+        header->version = SEC_METRICS_SHM_VERSION;
+        header->slot_size = sizeof(Sec_MetricsSlot);
+        header->num_slots = SEC_METRICS_MAX_PROCS;
+        __atomic_store_n(&header->magic, SEC_METRICS_SHM_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    for (waited = 0; __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SEC_METRICS_SHM_MAGIC; ++waited)
+    {
+        if (waited >= SEC_METRICS_ATTACH_WAIT_MS)
+        {
+            SEC_LOG_ERROR("Metrics segment was never initialized");
+            shmdt(seg);
+            return NULL;
+        }
+        usleep(1000);
+    }
+
+    if (header->version != SEC_METRICS_SHM_VERSION || header->slot_size != sizeof(Sec_MetricsSlot)
+            || header->num_slots != SEC_METRICS_MAX_PROCS)
+    {
+        SEC_LOG_ERROR("Metrics segment layout mismatch, version %d slot size %d slots %d",
+                header->version, header->slot_size, header->num_slots);
+        shmdt(seg);
+        return NULL;
+    }
+
+    return seg;
+}
+
+static SEC_BOOL _SecMetrics_IsDead(pid_t pid)
+{
+    return kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+static Sec_MetricsSlot *_SecMetrics_Claim(Sec_MetricsSegment *seg, pid_t pid)
+{
+    SEC_SIZE i;
+
+    for (i = 0; i < SEC_METRICS_MAX_PROCS; ++i)
+    {
+        Sec_MetricsSlot *slot = &seg->slots[i];
+        int32_t owner = __atomic_load_n(&slot->pid, __ATOMIC_ACQUIRE);
+
+        /* slots of processes that died without releasing them are reused */
+        if (owner != 0 && (owner == pid || !_SecMetrics_IsDead(owner)))
+            continue;
+
+        if (__atomic_compare_exchange_n(&slot->pid, &owner, pid, SEC_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return slot;
+    }
+
+    SEC_LOG_ERROR("No free metrics slot");
+    return NULL;
+}
+
+/* called with g_metrics_mutex held */
+static void _SecMetrics_Write(Sec_MetricsSlot *slot, const Sec_Stats *stats)
+{
+    struct timespec ts;
+    SEC_SIZE i;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->update_time = (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+    for (i = 0; i < SEC_STATS_OP_NUM; ++i)
+    {
+        slot->ops[i].count = stats->ops[i].count;
+        slot->ops[i].errors = stats->ops[i].errors;
+        slot->ops[i].bytes = stats->ops[i].bytes;
+        slot->ops[i].total_ns = stats->ops[i].total_ns;
+    }
+    memcpy(slot->caches, stats->caches, sizeof(slot->caches));
+    memcpy(slot->results, stats->results, sizeof(slot->results));
+    slot->outprot_denials = stats->outprot_denials;
+
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* called with g_metrics_mutex held */
+static void _SecMetrics_Release(void)
+{
+    if (NULL != g_metrics_slot)
+    {
+        __atomic_store_n(&g_metrics_slot->pid, 0, __ATOMIC_RELEASE);
+        g_metrics_slot = NULL;
+    }
+
+    if (NULL != g_metrics_seg)
+    {
+        shmdt(g_metrics_seg);
+        g_metrics_seg = NULL;
+    }
+}
+
+Sec_Result SecMetrics_Publish(void)
+{
+    Sec_Stats *stats;
+    Sec_Result res = SEC_RESULT_FAILURE;
+    pid_t pid = getpid();
+
+    /* Sec_Stats holds all histograms, keep it off the stack */
+    stats = (Sec_Stats *) calloc(1, sizeof(Sec_Stats));
+    if (NULL == stats)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    SecStats_Total(stats);
+
+    pthread_mutex_lock(&g_metrics_mutex);
+
+    /* a forked child starts with a copy of the parent attachment, but needs its own slot */
+    if (NULL != g_metrics_seg && g_metrics_pid != pid)
+    {
+        g_metrics_slot = NULL;
+        shmdt(g_metrics_seg);
+        g_metrics_seg = NULL;
+    }
+
+    if (NULL == g_metrics_seg)
+    {
+        g_metrics_seg = _SecMetrics_Attach();
+        g_metrics_pid = pid;
+    }
+
+    if (NULL != g_metrics_seg && NULL == g_metrics_slot)
+    {
+        g_metrics_slot = _SecMetrics_Claim(g_metrics_seg, pid);
+        if (NULL != g_metrics_slot)
+            memset(g_metrics_slot->ops, 0, sizeof(Sec_MetricsSlot) - offsetof(Sec_MetricsSlot, ops));
+    }
+
+    if (NULL != g_metrics_slot)
+    {
+        _SecMetrics_Write(g_metrics_slot, stats);
+        res = SEC_RESULT_SUCCESS;
+    }
+
+    pthread_mutex_unlock(&g_metrics_mutex);
+
+    SEC_FREE(stats);
+
+    return res;
+}
+
+static void *_SecMetrics_Exporter(void *arg)
+{
+    struct timespec deadline;
+
+    pthread_mutex_lock(&g_metrics_mutex);
+
+    while (!g_metrics_stop)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += g_metrics_interval_ms / 1000;
+        deadline.tv_nsec += (long) (g_metrics_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (!g_metrics_stop && pthread_cond_timedwait(&g_metrics_cond, &g_metrics_mutex, &deadline) != ETIMEDOUT)
+            ;
+
+        if (g_metrics_stop)
+            break;
+
+        pthread_mutex_unlock(&g_metrics_mutex);
+        SecMetrics_Publish();
+        pthread_mutex_lock(&g_metrics_mutex);
+    }
+
+    pthread_mutex_unlock(&g_metrics_mutex);
+    return NULL;
+}
+
+Sec_Result SecMetrics_StartExport(SEC_SIZE intervalMs)
+{
+    Sec_Result res = SEC_RESULT_SUCCESS;
+
+    if (intervalMs == 0)
+    {
+        SEC_LOG_ERROR("Invalid export interval");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    /* make the process visible right away */
+    if (SEC_RESULT_SUCCESS != SecMetrics_Publish())
+    {
+        SEC_LOG_ERROR("SecMetrics_Publish failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    pthread_mutex_lock(&g_metrics_mutex);
+
+    g_metrics_interval_ms = intervalMs;
+    if (!g_metrics_running)
+    {
+        g_metrics_stop = SEC_FALSE;
+        if (0 != pthread_create(&g_metrics_thread, NULL, _SecMetrics_Exporter, NULL))
+        {
+            SEC_LOG_ERROR("pthread_create failed");
+            res = SEC_RESULT_FAILURE;
+        }
+        else
+        {
+            g_metrics_running = SEC_TRUE;
+        }
+    }
+
+    pthread_mutex_unlock(&g_metrics_mutex);
+
+    return res;
+}
+
+Sec_Result SecMetrics_StopExport(void)
+{
+    SEC_BOOL running;
+
+    pthread_mutex_lock(&g_metrics_mutex);
+    running = g_metrics_running;
+    g_metrics_stop = SEC_TRUE;
+    pthread_cond_broadcast(&g_metrics_cond);
+    pthread_mutex_unlock(&g_metrics_mutex);
+
+    if (running)
+        pthread_join(g_metrics_thread, NULL);
+
+    pthread_mutex_lock(&g_metrics_mutex);
+    g_metrics_running = SEC_FALSE;
+    g_metrics_stop = SEC_FALSE;
+    if (g_metrics_pid == getpid())
+        _SecMetrics_Release();
+    pthread_mutex_unlock(&g_metrics_mutex);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+#else
+
+Sec_Result SecMetrics_Publish(void)
+{
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+Sec_Result SecMetrics_StartExport(SEC_SIZE intervalMs)
+{
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+Sec_Result SecMetrics_StopExport(void)
+{
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEC_SECURITY_METRICS_H_
+#define SEC_SECURITY_METRICS_H_
+
+#include "sec_security.h"
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* System V key of the shared metrics segment */
+#ifndef SEC_METRICS_SHM_KEY
+    #define SEC_METRICS_SHM_KEY ((key_t) 0x53454d31)
+#endif
+
+/* maximum number of processes publishing at the same time */
+#ifndef SEC_METRICS_MAX_PROCS
+    #define SEC_METRICS_MAX_PROCS 64
+#endif
+
+#define SEC_METRICS_SHM_MAGIC 0x5345434dU
+/* bump whenever the layout of Sec_MetricsSlot or Sec_MetricsHeader changes */
+#define SEC_METRICS_SHM_VERSION 2
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t errors;
+    uint64_t bytes;
+    uint64_t total_ns;
+} Sec_MetricsOp;
+
+/**
+ * Counters of one process.  The writer makes seq odd while it updates the slot,
+ * readers retry until they see the same even value before and after the copy.
+ */
+typedef struct
+{
+    uint32_t seq;
+    /* 0 if the slot is free */
+    int32_t pid;
+    /* CLOCK_REALTIME of the last update in ns */
+    uint64_t update_time;
+    Sec_MetricsOp ops[SEC_STATS_OP_NUM];
+    Sec_StatsCacheData caches[SEC_STATS_CACHE_NUM];
+    uint64_t results[SEC_RESULT_NUM];
+    uint64_t outprot_denials;
+} Sec_MetricsSlot;
+
+typedef struct
+{
+    /* written last by the process that created the segment */
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t num_slots;
+} Sec_MetricsHeader;
+
+typedef struct
+{
+    Sec_MetricsHeader header;
+    Sec_MetricsSlot slots[SEC_METRICS_MAX_PROCS];
+} Sec_MetricsSegment;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEC_SECURITY_METRICS_H_ */
@@ -20,10 +20,6 @@
 #include "sec_security_mutex.h"
 #include <errno.h>
 
-#if SEC_TRACE_MUTEX
-#pragma message "SEC_TRACE_MUTEX is enabled.  Please disable in production builds."
-#endif
-
 #if !defined(__APPLE__) && !defined(__ANDROID__)
     #define SEC_USE_ROBUST_MUTEX
 #endif
@@ -79,7 +75,6 @@ SEC_BOOL SecMutex_TryLock(pthread_mutex_t *mutex)
 {
     int ret;
 
-    SEC_TRACE(SEC_TRACE_MUTEX, "TRYLOCK %p", mutex);
     ret = pthread_mutex_trylock(mutex);
 
 #ifdef SEC_USE_ROBUST_MUTEX
@@ -98,7 +93,7 @@ SEC_BOOL SecMutex_TryLock(pthread_mutex_t *mutex)
 #endif
 
     if (ret == 0) {
-        SEC_TRACE(SEC_TRACE_MUTEX, "LOCKED %p", mutex);
+        SEC_TRACE_MUTEX_LOCKED(mutex);
     }
 
 #ifdef SEC_USE_ROBUST_MUTEX
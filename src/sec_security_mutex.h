@@ -21,6 +21,7 @@
 #define SEC_SECURITY_MUTEX_H_
 
 #include "sec_security.h"
+#include "sec_security_trace.h"
 #include <pthread.h>
 
 #ifdef __cplusplus
@@ -28,13 +29,9 @@ extern "C"
 {
 #endif
 
-#ifndef SEC_TRACE_MUTEX
-    #define SEC_TRACE_MUTEX 0
-#endif
-
-#define SEC_MUTEX_LOCK(mutex) do { SEC_TRACE(SEC_TRACE_MUTEX, "LOCK %p", mutex); SecMutex_Lock(mutex); SEC_TRACE(SEC_TRACE_MUTEX, "LOCKED %p", mutex);} while (0)
+#define SEC_MUTEX_LOCK(mutex) do { SEC_TRACE_MUTEX_LOCK(mutex); SecMutex_Lock(mutex); SEC_TRACE_MUTEX_LOCKED(mutex);} while (0)
 #define SEC_MUTEX_TRYLOCK(mutex) SecMutex_TryLock(mutex)
-#define SEC_MUTEX_UNLOCK(mutex)  do { SEC_TRACE(SEC_TRACE_MUTEX, "UNLOCK %p", mutex); SecMutex_Unlock(mutex); } while (0)
+#define SEC_MUTEX_UNLOCK(mutex)  do { SEC_TRACE_MUTEX_UNLOCK(mutex); SecMutex_Unlock(mutex); } while (0)
 
 #define SEC_MUTEX_SIZE sizeof(pthread_mutex_t)
 
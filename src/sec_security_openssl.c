@@ -19,6 +19,9 @@
 
 #include "sec_security_openssl.h"
 #include "sec_security_utils.h"
+#include "sec_security_stats.h"
+#include "sec_security_trace.h"
+#include "sec_security_arena.h"
 #include <stdlib.h>
 #include <string.h>
 #include <openssl/evp.h>
@@ -29,12 +32,20 @@
 #include <openssl/rsa.h>
 #include <openssl/err.h>
 #include <openssl/aes.h>
+#include <openssl/x509v3.h>
 #include "sec_security_asn1kc.h"
 #include "sec_version.h"
 #include "sec_pubops.h"
 #include "sec_security_jtype.h"
 #include "sec_security_outprot.h"
 #include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "outprot.h"
 
 #ifndef SEC_OBJECTID_COMCAST_XCALSESSIONMACKEY
@@ -58,10 +69,46 @@
         return SEC_RESULT_INVALID_HANDLE; \
     }
 
+/* object id reported by the API tracepoints of calls on a key */
+#define SEC_TRACE_KEY_ID(key) (NULL != (key) ? (key)->object_id : SEC_OBJECTID_INVALID)
+
+/* the handles must fit the storage sizes published for the *_Init functions */
+typedef char _Sec_CipherHandleFits[sizeof(Sec_CipherHandle) <= SEC_CIPHERHANDLE_STORAGE_SIZE ? 1 : -1];
+typedef char _Sec_DigestHandleFits[sizeof(Sec_DigestHandle) <= SEC_DIGESTHANDLE_STORAGE_SIZE ? 1 : -1];
+typedef char _Sec_SignatureHandleFits[sizeof(Sec_SignatureHandle) <= SEC_SIGNATUREHANDLE_STORAGE_SIZE ? 1 : -1];
+typedef char _Sec_MacHandleFits[sizeof(Sec_MacHandle) <= SEC_MACHANDLE_STORAGE_SIZE ? 1 : -1];
+typedef char _Sec_RandomHandleFits[sizeof(Sec_RandomHandle) <= SEC_RANDOMHANDLE_STORAGE_SIZE ? 1 : -1];
+typedef char _Sec_KeyHandleFits[sizeof(Sec_KeyHandle) <= SEC_KEYHANDLE_STORAGE_SIZE ? 1 : -1];
+
+/* validate and clear caller provided storage for a handle of the given size */
+static Sec_Result _Sec_InitHandleStorage(void *storage, SEC_SIZE storageSize, SEC_SIZE handleSize)
+{
+    if (NULL == storage || storageSize < handleSize)
+    {
+        SEC_LOG_ERROR("Handle storage is too small, %d bytes are needed", handleSize);
+        return SEC_RESULT_BUFFER_TOO_SMALL;
+    }
+
+    if (((uintptr_t) storage) % SEC_HANDLE_STORAGE_ALIGN != 0)
+    {
+        SEC_LOG_ERROR("Handle storage is not aligned to %d bytes", SEC_HANDLE_STORAGE_ALIGN);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    memset(storage, 0, handleSize);
+
+    return SEC_RESULT_SUCCESS;
+}
+
 static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_CipherAlgorithm algorithm, Sec_CipherMode mode, Sec_KeyHandle* key,
         SEC_BYTE *iv, Sec_CipherHandle** cipherHandle, SEC_BOOL isUnwrap);
 
+static void _Sec_CertIndexFree(Sec_ProcessorHandle *proc);
+
+static Sec_Result _Sec_ProcessAsn1KeyContainer(Sec_ProcessorHandle *proc,
+        _Sec_KeyData *key_data, void *data, SEC_SIZE data_len, SEC_OBJECTID objectId);
+
 typedef struct {
     Sec_KeyProperties properties;
     _Sec_KeyInfo info;
@@ -116,6 +163,12 @@ static Sec_Result _load_exported(Sec_ProcessorHandle *proc,
         return SEC_RESULT_FAILURE;
     }
 
+    SEC_BYTE *data = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == data) {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
     pthread_mutex_lock(&g_export_mutex);
 
     Sec_Result export_res = SEC_RESULT_FAILURE;
@@ -126,11 +179,10 @@ static Sec_Result _load_exported(Sec_ProcessorHandle *proc,
         goto done_export;
     }
 
-    SEC_BYTE data[SEC_KEYCONTAINER_MAX_LEN];
     export_res = SecStore_RetrieveDataWithKey(proc,
             SEC_OBJECTID_OPENSSL_EXPORT, SEC_OBJECTID_OPENSSL_EXPORT_MAC,
             SEC_TRUE, NULL, 0,
-            data, sizeof(data),
+            data, SEC_KEYCONTAINER_MAX_LEN,
             exported, store_len);
 
     if (SEC_RESULT_SUCCESS != export_res) {
@@ -143,6 +195,7 @@ done_export:
 
     pthread_mutex_unlock(&g_export_mutex);
     if (export_res != SEC_RESULT_SUCCESS) {
+        SecArena_Free(data);
         return export_res;
     }
 
@@ -151,11 +204,13 @@ done_export:
 
     if (data_len > key_len) {
         SEC_LOG_ERROR("Key buffer %d is too small to hold %d", key_len, data_len);
+        SecArena_Free(data);
         return SEC_RESULT_FAILURE;
     }
     memcpy(key, data + sizeof(_ExportedHeader), data_len);
     *key_written = data_len;
 
+    SecArena_Free(data);
     return SEC_RESULT_SUCCESS;
 }
 
@@ -316,7 +371,7 @@ Sec_Result _Sec_ValidateCertificateData(Sec_ProcessorHandle *proc,
 
 Sec_Result _Sec_SymetricFromKeyHandle(Sec_KeyHandle *key, SEC_BYTE *out_key, SEC_SIZE out_key_len, SEC_SIZE *written)
 {
-    SEC_BYTE key_data[SEC_KEYCONTAINER_MAX_LEN];
+    SEC_BYTE *key_data = NULL;
     SecUtils_KeyStoreHeader keystore_header;
     Sec_Result res = SEC_RESULT_FAILURE;
     SecOpenSSL_DerivedInputs *inputs = NULL;
@@ -335,32 +390,49 @@ Sec_Result _Sec_SymetricFromKeyHandle(Sec_KeyHandle *key, SEC_BYTE *out_key, SEC
     }
 
     if (key->key_data.info.kc_type == SEC_KEYCONTAINER_JTYPE) {
-        SEC_BYTE wrappedKey[SEC_KEYCONTAINER_MAX_LEN];
         SEC_SIZE wrappedKeyLen = 0;
         Sec_CipherAlgorithm wrappingAlg;
         SEC_BYTE iv[SEC_AES_BLOCK_SIZE];
         Sec_KeyProperties keyProperties;
 
+        /* the wrapped key goes into the buffer the key store path would use */
+        key_data = (SEC_BYTE *) SecArena_Alloc();
+        if (NULL == key_data)
+        {
+            SEC_LOG_ERROR("SecArena_Alloc failed");
+            goto done;
+        }
+
         if (SEC_RESULT_SUCCESS != SecJType_ProcessKey(key->proc,
                 SEC_OBJECTID_COMCAST_XCALSESSIONMACKEY,
-                key->key_data.kc.buffer, key->key_data.kc_len, wrappedKey,
-                sizeof(wrappedKey), &wrappedKeyLen, &keyProperties,
+                key->key_data.kc.buffer, key->key_data.kc_len, key_data,
+                SEC_KEYCONTAINER_MAX_LEN, &wrappedKeyLen, &keyProperties,
                 &wrappingAlg, iv))
         {
             SEC_LOG_ERROR("SecJType_ProcessKey failed");
-            return SEC_RESULT_FAILURE;
+            goto done;
         }
 
         if (SEC_RESULT_SUCCESS != SecCipher_SingleInputId(key->proc,
                         wrappingAlg,
                         SEC_CIPHERMODE_DECRYPT,
                         SEC_OBJECTID_COMCAST_XCALSESSIONENCKEY,
-                        iv, wrappedKey, wrappedKeyLen,
+                        iv, key_data, wrappedKeyLen,
                         out_key, out_key_len, written))
         {
             SEC_LOG_ERROR("SecCipher_Process failed");
-            return SEC_RESULT_FAILURE;
+            goto done;
+        }
+    } else if (key->object_id == SEC_OBJECTID_OPENSSL_TRANSIENT
+            && key->key_data.info.kc_type == SEC_OPENSSL_KEYCONTAINER_TRANSIENT) {
+        if (key->key_data.kc_len > out_key_len)
+        {
+            SEC_LOG_ERROR("output buffer is too small");
+            goto done;
         }
+
+        memcpy(out_key, key->key_data.kc.buffer, key->key_data.kc_len);
+        *written = key->key_data.kc_len;
     } else if (key->key_data.info.kc_type == SEC_KEYCONTAINER_EXPORTED) {
         _ExportedHeader header;
 
@@ -369,7 +441,7 @@ Sec_Result _Sec_SymetricFromKeyHandle(Sec_KeyHandle *key, SEC_BYTE *out_key, SEC
                         out_key, out_key_len, written,
                         key->key_data.kc.buffer, key->key_data.kc_len)) {
             SEC_LOG_ERROR("_load_exported failed");
-            return SEC_RESULT_FAILURE;
+            goto done;
         }
     } else {
         if (key->key_data.info.kc_type != SEC_KEYCONTAINER_STORE)
@@ -378,9 +450,16 @@ Sec_Result _Sec_SymetricFromKeyHandle(Sec_KeyHandle *key, SEC_BYTE *out_key, SEC
             goto done;
         }
 
+        key_data = (SEC_BYTE *) SecArena_Alloc();
+        if (NULL == key_data)
+        {
+            SEC_LOG_ERROR("SecArena_Alloc failed");
+            goto done;
+        }
+
         if (SEC_RESULT_SUCCESS != SecStore_RetrieveData(key->proc, SEC_FALSE,
                 &keystore_header, sizeof(keystore_header),
-                key_data, sizeof(key_data), &key->key_data.kc.store, key->key_data.kc_len))
+                key_data, SEC_KEYCONTAINER_MAX_LEN, &key->key_data.kc.store, key->key_data.kc_len))
         {
             SEC_LOG_ERROR("SecStore_RetrieveData failed");
             goto done;
@@ -437,7 +516,7 @@ Sec_Result _Sec_SymetricFromKeyHandle(Sec_KeyHandle *key, SEC_BYTE *out_key, SEC
     res = SEC_RESULT_SUCCESS;
 
 done:
-    Sec_Memset(key_data, 0, sizeof(key_data));
+    SecArena_Free(key_data);
     Sec_Memset(ladder_1, 0, sizeof(ladder_1));
 
     return res;
@@ -473,10 +552,73 @@ done:
     return res;
 }
 
+static SEC_BOOL _Sec_RSAHasFactors(RSA *rsa)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    return rsa->p != NULL && rsa->q != NULL;
+#else
+    const BIGNUM *p = NULL;
+    const BIGNUM *q = NULL;
+    RSA_get0_factors(rsa, &p, &q);
+    return p != NULL && q != NULL;
+#endif
+}
+
+RSA *_Sec_RSAGenerate(Sec_KeyType keyType)
+{
+    RSA *rsa = NULL;
+    BIGNUM *e = NULL;
+
+    if (!SecKey_IsPrivRsa(keyType))
+    {
+        SEC_LOG_ERROR("Not an RSA private key type: %d", keyType);
+        return NULL;
+    }
+
+    rsa = RSA_new();
+    e = BN_new();
+    if (NULL == rsa || NULL == e || 1 != BN_set_word(e, RSA_F4)
+            || 1 != RSA_generate_key_ex(rsa, SecKey_GetKeyLenForKeyType(keyType) * 8, e, NULL))
+    {
+        SEC_LOG_ERROR("RSA_generate_key_ex failed: %s", ERR_error_string(ERR_get_error(), NULL));
+        SEC_RSA_FREE(rsa);
+    }
+
+    if (NULL != e)
+        BN_free(e);
+
+    return rsa;
+}
+
+/*
+ * A pinned key is not loaded from the store again, so the key validity and the output
+ * protection that loading it would have been subject to are checked on every use.
+ */
+static Sec_Result _Sec_PinnedKeyAllowed(Sec_KeyHandle *key)
+{
+    if (SEC_RESULT_SUCCESS != SecOutprot_IsKeyAllowed(&key->pinned->props, key->pinned->props.usage))
+    {
+        SEC_LOG_ERROR("SecOutprot_IsKeyAllowed failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
+static void _Sec_UnpinKey(_Sec_PinnedKey *pinned)
+{
+    if (NULL == pinned)
+        return;
+
+    SEC_RSA_FREE(pinned->rsa);
+    SEC_ECC_FREE(pinned->ec_key);
+    SEC_FREE(pinned);
+}
+
 RSA *_Sec_RSAFromKeyHandle(Sec_KeyHandle *key)
 {
     SecUtils_KeyStoreHeader keystore_header;
-    SEC_BYTE key_data[SEC_KEYCONTAINER_MAX_LEN];
+    SEC_BYTE *key_data = NULL;
     RSA *rsa = NULL;
 
     if (!SecKey_IsRsa(key->key_data.info.key_type))
@@ -485,6 +627,23 @@ RSA *_Sec_RSAFromKeyHandle(Sec_KeyHandle *key)
         goto done;
     }
 
+    if (NULL != key->pinned && NULL != key->pinned->rsa)
+    {
+        if (SEC_RESULT_SUCCESS != _Sec_PinnedKeyAllowed(key))
+            goto done;
+
+        RSA_up_ref(key->pinned->rsa);
+        rsa = key->pinned->rsa;
+        goto done;
+    }
+
+    key_data = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == key_data)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     /* here the key is loaded in clear.  On a secure processor, the loading
      should be done in a secure manner with the key never being exposed to
      the host processor. */
@@ -496,7 +655,7 @@ RSA *_Sec_RSAFromKeyHandle(Sec_KeyHandle *key)
 
     if (SEC_RESULT_SUCCESS != SecStore_RetrieveData(key->proc, SEC_FALSE,
             &keystore_header, sizeof(keystore_header),
-            key_data, sizeof(key_data), &key->key_data.kc.store, key->key_data.kc_len))
+            key_data, SEC_KEYCONTAINER_MAX_LEN, &key->key_data.kc.store, key->key_data.kc_len))
     {
         SEC_LOG_ERROR("SecStore_RetrieveData failed");
         goto done;
@@ -507,7 +666,10 @@ RSA *_Sec_RSAFromKeyHandle(Sec_KeyHandle *key)
     case SEC_KEYTYPE_RSA_1024:
     case SEC_KEYTYPE_RSA_2048:
     case SEC_KEYTYPE_RSA_3072:
-        rsa = SecUtils_RSAFromPrivBinary((Sec_RSARawPrivateKey*) key_data);
+        if (SecStore_GetDataLen(&key->key_data.kc.store) == sizeof(Sec_RSARawPrivateFullKey))
+            rsa = SecUtils_RSAFromPrivFullBinary((Sec_RSARawPrivateFullKey*) key_data);
+        else
+            rsa = SecUtils_RSAFromPrivBinary((Sec_RSARawPrivateKey*) key_data);
         if (rsa == NULL)
         {
             SEC_LOG_ERROR("SecUtils_RSAFromPrivBinary failed");
@@ -532,14 +694,14 @@ RSA *_Sec_RSAFromKeyHandle(Sec_KeyHandle *key)
     }
 
 done:
-    Sec_Memset(key_data, 0, sizeof(key_data));
+    SecArena_Free(key_data);
     return rsa;
 }
 
 EC_KEY *_Sec_ECCFromKeyHandle(Sec_KeyHandle *keyHandle)
 {
     SecUtils_KeyStoreHeader keystore_header;
-    SEC_BYTE key_data[SEC_KEYCONTAINER_MAX_LEN];
+    SEC_BYTE *key_data = NULL;
     SEC_SIZE written;
     EC_KEY *ec_key = NULL;
 
@@ -549,12 +711,29 @@ EC_KEY *_Sec_ECCFromKeyHandle(Sec_KeyHandle *keyHandle)
         goto done;
     }
 
+    if (NULL != keyHandle->pinned && NULL != keyHandle->pinned->ec_key)
+    {
+        if (SEC_RESULT_SUCCESS != _Sec_PinnedKeyAllowed(keyHandle))
+            goto done;
+
+        EC_KEY_up_ref(keyHandle->pinned->ec_key);
+        ec_key = keyHandle->pinned->ec_key;
+        goto done;
+    }
+
+    key_data = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == key_data)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     if (keyHandle->key_data.info.kc_type == SEC_KEYCONTAINER_EXPORTED) {
         _ExportedHeader header;
 
         if (SEC_RESULT_SUCCESS != _load_exported(keyHandle->proc,
                         &header,
-                        key_data, sizeof(key_data), &written,
+                        key_data, SEC_KEYCONTAINER_MAX_LEN, &written,
                         keyHandle->key_data.kc.buffer, keyHandle->key_data.kc_len)) {
             SEC_LOG_ERROR("_load_exported failed");
             goto done;
@@ -568,7 +747,7 @@ EC_KEY *_Sec_ECCFromKeyHandle(Sec_KeyHandle *keyHandle)
         if (SEC_RESULT_SUCCESS
                 != SecStore_RetrieveData(keyHandle->proc, SEC_FALSE,
                         &keystore_header, sizeof(keystore_header), key_data,
-                        sizeof(key_data), &keyHandle->key_data.kc.store,
+                        SEC_KEYCONTAINER_MAX_LEN, &keyHandle->key_data.kc.store,
                         keyHandle->key_data.kc_len))
         {
             SEC_LOG_ERROR("SecStore_RetrieveData failed");
@@ -602,10 +781,110 @@ EC_KEY *_Sec_ECCFromKeyHandle(Sec_KeyHandle *keyHandle)
     }
 
 done:
-    Sec_Memset(key_data, 0, sizeof(key_data));
+    SecArena_Free(key_data);
     return ec_key;
 }
 
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+static int _Sec_Curve25519PKeyId(Sec_KeyType type)
+{
+    switch (type)
+    {
+    case SEC_KEYTYPE_X25519:
+    case SEC_KEYTYPE_X25519_PUBLIC:
+        return EVP_PKEY_X25519;
+
+    case SEC_KEYTYPE_ED25519:
+    case SEC_KEYTYPE_ED25519_PUBLIC:
+        return EVP_PKEY_ED25519;
+
+    default:
+        break;
+    }
+
+    return NID_undef;
+}
+
+static EVP_PKEY *_Sec_Curve25519FromRaw(Sec_KeyType type, const SEC_BYTE *data, SEC_SIZE data_len)
+{
+    EVP_PKEY *evp_key = NULL;
+
+    if (NID_undef == _Sec_Curve25519PKeyId(type) || data_len != SEC_CURVE25519_KEY_LEN)
+    {
+        SEC_LOG_ERROR("Invalid X25519/Ed25519 key data");
+        return NULL;
+    }
+
+    if (SecKey_IsPrivCurve25519(type))
+        evp_key = EVP_PKEY_new_raw_private_key(_Sec_Curve25519PKeyId(type), NULL, data, data_len);
+    else
+        evp_key = EVP_PKEY_new_raw_public_key(_Sec_Curve25519PKeyId(type), NULL, data, data_len);
+
+    if (NULL == evp_key)
+    {
+        SEC_LOG_ERROR("EVP_PKEY_new_raw_*_key failed: %s", ERR_error_string(ERR_get_error(), NULL));
+    }
+
+    return evp_key;
+}
+
+EVP_PKEY *_Sec_Curve25519FromKeyHandle(Sec_KeyHandle *keyHandle)
+{
+    SecUtils_KeyStoreHeader keystore_header;
+    SEC_BYTE *key_data = NULL;
+    SEC_SIZE written;
+    EVP_PKEY *evp_key = NULL;
+
+    if (!SecKey_IsCurve25519(keyHandle->key_data.info.key_type))
+    {
+        SEC_LOG_ERROR("Not an X25519/Ed25519 key");
+        goto done;
+    }
+
+    key_data = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == key_data)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
+    if (keyHandle->key_data.info.kc_type == SEC_KEYCONTAINER_EXPORTED) {
+        _ExportedHeader header;
+
+        if (SEC_RESULT_SUCCESS != _load_exported(keyHandle->proc,
+                        &header,
+                        key_data, SEC_KEYCONTAINER_MAX_LEN, &written,
+                        keyHandle->key_data.kc.buffer, keyHandle->key_data.kc_len)) {
+            SEC_LOG_ERROR("_load_exported failed");
+            goto done;
+        }
+    } else {
+        if (SEC_RESULT_SUCCESS
+                != SecStore_RetrieveData(keyHandle->proc, SEC_FALSE,
+                        &keystore_header, sizeof(keystore_header), key_data,
+                        SEC_KEYCONTAINER_MAX_LEN, &keyHandle->key_data.kc.store,
+                        keyHandle->key_data.kc_len))
+        {
+            SEC_LOG_ERROR("SecStore_RetrieveData failed");
+            goto done;
+        }
+        written = SecStore_GetDataLen(&keyHandle->key_data.kc.store);
+    }
+
+    if (written != SEC_CURVE25519_KEY_LEN)
+    {
+        SEC_LOG_ERROR("invalid size in store %d", written);
+        goto done;
+    }
+
+    evp_key = _Sec_Curve25519FromRaw(keyHandle->key_data.info.key_type, key_data, written);
+
+done:
+    SecArena_Free(key_data);
+    return evp_key;
+}
+#endif
+
 void _Sec_FindRAMKeyData(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID object_id,
         _Sec_RAMKeyData **data, _Sec_RAMKeyData **parent)
 {
@@ -676,8 +955,6 @@ Sec_Result SecOpenSSL_ProcessKeyContainer(Sec_ProcessorHandle *proc,
     SecUtils_KeyStoreHeader keystore_header;
     const unsigned char *p = (unsigned char*) data;
     PKCS8_PRIV_KEY_INFO *p8;
-    SEC_SIZE wrappedKeyLen = 2048;
-    SEC_BYTE wrappedKey[wrappedKeyLen];
 
     memset(key_data, 0, sizeof(_Sec_KeyData));
 
@@ -757,7 +1034,10 @@ Sec_Result SecOpenSSL_ProcessKeyContainer(Sec_ProcessorHandle *proc,
             || data_type == SEC_KEYCONTAINER_RAW_RSA_2048
             || data_type == SEC_KEYCONTAINER_RAW_RSA_3072)
     {
-        if (data_len != sizeof(Sec_RSARawPrivateKey))
+        /* the full form also carries the factors so that the CRT parameters
+         can be recomputed on load */
+        if (data_len != sizeof(Sec_RSARawPrivateKey)
+                && data_len != sizeof(Sec_RSARawPrivateFullKey))
         {
             SEC_LOG_ERROR("Invalid key container length");
             return SEC_RESULT_INVALID_PARAMETERS;
@@ -766,7 +1046,10 @@ Sec_Result SecOpenSSL_ProcessKeyContainer(Sec_ProcessorHandle *proc,
         key_data->info.key_type = SecKey_GetKeyTypeForClearKeyContainer(data_type);
 
         /* validate the key */
-        rsa = SecUtils_RSAFromPrivBinary((Sec_RSARawPrivateKey *) data);
+        if (data_len == sizeof(Sec_RSARawPrivateFullKey))
+            rsa = SecUtils_RSAFromPrivFullBinary((Sec_RSARawPrivateFullKey *) data);
+        else
+            rsa = SecUtils_RSAFromPrivBinary((Sec_RSARawPrivateKey *) data);
         if (rsa == NULL
                 || (SEC_SIZE) RSA_size(rsa)
                         != SecKey_GetKeyLenForKeyType(key_data->info.key_type))
@@ -1202,232 +1485,112 @@ Sec_Result SecOpenSSL_ProcessKeyContainer(Sec_ProcessorHandle *proc,
         return SEC_RESULT_SUCCESS;
     }
 
-    if (data_type == SEC_KEYCONTAINER_ASN1)
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+    if (data_type == SEC_KEYCONTAINER_RAW_X25519
+            || data_type == SEC_KEYCONTAINER_RAW_X25519_PUBLIC
+            || data_type == SEC_KEYCONTAINER_RAW_ED25519
+            || data_type == SEC_KEYCONTAINER_RAW_ED25519_PUBLIC)
     {
-        SEC_BYTE tempkc[SEC_KEYCONTAINER_MAX_LEN];
-        SEC_SIZE tempkcLen;
-        Sec_KeyContainer tempkcType;
-        Sec_KeyType wrappedKeyType;
-        SEC_OBJECTID wrappingId;
-        SEC_BYTE wrappingIv[SEC_AES_BLOCK_SIZE];
-        Sec_CipherAlgorithm wrappingAlg;
-        SEC_SIZE wrappedKeyOffset;
-        SEC_BYTE wrappingKey[SEC_KEYCONTAINER_MAX_LEN];
-        SEC_SIZE wrappingKeyLen;
-
-        Sec_Asn1KC *asn1kc = SecAsn1KC_Decode(data, data_len);
-        if (asn1kc == NULL)
+        if (data_len != SEC_CURVE25519_KEY_LEN)
         {
-            SEC_LOG_ERROR("SecAsn1KC_Decode failed");
-            return SEC_RESULT_FAILURE;
+            SEC_LOG_ERROR("Invalid key container length");
+            return SEC_RESULT_INVALID_PARAMETERS;
         }
 
-        if (SEC_RESULT_SUCCESS != SecKey_ExtractWrappedKeyParamsAsn1V3(asn1kc, tempkc, sizeof(tempkc), &tempkcLen,
-                                                                     &wrappedKeyType, &wrappingId, wrappingIv, &wrappingAlg,
-                                                                     &wrappedKeyOffset,
-                                                                     wrappingKey, sizeof(wrappingKey), &wrappingKeyLen))
+        key_data->info.key_type = SecKey_GetKeyTypeForClearKeyContainer(data_type);
+
+        evp_key = _Sec_Curve25519FromRaw(key_data->info.key_type, data, data_len);
+        if (evp_key == NULL)
         {
-            SEC_LOG_ERROR("SecKey_ExtractWrappedKeyParamsAsn1V3 failed");
-            SecAsn1KC_Free(asn1kc);
-            return SEC_RESULT_FAILURE;
+            SEC_LOG_ERROR("Invalid X25519/Ed25519 key container");
+            return SEC_RESULT_INVALID_PARAMETERS;
         }
 
-        SecAsn1KC_Free(asn1kc);
+        SEC_EVPPKEY_FREE(evp_key);
+        goto store_data;
+    }
 
-        if (wrappingKeyLen > 0) {
-            //V3
+    if (data_type == SEC_KEYCONTAINER_DER_X25519
+            || data_type == SEC_KEYCONTAINER_DER_X25519_PUBLIC
+            || data_type == SEC_KEYCONTAINER_DER_ED25519
+            || data_type == SEC_KEYCONTAINER_DER_ED25519_PUBLIC)
+    {
+        Sec_KeyType keyType = SecKey_GetKeyTypeForClearKeyContainer(data_type);
+        SEC_BYTE raw[SEC_CURVE25519_KEY_LEN];
+        size_t raw_len = sizeof(raw);
+        int ok;
 
-            //get free id
-            SEC_OBJECTID tempId = SecKey_ObtainFreeObjectId(proc, SEC_OBJECTID_RESERVED_BASE, SEC_OBJECTID_RESERVED_TOP);
-            if (SEC_OBJECTID_INVALID == tempId) {
-                SEC_LOG_ERROR("SecKey_ObtainFreeObjectId failed");
-                return SEC_RESULT_FAILURE;
-            }
+        if (SecKey_IsPrivCurve25519(keyType))
+            evp_key = d2i_AutoPrivateKey(NULL, &p, data_len);
+        else
+            evp_key = d2i_PUBKEY(NULL, &p, data_len);
 
-            //provision wrapping key
-            if (SEC_RESULT_SUCCESS != SecKey_Provision(proc, tempId, SEC_STORAGELOC_RAM, SEC_KEYCONTAINER_ASN1, wrappingKey, wrappingKeyLen)) {
-                SEC_LOG_ERROR("SecKey_Provision failed");
-                return SEC_RESULT_FAILURE;
-            }
+        if (evp_key == NULL || EVP_PKEY_id(evp_key) != _Sec_Curve25519PKeyId(keyType))
+        {
+            SEC_LOG_ERROR("Invalid X25519/Ed25519 DER key container");
+            SEC_EVPPKEY_FREE(evp_key);
+            return SEC_RESULT_INVALID_PARAMETERS;
+        }
 
-            //unwrap
-            if (SEC_RESULT_SUCCESS != SecCipher_SingleInputId(proc,
-                    wrappingAlg, SEC_CIPHERMODE_DECRYPT, tempId,
-                    wrappingIv, tempkc, tempkcLen, tempkc,
-                    sizeof(tempkc), &tempkcLen)) {
-                SEC_LOG_ERROR("SecCipher_SingleInputId failed");
-                SecKey_Delete(proc, tempId);
-                return SEC_RESULT_FAILURE;
-            }
+        if (SecKey_IsPrivCurve25519(keyType))
+            ok = EVP_PKEY_get_raw_private_key(evp_key, raw, &raw_len);
+        else
+            ok = EVP_PKEY_get_raw_public_key(evp_key, raw, &raw_len);
+        SEC_EVPPKEY_FREE(evp_key);
 
-            //release wrapping key
-            SecKey_Delete(proc, tempId);
+        if (1 != ok || raw_len != SEC_CURVE25519_KEY_LEN)
+        {
+            SEC_LOG_ERROR("EVP_PKEY_get_raw_*_key failed");
+            Sec_Memset(raw, 0, sizeof(raw));
+            return SEC_RESULT_FAILURE;
+        }
 
-            Sec_ECCRawOnlyPrivateKey eccRawOnlyPrivKey;
-            switch(wrappedKeyType)
-            {
-            case SEC_KEYTYPE_RSA_1024:
-                tempkcType = SEC_KEYCONTAINER_DER_RSA_1024;
-                break;
-            case SEC_KEYTYPE_RSA_2048:
-                tempkcType = SEC_KEYCONTAINER_DER_RSA_2048;
-                break;
-            case SEC_KEYTYPE_ECC_NISTP256:
-                tempkcType = SEC_KEYCONTAINER_RAW_ECC_PRIVONLY_NISTP256;
+        ok = SecOpenSSL_ProcessKeyContainer(proc, key_data,
+                SecKey_GetClearContainer(keyType), raw, sizeof(raw), objectId) == SEC_RESULT_SUCCESS;
+        Sec_Memset(raw, 0, sizeof(raw));
 
-                // Convert a 32 byte value into a raw ECC structure prv value
-                memcpy(eccRawOnlyPrivKey.prv, tempkc, sizeof(eccRawOnlyPrivKey));
-                tempkcLen = sizeof(eccRawOnlyPrivKey);
-                memcpy(tempkc, &eccRawOnlyPrivKey, tempkcLen);
-                break;
-            case SEC_KEYTYPE_AES_128:
-                tempkcType = SEC_KEYCONTAINER_RAW_AES_128;
-                break;
-            case SEC_KEYTYPE_AES_256:
-                tempkcType = SEC_KEYCONTAINER_RAW_AES_256;
-                break;
-            case SEC_KEYTYPE_HMAC_128:
-                tempkcType = SEC_KEYCONTAINER_RAW_HMAC_128;
-                break;
-            case SEC_KEYTYPE_HMAC_160:
-                tempkcType = SEC_KEYCONTAINER_RAW_HMAC_160;
-                break;
-            case SEC_KEYTYPE_HMAC_256:
-                tempkcType = SEC_KEYCONTAINER_RAW_HMAC_256;
-                break;
-            default:
-                SEC_LOG_ERROR("Wrapped keyType is not yet supported");
-                return SEC_RESULT_FAILURE;
-            }
+        if (!ok) {
+            SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
+            return SEC_RESULT_INVALID_PARAMETERS;
+        }
 
-            if (wrappedKeyOffset > 0 && !SecKey_IsSymetric(wrappedKeyType)) {
-                SEC_LOG_ERROR("Only wrapped symetric keys can specify an offset");
-                return SEC_RESULT_FAILURE;
-            }
+        return SEC_RESULT_SUCCESS;
+    }
+#endif
 
-            /* process the unwrapped key */
-            if (SecKey_IsSymetric(wrappedKeyType)) {
-                if ((tempkcLen - wrappedKeyOffset) < SecKey_GetKeyLenForKeyType(wrappedKeyType)) {
-                    SEC_LOG_ERROR("payload is too small(%d) for specified offset %d", tempkcLen, wrappedKeyOffset);
-                        return SEC_RESULT_FAILURE;
-                }
+    if (data_type == SEC_KEYCONTAINER_ASN1)
+    {
+        return _Sec_ProcessAsn1KeyContainer(proc, key_data, data, data_len, objectId);
+    }
 
-                if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
-                        key_data, tempkcType, &tempkc[wrappedKeyOffset],
-                        SecKey_GetKeyLenForKeyType(wrappedKeyType), objectId))
-                {
-                    SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
-                    return SEC_RESULT_FAILURE;
-                }
-            } else {
-                if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
-                        key_data, tempkcType, tempkc,
-                        tempkcLen, objectId))
-                {
-                    SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
-                    return SEC_RESULT_FAILURE;
-                }
-            }
+    if (data_type == SEC_KEYCONTAINER_JTYPE)
+    {
+        Sec_KeyProperties lkp;
+        Sec_CipherAlgorithm alg;
+        SEC_BYTE iv[SEC_AES_BLOCK_SIZE];
+        SEC_BYTE *wrappedKey;
+        SEC_SIZE wrappedKeyLen;
+        Sec_Result res;
 
-            return SEC_RESULT_SUCCESS;
-        } else {
-            //V2
-            if (SEC_RESULT_SUCCESS != _SecCipher_SingleInputId(proc,
-                    wrappingAlg, SEC_CIPHERMODE_DECRYPT, wrappingId,
-                    wrappingIv, tempkc, tempkcLen, tempkc,
-                    sizeof(tempkc), &tempkcLen))
-            {
-                SEC_LOG_ERROR("SecCipher_SingleInputId failed");
-                return SEC_RESULT_FAILURE;
-            }
+        wrappedKey = (SEC_BYTE *) SecArena_Alloc();
+        if (NULL == wrappedKey)
+        {
+            SEC_LOG_ERROR("SecArena_Alloc failed");
+            return SEC_RESULT_FAILURE;
+        }
 
-            Sec_ECCRawOnlyPrivateKey eccRawOnlyPrivKey;
+        res = SecJType_ProcessKey(proc, SEC_OBJECTID_COMCAST_XCALSESSIONMACKEY,
+                        data,
+                        data_len,
+                        wrappedKey, SEC_KEYCONTAINER_MAX_LEN, &wrappedKeyLen,
+                        &lkp, &alg, iv);
+        SecArena_Free(wrappedKey);
 
-            switch(wrappedKeyType)
-            {
-            case SEC_KEYTYPE_RSA_1024:
-                tempkcType = SEC_KEYCONTAINER_DER_RSA_1024;
-                break;
-            case SEC_KEYTYPE_RSA_2048:
-                tempkcType = SEC_KEYCONTAINER_DER_RSA_2048;
-                break;
-            case SEC_KEYTYPE_ECC_NISTP256:
-                tempkcType = SEC_KEYCONTAINER_RAW_ECC_PRIVONLY_NISTP256;
-
-                // Convert a 32 byte value into a raw ECC structure prv value
-                memcpy(eccRawOnlyPrivKey.prv, tempkc, sizeof(eccRawOnlyPrivKey));
-                tempkcLen = sizeof(eccRawOnlyPrivKey);
-                memcpy(tempkc, &eccRawOnlyPrivKey, tempkcLen);
-                break;
-            case SEC_KEYTYPE_AES_128:
-                tempkcType = SEC_KEYCONTAINER_RAW_AES_128;
-                break;
-            case SEC_KEYTYPE_AES_256:
-                tempkcType = SEC_KEYCONTAINER_RAW_AES_256;
-                break;
-            case SEC_KEYTYPE_HMAC_128:
-                tempkcType = SEC_KEYCONTAINER_RAW_HMAC_128;
-                break;
-            case SEC_KEYTYPE_HMAC_160:
-                tempkcType = SEC_KEYCONTAINER_RAW_HMAC_160;
-                break;
-            case SEC_KEYTYPE_HMAC_256:
-                tempkcType = SEC_KEYCONTAINER_RAW_HMAC_256;
-                break;
-            default:
-                SEC_LOG_ERROR("Wrapped keyType is not yet supported");
-                return SEC_RESULT_FAILURE;
-            }
-
-            if (wrappedKeyOffset > 0 && !SecKey_IsSymetric(wrappedKeyType)) {
-                SEC_LOG_ERROR("Only wrapped symetric keys can specify an offset");
-                return SEC_RESULT_FAILURE;
-            }
-
-            /* process the unwrapped key */
-            if (SecKey_IsSymetric(wrappedKeyType)) {
-                if ((tempkcLen - wrappedKeyOffset) < SecKey_GetKeyLenForKeyType(wrappedKeyType)) {
-                    SEC_LOG_ERROR("payload is too small(%d) for specified offset %d", tempkcLen, wrappedKeyOffset);
-                        return SEC_RESULT_FAILURE;
-                }
-
-                if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
-                        key_data, tempkcType, &tempkc[wrappedKeyOffset],
-                        SecKey_GetKeyLenForKeyType(wrappedKeyType), objectId))
-                {
-                    SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
-                    return SEC_RESULT_FAILURE;
-                }
-            } else {
-                if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
-                        key_data, tempkcType, tempkc,
-                        tempkcLen, objectId))
-                {
-                    SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
-                    return SEC_RESULT_FAILURE;
-                }
-            }
-
-            return SEC_RESULT_SUCCESS;
-        }
-    }
-
-    if (data_type == SEC_KEYCONTAINER_JTYPE)
-    {
-        Sec_KeyProperties lkp;
-        Sec_CipherAlgorithm alg;
-        SEC_BYTE iv[SEC_AES_BLOCK_SIZE];
-
-        if (SEC_RESULT_SUCCESS
-                != SecJType_ProcessKey(proc, SEC_OBJECTID_COMCAST_XCALSESSIONMACKEY,
-                        data,
-                        data_len,
-                        wrappedKey, sizeof(wrappedKey), &wrappedKeyLen,
-                        &lkp, &alg, iv))
-        {
-            SEC_LOG_ERROR("SecJtype_ProcessKey failed");
-            return SEC_RESULT_FAILURE;
-        }
+        if (SEC_RESULT_SUCCESS != res)
+        {
+            SEC_LOG_ERROR("SecJtype_ProcessKey failed");
+            return SEC_RESULT_FAILURE;
+        }
 
         key_data->info.key_type = lkp.keyType;
         key_data->info.kc_type = data_type;
@@ -1441,13 +1604,23 @@ Sec_Result SecOpenSSL_ProcessKeyContainer(Sec_ProcessorHandle *proc,
     if (data_type == SEC_KEYCONTAINER_EXPORTED)
     {
         _ExportedHeader header;
-        SEC_BYTE skb_data[SEC_KEYCONTAINER_MAX_LEN];
+        SEC_BYTE *skb_data;
         SEC_SIZE skb_data_len;
+        Sec_Result res;
+
+        skb_data = (SEC_BYTE *) SecArena_Alloc();
+        if (NULL == skb_data) {
+            SEC_LOG_ERROR("SecArena_Alloc failed");
+            return SEC_RESULT_FAILURE;
+        }
 
-        if (SEC_RESULT_SUCCESS != _load_exported(proc,
+        res = _load_exported(proc,
                         &header,
-                        skb_data, sizeof(skb_data), &skb_data_len,
-                        data, data_len)) {
+                        skb_data, SEC_KEYCONTAINER_MAX_LEN, &skb_data_len,
+                        data, data_len);
+        SecArena_Free(skb_data);
+
+        if (SEC_RESULT_SUCCESS != res) {
             SEC_LOG_ERROR("_load_exported failed");
             return SEC_RESULT_FAILURE;
         }
@@ -1486,6 +1659,241 @@ Sec_Result SecOpenSSL_ProcessKeyContainer(Sec_ProcessorHandle *proc,
     return SEC_RESULT_SUCCESS;
 }
 
+/* unwrap an ASN1 key container and process the clear key it holds */
+static Sec_Result _Sec_ProcessAsn1KeyContainer(Sec_ProcessorHandle *proc,
+        _Sec_KeyData *key_data, void *data, SEC_SIZE data_len, SEC_OBJECTID objectId)
+{
+    SEC_BYTE *tempkc = NULL;
+    SEC_BYTE *wrappingKey = NULL;
+    SEC_SIZE tempkcLen;
+    Sec_KeyContainer tempkcType;
+    Sec_KeyType wrappedKeyType;
+    SEC_OBJECTID wrappingId;
+    SEC_BYTE wrappingIv[SEC_AES_BLOCK_SIZE];
+    Sec_CipherAlgorithm wrappingAlg;
+    SEC_SIZE wrappedKeyOffset;
+    SEC_SIZE wrappingKeyLen;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    tempkc = (SEC_BYTE *) SecArena_Alloc();
+    wrappingKey = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == tempkc || NULL == wrappingKey)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
+    Sec_Asn1KC *asn1kc = SecAsn1KC_Decode(data, data_len);
+    if (asn1kc == NULL)
+    {
+        SEC_LOG_ERROR("SecAsn1KC_Decode failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecKey_ExtractWrappedKeyParamsAsn1V3(asn1kc, tempkc, SEC_KEYCONTAINER_MAX_LEN, &tempkcLen,
+                                                                 &wrappedKeyType, &wrappingId, wrappingIv, &wrappingAlg,
+                                                                 &wrappedKeyOffset,
+                                                                 wrappingKey, SEC_KEYCONTAINER_MAX_LEN, &wrappingKeyLen))
+    {
+        SEC_LOG_ERROR("SecKey_ExtractWrappedKeyParamsAsn1V3 failed");
+        SecAsn1KC_Free(asn1kc);
+        goto done;
+    }
+
+    SecAsn1KC_Free(asn1kc);
+
+    if (wrappingKeyLen > 0) {
+        //V3
+
+        //load wrapping key
+        Sec_KeyHandle *wrappingKeyHandle = NULL;
+        if (SEC_RESULT_SUCCESS != SecKey_CreateTransient(proc, SEC_KEYCONTAINER_ASN1, wrappingKey, wrappingKeyLen, &wrappingKeyHandle)) {
+            SEC_LOG_ERROR("SecKey_CreateTransient failed");
+            goto done;
+        }
+
+        //unwrap
+        if (SEC_RESULT_SUCCESS != SecCipher_SingleInput(proc,
+                wrappingAlg, SEC_CIPHERMODE_DECRYPT, wrappingKeyHandle,
+                wrappingIv, tempkc, tempkcLen, tempkc,
+                SEC_KEYCONTAINER_MAX_LEN, &tempkcLen)) {
+            SEC_LOG_ERROR("SecCipher_SingleInput failed");
+            SecKey_Release(wrappingKeyHandle);
+            goto done;
+        }
+
+        //release wrapping key
+        SecKey_Release(wrappingKeyHandle);
+
+        Sec_ECCRawOnlyPrivateKey eccRawOnlyPrivKey;
+        switch(wrappedKeyType)
+        {
+        case SEC_KEYTYPE_RSA_1024:
+            tempkcType = SEC_KEYCONTAINER_DER_RSA_1024;
+            break;
+        case SEC_KEYTYPE_RSA_2048:
+            tempkcType = SEC_KEYCONTAINER_DER_RSA_2048;
+            break;
+        case SEC_KEYTYPE_ECC_NISTP256:
+            tempkcType = SEC_KEYCONTAINER_RAW_ECC_PRIVONLY_NISTP256;
+
+            // Convert a 32 byte value into a raw ECC structure prv value
+            memcpy(eccRawOnlyPrivKey.prv, tempkc, sizeof(eccRawOnlyPrivKey));
+            tempkcLen = sizeof(eccRawOnlyPrivKey);
+            memcpy(tempkc, &eccRawOnlyPrivKey, tempkcLen);
+            Sec_Memset(&eccRawOnlyPrivKey, 0, sizeof(eccRawOnlyPrivKey));
+            break;
+        case SEC_KEYTYPE_X25519:
+            tempkcType = SEC_KEYCONTAINER_RAW_X25519;
+            break;
+        case SEC_KEYTYPE_ED25519:
+            tempkcType = SEC_KEYCONTAINER_RAW_ED25519;
+            break;
+        case SEC_KEYTYPE_AES_128:
+            tempkcType = SEC_KEYCONTAINER_RAW_AES_128;
+            break;
+        case SEC_KEYTYPE_AES_256:
+            tempkcType = SEC_KEYCONTAINER_RAW_AES_256;
+            break;
+        case SEC_KEYTYPE_HMAC_128:
+            tempkcType = SEC_KEYCONTAINER_RAW_HMAC_128;
+            break;
+        case SEC_KEYTYPE_HMAC_160:
+            tempkcType = SEC_KEYCONTAINER_RAW_HMAC_160;
+            break;
+        case SEC_KEYTYPE_HMAC_256:
+            tempkcType = SEC_KEYCONTAINER_RAW_HMAC_256;
+            break;
+        default:
+            SEC_LOG_ERROR("Wrapped keyType is not yet supported");
+            goto done;
+        }
+
+        if (wrappedKeyOffset > 0 && !SecKey_IsSymetric(wrappedKeyType)) {
+            SEC_LOG_ERROR("Only wrapped symetric keys can specify an offset");
+            goto done;
+        }
+
+        /* process the unwrapped key */
+        if (SecKey_IsSymetric(wrappedKeyType)) {
+            if ((tempkcLen - wrappedKeyOffset) < SecKey_GetKeyLenForKeyType(wrappedKeyType)) {
+                SEC_LOG_ERROR("payload is too small(%d) for specified offset %d", tempkcLen, wrappedKeyOffset);
+                    goto done;
+            }
+
+            if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
+                    key_data, tempkcType, &tempkc[wrappedKeyOffset],
+                    SecKey_GetKeyLenForKeyType(wrappedKeyType), objectId))
+            {
+                SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
+                goto done;
+            }
+        } else {
+            if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
+                    key_data, tempkcType, tempkc,
+                    tempkcLen, objectId))
+            {
+                SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
+                goto done;
+            }
+        }
+
+        res = SEC_RESULT_SUCCESS;
+    } else {
+        //V2
+        if (SEC_RESULT_SUCCESS != _SecCipher_SingleInputId(proc,
+                wrappingAlg, SEC_CIPHERMODE_DECRYPT, wrappingId,
+                wrappingIv, tempkc, tempkcLen, tempkc,
+                SEC_KEYCONTAINER_MAX_LEN, &tempkcLen))
+        {
+            SEC_LOG_ERROR("SecCipher_SingleInputId failed");
+            goto done;
+        }
+
+        Sec_ECCRawOnlyPrivateKey eccRawOnlyPrivKey;
+
+        switch(wrappedKeyType)
+        {
+        case SEC_KEYTYPE_RSA_1024:
+            tempkcType = SEC_KEYCONTAINER_DER_RSA_1024;
+            break;
+        case SEC_KEYTYPE_RSA_2048:
+            tempkcType = SEC_KEYCONTAINER_DER_RSA_2048;
+            break;
+        case SEC_KEYTYPE_ECC_NISTP256:
+            tempkcType = SEC_KEYCONTAINER_RAW_ECC_PRIVONLY_NISTP256;
+
+            // Convert a 32 byte value into a raw ECC structure prv value
+            memcpy(eccRawOnlyPrivKey.prv, tempkc, sizeof(eccRawOnlyPrivKey));
+            tempkcLen = sizeof(eccRawOnlyPrivKey);
+            memcpy(tempkc, &eccRawOnlyPrivKey, tempkcLen);
+            Sec_Memset(&eccRawOnlyPrivKey, 0, sizeof(eccRawOnlyPrivKey));
+            break;
+        case SEC_KEYTYPE_X25519:
+            tempkcType = SEC_KEYCONTAINER_RAW_X25519;
+            break;
+        case SEC_KEYTYPE_ED25519:
+            tempkcType = SEC_KEYCONTAINER_RAW_ED25519;
+            break;
+        case SEC_KEYTYPE_AES_128:
+            tempkcType = SEC_KEYCONTAINER_RAW_AES_128;
+            break;
+        case SEC_KEYTYPE_AES_256:
+            tempkcType = SEC_KEYCONTAINER_RAW_AES_256;
+            break;
+        case SEC_KEYTYPE_HMAC_128:
+            tempkcType = SEC_KEYCONTAINER_RAW_HMAC_128;
+            break;
+        case SEC_KEYTYPE_HMAC_160:
+            tempkcType = SEC_KEYCONTAINER_RAW_HMAC_160;
+            break;
+        case SEC_KEYTYPE_HMAC_256:
+            tempkcType = SEC_KEYCONTAINER_RAW_HMAC_256;
+            break;
+        default:
+            SEC_LOG_ERROR("Wrapped keyType is not yet supported");
+            goto done;
+        }
+
+        if (wrappedKeyOffset > 0 && !SecKey_IsSymetric(wrappedKeyType)) {
+            SEC_LOG_ERROR("Only wrapped symetric keys can specify an offset");
+            goto done;
+        }
+
+        /* process the unwrapped key */
+        if (SecKey_IsSymetric(wrappedKeyType)) {
+            if ((tempkcLen - wrappedKeyOffset) < SecKey_GetKeyLenForKeyType(wrappedKeyType)) {
+                SEC_LOG_ERROR("payload is too small(%d) for specified offset %d", tempkcLen, wrappedKeyOffset);
+                    goto done;
+            }
+
+            if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
+                    key_data, tempkcType, &tempkc[wrappedKeyOffset],
+                    SecKey_GetKeyLenForKeyType(wrappedKeyType), objectId))
+            {
+                SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
+                goto done;
+            }
+        } else {
+            if (SEC_RESULT_SUCCESS != SecOpenSSL_ProcessKeyContainer(proc,
+                    key_data, tempkcType, tempkc,
+                    tempkcLen, objectId))
+            {
+                SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
+                goto done;
+            }
+        }
+
+        res = SEC_RESULT_SUCCESS;
+    }
+
+done:
+    SecArena_Free(tempkc);
+    SecArena_Free(wrappingKey);
+
+    return res;
+}
+
 Sec_Result _Sec_ProcessCertificateContainer(Sec_ProcessorHandle *proc,
         _Sec_CertificateData *cert_data, Sec_CertificateContainer data_type,
         void *data, SEC_SIZE data_len)
@@ -1609,6 +2017,7 @@ Sec_Result _Sec_RetrieveKeyData(Sec_ProcessorHandle* secProcHandle,
 
     /* check in RAM */
     _Sec_FindRAMKeyData(secProcHandle, object_id, &ram_key, &ram_key_parent);
+    SEC_STATS_CACHE(SEC_STATS_CACHE_RAM_KEY, ram_key != NULL);
     if (ram_key != NULL)
     {
         memcpy(keyData, &(ram_key->key_data), sizeof(_Sec_KeyData));
@@ -1637,6 +2046,13 @@ Sec_Result _Sec_RetrieveKeyData(Sec_ProcessorHandle* secProcHandle,
                 return SEC_RESULT_FAILURE;
             }
 
+            /* transient containers only ever live in SecKey_CreateTransient handles */
+            if (keyData->info.kc_type == SEC_OPENSSL_KEYCONTAINER_TRANSIENT)
+            {
+                SEC_LOG_ERROR("Invalid key container type in the key info file");
+                return SEC_RESULT_FAILURE;
+            }
+
             *location = SEC_STORAGELOC_FILE;
 
             return SEC_RESULT_SUCCESS;
@@ -1664,6 +2080,13 @@ Sec_Result _Sec_RetrieveKeyData(Sec_ProcessorHandle* secProcHandle,
                 return SEC_RESULT_FAILURE;
             }
 
+            /* transient containers only ever live in SecKey_CreateTransient handles */
+            if (keyData->info.kc_type == SEC_OPENSSL_KEYCONTAINER_TRANSIENT)
+            {
+                SEC_LOG_ERROR("Invalid key container type in the key info file");
+                return SEC_RESULT_FAILURE;
+            }
+
             *location = SEC_STORAGELOC_FILE;
 
             return SEC_RESULT_SUCCESS;
@@ -1810,6 +2233,10 @@ Sec_Result _Sec_StoreKeyData(Sec_ProcessorHandle* secProcHandle,
     char file_name_key[SEC_MAX_FILE_PATH_LEN];
     char file_name_info[SEC_MAX_FILE_PATH_LEN];
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(SEC_PUBOPS_TOMCRYPT)
+    _SecProvider_DropKey(secProcHandle, object_id);
+#endif
+
     if (location == SEC_STORAGELOC_RAM
             || location == SEC_STORAGELOC_RAM_SOFT_WRAPPED)
     {
@@ -1957,7 +2384,7 @@ Sec_Result _Sec_ProvisionBaseKey(Sec_ProcessorHandle *secProcHandle, SEC_BYTE *n
     SEC_SIZE cipher_output_len;
     SEC_BYTE cipher_output[SEC_SYMETRIC_KEY_MAX_LEN];
     SEC_BYTE *cipher_key = secProcHandle->root_key;
-    SEC_OBJECTID temp_key_id = SEC_OBJECTID_INVALID;
+    Sec_KeyHandle *temp_key = NULL;
     SEC_BYTE c1[SEC_SYMETRIC_KEY_MAX_LEN];
     SEC_BYTE c2[SEC_SYMETRIC_KEY_MAX_LEN];
     SEC_BYTE c3[SEC_SYMETRIC_KEY_MAX_LEN];
@@ -1977,25 +2404,23 @@ Sec_Result _Sec_ProvisionBaseKey(Sec_ProcessorHandle *secProcHandle, SEC_BYTE *n
     for (i = 1; i <= 4; i++)
     {
         /* encrypt digest */
-        temp_key_id = SEC_OBJECTID_OPENSSL_DERIVE_TMP;
-
-        /* provision temp key */
-        res = SecKey_Provision(secProcHandle, temp_key_id, SEC_STORAGELOC_RAM, SEC_KEYCONTAINER_RAW_AES_128, cipher_key, keySize);
+        res = SecKey_CreateTransient(secProcHandle, SEC_KEYCONTAINER_RAW_AES_128, cipher_key, keySize, &temp_key);
         if (SEC_RESULT_SUCCESS != res)
         {
-            SEC_LOG_ERROR("SecKey_Provision failed");
+            SEC_LOG_ERROR("SecKey_CreateTransient failed");
             goto done;
         }
 
-        res = SecCipher_SingleInputId(secProcHandle, cipherAlgorithm, cipherMode, temp_key_id, NULL,
+        res = SecCipher_SingleInput(secProcHandle, cipherAlgorithm, cipherMode, temp_key, NULL,
                 c[i-1], keySize, cipher_output, sizeof(cipher_output), &cipher_output_len);
 
-        /* delete temp key */
-        SecKey_Delete(secProcHandle, temp_key_id);
+        /* release temp key */
+        SecKey_Release(temp_key);
+        temp_key = NULL;
 
         if (SEC_RESULT_SUCCESS != res)
         {
-            SEC_LOG_ERROR("SecCipher_SingleInputId failed");
+            SEC_LOG_ERROR("SecCipher_SingleInput failed");
             goto done;
         }
 
@@ -2050,6 +2475,22 @@ Sec_Result SecProcessor_PrintInfo(Sec_ProcessorHandle* secProcHandle)
     return SEC_RESULT_SUCCESS;
 }
 
+static pthread_mutex_t g_sec_processor_count_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SEC_SIZE g_sec_processor_count = 0;
+
+/* adjusts the number of live processors and returns the new count */
+static SEC_SIZE _Sec_ProcessorCount(int delta)
+{
+    SEC_SIZE count;
+
+    pthread_mutex_lock(&g_sec_processor_count_mutex);
+    g_sec_processor_count += delta;
+    count = g_sec_processor_count;
+    pthread_mutex_unlock(&g_sec_processor_count_mutex);
+
+    return count;
+}
+
 Sec_Result SecProcessor_GetInstance_Directories(Sec_ProcessorHandle** secProcHandle, const char* globalDir, const char* appDir) {
     const char *otherInfo = "certMacKey" "hmacSha256" "concatKdfSha1";
     const char *nonce = "abcdefghijklmnopqr\0\0";
@@ -2073,6 +2514,9 @@ Sec_Result SecProcessor_GetInstance_Directories(Sec_ProcessorHandle** secProcHan
         SEC_LOG_ERROR("malloc failed");
         return SEC_RESULT_FAILURE;
     }
+    (*secProcHandle)->handle_pool = _SecHandlePool_New();
+    if (NULL == (*secProcHandle)->handle_pool)
+        goto error;
 
     /* setup key and cert directories */
     if (appDir != NULL) {
@@ -2153,11 +2597,14 @@ Sec_Result SecProcessor_GetInstance_Directories(Sec_ProcessorHandle** secProcHan
             SecKey_Derive_ConcatKDF(*secProcHandle, SEC_OBJECTID_CERTSTORE_KEY, SEC_KEYTYPE_HMAC_256, SEC_STORAGELOC_RAM_SOFT_WRAPPED, SEC_DIGESTALGORITHM_SHA256, (SEC_BYTE *) nonce, (SEC_BYTE *) otherInfo, strlen(otherInfo)),
             SEC_RESULT_SUCCESS, error);
 
+    _Sec_ProcessorCount(1);
+
     return SEC_RESULT_SUCCESS;
 
 error:
     if ((*secProcHandle) != NULL )
     {
+        _SecHandlePool_Release((*secProcHandle)->handle_pool);
         SEC_FREE(*secProcHandle);
         *secProcHandle = NULL;
     }
@@ -2189,6 +2636,9 @@ Sec_Result SecProcessor_GetInstance(Sec_ProcessorHandle** secProcHandle, Sec_Pro
         SEC_LOG_ERROR("malloc failed");
         return SEC_RESULT_FAILURE;
     }
+    (*secProcHandle)->handle_pool = _SecHandlePool_New();
+    if (NULL == (*secProcHandle)->handle_pool)
+        goto error;
 
     /* setup key and cert directories */
     (*secProcHandle)->app_dir = (char*) calloc(1, SEC_MAX_FILE_PATH_LEN);
@@ -2260,11 +2710,14 @@ Sec_Result SecProcessor_GetInstance(Sec_ProcessorHandle** secProcHandle, Sec_Pro
             SecKey_Derive_ConcatKDF(*secProcHandle, SEC_OBJECTID_CERTSTORE_KEY, SEC_KEYTYPE_HMAC_256, SEC_STORAGELOC_RAM_SOFT_WRAPPED, SEC_DIGESTALGORITHM_SHA256, (SEC_BYTE *) nonce, (SEC_BYTE *) otherInfo, strlen(otherInfo)),
             SEC_RESULT_SUCCESS, error);
 
+    _Sec_ProcessorCount(1);
+
     return SEC_RESULT_SUCCESS;
 
 error:
     if ((*secProcHandle) != NULL )
     {
+        _SecHandlePool_Release((*secProcHandle)->handle_pool);
         SEC_FREE(*secProcHandle);
         *secProcHandle = NULL;
     }
@@ -2288,6 +2741,12 @@ Sec_Result SecProcessor_Release(Sec_ProcessorHandle *secProcHandle)
     if (NULL == secProcHandle)
         return SEC_RESULT_SUCCESS;
 
+    _SecRSAPool_CancelJobs(secProcHandle);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(SEC_PUBOPS_TOMCRYPT)
+    _SecProvider_DropProcessor(secProcHandle);
+#endif
+
     /* release ram keys */
     while (secProcHandle->ram_keys != NULL)
     {
@@ -2307,6 +2766,13 @@ Sec_Result SecProcessor_Release(Sec_ProcessorHandle *secProcHandle)
                 secProcHandle->ram_certs->object_id);
     }
 
+    _Sec_CertIndexFree(secProcHandle);
+    _SecHandlePool_Release(secProcHandle->handle_pool);
+
+    /* the parsed public key cache is process wide and shared by the live processors */
+    if (0 == _Sec_ProcessorCount(-1))
+        _Pubops_FlushKeyCache();
+
     SEC_FREE(secProcHandle->app_dir);
     SEC_FREE(secProcHandle->global_dir);
 
@@ -2317,6 +2783,62 @@ Sec_Result SecProcessor_Release(Sec_ProcessorHandle *secProcHandle)
     return SEC_RESULT_SUCCESS;
 }
 
+static pthread_mutex_t g_reserved_id_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+SEC_OBJECTID _Sec_ReservedIdAcquire(Sec_ProcessorHandle *proc)
+{
+    SEC_SIZE offset;
+
+    pthread_mutex_lock(&g_reserved_id_mutex);
+
+    /* ids on the free list always have their bit cleared, the bitmap is only searched once it is empty */
+    if (proc->reserved_free_num > 0)
+        offset = proc->reserved_free[--proc->reserved_free_num];
+    else
+        offset = SecUtils_BitmapGetFirst(proc->reserved_ids, sizeof(proc->reserved_ids), SEC_FALSE);
+
+    if (offset >= SEC_RESERVEDID_NUM)
+    {
+        pthread_mutex_unlock(&g_reserved_id_mutex);
+        SEC_LOG_ERROR("All %d reserved ids are in use", SEC_RESERVEDID_NUM);
+        return SEC_OBJECTID_INVALID;
+    }
+
+    SecUtils_BitmapSet(proc->reserved_ids, offset, SEC_TRUE);
+
+    pthread_mutex_unlock(&g_reserved_id_mutex);
+
+    return SEC_OBJECTID_RESERVED_BASE + offset;
+}
+
+void _Sec_ReservedIdRelease(Sec_ProcessorHandle *proc, SEC_OBJECTID id)
+{
+    SEC_SIZE offset;
+
+    if (id < SEC_OBJECTID_RESERVED_BASE || id >= SEC_OBJECTID_RESERVED_TOP)
+    {
+        SEC_LOG_ERROR("Not a reserved id: " SEC_OBJECTID_PATTERN, id);
+        return;
+    }
+
+    offset = (SEC_SIZE) (id - SEC_OBJECTID_RESERVED_BASE);
+
+    pthread_mutex_lock(&g_reserved_id_mutex);
+
+    if (!SecUtils_BitmapGet(proc->reserved_ids, offset))
+    {
+        pthread_mutex_unlock(&g_reserved_id_mutex);
+        SEC_LOG_ERROR("Reserved id " SEC_OBJECTID_PATTERN " released twice", id);
+        return;
+    }
+
+    SecUtils_BitmapSet(proc->reserved_ids, offset, SEC_FALSE);
+    if (proc->reserved_free_num < SEC_RESERVEDID_FREELIST_SIZE)
+        proc->reserved_free[proc->reserved_free_num++] = (SEC_BYTE) offset;
+
+    pthread_mutex_unlock(&g_reserved_id_mutex);
+}
+
 SEC_SIZE SecProcessor_GetKeyLadderMinDepth(Sec_ProcessorHandle* handle, Sec_KeyLadderRoot root)
 {
     if (root == SEC_KEYLADDERROOT_UNIQUE) {
@@ -2374,14 +2896,17 @@ SEC_SIZE SecProcessor_GetKeyLadderMaxDepth(Sec_ProcessorHandle* handle, Sec_KeyL
  *  - Release
  */
 
-static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
+/* storage is NULL for pooled or heap handles, otherwise the handle is constructed in it */
+static Sec_Result _SecCipher_Setup(Sec_ProcessorHandle* secProcHandle,
         Sec_CipherAlgorithm algorithm, Sec_CipherMode mode, Sec_KeyHandle* key,
-        SEC_BYTE *iv, Sec_CipherHandle** cipherHandle, SEC_BOOL isUnwrap)
+        SEC_BYTE *iv, void *storage, SEC_SIZE storageSize,
+        Sec_CipherHandle** cipherHandle, SEC_BOOL isUnwrap)
 {
     Sec_CipherHandle localHandle;
+    Sec_CipherHandle *pooled = NULL;
     const EVP_CIPHER *evp_cipher = NULL;
     Sec_Result res = SEC_RESULT_FAILURE;
-    SEC_BYTE symetric_key[SEC_KEYCONTAINER_MAX_LEN];
+    SEC_BYTE *symetric_key = NULL;
     int padding = 0;
     Sec_KeyProperties keyProps;
     SEC_BOOL svp_required = SEC_FALSE;
@@ -2391,6 +2916,14 @@ static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
     memset(&localHandle, 0, sizeof(localHandle));
     memset(&keyProps,0, sizeof(Sec_KeyProperties));
 
+    if (NULL != storage)
+    {
+        res = _Sec_InitHandleStorage(storage, storageSize, sizeof(Sec_CipherHandle));
+        if (SEC_RESULT_SUCCESS != res)
+            return res;
+        res = SEC_RESULT_FAILURE;
+    }
+
     if (SEC_RESULT_SUCCESS != SecCipher_IsValidKey(key->key_data.info.key_type, algorithm, mode, iv))
     {
         SEC_LOG_ERROR("Invalid key used for specified algorithm");
@@ -2410,6 +2943,12 @@ static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
     }
     svp_required = SecOutprot_IsSVPRequired(&keyProps);
 
+    /* a released handle comes with a reset cipher context */
+    if (NULL == storage)
+        pooled = _SecHandlePool_TakeCipher(secProcHandle->handle_pool, algorithm);
+    if (NULL != pooled)
+        localHandle.evp_ctx = pooled->evp_ctx;
+
     switch (algorithm)
     {
     case SEC_CIPHERALGORITHM_AES_CBC_NO_PADDING:
@@ -2444,13 +2983,15 @@ static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
             goto done;
         }
 
-        localHandle.evp_ctx = EVP_CIPHER_CTX_new();
         if (localHandle.evp_ctx == NULL) {
-            SEC_LOG_ERROR("EVP_CIPHER_CTX_new failed");
-            goto done;
-        }
+            localHandle.evp_ctx = EVP_CIPHER_CTX_new();
+            if (localHandle.evp_ctx == NULL) {
+                SEC_LOG_ERROR("EVP_CIPHER_CTX_new failed");
+                goto done;
+            }
 
-        EVP_CIPHER_CTX_init(localHandle.evp_ctx);
+            EVP_CIPHER_CTX_init(localHandle.evp_ctx);
+        }
 
         if (1 != EVP_CipherInit_ex(localHandle.evp_ctx, evp_cipher, NULL,
                             NULL, NULL, (mode == SEC_CIPHERMODE_ENCRYPT || mode == SEC_CIPHERMODE_ENCRYPT_NATIVEMEM) ? 1 : 0))
@@ -2465,8 +3006,15 @@ static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
             goto done;
         }
 
+        symetric_key = (SEC_BYTE *) SecArena_Alloc();
+        if (NULL == symetric_key)
+        {
+            SEC_LOG_ERROR("SecArena_Alloc failed");
+            goto done;
+        }
+
         SEC_SIZE wr;
-        if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(key, symetric_key, sizeof(symetric_key), &wr))
+        if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(key, symetric_key, SEC_KEYCONTAINER_MAX_LEN, &wr))
         {
             SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
             goto done;
@@ -2493,7 +3041,12 @@ static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
         goto done;
     }
 
-    *cipherHandle = calloc(1, sizeof(Sec_CipherHandle));
+    if (NULL != storage)
+        *cipherHandle = (Sec_CipherHandle *) storage;
+    else if (NULL != pooled)
+        *cipherHandle = pooled;
+    else
+        *cipherHandle = calloc(1, sizeof(Sec_CipherHandle));
     if (NULL == *cipherHandle)
     {
         SEC_LOG_ERROR("malloc failed");
@@ -2501,6 +3054,9 @@ static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
     }
 
     memcpy(*cipherHandle, &localHandle, sizeof(localHandle));
+    /* caller storage is never handed to the pool */
+    if (NULL == storage)
+        (*cipherHandle)->pool = _SecHandlePool_Ref(secProcHandle->handle_pool);
     (*cipherHandle)->algorithm = algorithm;
     (*cipherHandle)->mode = mode;
     (*cipherHandle)->key_handle = key;
@@ -2519,18 +3075,59 @@ done:
         if (localHandle.evp_ctx != NULL) {
             EVP_CIPHER_CTX_free(localHandle.evp_ctx);
         }
+        SEC_FREE(pooled);
     }
-    Sec_Memset(symetric_key, 0, sizeof(symetric_key));
+    SecArena_Free(symetric_key);
     return res;
 }
 
+static Sec_Result _SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        Sec_CipherAlgorithm algorithm, Sec_CipherMode mode, Sec_KeyHandle* key,
+        SEC_BYTE *iv, Sec_CipherHandle** cipherHandle, SEC_BOOL isUnwrap)
+{
+    return _SecCipher_Setup(secProcHandle, algorithm, mode, key, iv,
+            NULL, 0, cipherHandle, isUnwrap);
+}
+
 Sec_Result SecCipher_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_CipherAlgorithm algorithm, Sec_CipherMode mode, Sec_KeyHandle* key,
         SEC_BYTE *iv, Sec_CipherHandle** cipherHandle) {
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_GETINSTANCE, SEC_TRACE_KEY_ID(key));
 
-    return _SecCipher_GetInstance(secProcHandle,
+    res = _SecCipher_GetInstance(secProcHandle,
         algorithm, mode, key,
         iv, cipherHandle, SEC_FALSE);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_GETINSTANCE, res);
+    return res;
+}
+
+Sec_Result SecCipher_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_CipherAlgorithm algorithm, Sec_CipherMode mode, Sec_KeyHandle* key,
+        SEC_BYTE *iv, void *storage, SEC_SIZE storageSize,
+        Sec_CipherHandle** cipherHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_GETINSTANCE, SEC_TRACE_KEY_ID(key));
+
+    if (NULL == storage)
+    {
+        SEC_LOG_ERROR("NULL storage");
+        res = SEC_RESULT_INVALID_PARAMETERS;
+    }
+    else
+    {
+        res = _SecCipher_Setup(secProcHandle, algorithm, mode, key, iv,
+                storage, storageSize, cipherHandle, SEC_FALSE);
+    }
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_GETINSTANCE, res);
+    return res;
 }
 
 Sec_Result SecCipher_UpdateIV(Sec_CipherHandle* cipherHandle, SEC_BYTE* iv) {
@@ -2557,7 +3154,7 @@ Sec_Result SecCipher_UpdateIV(Sec_CipherHandle* cipherHandle, SEC_BYTE* iv) {
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecCipher_ProcessFragmented(Sec_CipherHandle* cipherHandle, SEC_BYTE* input,
+static Sec_Result _SecCipher_ProcessFragmented(Sec_CipherHandle* cipherHandle, SEC_BYTE* input,
         SEC_SIZE inputSize, SEC_BOOL lastInput, SEC_BYTE* output, SEC_SIZE outputSize,
         SEC_SIZE *bytesWritten, SEC_SIZE fragmentOffset, SEC_SIZE fragmentSize, SEC_SIZE fragmentPeriod)
 {
@@ -2628,6 +3225,21 @@ done:
     return res;
 }
 
+Sec_Result SecCipher_ProcessFragmented(Sec_CipherHandle* cipherHandle, SEC_BYTE* input,
+        SEC_SIZE inputSize, SEC_BOOL lastInput, SEC_BYTE* output, SEC_SIZE outputSize,
+        SEC_SIZE *bytesWritten, SEC_SIZE fragmentOffset, SEC_SIZE fragmentSize, SEC_SIZE fragmentPeriod)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_PROCESS, SEC_TRACE_KEY_ID(NULL != cipherHandle ? cipherHandle->key_handle : NULL));
+
+    res = _SecCipher_ProcessFragmented(cipherHandle, input, inputSize, lastInput, output, outputSize, bytesWritten, fragmentOffset, fragmentSize, fragmentPeriod);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_PROCESS, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_PROCESS, res);
+    return res;
+}
+
 static size_t bytesToProcessToRollover(uint64_t ctr, size_t sub_block_offset, size_t inputLen) {
     uint64_t maxBlocksToProcess = (ctr == 0) ? UINT64_MAX : (UINT64_MAX - ctr + 1);
 
@@ -2921,14 +3533,25 @@ static Sec_Result _SecCipher_Process(Sec_CipherHandle* cipherHandle, SEC_BYTE* i
         if (cipherHandle->mode == SEC_CIPHERMODE_ENCRYPT
                 || cipherHandle->mode == SEC_CIPHERMODE_ENCRYPT_NATIVEMEM)
         {
-            EC_KEY *ec_key = _Sec_ECCFromKeyHandle(cipherHandle->key_handle);
+            /* the recipient setup is reused for every block encrypted with this handle */
+            if (NULL == cipherHandle->elgamal_ctx)
+            {
+                EC_KEY *ec_key = _Sec_ECCFromKeyHandle(cipherHandle->key_handle);
 
-            ec_res = SecUtils_ElGamal_Encrypt(ec_key, input, inputSize, output, outputSize);
+                if (NULL != ec_key)
+                    cipherHandle->elgamal_ctx = SecUtils_ElGamal_NewCtx(ec_key);
+                SEC_ECC_FREE(ec_key);
+                if (NULL == cipherHandle->elgamal_ctx)
+                {
+                    SEC_LOG_ERROR("SecUtils_ElGamal_NewCtx failed");
+                    goto done;
+                }
+            }
 
-            SEC_ECC_FREE(ec_key);
+            ec_res = SecUtils_ElGamal_EncryptBatch(cipherHandle->elgamal_ctx, input, inputSize, output, outputSize);
             if (ec_res < 0)
             {
-                SEC_LOG_ERROR("SecUtils_ElGamal_Encrypt failed");
+                SEC_LOG_ERROR("SecUtils_ElGamal_EncryptBatch failed");
                 goto done;
             }
         }
@@ -2969,11 +3592,23 @@ Sec_Result SecCipher_Process(Sec_CipherHandle* cipherHandle, SEC_BYTE* input,
         SEC_SIZE inputSize, SEC_BOOL lastInput, SEC_BYTE* output,
         SEC_SIZE outputSize, SEC_SIZE *bytesWritten)
 {
-    return _SecCipher_Process(cipherHandle, input, inputSize,lastInput,output,outputSize,bytesWritten,SEC_FALSE);
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_PROCESS, SEC_TRACE_KEY_ID(NULL != cipherHandle ? cipherHandle->key_handle : NULL));
+
+    res = _SecCipher_Process(cipherHandle, input, inputSize,lastInput,output,outputSize,bytesWritten,SEC_FALSE);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_PROCESS, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_PROCESS, res);
+    return res;
 }
 
-Sec_Result SecCipher_Release(Sec_CipherHandle* cipherHandle)
+static Sec_Result _SecCipher_Release(Sec_CipherHandle* cipherHandle)
 {
+    EVP_CIPHER_CTX *evp_ctx = NULL;
+    _Sec_HandlePool *pool;
+    Sec_CipherAlgorithm algorithm;
+
     CHECK_HANDLE(cipherHandle);
 
     switch (cipherHandle->algorithm)
@@ -2984,13 +3619,23 @@ Sec_Result SecCipher_Release(Sec_CipherHandle* cipherHandle)
     case SEC_CIPHERALGORITHM_AES_CBC_PKCS7_PADDING:
     case SEC_CIPHERALGORITHM_AES_CTR:
         if (cipherHandle->evp_ctx != NULL) {
-            EVP_CIPHER_CTX_free(cipherHandle->evp_ctx);
+            /* wipes the key schedule, the context itself can be reused */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+            EVP_CIPHER_CTX_cleanup(cipherHandle->evp_ctx);
+#else
+            EVP_CIPHER_CTX_reset(cipherHandle->evp_ctx);
+#endif
+            evp_ctx = cipherHandle->evp_ctx;
         }
         break;
 
     case SEC_CIPHERALGORITHM_RSA_PKCS1_PADDING:
     case SEC_CIPHERALGORITHM_RSA_OAEP_PADDING:
+        break;
+
     case SEC_CIPHERALGORITHM_ECC_ELGAMAL:
+        SecUtils_ElGamal_FreeCtx(cipherHandle->elgamal_ctx);
+        cipherHandle->elgamal_ctx = NULL;
         break;
 
         /* NEW: other cipher algorithms */
@@ -2999,6 +3644,20 @@ Sec_Result SecCipher_Release(Sec_CipherHandle* cipherHandle)
         goto unimplemented;
     }
 
+    pool = cipherHandle->pool;
+    algorithm = cipherHandle->algorithm;
+
+    /* no iv or counter state survives in the pool */
+    Sec_Memset(cipherHandle, 0, sizeof(Sec_CipherHandle));
+    cipherHandle->algorithm = algorithm;
+    cipherHandle->evp_ctx = evp_ctx;
+
+    if (NULL != pool && _SecHandlePool_PutCipher(pool, cipherHandle))
+        return SEC_RESULT_SUCCESS;
+
+    if (evp_ctx != NULL) {
+        EVP_CIPHER_CTX_free(evp_ctx);
+    }
     SEC_FREE(cipherHandle);
     return SEC_RESULT_SUCCESS;
 
@@ -3006,35 +3665,175 @@ unimplemented:
     return SEC_RESULT_UNIMPLEMENTED_FEATURE;
 }
 
-Sec_Result SecDigest_GetInstance(Sec_ProcessorHandle* secProcHandle,
-        Sec_DigestAlgorithm algorithm, Sec_DigestHandle** digestHandle)
+Sec_Result SecCipher_Release(Sec_CipherHandle* cipherHandle)
 {
-    CHECK_HANDLE(secProcHandle);
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_RELEASE, SEC_TRACE_KEY_ID(NULL != cipherHandle ? cipherHandle->key_handle : NULL));
 
-    *digestHandle = calloc(1, sizeof(Sec_DigestHandle));
-    if (NULL == *digestHandle)
+    res = _SecCipher_Release(cipherHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_RELEASE, res);
+    return res;
+}
+
+static Sec_Result _SecCipher_Cleanup(Sec_CipherHandle* cipherHandle)
+{
+    CHECK_HANDLE(cipherHandle);
+
+    if (NULL != cipherHandle->evp_ctx)
+        EVP_CIPHER_CTX_free(cipherHandle->evp_ctx);
+    SecUtils_ElGamal_FreeCtx(cipherHandle->elgamal_ctx);
+
+    /* no iv or counter state is left in the caller storage */
+    Sec_Memset(cipherHandle, 0, sizeof(Sec_CipherHandle));
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecCipher_Cleanup(Sec_CipherHandle* cipherHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_RELEASE, SEC_TRACE_KEY_ID(NULL != cipherHandle ? cipherHandle->key_handle : NULL));
+
+    res = _SecCipher_Cleanup(cipherHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_RELEASE, res);
+    return res;
+}
+
+/* all ones if the top bit of a is set, zero otherwise */
+static unsigned int _Sec_CtMsb(unsigned int a)
+{
+    return 0 - (a >> (sizeof(a) * 8 - 1));
+}
+
+static unsigned int _Sec_CtIsZero(unsigned int a)
+{
+    return _Sec_CtMsb(~a & (a - 1));
+}
+
+static unsigned int _Sec_CtEq(unsigned int a, unsigned int b)
+{
+    return _Sec_CtIsZero(a ^ b);
+}
+
+static SEC_BYTE _Sec_CtSelect(unsigned int mask, SEC_BYTE a, SEC_BYTE b)
+{
+    return (SEC_BYTE) ((mask & a) | (~mask & b));
+}
+
+Sec_Result SecCipher_DecryptTlsPremaster(Sec_KeyHandle* key, SEC_BYTE* input, SEC_SIZE inputSize,
+        SEC_SIZE clientVersion, SEC_SIZE altVersion, SEC_BYTE* premaster)
+{
+    SEC_BYTE em[SEC_RSA_KEY_MAX_LEN];
+    SEC_BYTE fallback[SEC_TLS_PREMASTER_LEN];
+    Sec_KeyProperties keyProps;
+    RSA *rsa = NULL;
+    SEC_SIZE key_len;
+    SEC_SIZE msg;
+    SEC_SIZE i;
+    unsigned int good;
+    unsigned int version_good;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    CHECK_HANDLE(key);
+
+    if (NULL == input || NULL == premaster || !SecKey_IsPrivRsa(SecKey_GetKeyType(key)))
+        return SEC_RESULT_INVALID_PARAMETERS;
+
+    /* everything checked up to the decryption depends only on public values */
+    key_len = SecKey_GetKeyLen(key);
+    if (inputSize != key_len || key_len > sizeof(em) || key_len < SEC_TLS_PREMASTER_LEN + 11)
     {
-        SEC_LOG_ERROR("malloc failed");
+        SEC_LOG_ERROR("Invalid input size %d", inputSize);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    memset(&keyProps, 0, sizeof(keyProps));
+    if (SEC_RESULT_SUCCESS != SecKey_GetProperties(key, &keyProps)
+            || SEC_RESULT_SUCCESS != SecOutprot_IsKeyAllowed(&keyProps, SEC_KEYUSAGE_DATA))
+    {
+        SEC_LOG_ERROR("SecOutprot_IsKeyAllowed failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (1 != RAND_bytes(fallback, sizeof(fallback)))
+    {
+        SEC_LOG_ERROR("RAND_bytes failed");
         return SEC_RESULT_FAILURE;
     }
-    (*digestHandle)->algorithm = algorithm;
+
+    rsa = _Sec_RSAFromKeyHandle(key);
+    if (NULL == rsa)
+    {
+        SEC_LOG_ERROR("_Sec_RSAFromKeyHandle failed");
+        goto done;
+    }
+
+    /* fails only for an input that is not below the modulus */
+    if ((int) key_len != RSA_private_decrypt(inputSize, input, em, rsa, RSA_NO_PADDING))
+    {
+        SEC_LOG_ERROR("RSA_private_decrypt failed");
+        goto done;
+    }
+
+    /*
+     * From here on the result does not depend on the padding or the version: 00 02, at least
+     * eight nonzero bytes, 00 and the 48 byte message are checked without branches, and a bad
+     * message is replaced by random bytes as RFC 5246 section 7.4.7.1 requires.
+     */
+    msg = key_len - SEC_TLS_PREMASTER_LEN;
+    good = _Sec_CtIsZero(em[0]) & _Sec_CtEq(em[1], 2);
+    for (i = 2; i < msg - 1; ++i)
+        good &= ~_Sec_CtIsZero(em[i]);
+    good &= _Sec_CtIsZero(em[msg - 1]);
+
+    version_good = _Sec_CtEq(em[msg], (clientVersion >> 8) & 0xff)
+            & _Sec_CtEq(em[msg + 1], clientVersion & 0xff);
+    if (altVersion != 0)
+    {
+        version_good |= _Sec_CtEq(em[msg], (altVersion >> 8) & 0xff)
+                & _Sec_CtEq(em[msg + 1], altVersion & 0xff);
+    }
+    good &= version_good;
+
+    for (i = 0; i < SEC_TLS_PREMASTER_LEN; ++i)
+        premaster[i] = _Sec_CtSelect(good, em[msg + i], fallback[i]);
+
+    /* the version bytes always carry the client version */
+    premaster[0] = (clientVersion >> 8) & 0xff;
+    premaster[1] = clientVersion & 0xff;
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SEC_RSA_FREE(rsa);
+    Sec_Memset(em, 0, sizeof(em));
+    Sec_Memset(fallback, 0, sizeof(fallback));
+
+    return res;
+}
+
+/* set up a zeroed digest handle */
+static Sec_Result _SecDigest_Setup(Sec_DigestHandle* digestHandle,
+        Sec_DigestAlgorithm algorithm)
+{
+    digestHandle->algorithm = algorithm;
 
     switch (algorithm)
     {
     case SEC_DIGESTALGORITHM_SHA1:
-        if (1 != SHA1_Init(&((*digestHandle)->sha1_ctx)))
-        {
-            SEC_FREE(*digestHandle);
+        if (1 != SHA1_Init(&(digestHandle->sha1_ctx)))
             return SEC_RESULT_FAILURE;
-        }
         break;
 
     case SEC_DIGESTALGORITHM_SHA256:
-        if (1 != SHA256_Init(&((*digestHandle)->sha256_ctx)))
-        {
-            SEC_FREE(*digestHandle);
+        if (1 != SHA256_Init(&(digestHandle->sha256_ctx)))
             return SEC_RESULT_FAILURE;
-        }
         break;
 
     default:
@@ -3045,7 +3844,78 @@ Sec_Result SecDigest_GetInstance(Sec_ProcessorHandle* secProcHandle,
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecDigest_Update(Sec_DigestHandle* digestHandle, SEC_BYTE* input,
+static Sec_Result _SecDigest_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        Sec_DigestAlgorithm algorithm, Sec_DigestHandle** digestHandle)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(secProcHandle);
+
+    *digestHandle = calloc(1, sizeof(Sec_DigestHandle));
+    if (NULL == *digestHandle)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    res = _SecDigest_Setup(*digestHandle, algorithm);
+    if (SEC_RESULT_SUCCESS != res)
+        SEC_FREE(*digestHandle);
+
+    return res;
+}
+
+Sec_Result SecDigest_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        Sec_DigestAlgorithm algorithm, Sec_DigestHandle** digestHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_DIGEST_GETINSTANCE, SEC_OBJECTID_INVALID);
+
+    res = _SecDigest_GetInstance(secProcHandle, algorithm, digestHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_DIGEST_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_DIGEST_GETINSTANCE, res);
+    return res;
+}
+
+static Sec_Result _SecDigest_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_DigestAlgorithm algorithm, void *storage, SEC_SIZE storageSize,
+        Sec_DigestHandle** digestHandle)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(secProcHandle);
+
+    *digestHandle = NULL;
+
+    res = _Sec_InitHandleStorage(storage, storageSize, sizeof(Sec_DigestHandle));
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
+    res = _SecDigest_Setup((Sec_DigestHandle *) storage, algorithm);
+    if (SEC_RESULT_SUCCESS == res)
+        *digestHandle = (Sec_DigestHandle *) storage;
+
+    return res;
+}
+
+Sec_Result SecDigest_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_DigestAlgorithm algorithm, void *storage, SEC_SIZE storageSize,
+        Sec_DigestHandle** digestHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_DIGEST_GETINSTANCE, SEC_OBJECTID_INVALID);
+
+    res = _SecDigest_Init(secProcHandle, algorithm, storage, storageSize, digestHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_DIGEST_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_DIGEST_GETINSTANCE, res);
+    return res;
+}
+
+static Sec_Result _SecDigest_Update(Sec_DigestHandle* digestHandle, SEC_BYTE* input,
         SEC_SIZE inputSize)
 {
     CHECK_HANDLE(digestHandle);
@@ -3075,16 +3945,37 @@ Sec_Result SecDigest_Update(Sec_DigestHandle* digestHandle, SEC_BYTE* input,
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecDigest_UpdateWithKey(Sec_DigestHandle* digestHandle,
+Sec_Result SecDigest_Update(Sec_DigestHandle* digestHandle, SEC_BYTE* input,
+        SEC_SIZE inputSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_DIGEST_UPDATE, SEC_OBJECTID_INVALID);
+
+    res = _SecDigest_Update(digestHandle, input, inputSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_DIGEST_UPDATE, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_DIGEST_UPDATE, res);
+    return res;
+}
+
+static Sec_Result _SecDigest_UpdateWithKey(Sec_DigestHandle* digestHandle,
         Sec_KeyHandle *key)
 {
     Sec_Result res = SEC_RESULT_FAILURE;
-    SEC_BYTE symetric_key[SEC_SYMETRIC_KEY_MAX_LEN];
+    SEC_BYTE *symetric_key = NULL;
     SEC_SIZE wr;
 
     CHECK_HANDLE(digestHandle);
 
-    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(key, symetric_key, sizeof(symetric_key), &wr))
+    symetric_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == symetric_key)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(key, symetric_key, SEC_KEYCONTAINER_MAX_LEN, &wr))
     {
         SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
         goto done;
@@ -3119,15 +4010,27 @@ Sec_Result SecDigest_UpdateWithKey(Sec_DigestHandle* digestHandle,
     res = SEC_RESULT_SUCCESS;
 
 done:
-    Sec_Memset(symetric_key, 0, sizeof(symetric_key));
+    SecArena_Free(symetric_key);
     return res;
 }
 
-Sec_Result SecDigest_Release(Sec_DigestHandle* digestHandle,
-        SEC_BYTE* digestOutput, SEC_SIZE* digestSize)
+Sec_Result SecDigest_UpdateWithKey(Sec_DigestHandle* digestHandle,
+        Sec_KeyHandle *key)
 {
-    CHECK_HANDLE(digestHandle);
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_DIGEST_UPDATE, SEC_TRACE_KEY_ID(key));
+
+    res = _SecDigest_UpdateWithKey(digestHandle, key);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_DIGEST_UPDATE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_DIGEST_UPDATE, res);
+    return res;
+}
 
+static Sec_Result _SecDigest_Final(Sec_DigestHandle* digestHandle,
+        SEC_BYTE* digestOutput, SEC_SIZE* digestSize)
+{
     switch (digestHandle->algorithm)
     {
     case SEC_DIGESTALGORITHM_SHA1:
@@ -3150,11 +4053,68 @@ Sec_Result SecDigest_Release(Sec_DigestHandle* digestHandle,
         return SEC_RESULT_UNIMPLEMENTED_FEATURE;
     }
 
+    return SEC_RESULT_SUCCESS;
+}
+
+static Sec_Result _SecDigest_Release(Sec_DigestHandle* digestHandle,
+        SEC_BYTE* digestOutput, SEC_SIZE* digestSize)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(digestHandle);
+
+    res = _SecDigest_Final(digestHandle, digestOutput, digestSize);
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
     SEC_FREE(digestHandle);
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecSignature_GetInstance(Sec_ProcessorHandle* secProcHandle,
+Sec_Result SecDigest_Release(Sec_DigestHandle* digestHandle,
+        SEC_BYTE* digestOutput, SEC_SIZE* digestSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_DIGEST_RELEASE, SEC_OBJECTID_INVALID);
+
+    res = _SecDigest_Release(digestHandle, digestOutput, digestSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_DIGEST_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_DIGEST_RELEASE, res);
+    return res;
+}
+
+static Sec_Result _SecDigest_Cleanup(Sec_DigestHandle* digestHandle,
+        SEC_BYTE* digestOutput, SEC_SIZE* digestSize)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(digestHandle);
+
+    res = _SecDigest_Final(digestHandle, digestOutput, digestSize);
+
+    /* the state may have absorbed key material with SecDigest_UpdateWithKey */
+    Sec_Memset(digestHandle, 0, sizeof(Sec_DigestHandle));
+
+    return res;
+}
+
+Sec_Result SecDigest_Cleanup(Sec_DigestHandle* digestHandle,
+        SEC_BYTE* digestOutput, SEC_SIZE* digestSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_DIGEST_RELEASE, SEC_OBJECTID_INVALID);
+
+    res = _SecDigest_Cleanup(digestHandle, digestOutput, digestSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_DIGEST_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_DIGEST_RELEASE, res);
+    return res;
+}
+
+static Sec_Result _SecSignature_GetInstance(Sec_ProcessorHandle* secProcHandle,
         Sec_SignatureAlgorithm algorithm, Sec_SignatureMode mode,
         Sec_KeyHandle* key, Sec_SignatureHandle** signatureHandle)
 {
@@ -3179,66 +4139,177 @@ Sec_Result SecSignature_GetInstance(Sec_ProcessorHandle* secProcHandle,
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecSignature_Process(Sec_SignatureHandle* signatureHandle,
-        SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* signature,
-        SEC_SIZE *signatureSize)
+static Sec_Result _SecSignature_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_SignatureAlgorithm algorithm, Sec_SignatureMode mode,
+        Sec_KeyHandle* key, void *storage, SEC_SIZE storageSize,
+        Sec_SignatureHandle** signatureHandle)
 {
     Sec_Result res;
-    SEC_BYTE digest[SEC_DIGEST_MAX_LEN];
-    SEC_SIZE digest_len;
-    SEC_SIZE sig_size;
-    Sec_RSARawPublicKey rsaPubKey;
-    RSA *rsa = NULL;
-    Sec_ECCRawPublicKey ecPubKey;
-    EC_KEY *ec_key = NULL;
-    int openssl_digest;
-    int openssl_res;
-    SEC_BYTE em[256];
 
-    CHECK_HANDLE(signatureHandle);
+    CHECK_HANDLE(secProcHandle);
 
-    if (SecSignature_IsDigest(signatureHandle->algorithm))
-    {
-        if (inputSize
-                != SecDigest_GetDigestLenForAlgorithm(
-                        SecSignature_GetDigestAlgorithm(
-                                signatureHandle->algorithm)))
-        {
-            SEC_LOG_ERROR("Invalid input length");
-            return SEC_RESULT_FAILURE;
-        }
+    *signatureHandle = NULL;
 
-        memcpy(digest, input, inputSize);
-        digest_len = inputSize;
-    }
-    else
+    if (SEC_RESULT_SUCCESS
+            != SecSignature_IsValidKey(key->key_data.info.key_type, algorithm, mode))
     {
-        /* calculate digest */
-        res = SecDigest_SingleInput(signatureHandle->key_handle->proc,
-                SecSignature_GetDigestAlgorithm(signatureHandle->algorithm), input,
-                inputSize, digest, &digest_len);
-        if (res != SEC_RESULT_SUCCESS)
-        {
-            SEC_LOG_ERROR("SecDigest_SingleInput failed");
-            return res;
-        }
+        return SEC_RESULT_INVALID_PARAMETERS;
     }
 
-    switch (signatureHandle->algorithm)
-    {
-        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PKCS:
-        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PKCS_DIGEST:
-        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS:
-        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS_DIGEST:
-            openssl_digest = NID_sha1;
-            break;
+    res = _Sec_InitHandleStorage(storage, storageSize, sizeof(Sec_SignatureHandle));
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
+    *signatureHandle = (Sec_SignatureHandle *) storage;
+    (*signatureHandle)->algorithm = algorithm;
+    (*signatureHandle)->mode = mode;
+    (*signatureHandle)->key_handle = key;
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecSignature_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        Sec_SignatureAlgorithm algorithm, Sec_SignatureMode mode,
+        Sec_KeyHandle* key, Sec_SignatureHandle** signatureHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_GETINSTANCE, SEC_TRACE_KEY_ID(key));
+
+    res = _SecSignature_GetInstance(secProcHandle, algorithm, mode, key, signatureHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_GETINSTANCE, res);
+    return res;
+}
+
+Sec_Result SecSignature_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_SignatureAlgorithm algorithm, Sec_SignatureMode mode,
+        Sec_KeyHandle* key, void *storage, SEC_SIZE storageSize,
+        Sec_SignatureHandle** signatureHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_GETINSTANCE, SEC_TRACE_KEY_ID(key));
+
+    res = _SecSignature_Init(secProcHandle, algorithm, mode, key, storage, storageSize, signatureHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_GETINSTANCE, res);
+    return res;
+}
+
+static Sec_Result _SecSignature_RsaSignDigest(RSA *rsa, Sec_SignatureAlgorithm algorithm,
+        SEC_BYTE* digest, SEC_SIZE digest_len, SEC_BYTE* signature,
+        SEC_SIZE *signatureSize)
+{
+    SEC_SIZE sig_size;
+    int openssl_digest;
+    int openssl_res;
+    SEC_BYTE em[SEC_RSA_KEY_MAX_LEN];
+
+    openssl_digest = (SecSignature_GetDigestAlgorithm(algorithm) == SEC_DIGESTALGORITHM_SHA1) ? NID_sha1 : NID_sha256;
+
+    if (SecSignature_IsRsaPss(algorithm)) {
+        //pss padding
+        if (!RSA_padding_add_PKCS1_PSS(rsa, em, digest, (openssl_digest == NID_sha1) ? EVP_sha1() : EVP_sha256(), (openssl_digest == NID_sha1) ? 20 : 32)) {
+            SEC_LOG_ERROR("RSA_padding_add_PKCS1_PSS failed with error %s", ERR_error_string(ERR_get_error(), NULL));
+            return SEC_RESULT_FAILURE;
+        }
+
+        /* perform digital signature */
+        if (RSA_private_encrypt(RSA_size(rsa), em, signature, rsa, RSA_NO_PADDING) == -1) {
+            openssl_res = 0;
+        } else {
+            openssl_res = 1;
+        }
+        *signatureSize = RSA_size(rsa);
+    } else {
+        //pkcs15
+        openssl_res = RSA_sign(openssl_digest, digest, digest_len, signature, &sig_size, rsa);
+        *signatureSize = sig_size;
+    }
+
+    if (0 == openssl_res)
+    {
+        SEC_LOG_ERROR("RSA_sign failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
+static Sec_Result _SecSignature_EccSignDigest(EC_KEY *ec_key, BN_CTX *ctx, Sec_SignatureAlgorithm algorithm,
+        SEC_BYTE* digest, SEC_SIZE digest_len, SEC_BYTE* signature,
+        SEC_SIZE *signatureSize)
+{
+    ECDSA_SIG *esig = NULL;
+    BIGNUM *kinv = NULL;
+    BIGNUM *rp = NULL;
+
+    if (NULL != ctx)
+    {
+        /* caller supplied scratch context, precompute k^-1 and r with it */
+        if (1 != ECDSA_sign_setup(ec_key, ctx, &kinv, &rp))
+        {
+            SEC_LOG_ERROR("ECDSA_sign_setup failed");
+            return SEC_RESULT_FAILURE;
+        }
+
+        esig = ECDSA_do_sign_ex(digest, digest_len, kinv, rp, ec_key);
+        BN_clear_free(kinv);
+        BN_clear_free(rp);
+    }
+    else
+    {
+        esig = ECDSA_do_sign(digest, digest_len, ec_key);
+    }
+
+    if (NULL == esig)
+    {
+        SEC_LOG_ERROR("ECDSA_do_sign failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    SecUtils_BigNumToBuffer(esig->r, &signature[0], SEC_ECC_NISTP256_KEY_LEN);
+    SecUtils_BigNumToBuffer(esig->s, &signature[SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN);
+#else
+    const BIGNUM *esigr = NULL;
+    const BIGNUM *esigs = NULL;
+    ECDSA_SIG_get0(esig, &esigr, &esigs);
+    SecUtils_BigNumToBuffer((BIGNUM *) esigr, &signature[0], SEC_ECC_NISTP256_KEY_LEN);
+    SecUtils_BigNumToBuffer((BIGNUM *) esigs, &signature[SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN);
+#endif
+    ECDSA_SIG_free(esig);
+
+    *signatureSize = SecSignature_GetEccSignatureSize(algorithm);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+static Sec_Result _SecSignature_ProcessDigest(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* digest, SEC_SIZE digest_len, SEC_BYTE* signature,
+        SEC_SIZE *signatureSize)
+{
+    Sec_Result res;
+    Sec_RSARawPublicKey rsaPubKey;
+    RSA *rsa = NULL;
+    Sec_ECCRawPublicKey ecPubKey;
+    EC_KEY *ec_key = NULL;
+
+    switch (signatureHandle->algorithm)
+    {
+        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PKCS:
+        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PKCS_DIGEST:
+        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS:
+        case SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS_DIGEST:
         case SEC_SIGNATUREALGORITHM_RSA_SHA256_PKCS:
         case SEC_SIGNATUREALGORITHM_RSA_SHA256_PKCS_DIGEST:
         case SEC_SIGNATUREALGORITHM_RSA_SHA256_PSS:
         case SEC_SIGNATUREALGORITHM_RSA_SHA256_PSS_DIGEST:
         case SEC_SIGNATUREALGORITHM_ECDSA_NISTP256:
         case SEC_SIGNATUREALGORITHM_ECDSA_NISTP256_DIGEST:
-            openssl_digest = NID_sha256;
             break;
         default:
             return SEC_RESULT_UNIMPLEMENTED_FEATURE;
@@ -3255,38 +4326,11 @@ Sec_Result SecSignature_Process(Sec_SignatureHandle* signatureHandle,
                 return SEC_RESULT_FAILURE;
             }
 
-            if (signatureHandle->algorithm == SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS
-                || signatureHandle->algorithm == SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS_DIGEST
-                || signatureHandle->algorithm == SEC_SIGNATUREALGORITHM_RSA_SHA256_PSS
-                || signatureHandle->algorithm == SEC_SIGNATUREALGORITHM_RSA_SHA256_PSS_DIGEST) {
-
-                //pss padding
-                if (!RSA_padding_add_PKCS1_PSS(rsa, em, digest, (openssl_digest == NID_sha1) ? EVP_sha1() : EVP_sha256(), (openssl_digest == NID_sha1) ? 20 : 32)) {
-                    SEC_RSA_FREE(rsa);
-                    SEC_LOG_ERROR("RSA_padding_add_PKCS1_PSS failed with error %s", ERR_error_string(ERR_get_error(), NULL));
-                    return SEC_RESULT_FAILURE;
-                }
-
-                /* perform digital signature */
-                if (RSA_private_encrypt(RSA_size(rsa), em, signature, rsa, RSA_NO_PADDING) == -1) {
-                    openssl_res = 0;
-                } else {
-                    openssl_res = 1;
-                }
-                *signatureSize = RSA_size(rsa);
-            } else {
-                //pkcs15
-                openssl_res = RSA_sign(openssl_digest, digest, digest_len, signature, &sig_size, rsa);
-                *signatureSize = sig_size;
-            }
-
+            res = _SecSignature_RsaSignDigest(rsa, signatureHandle->algorithm, digest, digest_len, signature, signatureSize);
             SEC_RSA_FREE(rsa);
 
-            if (0 == openssl_res)
-            {
-                SEC_LOG_ERROR("RSA_sign failed");
-                return SEC_RESULT_FAILURE;
-            }
+            if (res != SEC_RESULT_SUCCESS)
+                return res;
         }
         else if (SecSignature_IsEcc(signatureHandle->algorithm))
         {
@@ -3297,29 +4341,11 @@ Sec_Result SecSignature_Process(Sec_SignatureHandle* signatureHandle,
                 return SEC_RESULT_FAILURE;
             }
 
-            ECDSA_SIG *esig = ECDSA_do_sign(digest, digest_len, ec_key);
-
+            res = _SecSignature_EccSignDigest(ec_key, NULL, signatureHandle->algorithm, digest, digest_len, signature, signatureSize);
             SEC_ECC_FREE(ec_key);
 
-            if (NULL == esig)
-            {
-                SEC_LOG_ERROR("ECDSA_do_sign failed");
-                return SEC_RESULT_FAILURE;
-            }
-
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-            SecUtils_BigNumToBuffer(esig->r, &signature[0], SEC_ECC_NISTP256_KEY_LEN);
-            SecUtils_BigNumToBuffer(esig->s, &signature[SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN);
-#else
-            const BIGNUM *esigr = NULL;
-            const BIGNUM *esigs = NULL;
-            ECDSA_SIG_get0(esig, &esigr, &esigs);
-            SecUtils_BigNumToBuffer((BIGNUM *) esigr, &signature[0], SEC_ECC_NISTP256_KEY_LEN);
-            SecUtils_BigNumToBuffer((BIGNUM *) esigs, &signature[SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN);
-#endif
-            ECDSA_SIG_free(esig);
-
-            *signatureSize = SecSignature_GetEccSignatureSize(signatureHandle->algorithm);
+            if (res != SEC_RESULT_SUCCESS)
+                return res;
         }
         else
         {
@@ -3376,319 +4402,2084 @@ Sec_Result SecSignature_Process(Sec_SignatureHandle* signatureHandle,
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecSignature_Release(Sec_SignatureHandle* signatureHandle)
-{
-    CHECK_HANDLE(signatureHandle);
-    SEC_FREE(signatureHandle);
-    return SEC_RESULT_SUCCESS;
-}
-
-Sec_Result SecMac_GetInstance(Sec_ProcessorHandle* secProcHandle,
-        Sec_MacAlgorithm algorithm, Sec_KeyHandle* key,
-        Sec_MacHandle** macHandle)
+static Sec_Result _SecSignature_Ed25519Process(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* signature,
+        SEC_SIZE *signatureSize)
 {
-    SEC_BYTE symetric_key[SEC_SYMETRIC_KEY_MAX_LEN];
-    SEC_SIZE wr;
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
     Sec_Result res = SEC_RESULT_FAILURE;
+    EVP_PKEY *evp_key = NULL;
+    EVP_MD_CTX *md_ctx = NULL;
+    size_t sig_len = SEC_ED25519_SIGNATURE_LEN;
 
-    CHECK_HANDLE(secProcHandle);
-
-    *macHandle = NULL;
-
-    if (SEC_RESULT_SUCCESS
-            != SecMac_IsValidKey(key->key_data.info.key_type, algorithm))
+    /* Ed25519 hashes the message itself, so there is no digest step here */
+    evp_key = _Sec_Curve25519FromKeyHandle(signatureHandle->key_handle);
+    if (NULL == evp_key)
     {
-        SEC_LOG_ERROR("Not a valid mac key");
+        SEC_LOG_ERROR("_Sec_Curve25519FromKeyHandle failed");
         goto done;
     }
 
-    *macHandle = calloc(1, sizeof(Sec_MacHandle));
-    if (NULL == *macHandle)
+    md_ctx = EVP_MD_CTX_new();
+    if (NULL == md_ctx)
     {
-        SEC_LOG_ERROR("malloc failed");
+        SEC_LOG_ERROR("EVP_MD_CTX_new failed");
         goto done;
     }
 
-    (*macHandle)->algorithm = algorithm;
-    (*macHandle)->key_handle = key;
-
-    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(key, symetric_key, sizeof(symetric_key), &wr))
+    if (signatureHandle->mode == SEC_SIGNATUREMODE_SIGN)
     {
-        SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
-        goto done;
+        if (1 != EVP_DigestSignInit(md_ctx, NULL, NULL, NULL, evp_key)
+                || 1 != EVP_DigestSign(md_ctx, signature, &sig_len, input, inputSize))
+        {
+            SEC_LOG_ERROR("EVP_DigestSign failed: %s", ERR_error_string(ERR_get_error(), NULL));
+            goto done;
+        }
+        *signatureSize = (SEC_SIZE) sig_len;
     }
-
-    switch (algorithm)
+    else
     {
-    case SEC_MACALGORITHM_HMAC_SHA1:
-    case SEC_MACALGORITHM_HMAC_SHA256:
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-        (*macHandle)->hmac_ctx = &(*macHandle)->_hmac_ctx;
-        HMAC_CTX_init((*macHandle)->hmac_ctx);
-#else
-        (*macHandle)->hmac_ctx = HMAC_CTX_new();
-
-        if ((*macHandle)->hmac_ctx == NULL) {
-            SEC_LOG_ERROR("HMAC_CTX_new failed");
+        if (*signatureSize != SEC_ED25519_SIGNATURE_LEN)
+        {
+            SEC_LOG_ERROR("Incorrect Ed25519 signature size");
             goto done;
         }
-#endif
-        HMAC_Init_ex((*macHandle)->hmac_ctx, symetric_key,
-                    SecKey_GetKeyLen(key), (algorithm == SEC_MACALGORITHM_HMAC_SHA1) ? EVP_sha1() : EVP_sha256(),
-                    NULL);
-        break;
 
-    case SEC_MACALGORITHM_CMAC_AES_128:
-        (*macHandle)->cmac_ctx = CMAC_CTX_new();
-        if (NULL == (*macHandle)->cmac_ctx) {
-            SEC_LOG_ERROR("CMAC_CTX_new failed");
+        if (1 != EVP_DigestVerifyInit(md_ctx, NULL, NULL, NULL, evp_key))
+        {
+            SEC_LOG_ERROR("EVP_DigestVerifyInit failed");
             goto done;
         }
 
-        if (1 != CMAC_Init((*macHandle)->cmac_ctx, symetric_key,
-                    SecKey_GetKeyLen(key), SecKey_GetKeyLen(key) == 16 ? EVP_aes_128_cbc() : EVP_aes_256_cbc(), NULL))
+        if (1 != EVP_DigestVerify(md_ctx, signature, *signatureSize, input, inputSize))
         {
-            CMAC_CTX_free((*macHandle)->cmac_ctx);
-            SEC_LOG_ERROR("CMAC_Init failed");
+            res = SEC_RESULT_VERIFICATION_FAILED;
             goto done;
         }
-        break;
-
-    default:
-        SEC_LOG_ERROR("Unimplemented mac algorithm");
-        goto done;
     }
 
     res = SEC_RESULT_SUCCESS;
 
 done:
-    if (res != SEC_RESULT_SUCCESS)
-    {
-        SEC_FREE(*macHandle);
-    }
-    Sec_Memset(symetric_key, 0, sizeof(symetric_key));
+    if (NULL != md_ctx)
+        EVP_MD_CTX_free(md_ctx);
+    SEC_EVPPKEY_FREE(evp_key);
     return res;
+#else
+    SEC_LOG_ERROR("Ed25519 requires OpenSSL 1.1.1 or later");
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+#endif
 }
 
-Sec_Result SecMac_Update(Sec_MacHandle* macHandle, SEC_BYTE* input,
-        SEC_SIZE inputSize)
+static Sec_Result _SecSignature_Process(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* signature,
+        SEC_SIZE *signatureSize)
 {
-    CHECK_HANDLE(macHandle);
+    Sec_Result res;
+    SEC_BYTE digest[SEC_DIGEST_MAX_LEN];
+    SEC_SIZE digest_len;
 
-    switch (macHandle->algorithm)
+    CHECK_HANDLE(signatureHandle);
+
+    if (signatureHandle->algorithm == SEC_SIGNATUREALGORITHM_ED25519)
     {
-    case SEC_MACALGORITHM_HMAC_SHA1:
-    case SEC_MACALGORITHM_HMAC_SHA256:
-        HMAC_Update(macHandle->hmac_ctx, input, inputSize);
-        break;
+        return _SecSignature_Ed25519Process(signatureHandle, input, inputSize, signature, signatureSize);
+    }
 
-    case SEC_MACALGORITHM_CMAC_AES_128:
-        CMAC_Update(macHandle->cmac_ctx, input, inputSize);
-        break;
+    if (SecSignature_IsDigest(signatureHandle->algorithm))
+    {
+        if (inputSize
+                != SecDigest_GetDigestLenForAlgorithm(
+                        SecSignature_GetDigestAlgorithm(
+                                signatureHandle->algorithm)))
+        {
+            SEC_LOG_ERROR("Invalid input length");
+            return SEC_RESULT_FAILURE;
+        }
 
-    default:
-        SEC_LOG_ERROR("Unimplemented mac algorithm");
-        goto unimplemented;
+        memcpy(digest, input, inputSize);
+        digest_len = inputSize;
+    }
+    else
+    {
+        /* calculate digest */
+        res = SecDigest_SingleInput(signatureHandle->key_handle->proc,
+                SecSignature_GetDigestAlgorithm(signatureHandle->algorithm), input,
+                inputSize, digest, &digest_len);
+        if (res != SEC_RESULT_SUCCESS)
+        {
+            SEC_LOG_ERROR("SecDigest_SingleInput failed");
+            return res;
+        }
     }
 
-    return SEC_RESULT_SUCCESS;
-    unimplemented: return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+    return _SecSignature_ProcessDigest(signatureHandle, digest, digest_len, signature, signatureSize);
 }
 
-Sec_Result SecMac_UpdateWithKey(Sec_MacHandle* macHandle,
-        Sec_KeyHandle *keyHandle)
+Sec_Result SecSignature_Process(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* signature,
+        SEC_SIZE *signatureSize)
 {
-    Sec_Result res = SEC_RESULT_FAILURE;
-    SEC_BYTE symetric_key[SEC_SYMETRIC_KEY_MAX_LEN];
-    SEC_SIZE wr;
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, SEC_TRACE_KEY_ID(NULL != signatureHandle ? signatureHandle->key_handle : NULL));
 
-    CHECK_HANDLE(macHandle);
+    res = _SecSignature_Process(signatureHandle, input, inputSize, signature, signatureSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_PROCESS, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, res);
+    return res;
+}
+
+static Sec_Result _SecSignature_Update(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* input, SEC_SIZE inputSize)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(signatureHandle);
 
-    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(keyHandle, symetric_key, sizeof(symetric_key), &wr))
+    if (SecSignature_IsDigest(signatureHandle->algorithm))
     {
-        SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
-        goto done;
+        SEC_LOG_ERROR("Streaming is not supported for digest input signature algorithms");
+        return SEC_RESULT_INVALID_PARAMETERS;
     }
 
-    switch (macHandle->algorithm)
+    if (signatureHandle->algorithm == SEC_SIGNATUREALGORITHM_ED25519)
     {
-    case SEC_MACALGORITHM_HMAC_SHA1:
-    case SEC_MACALGORITHM_HMAC_SHA256:
-        HMAC_Update(macHandle->hmac_ctx, symetric_key,
-                SecKey_GetKeyLen(keyHandle));
-        break;
-
-    case SEC_MACALGORITHM_CMAC_AES_128:
-        CMAC_Update(macHandle->cmac_ctx, symetric_key,
-                SecKey_GetKeyLen(keyHandle));
-        break;
-
-    default:
-        SEC_LOG_ERROR("Unimplemented mac algorithm");
-        goto done;
+        SEC_LOG_ERROR("Streaming is not supported for Ed25519, use SecSignature_Process");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (NULL == signatureHandle->digest_handle)
+    {
+        res = SecDigest_Init(signatureHandle->key_handle->proc,
+                SecSignature_GetDigestAlgorithm(signatureHandle->algorithm),
+                signatureHandle->digest_storage, sizeof(signatureHandle->digest_storage),
+                &signatureHandle->digest_handle);
+        if (res != SEC_RESULT_SUCCESS)
+        {
+            SEC_LOG_ERROR("SecDigest_Init failed");
+            signatureHandle->digest_handle = NULL;
+            return res;
+        }
+    }
+
+    res = SecDigest_Update(signatureHandle->digest_handle, input, inputSize);
+    if (res != SEC_RESULT_SUCCESS)
+    {
+        SEC_LOG_ERROR("SecDigest_Update failed");
+        return res;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecSignature_Update(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* input, SEC_SIZE inputSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, SEC_TRACE_KEY_ID(NULL != signatureHandle ? signatureHandle->key_handle : NULL));
+
+    res = _SecSignature_Update(signatureHandle, input, inputSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_PROCESS, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, res);
+    return res;
+}
+
+static Sec_Result _SecSignature_Finalize(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* signature, SEC_SIZE *signatureSize)
+{
+    Sec_Result res;
+    SEC_BYTE digest[SEC_DIGEST_MAX_LEN];
+    SEC_SIZE digest_len;
+
+    CHECK_HANDLE(signatureHandle);
+
+    if (SecSignature_IsDigest(signatureHandle->algorithm))
+    {
+        SEC_LOG_ERROR("Streaming is not supported for digest input signature algorithms");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (signatureHandle->algorithm == SEC_SIGNATUREALGORITHM_ED25519)
+    {
+        SEC_LOG_ERROR("Streaming is not supported for Ed25519, use SecSignature_Process");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    /* no updates means an empty message */
+    if (NULL == signatureHandle->digest_handle)
+    {
+        res = SecSignature_Update(signatureHandle, NULL, 0);
+        if (res != SEC_RESULT_SUCCESS)
+            return res;
+    }
+
+    res = SecDigest_Cleanup(signatureHandle->digest_handle, digest, &digest_len);
+    signatureHandle->digest_handle = NULL;
+    if (res != SEC_RESULT_SUCCESS)
+    {
+        SEC_LOG_ERROR("SecDigest_Cleanup failed");
+        return res;
+    }
+
+    res = _SecSignature_ProcessDigest(signatureHandle, digest, digest_len, signature, signatureSize);
+    Sec_Memset(digest, 0, sizeof(digest));
+
+    return res;
+}
+
+Sec_Result SecSignature_Finalize(Sec_SignatureHandle* signatureHandle,
+        SEC_BYTE* signature, SEC_SIZE *signatureSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, SEC_TRACE_KEY_ID(NULL != signatureHandle ? signatureHandle->key_handle : NULL));
+
+    res = _SecSignature_Finalize(signatureHandle, signature, signatureSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_PROCESS, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, res);
+    return res;
+}
+
+static void _SecSignature_Finish(Sec_SignatureHandle* signatureHandle)
+{
+    SEC_BYTE digest[SEC_DIGEST_MAX_LEN];
+    SEC_SIZE digest_len;
+
+    if (NULL != signatureHandle->digest_handle)
+    {
+        SecDigest_Cleanup(signatureHandle->digest_handle, digest, &digest_len);
+        signatureHandle->digest_handle = NULL;
+    }
+}
+
+static Sec_Result _SecSignature_Release(Sec_SignatureHandle* signatureHandle)
+{
+    CHECK_HANDLE(signatureHandle);
+
+    _SecSignature_Finish(signatureHandle);
+
+    SEC_FREE(signatureHandle);
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecSignature_Release(Sec_SignatureHandle* signatureHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_RELEASE, SEC_TRACE_KEY_ID(NULL != signatureHandle ? signatureHandle->key_handle : NULL));
+
+    res = _SecSignature_Release(signatureHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_RELEASE, res);
+    return res;
+}
+
+static Sec_Result _SecSignature_Cleanup(Sec_SignatureHandle* signatureHandle)
+{
+    CHECK_HANDLE(signatureHandle);
+
+    _SecSignature_Finish(signatureHandle);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecSignature_Cleanup(Sec_SignatureHandle* signatureHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_RELEASE, SEC_TRACE_KEY_ID(NULL != signatureHandle ? signatureHandle->key_handle : NULL));
+
+    res = _SecSignature_Cleanup(signatureHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_RELEASE, res);
+    return res;
+}
+
+typedef struct
+{
+    Sec_KeyHandle* key;
+    Sec_SignatureAlgorithm algorithm;
+    Sec_SignatureMode mode;
+    RSA *rsa;
+    EC_KEY *ec_key;
+    Sec_RSARawPublicKey *rsaPub;
+    Sec_ECCRawPublicKey *eccPub;
+    SEC_BYTE** inputs;
+    SEC_SIZE* inputSizes;
+    SEC_BYTE** signatures;
+    SEC_SIZE* signatureSizes;
+    Sec_Result* results;
+    SEC_SIZE count;
+    SEC_SIZE start;
+    SEC_SIZE stride;
+} _Sec_SignatureBatchWork;
+
+static void *_SecSignature_BatchWorker(void *arg)
+{
+    _Sec_SignatureBatchWork *work = (_Sec_SignatureBatchWork *) arg;
+    RSA *rsa = NULL;
+    EC_KEY *ec_key = NULL;
+    BN_CTX *ctx = NULL;
+    SEC_BYTE digest[SEC_DIGEST_MAX_LEN];
+    SEC_SIZE digest_len;
+    SEC_SIZE i;
+    Sec_Result res = SEC_RESULT_SUCCESS;
+
+    /* every worker signs with its own copy of the key and scratch context */
+    if (work->mode == SEC_SIGNATUREMODE_VERIFY)
+    {
+        /* public key objects are shared through the pubops key cache */
+    }
+    else if (NULL != work->rsa)
+    {
+        rsa = RSAPrivateKey_dup(work->rsa);
+        if (NULL == rsa)
+        {
+            SEC_LOG_ERROR("RSAPrivateKey_dup failed");
+            res = SEC_RESULT_FAILURE;
+        }
+    }
+    else
+    {
+        ec_key = EC_KEY_dup(work->ec_key);
+        ctx = BN_CTX_new();
+        if (NULL == ec_key || NULL == ctx)
+        {
+            SEC_LOG_ERROR("EC_KEY_dup failed");
+            res = SEC_RESULT_FAILURE;
+        }
+    }
+
+    for (i = work->start; i < work->count; i += work->stride)
+    {
+        if (res != SEC_RESULT_SUCCESS)
+        {
+            work->results[i] = res;
+            continue;
+        }
+
+        if (SecSignature_IsDigest(work->algorithm))
+        {
+            digest_len = SecDigest_GetDigestLenForAlgorithm(SecSignature_GetDigestAlgorithm(work->algorithm));
+            if (work->inputSizes[i] != digest_len)
+            {
+                SEC_LOG_ERROR("Invalid input length for item %d", i);
+                work->results[i] = SEC_RESULT_INVALID_PARAMETERS;
+                continue;
+            }
+            memcpy(digest, work->inputs[i], digest_len);
+        }
+        else if (SEC_RESULT_SUCCESS != SecDigest_SingleInput(work->key->proc,
+                SecSignature_GetDigestAlgorithm(work->algorithm),
+                work->inputs[i], work->inputSizes[i], digest, &digest_len))
+        {
+            SEC_LOG_ERROR("SecDigest_SingleInput failed for item %d", i);
+            work->results[i] = SEC_RESULT_FAILURE;
+            continue;
+        }
+
+        if (work->mode == SEC_SIGNATUREMODE_VERIFY)
+        {
+            if (NULL != work->rsaPub)
+            {
+                work->results[i] = _Pubops_VerifyWithPubRsa(work->rsaPub, work->algorithm,
+                        digest, digest_len, work->signatures[i], work->signatureSizes[i], -1);
+            }
+            else if (work->signatureSizes[i] != SecSignature_GetEccSignatureSize(work->algorithm))
+            {
+                SEC_LOG_ERROR("Incorrect ECC signature size for item %d", i);
+                work->results[i] = SEC_RESULT_FAILURE;
+            }
+            else
+            {
+                work->results[i] = _Pubops_VerifyWithPubEcc(work->eccPub, work->algorithm,
+                        digest, digest_len, work->signatures[i], work->signatureSizes[i]);
+            }
+
+            if (work->results[i] != SEC_RESULT_SUCCESS)
+                work->results[i] = SEC_RESULT_VERIFICATION_FAILED;
+        }
+        else if (NULL != rsa)
+        {
+            work->results[i] = _SecSignature_RsaSignDigest(rsa, work->algorithm,
+                    digest, digest_len, work->signatures[i], &work->signatureSizes[i]);
+        }
+        else
+        {
+            work->results[i] = _SecSignature_EccSignDigest(ec_key, ctx, work->algorithm,
+                    digest, digest_len, work->signatures[i], &work->signatureSizes[i]);
+        }
+    }
+
+    Sec_Memset(digest, 0, sizeof(digest));
+    SEC_RSA_FREE(rsa);
+    SEC_ECC_FREE(ec_key);
+    if (NULL != ctx)
+        BN_CTX_free(ctx);
+
+    return NULL;
+}
+
+static Sec_Result _SecSignature_Batch(Sec_KeyHandle* key,
+        Sec_SignatureAlgorithm algorithm, Sec_SignatureMode mode,
+        SEC_BYTE** inputs, SEC_SIZE* inputSizes,
+        SEC_BYTE** signatures, SEC_SIZE* signatureSizes, Sec_Result* results,
+        SEC_SIZE count, SEC_SIZE numThreads)
+{
+    _Sec_SignatureBatchWork work[SEC_SIGNATURE_BATCH_MAX_THREADS];
+    pthread_t threads[SEC_SIGNATURE_BATCH_MAX_THREADS];
+    SEC_BOOL started[SEC_SIGNATURE_BATCH_MAX_THREADS];
+    RSA *rsa = NULL;
+    EC_KEY *ec_key = NULL;
+    Sec_RSARawPublicKey rsaPub;
+    Sec_ECCRawPublicKey eccPub;
+    Sec_Result res = SEC_RESULT_FAILURE;
+    SEC_SIZE i;
+    long cpus;
+
+    CHECK_HANDLE(key);
+
+    if (count == 0)
+        return SEC_RESULT_SUCCESS;
+
+    if (NULL == inputs || NULL == inputSizes || NULL == signatures
+            || NULL == signatureSizes || NULL == results)
+    {
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (SEC_RESULT_SUCCESS
+            != SecSignature_IsValidKey(key->key_data.info.key_type, algorithm, mode))
+    {
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    /* the key is unwrapped only once for the whole batch */
+    if (mode == SEC_SIGNATUREMODE_VERIFY && SecSignature_IsRsa(algorithm))
+    {
+        if (SEC_RESULT_SUCCESS != SecKey_ExtractRSAPublicKey(key, &rsaPub))
+        {
+            SEC_LOG_ERROR("SecKey_ExtractRSAPublicKey failed");
+            goto done;
+        }
+    }
+    else if (mode == SEC_SIGNATUREMODE_VERIFY && SecSignature_IsEcc(algorithm))
+    {
+        if (SEC_RESULT_SUCCESS != SecKey_ExtractECCPublicKey(key, &eccPub))
+        {
+            SEC_LOG_ERROR("SecKey_ExtractECCPublicKey failed");
+            goto done;
+        }
+    }
+    else if (SecSignature_IsRsa(algorithm))
+    {
+        rsa = _Sec_RSAFromKeyHandle(key);
+        if (NULL == rsa)
+        {
+            SEC_LOG_ERROR("_Sec_RSAFromKeyHandle failed");
+            goto done;
+        }
+    }
+    else if (SecSignature_IsEcc(algorithm))
+    {
+        ec_key = _Sec_ECCFromKeyHandle(key);
+        if (NULL == ec_key)
+        {
+            SEC_LOG_ERROR("_Sec_ECCFromKeyHandle failed");
+            goto done;
+        }
+    }
+    else
+    {
+        SEC_LOG_ERROR("Unimplemented signature algorithm");
+        return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+    }
+
+    if (numThreads == 0)
+    {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = (cpus > 0) ? (SEC_SIZE) cpus : 1;
+    }
+    if (numThreads > SEC_SIGNATURE_BATCH_MAX_THREADS)
+        numThreads = SEC_SIGNATURE_BATCH_MAX_THREADS;
+    if (numThreads > count)
+        numThreads = count;
+
+    for (i = 0; i < numThreads; ++i)
+    {
+        work[i].key = key;
+        work[i].algorithm = algorithm;
+        work[i].mode = mode;
+        work[i].rsa = rsa;
+        work[i].ec_key = ec_key;
+        work[i].rsaPub = (mode == SEC_SIGNATUREMODE_VERIFY && SecSignature_IsRsa(algorithm)) ? &rsaPub : NULL;
+        work[i].eccPub = (mode == SEC_SIGNATUREMODE_VERIFY && SecSignature_IsEcc(algorithm)) ? &eccPub : NULL;
+        work[i].inputs = inputs;
+        work[i].inputSizes = inputSizes;
+        work[i].signatures = signatures;
+        work[i].signatureSizes = signatureSizes;
+        work[i].results = results;
+        work[i].count = count;
+        work[i].start = i;
+        work[i].stride = numThreads;
+        started[i] = SEC_FALSE;
+    }
+
+    /* the calling thread works on the first stripe itself */
+    for (i = 1; i < numThreads; ++i)
+    {
+        if (0 != pthread_create(&threads[i], NULL, _SecSignature_BatchWorker, &work[i]))
+        {
+            SEC_LOG_ERROR("pthread_create failed, processing stripe %d inline", i);
+            _SecSignature_BatchWorker(&work[i]);
+            continue;
+        }
+        started[i] = SEC_TRUE;
+    }
+
+    _SecSignature_BatchWorker(&work[0]);
+
+    for (i = 1; i < numThreads; ++i)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
     }
 
     res = SEC_RESULT_SUCCESS;
+    for (i = 0; i < count; ++i)
+    {
+        if (results[i] != SEC_RESULT_SUCCESS)
+            res = SEC_RESULT_FAILURE;
+    }
+
+done:
+    SEC_RSA_FREE(rsa);
+    SEC_ECC_FREE(ec_key);
+
+    return res;
+}
+
+static Sec_Result _SecSignature_ProcessBatch(Sec_KeyHandle* key,
+        Sec_SignatureAlgorithm algorithm, SEC_BYTE** inputs, SEC_SIZE* inputSizes,
+        SEC_BYTE** signatures, SEC_SIZE* signatureSizes, Sec_Result* results,
+        SEC_SIZE count, SEC_SIZE numThreads)
+{
+    return _SecSignature_Batch(key, algorithm, SEC_SIGNATUREMODE_SIGN, inputs, inputSizes,
+            signatures, signatureSizes, results, count, numThreads);
+}
+
+Sec_Result SecSignature_ProcessBatch(Sec_KeyHandle* key,
+        Sec_SignatureAlgorithm algorithm, SEC_BYTE** inputs, SEC_SIZE* inputSizes,
+        SEC_BYTE** signatures, SEC_SIZE* signatureSizes, Sec_Result* results,
+        SEC_SIZE count, SEC_SIZE numThreads)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, SEC_TRACE_KEY_ID(key));
+
+    res = _SecSignature_ProcessBatch(key, algorithm, inputs, inputSizes, signatures, signatureSizes,
+            results, count, numThreads);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_PROCESS, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, res);
+    return res;
+}
+
+static Sec_Result _SecSignature_VerifyBatch(Sec_KeyHandle* key,
+        Sec_SignatureAlgorithm algorithm, SEC_BYTE** inputs, SEC_SIZE* inputSizes,
+        SEC_BYTE** signatures, SEC_SIZE* signatureSizes, Sec_Result* results,
+        SEC_SIZE count, SEC_SIZE numThreads)
+{
+    return _SecSignature_Batch(key, algorithm, SEC_SIGNATUREMODE_VERIFY, inputs, inputSizes,
+            signatures, signatureSizes, results, count, numThreads);
+}
+
+Sec_Result SecSignature_VerifyBatch(Sec_KeyHandle* key,
+        Sec_SignatureAlgorithm algorithm, SEC_BYTE** inputs, SEC_SIZE* inputSizes,
+        SEC_BYTE** signatures, SEC_SIZE* signatureSizes, Sec_Result* results,
+        SEC_SIZE count, SEC_SIZE numThreads)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, SEC_TRACE_KEY_ID(key));
+
+    res = _SecSignature_VerifyBatch(key, algorithm, inputs, inputSizes, signatures, signatureSizes,
+            results, count, numThreads);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_SIGNATURE_PROCESS, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_SIGNATURE_PROCESS, res);
+    return res;
+}
+
+/* free the contexts of a mac handle */
+static void _SecMac_FreeCtx(Sec_MacHandle* macHandle)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    if (NULL != macHandle->hmac_ctx)
+        HMAC_CTX_cleanup(macHandle->hmac_ctx);
+#else
+    if (NULL != macHandle->hmac_ctx)
+        HMAC_CTX_free(macHandle->hmac_ctx);
+#endif
+    macHandle->hmac_ctx = NULL;
+
+    if (NULL != macHandle->cmac_ctx)
+        CMAC_CTX_free(macHandle->cmac_ctx);
+    macHandle->cmac_ctx = NULL;
+}
+
+/* wipe the keys from the contexts of a mac handle, the contexts themselves can be reused */
+static void _SecMac_ResetCtx(Sec_MacHandle* macHandle)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    if (NULL != macHandle->hmac_ctx)
+        HMAC_CTX_cleanup(macHandle->hmac_ctx);
+    macHandle->hmac_ctx = NULL;
+#else
+    if (NULL != macHandle->hmac_ctx)
+        HMAC_CTX_reset(macHandle->hmac_ctx);
+#endif
+    if (NULL != macHandle->cmac_ctx)
+        CMAC_CTX_cleanup(macHandle->cmac_ctx);
+}
+
+/* hand the reusable contexts of a mac handle over to another one, a pre 1.1 HMAC_CTX stays embedded */
+static void _SecMac_MoveCtx(Sec_MacHandle* to, Sec_MacHandle* from)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    to->hmac_ctx = from->hmac_ctx;
+    from->hmac_ctx = NULL;
+#endif
+    to->cmac_ctx = from->cmac_ctx;
+    from->cmac_ctx = NULL;
+}
+
+/* scrub a heap mac handle and give it back to its pool with its contexts, or free it */
+static void _SecMac_Recycle(Sec_MacHandle* macHandle)
+{
+    _Sec_HandlePool *pool = macHandle->pool;
+    Sec_MacAlgorithm algorithm = macHandle->algorithm;
+    HMAC_CTX *hmac_ctx;
+    CMAC_CTX *cmac_ctx;
+
+    _SecMac_ResetCtx(macHandle);
+    hmac_ctx = macHandle->hmac_ctx;
+    cmac_ctx = macHandle->cmac_ctx;
+
+    Sec_Memset(macHandle, 0, sizeof(Sec_MacHandle));
+    macHandle->algorithm = algorithm;
+    macHandle->hmac_ctx = hmac_ctx;
+    macHandle->cmac_ctx = cmac_ctx;
+
+    if (NULL != pool && _SecHandlePool_PutMac(pool, macHandle))
+        return;
+
+    _SecMac_FreeCtx(macHandle);
+    SEC_FREE(macHandle);
+}
+
+/* set up a zeroed or pooled mac handle, contexts left by the pool are reused */
+static Sec_Result _SecMac_Setup(Sec_MacHandle* macHandle,
+        Sec_MacAlgorithm algorithm, Sec_KeyHandle* key)
+{
+    SEC_BYTE *symetric_key = NULL;
+    SEC_SIZE wr;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    macHandle->algorithm = algorithm;
+    macHandle->key_handle = key;
+
+    symetric_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == symetric_key)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(key, symetric_key, SEC_KEYCONTAINER_MAX_LEN, &wr))
+    {
+        SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
+        goto done;
+    }
+
+    switch (algorithm)
+    {
+    case SEC_MACALGORITHM_HMAC_SHA1:
+    case SEC_MACALGORITHM_HMAC_SHA256:
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        macHandle->hmac_ctx = &macHandle->_hmac_ctx;
+        HMAC_CTX_init(macHandle->hmac_ctx);
+#else
+        if (macHandle->hmac_ctx == NULL)
+            macHandle->hmac_ctx = HMAC_CTX_new();
+
+        if (macHandle->hmac_ctx == NULL) {
+            SEC_LOG_ERROR("HMAC_CTX_new failed");
+            goto done;
+        }
+#endif
+        HMAC_Init_ex(macHandle->hmac_ctx, symetric_key,
+                    SecKey_GetKeyLen(key), (algorithm == SEC_MACALGORITHM_HMAC_SHA1) ? EVP_sha1() : EVP_sha256(),
+                    NULL);
+        break;
+
+    case SEC_MACALGORITHM_CMAC_AES_128:
+        if (NULL == macHandle->cmac_ctx)
+            macHandle->cmac_ctx = CMAC_CTX_new();
+        if (NULL == macHandle->cmac_ctx) {
+            SEC_LOG_ERROR("CMAC_CTX_new failed");
+            goto done;
+        }
+
+        if (1 != CMAC_Init(macHandle->cmac_ctx, symetric_key,
+                    SecKey_GetKeyLen(key), SecKey_GetKeyLen(key) == 16 ? EVP_aes_128_cbc() : EVP_aes_256_cbc(), NULL))
+        {
+            CMAC_CTX_free(macHandle->cmac_ctx);
+            macHandle->cmac_ctx = NULL;
+            SEC_LOG_ERROR("CMAC_Init failed");
+            goto done;
+        }
+        break;
+
+    default:
+        SEC_LOG_ERROR("Unimplemented mac algorithm");
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SecArena_Free(symetric_key);
+    return res;
+}
+
+static Sec_Result _SecMac_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        Sec_MacAlgorithm algorithm, Sec_KeyHandle* key,
+        Sec_MacHandle** macHandle)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(secProcHandle);
+
+    *macHandle = NULL;
+
+    if (SEC_RESULT_SUCCESS
+            != SecMac_IsValidKey(key->key_data.info.key_type, algorithm))
+    {
+        SEC_LOG_ERROR("Not a valid mac key");
+        return SEC_RESULT_FAILURE;
+    }
+
+    /* a released handle comes with reset mac contexts */
+    *macHandle = _SecHandlePool_TakeMac(secProcHandle->handle_pool, algorithm);
+    if (NULL == *macHandle)
+        *macHandle = calloc(1, sizeof(Sec_MacHandle));
+    if (NULL == *macHandle)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    res = _SecMac_Setup(*macHandle, algorithm, key);
+    if (SEC_RESULT_SUCCESS != res)
+    {
+        _SecMac_FreeCtx(*macHandle);
+        SEC_FREE(*macHandle);
+        return res;
+    }
+
+    (*macHandle)->pool = _SecHandlePool_Ref(secProcHandle->handle_pool);
+
+    return res;
+}
+
+static Sec_Result _SecMac_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_MacAlgorithm algorithm, Sec_KeyHandle* key,
+        void *storage, SEC_SIZE storageSize, Sec_MacHandle** macHandle)
+{
+    Sec_MacHandle *handle;
+    Sec_MacHandle *owner;
+    Sec_Result res;
+
+    CHECK_HANDLE(secProcHandle);
+
+    *macHandle = NULL;
+
+    if (SEC_RESULT_SUCCESS
+            != SecMac_IsValidKey(key->key_data.info.key_type, algorithm))
+    {
+        SEC_LOG_ERROR("Not a valid mac key");
+        return SEC_RESULT_FAILURE;
+    }
+
+    res = _Sec_InitHandleStorage(storage, storageSize, sizeof(Sec_MacHandle));
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
+    handle = (Sec_MacHandle *) storage;
+
+    /* the opaque contexts can not live in the storage, they are borrowed from a pooled handle */
+    owner = _SecHandlePool_TakeMac(secProcHandle->handle_pool, algorithm);
+    if (NULL == owner)
+        owner = calloc(1, sizeof(Sec_MacHandle));
+    if (NULL == owner)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    _SecMac_MoveCtx(handle, owner);
+
+    res = _SecMac_Setup(handle, algorithm, key);
+    if (SEC_RESULT_SUCCESS != res)
+    {
+        _SecMac_FreeCtx(handle);
+        _SecMac_FreeCtx(owner);
+        SEC_FREE(owner);
+        return res;
+    }
+
+    owner->algorithm = algorithm;
+    owner->pool = _SecHandlePool_Ref(secProcHandle->handle_pool);
+    handle->ctx_owner = owner;
+    *macHandle = handle;
+
+    return res;
+}
+
+
+Sec_Result SecMac_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        Sec_MacAlgorithm algorithm, Sec_KeyHandle* key,
+        Sec_MacHandle** macHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_MAC_GETINSTANCE, SEC_TRACE_KEY_ID(key));
+
+    res = _SecMac_GetInstance(secProcHandle, algorithm, key, macHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_MAC_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_MAC_GETINSTANCE, res);
+    return res;
+}
+
+Sec_Result SecMac_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_MacAlgorithm algorithm, Sec_KeyHandle* key,
+        void *storage, SEC_SIZE storageSize, Sec_MacHandle** macHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_MAC_GETINSTANCE, SEC_TRACE_KEY_ID(key));
+
+    res = _SecMac_Init(secProcHandle, algorithm, key, storage, storageSize, macHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_MAC_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_MAC_GETINSTANCE, res);
+    return res;
+}
+
+static Sec_Result _SecMac_Update(Sec_MacHandle* macHandle, SEC_BYTE* input,
+        SEC_SIZE inputSize)
+{
+    CHECK_HANDLE(macHandle);
+
+    switch (macHandle->algorithm)
+    {
+    case SEC_MACALGORITHM_HMAC_SHA1:
+    case SEC_MACALGORITHM_HMAC_SHA256:
+        HMAC_Update(macHandle->hmac_ctx, input, inputSize);
+        break;
+
+    case SEC_MACALGORITHM_CMAC_AES_128:
+        CMAC_Update(macHandle->cmac_ctx, input, inputSize);
+        break;
+
+    default:
+        SEC_LOG_ERROR("Unimplemented mac algorithm");
+        goto unimplemented;
+    }
+
+    return SEC_RESULT_SUCCESS;
+    unimplemented: return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+Sec_Result SecMac_Update(Sec_MacHandle* macHandle, SEC_BYTE* input,
+        SEC_SIZE inputSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_MAC_UPDATE, SEC_TRACE_KEY_ID(NULL != macHandle ? macHandle->key_handle : NULL));
+
+    res = _SecMac_Update(macHandle, input, inputSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_MAC_UPDATE, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_MAC_UPDATE, res);
+    return res;
+}
+
+static Sec_Result _SecMac_UpdateWithKey(Sec_MacHandle* macHandle,
+        Sec_KeyHandle *keyHandle)
+{
+    Sec_Result res = SEC_RESULT_FAILURE;
+    SEC_BYTE *symetric_key = NULL;
+    SEC_SIZE wr;
+
+    CHECK_HANDLE(macHandle);
+
+    symetric_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == symetric_key)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(keyHandle, symetric_key, SEC_KEYCONTAINER_MAX_LEN, &wr))
+    {
+        SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
+        goto done;
+    }
+
+    switch (macHandle->algorithm)
+    {
+    case SEC_MACALGORITHM_HMAC_SHA1:
+    case SEC_MACALGORITHM_HMAC_SHA256:
+        HMAC_Update(macHandle->hmac_ctx, symetric_key,
+                SecKey_GetKeyLen(keyHandle));
+        break;
+
+    case SEC_MACALGORITHM_CMAC_AES_128:
+        CMAC_Update(macHandle->cmac_ctx, symetric_key,
+                SecKey_GetKeyLen(keyHandle));
+        break;
+
+    default:
+        SEC_LOG_ERROR("Unimplemented mac algorithm");
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SecArena_Free(symetric_key);
+    return res;
+}
+
+Sec_Result SecMac_UpdateWithKey(Sec_MacHandle* macHandle,
+        Sec_KeyHandle *keyHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_MAC_UPDATE, SEC_TRACE_KEY_ID(keyHandle));
+
+    res = _SecMac_UpdateWithKey(macHandle, keyHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_MAC_UPDATE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_MAC_UPDATE, res);
+    return res;
+}
+
+static Sec_Result _SecMac_Final(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer,
+        SEC_SIZE* macSize)
+{
+    unsigned int o1;
+    size_t o2;
+
+    switch (macHandle->algorithm)
+    {
+    case SEC_MACALGORITHM_HMAC_SHA1:
+    case SEC_MACALGORITHM_HMAC_SHA256:
+        HMAC_Final(macHandle->hmac_ctx, macBuffer, &o1);
+        *macSize = o1;
+        break;
+
+    case SEC_MACALGORITHM_CMAC_AES_128:
+        CMAC_Final(macHandle->cmac_ctx, macBuffer, &o2);
+        *macSize = o2;
+        break;
+
+    default:
+        SEC_LOG_ERROR("Unimplemented mac algorithm");
+        return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
+static Sec_Result _SecMac_Release(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer,
+        SEC_SIZE* macSize)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(macHandle);
+
+    res = _SecMac_Final(macHandle, macBuffer, macSize);
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
+    _SecMac_Recycle(macHandle);
+    return SEC_RESULT_SUCCESS;
+}
+
+static Sec_Result _SecMac_Cleanup(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer,
+        SEC_SIZE* macSize)
+{
+    Sec_MacHandle *owner;
+    Sec_Result res;
+
+    CHECK_HANDLE(macHandle);
+
+    res = _SecMac_Final(macHandle, macBuffer, macSize);
+
+    /* the borrowed contexts go back to the pool with their owner */
+    owner = macHandle->ctx_owner;
+    if (NULL != owner)
+    {
+        _SecMac_MoveCtx(owner, macHandle);
+        _SecMac_Recycle(owner);
+    }
+    _SecMac_FreeCtx(macHandle);
+
+    /* an embedded pre 1.1 HMAC_CTX holds the padded key */
+    Sec_Memset(macHandle, 0, sizeof(Sec_MacHandle));
+
+    return res;
+}
+
+Sec_Result SecMac_Release(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer,
+        SEC_SIZE* macSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_MAC_RELEASE, SEC_TRACE_KEY_ID(NULL != macHandle ? macHandle->key_handle : NULL));
+
+    res = _SecMac_Release(macHandle, macBuffer, macSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_MAC_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_MAC_RELEASE, res);
+    return res;
+}
+
+Sec_Result SecMac_Cleanup(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer,
+        SEC_SIZE* macSize)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_MAC_RELEASE, SEC_TRACE_KEY_ID(NULL != macHandle ? macHandle->key_handle : NULL));
+
+    res = _SecMac_Cleanup(macHandle, macBuffer, macSize);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_MAC_RELEASE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_MAC_RELEASE, res);
+    return res;
+}
+
+Sec_Result SecRandom_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        Sec_RandomAlgorithm algorithm, Sec_RandomHandle** randomHandle)
+{
+    CHECK_HANDLE(secProcHandle);
+
+    *randomHandle = calloc(1, sizeof(Sec_RandomHandle));
+    if (NULL == *randomHandle)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+    (*randomHandle)->algorithm = algorithm;
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecRandom_Init(Sec_ProcessorHandle* secProcHandle,
+        Sec_RandomAlgorithm algorithm, void *storage, SEC_SIZE storageSize,
+        Sec_RandomHandle** randomHandle)
+{
+    Sec_Result res;
+
+    CHECK_HANDLE(secProcHandle);
+
+    *randomHandle = NULL;
+
+    res = _Sec_InitHandleStorage(storage, storageSize, sizeof(Sec_RandomHandle));
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
+    *randomHandle = (Sec_RandomHandle *) storage;
+    (*randomHandle)->algorithm = algorithm;
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecRandom_Process(Sec_RandomHandle* randomHandle, SEC_BYTE* output,
+        SEC_SIZE outputSize)
+{
+    CHECK_HANDLE(randomHandle);
+
+    switch (randomHandle->algorithm)
+    {
+    case SEC_RANDOMALGORITHM_TRUE:
+            CHECK_EXACT(RAND_bytes(output, outputSize), 1, error);
+        break;
+
+    case SEC_RANDOMALGORITHM_PRNG:
+            CHECK_EXACT(RAND_bytes(output, outputSize), 1, error);
+        break;
+
+    default:
+        SEC_LOG_ERROR("Unimplemented random algorithm");
+        goto unimplemented;
+    }
+
+    return SEC_RESULT_SUCCESS;
+    error: return SEC_RESULT_FAILURE;
+    unimplemented: return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+Sec_Result SecRandom_Release(Sec_RandomHandle* randomHandle)
+{
+    CHECK_HANDLE(randomHandle);
+    SEC_FREE(randomHandle);
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecRandom_Cleanup(Sec_RandomHandle* randomHandle)
+{
+    CHECK_HANDLE(randomHandle);
+    memset(randomHandle, 0, sizeof(Sec_RandomHandle));
+    return SEC_RESULT_SUCCESS;
+}
+
+SEC_SIZE SecCertificate_List(Sec_ProcessorHandle *proc, SEC_OBJECTID *items, SEC_SIZE maxNumItems)
+{
+    _Sec_RAMCertificateData *cert;
+    SEC_SIZE numItems = 0;
+
+    CHECK_HANDLE(proc);
+
+    /* look in RAM */
+    cert = proc->ram_certs;
+    while (cert != NULL)
+    {
+        numItems = SecUtils_UpdateItemList(items, maxNumItems, numItems, cert->object_id);
+        cert = cert->next;
+    }
+
+    /* look in file system */
+    if (proc->global_dir != NULL) {
+        numItems = SecUtils_UpdateItemListFromDir(items, maxNumItems, numItems, proc->global_dir, SEC_CERT_FILENAME_EXT);
+    }
+
+    if (proc->app_dir != NULL) {
+        numItems = SecUtils_UpdateItemListFromDir(items, maxNumItems, numItems, proc->app_dir, SEC_CERT_FILENAME_EXT);
+    }
+
+    return numItems;
+}
+
+Sec_Result SecCertificate_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID object_id, Sec_CertificateHandle** certHandle)
+{
+    Sec_Result result;
+    _Sec_CertificateData cert_data;
+    Sec_StorageLoc location;
+
+    CHECK_HANDLE(secProcHandle);
+
+    if (object_id == SEC_OBJECTID_INVALID)
+    {
+        SEC_LOG_ERROR("Invalid object_id");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    result = _Sec_RetrieveCertificateData(secProcHandle, object_id, &location,
+            &cert_data);
+    if (result != SEC_RESULT_SUCCESS)
+    {
+        return result;
+    }
+
+    result = _Sec_ValidateCertificateData(secProcHandle, &cert_data);
+    if (result != SEC_RESULT_SUCCESS)
+    {
+        SEC_LOG_ERROR("_Sec_ValidateCertificateData failed");
+        return SEC_RESULT_VERIFICATION_FAILED;
+    }
+
+    *certHandle = calloc(1, sizeof(Sec_CertificateHandle));
+    if (NULL == *certHandle)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+    (*certHandle)->object_id = object_id;
+    memcpy(&((*certHandle)->cert_data), &cert_data,
+            sizeof(_Sec_CertificateData));
+    (*certHandle)->location = location;
+    (*certHandle)->proc = secProcHandle;
+
+    return SEC_RESULT_SUCCESS;
+}
+
+static pthread_mutex_t g_cert_verify_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void _Sec_CertVerifyCacheHash(SEC_BYTE tag, SEC_BYTE *data, SEC_SIZE data_len, SEC_BYTE *hash)
+{
+    SHA256_CTX ctx;
+
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, &tag, 1);
+    SHA256_Update(&ctx, data, data_len);
+    SHA256_Final(hash, &ctx);
+}
+
+/* monotonic seconds, so that setting the wall clock back does not extend cache entries */
+static SEC_SIZE _Sec_CertVerifyCacheNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (SEC_SIZE) ts.tv_sec;
+}
+
+static void _Sec_CertVerifyCacheInvalidate(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id)
+{
+    int i;
+
+    pthread_mutex_lock(&g_cert_verify_cache_mutex);
+    for (i = 0; i < SEC_CERT_VERIFY_CACHE_SIZE; ++i)
+    {
+        if (proc->cert_verify_cache[i].valid && proc->cert_verify_cache[i].object_id == object_id)
+            memset(&proc->cert_verify_cache[i], 0, sizeof(_Sec_CertVerifyCacheEntry));
+    }
+    pthread_mutex_unlock(&g_cert_verify_cache_mutex);
+}
+
+static SEC_BOOL _Sec_CertVerifyCacheLookup(Sec_ProcessorHandle *proc, SEC_BYTE *cert_hash, SEC_BYTE *pub_hash)
+{
+    SEC_SIZE now = _Sec_CertVerifyCacheNow();
+    SEC_BOOL found = SEC_FALSE;
+    int i;
+
+    pthread_mutex_lock(&g_cert_verify_cache_mutex);
+    for (i = 0; i < SEC_CERT_VERIFY_CACHE_SIZE; ++i)
+    {
+        _Sec_CertVerifyCacheEntry *entry = &proc->cert_verify_cache[i];
+
+        if (!entry->valid)
+            continue;
+
+        if (entry->expires <= now)
+        {
+            memset(entry, 0, sizeof(_Sec_CertVerifyCacheEntry));
+            continue;
+        }
+
+        if (0 == memcmp(entry->cert_hash, cert_hash, SHA256_DIGEST_LENGTH)
+                && 0 == memcmp(entry->pub_hash, pub_hash, SHA256_DIGEST_LENGTH))
+        {
+            found = SEC_TRUE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_cert_verify_cache_mutex);
+
+    SEC_STATS_CACHE(SEC_STATS_CACHE_CERT_VERIFY, found);
+    return found;
+}
+
+/* only successful verifications are recorded, the entry closest to expiry is replaced when full */
+static void _Sec_CertVerifyCacheInsert(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id,
+        SEC_BYTE *cert_hash, SEC_BYTE *pub_hash)
+{
+    _Sec_CertVerifyCacheEntry *slot = &proc->cert_verify_cache[0];
+    int i;
+
+    pthread_mutex_lock(&g_cert_verify_cache_mutex);
+    for (i = 0; i < SEC_CERT_VERIFY_CACHE_SIZE; ++i)
+    {
+        if (!proc->cert_verify_cache[i].valid)
+        {
+            slot = &proc->cert_verify_cache[i];
+            break;
+        }
+
+        if (proc->cert_verify_cache[i].expires < slot->expires)
+            slot = &proc->cert_verify_cache[i];
+    }
+
+    slot->valid = SEC_TRUE;
+    slot->object_id = object_id;
+    memcpy(slot->cert_hash, cert_hash, SHA256_DIGEST_LENGTH);
+    memcpy(slot->pub_hash, pub_hash, SHA256_DIGEST_LENGTH);
+    slot->expires = _Sec_CertVerifyCacheNow() + SEC_CERT_VERIFY_CACHE_TTL;
+    pthread_mutex_unlock(&g_cert_verify_cache_mutex);
+}
+
+/*
+ * certificates.idx is authenticated with the certificate store key, so its entries are trusted
+ * without loading the certificates.  Processors in several processes may share an app_dir, so
+ * every update re-reads the file under an flock on certificates.idx.lock and writes it back with
+ * the next generation, which is also published in the mapped lock file.  A lookup only compares
+ * the published generation with its own and does not touch the file system while they match.
+ * Every certificate carries a stamp of its store files.  The stamps are checked when a processor
+ * first loads the index, so a certificate added, removed or rewritten behind the API is picked
+ * up by the next processor created on the store.
+ */
+
+static void _Sec_CertIndexHash(Sec_CertificateIndexType type, SEC_BYTE *value, SEC_SIZE value_len, SEC_BYTE *hash)
+{
+    SHA256_CTX ctx;
+    SEC_BYTE tag = (SEC_BYTE) type;
+
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, &tag, 1);
+    SHA256_Update(&ctx, value, value_len);
+    SHA256_Final(hash, &ctx);
+}
+
+static SEC_SIZE _Sec_CertIndexBucket(SEC_BYTE *hash)
+{
+    return Sec_BEBytesToUint32(hash) % SEC_CERTINDEX_BUCKETS;
+}
+
+static void _Sec_CertIndexPresentHash(SEC_OBJECTID object_id, SEC_BYTE *hash)
+{
+    SEC_BYTE id[8];
+
+    Sec_Uint64ToBEBytes(object_id, id);
+    _Sec_CertIndexHash(SEC_CERTINDEX_PRESENT, id, sizeof(id), hash);
+}
+
+static Sec_Result _Sec_CertIndexAdd(Sec_ProcessorHandle *proc, Sec_CertificateIndexType type,
+        SEC_BYTE *hash, SEC_OBJECTID object_id, SEC_BOOL persistent, uint64_t stamp)
+{
+    SEC_SIZE bucket = _Sec_CertIndexBucket(hash);
+    _Sec_CertIndexEntry *entry;
+
+    entry = calloc(1, sizeof(_Sec_CertIndexEntry));
+    if (NULL == entry)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    entry->type = type;
+    memcpy(entry->hash, hash, SHA256_DIGEST_LENGTH);
+    entry->object_id = object_id;
+    entry->persistent = persistent;
+    entry->stamp = stamp;
+    entry->next = proc->cert_index[bucket];
+    proc->cert_index[bucket] = entry;
+
+    return SEC_RESULT_SUCCESS;
+}
 
-done:
-    Sec_Memset(symetric_key, 0, sizeof(symetric_key));
-    return res;
+static void _Sec_CertIndexRemove(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id)
+{
+    _Sec_CertIndexEntry **link;
+    _Sec_CertIndexEntry *entry;
+    SEC_SIZE i;
+
+    for (i = 0; i < SEC_CERTINDEX_BUCKETS; ++i)
+    {
+        link = &proc->cert_index[i];
+        while (*link != NULL)
+        {
+            entry = *link;
+            if (entry->object_id == object_id)
+            {
+                *link = entry->next;
+                SEC_FREE(entry);
+                continue;
+            }
+            link = &entry->next;
+        }
+    }
 }
 
-Sec_Result SecMac_Release(Sec_MacHandle* macHandle, SEC_BYTE* macBuffer,
-        SEC_SIZE* macSize)
+/* drops the persisted entries, or all of them, RAM certificates are only ever indexed in memory */
+static void _Sec_CertIndexFreeEntries(Sec_ProcessorHandle *proc, SEC_BOOL persistent_only)
 {
-    unsigned int o1;
-    size_t o2;
+    _Sec_CertIndexEntry **link;
+    _Sec_CertIndexEntry *entry;
+    SEC_SIZE i;
 
-    CHECK_HANDLE(macHandle);
+    for (i = 0; i < SEC_CERTINDEX_BUCKETS; ++i)
+    {
+        link = &proc->cert_index[i];
+        while (*link != NULL)
+        {
+            entry = *link;
+            if (entry->persistent || !persistent_only)
+            {
+                *link = entry->next;
+                SEC_FREE(entry);
+                continue;
+            }
+            link = &entry->next;
+        }
+    }
+}
 
-    switch (macHandle->algorithm)
+static void _Sec_CertIndexFree(Sec_ProcessorHandle *proc)
+{
+    _Sec_CertIndexFreeEntries(proc, SEC_FALSE);
+    proc->cert_index_loaded = SEC_FALSE;
+    proc->cert_index_generation = 0;
+
+    if (NULL != proc->cert_index_shared)
+        munmap((void *) proc->cert_index_shared, sizeof(uint64_t));
+    proc->cert_index_shared = NULL;
+}
+
+/* the entry marking object_id as indexed, NULL if it is not */
+static _Sec_CertIndexEntry *_Sec_CertIndexPresent(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id)
+{
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    _Sec_CertIndexEntry *entry;
+
+    _Sec_CertIndexPresentHash(object_id, hash);
+
+    for (entry = proc->cert_index[_Sec_CertIndexBucket(hash)]; entry != NULL; entry = entry->next)
     {
-    case SEC_MACALGORITHM_HMAC_SHA1:
-    case SEC_MACALGORITHM_HMAC_SHA256:
-        HMAC_Final(macHandle->hmac_ctx, macBuffer, &o1);
-        *macSize = o1;
+        if (entry->type == SEC_CERTINDEX_PRESENT && entry->object_id == object_id)
+            return entry;
+    }
+
+    return NULL;
+}
+
+/* hash of the value of the certificate indexed under type, SEC_FALSE if the certificate has none */
+static SEC_BOOL _Sec_CertIndexCertHash(X509 *x509, Sec_CertificateIndexType type, SEC_BYTE *hash)
+{
+    ASN1_OCTET_STRING *ski = NULL;
+    SEC_BYTE *der = NULL;
+    int der_len;
+
+    if (type == SEC_CERTIFICATEINDEX_SKI)
+    {
+        ski = X509_get_ext_d2i(x509, NID_subject_key_identifier, NULL, NULL);
+        if (NULL == ski)
+            return SEC_FALSE;
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
+        _Sec_CertIndexHash(type, ASN1_STRING_data(ski), ASN1_STRING_length(ski), hash);
 #else
-        HMAC_CTX_free(macHandle->hmac_ctx);
+        _Sec_CertIndexHash(type, (SEC_BYTE *) ASN1_STRING_get0_data(ski), ASN1_STRING_length(ski), hash);
 #endif
-        break;
+        ASN1_OCTET_STRING_free(ski);
+        return SEC_TRUE;
+    }
 
-    case SEC_MACALGORITHM_CMAC_AES_128:
-        CMAC_Final(macHandle->cmac_ctx, macBuffer, &o2);
-        *macSize = o2;
+    der_len = i2d_X509_NAME((type == SEC_CERTIFICATEINDEX_SUBJECT) ? X509_get_subject_name(x509)
+            : X509_get_issuer_name(x509), &der);
+    if (der_len <= 0)
+    {
+        SEC_LOG_ERROR("i2d_X509_NAME failed");
+        return SEC_FALSE;
+    }
 
-        CMAC_CTX_free(macHandle->cmac_ctx);
-        break;
+    _Sec_CertIndexHash(type, der, der_len, hash);
+    OPENSSL_free(der);
 
-    default:
-        SEC_LOG_ERROR("Unimplemented mac algorithm");
-        return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+    return SEC_TRUE;
+}
+
+/* a certificate that cannot be parsed is still marked present, so that rescans do not load it again */
+static Sec_Result _Sec_CertIndexAddCert(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id,
+        SEC_BYTE *cert, SEC_SIZE cert_len, SEC_BOOL persistent, uint64_t stamp)
+{
+    X509 *x509 = NULL;
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    int type;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    x509 = SecCertificate_DerToX509(cert, cert_len);
+    if (NULL == x509)
+    {
+        SEC_LOG_ERROR("SecCertificate_DerToX509 failed");
+        goto done;
+    }
+
+    for (type = 0; type < SEC_CERTIFICATEINDEX_NUM; ++type)
+    {
+        if (!_Sec_CertIndexCertHash(x509, (Sec_CertificateIndexType) type, hash))
+        {
+            /* the subject key identifier extension is optional */
+            if (type == SEC_CERTIFICATEINDEX_SKI)
+                continue;
+            goto done;
+        }
+
+        if (SEC_RESULT_SUCCESS != _Sec_CertIndexAdd(proc, (Sec_CertificateIndexType) type, hash, object_id, persistent, 0))
+            goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SEC_X509_FREE(x509);
+
+    if (SEC_RESULT_SUCCESS != res)
+        _Sec_CertIndexRemove(proc, object_id);
+
+    _Sec_CertIndexPresentHash(object_id, hash);
+    if (SEC_RESULT_SUCCESS != _Sec_CertIndexAdd(proc, SEC_CERTINDEX_PRESENT, hash, object_id, persistent, stamp))
+    {
+        _Sec_CertIndexRemove(proc, object_id);
+        res = SEC_RESULT_FAILURE;
+    }
+
+    return res;
+}
+
+/* identifies the store files of a certificate, a file that is replaced or rewritten changes it */
+static uint64_t _Sec_CertIndexFileStamp(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id)
+{
+    char file_name[SEC_MAX_FILE_PATH_LEN];
+    const char *dirs[2];
+    SEC_BYTE digest[SHA256_DIGEST_LENGTH];
+    struct stat st;
+    SEC_BYTE field[8];
+    SHA256_CTX ctx;
+    int i;
+
+    dirs[0] = proc->global_dir;
+    dirs[1] = proc->app_dir;
+
+    SHA256_Init(&ctx);
+    for (i = 0; i < 2; ++i)
+    {
+        memset(&st, 0, sizeof(st));
+        if (dirs[i] != NULL)
+        {
+            snprintf(file_name, sizeof(file_name), "%s" SEC_CERT_FILENAME_PATTERN, dirs[i], object_id);
+            if (0 != stat(file_name, &st))
+                memset(&st, 0, sizeof(st));
+        }
+
+        Sec_Uint64ToBEBytes((uint64_t) st.st_dev, field);
+        SHA256_Update(&ctx, field, sizeof(field));
+        Sec_Uint64ToBEBytes((uint64_t) st.st_ino, field);
+        SHA256_Update(&ctx, field, sizeof(field));
+        Sec_Uint64ToBEBytes((uint64_t) st.st_size, field);
+        SHA256_Update(&ctx, field, sizeof(field));
+        Sec_Uint64ToBEBytes((uint64_t) st.st_mtim.tv_sec, field);
+        SHA256_Update(&ctx, field, sizeof(field));
+        Sec_Uint64ToBEBytes((uint64_t) st.st_mtim.tv_nsec, field);
+        SHA256_Update(&ctx, field, sizeof(field));
+        Sec_Uint64ToBEBytes((uint64_t) st.st_ctim.tv_sec, field);
+        SHA256_Update(&ctx, field, sizeof(field));
+        Sec_Uint64ToBEBytes((uint64_t) st.st_ctim.tv_nsec, field);
+        SHA256_Update(&ctx, field, sizeof(field));
+    }
+    SHA256_Final(digest, &ctx);
+
+    return Sec_BEBytesToUint64(digest);
+}
+
+/* returns the locked descriptor, or -1 if the processor has no app_dir or the lock failed */
+static int _Sec_CertIndexLock(Sec_ProcessorHandle *proc, int operation)
+{
+    char file_name[SEC_MAX_FILE_PATH_LEN];
+    int fd;
+
+    if (proc->app_dir == NULL)
+        return -1;
+
+    snprintf(file_name, sizeof(file_name), "%s" SEC_CERTINDEX_LOCK_FILENAME, proc->app_dir);
+    fd = open(file_name, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        SEC_LOG_ERROR("Could not open file: %s, errno: %d", file_name, errno);
+        return -1;
+    }
+
+    while (0 != flock(fd, operation))
+    {
+        if (errno != EINTR)
+        {
+            SEC_LOG_ERROR("flock failed for file: %s, errno: %d", file_name, errno);
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+static void _Sec_CertIndexUnlock(int fd)
+{
+    if (fd < 0)
+        return;
+
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+/* maps the generation published in the lock file, must be called with the exclusive lock held */
+static void _Sec_CertIndexMapShared(Sec_ProcessorHandle *proc, int fd)
+{
+    struct stat st;
+    void *shared;
+
+    if (NULL != proc->cert_index_shared || fd < 0)
+        return;
+
+    if (0 != fstat(fd, &st) || (st.st_size < (off_t) sizeof(uint64_t) && 0 != ftruncate(fd, sizeof(uint64_t))))
+    {
+        SEC_LOG_ERROR("Could not size the certificate index lock file, errno: %d", errno);
+        return;
+    }
+
+    shared = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == shared)
+    {
+        SEC_LOG_ERROR("mmap failed for the certificate index lock file, errno: %d", errno);
+        return;
+    }
+
+    proc->cert_index_shared = (uint64_t *) shared;
+}
+
+/* the generation the other processors on the app_dir have published */
+static uint64_t _Sec_CertIndexSharedGeneration(Sec_ProcessorHandle *proc)
+{
+    if (NULL == proc->cert_index_shared)
+        return proc->cert_index_generation;
+
+    return __atomic_load_n(proc->cert_index_shared, __ATOMIC_ACQUIRE);
+}
+
+static Sec_Result _Sec_CertIndexMac(Sec_ProcessorHandle *proc, SEC_BYTE *data, SEC_SIZE data_len, SEC_BYTE *mac)
+{
+    SEC_SIZE mac_len = 0;
+
+    if (SEC_RESULT_SUCCESS != SecMac_SingleInputId(proc, SEC_MACALGORITHM_HMAC_SHA256, SEC_OBJECTID_CERTSTORE_KEY,
+            data, data_len, mac, &mac_len) || mac_len != SHA256_DIGEST_LENGTH)
+    {
+        SEC_LOG_ERROR("SecMac_SingleInputId failed");
+        return SEC_RESULT_FAILURE;
     }
 
-    SEC_FREE(macHandle);
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecRandom_GetInstance(Sec_ProcessorHandle* secProcHandle,
-        Sec_RandomAlgorithm algorithm, Sec_RandomHandle** randomHandle)
+/*
+ * replaces the persisted entries with the contents of the file if it was written as generation,
+ * must be called with the lock held
+ */
+static Sec_Result _Sec_CertIndexRead(Sec_ProcessorHandle *proc, uint64_t generation)
 {
-    CHECK_HANDLE(secProcHandle);
+    char file_name[SEC_MAX_FILE_PATH_LEN];
+    _Sec_CertIndexRecord *records;
+    SEC_BYTE mac[SHA256_DIGEST_LENGTH];
+    SEC_BYTE *buffer = NULL;
+    struct stat st;
+    SEC_SIZE read = 0;
+    SEC_SIZE num;
+    SEC_SIZE i;
+    Sec_Result res = SEC_RESULT_FAILURE;
 
-    *randomHandle = calloc(1, sizeof(Sec_RandomHandle));
-    if (NULL == *randomHandle)
+    snprintf(file_name, sizeof(file_name), "%s" SEC_CERTINDEX_FILENAME, proc->app_dir);
+    if (0 != stat(file_name, &st))
+        return SEC_RESULT_NO_SUCH_ITEM;
+
+    if (st.st_size < SEC_CERTINDEX_HEADER_LEN + SHA256_DIGEST_LENGTH || st.st_size > SEC_CERTINDEX_MAX_FILE_LEN)
+    {
+        SEC_LOG_ERROR("Invalid certificate index size %ld", (long) st.st_size);
+        return SEC_RESULT_FAILURE;
+    }
+
+    buffer = malloc(st.st_size);
+    if (NULL == buffer)
     {
         SEC_LOG_ERROR("malloc failed");
         return SEC_RESULT_FAILURE;
     }
-    (*randomHandle)->algorithm = algorithm;
 
-    return SEC_RESULT_SUCCESS;
+    if (SEC_RESULT_SUCCESS != SecUtils_ReadFile(file_name, buffer, st.st_size, &read)
+            || read < SEC_CERTINDEX_HEADER_LEN + SHA256_DIGEST_LENGTH
+            || 0 != memcmp(buffer, SEC_CERTINDEX_MAGIC, 4))
+    {
+        SEC_LOG_ERROR("Invalid certificate index");
+        goto done;
+    }
+
+    /* a file left behind by a failed update is rebuilt */
+    if (Sec_BEBytesToUint64(buffer + 4) != generation)
+        goto done;
+
+    num = Sec_BEBytesToUint32(buffer + 12);
+    if (num > (read - SEC_CERTINDEX_HEADER_LEN - SHA256_DIGEST_LENGTH) / sizeof(_Sec_CertIndexRecord)
+            || read != SEC_CERTINDEX_HEADER_LEN + num * sizeof(_Sec_CertIndexRecord) + SHA256_DIGEST_LENGTH)
+    {
+        SEC_LOG_ERROR("Invalid certificate index");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_CertIndexMac(proc, buffer, read - SHA256_DIGEST_LENGTH, mac)
+            || 0 != Sec_Memcmp(mac, buffer + read - SHA256_DIGEST_LENGTH, SHA256_DIGEST_LENGTH))
+    {
+        SEC_LOG_ERROR("Certificate index mac does not match the expected value");
+        goto done;
+    }
+
+    _Sec_CertIndexFreeEntries(proc, SEC_TRUE);
+
+    records = (_Sec_CertIndexRecord *) (buffer + SEC_CERTINDEX_HEADER_LEN);
+    for (i = 0; i < num; ++i)
+    {
+        if (records[i].type > SEC_CERTINDEX_PRESENT)
+            continue;
+
+        if (SEC_RESULT_SUCCESS != _Sec_CertIndexAdd(proc, (Sec_CertificateIndexType) records[i].type,
+                records[i].hash, Sec_BEBytesToUint64(records[i].object_id), SEC_TRUE,
+                Sec_BEBytesToUint64(records[i].stamp)))
+        {
+            _Sec_CertIndexFreeEntries(proc, SEC_TRUE);
+            goto done;
+        }
+    }
+
+    proc->cert_index_generation = generation;
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SEC_FREE(buffer);
+    return res;
+}
+
+/* writes the persisted entries as generation, must be called with the exclusive lock held */
+static Sec_Result _Sec_CertIndexWrite(Sec_ProcessorHandle *proc, uint64_t generation)
+{
+    char file_name[SEC_MAX_FILE_PATH_LEN];
+    _Sec_CertIndexRecord *records;
+    _Sec_CertIndexEntry *entry;
+    SEC_BYTE *buffer = NULL;
+    SEC_SIZE buffer_len;
+    SEC_SIZE num = 0;
+    SEC_SIZE i;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    for (i = 0; i < SEC_CERTINDEX_BUCKETS; ++i)
+    {
+        for (entry = proc->cert_index[i]; entry != NULL; entry = entry->next)
+        {
+            if (entry->persistent)
+                ++num;
+        }
+    }
+
+    buffer_len = SEC_CERTINDEX_HEADER_LEN + num * sizeof(_Sec_CertIndexRecord) + SHA256_DIGEST_LENGTH;
+    buffer = calloc(1, buffer_len);
+    if (NULL == buffer)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    memcpy(buffer, SEC_CERTINDEX_MAGIC, 4);
+    Sec_Uint64ToBEBytes(generation, buffer + 4);
+    Sec_Uint32ToBEBytes(num, buffer + 12);
+
+    records = (_Sec_CertIndexRecord *) (buffer + SEC_CERTINDEX_HEADER_LEN);
+    num = 0;
+    for (i = 0; i < SEC_CERTINDEX_BUCKETS; ++i)
+    {
+        for (entry = proc->cert_index[i]; entry != NULL; entry = entry->next)
+        {
+            if (!entry->persistent)
+                continue;
+
+            records[num].type = (SEC_BYTE) entry->type;
+            Sec_Uint64ToBEBytes(entry->object_id, records[num].object_id);
+            Sec_Uint64ToBEBytes(entry->stamp, records[num].stamp);
+            memcpy(records[num].hash, entry->hash, SHA256_DIGEST_LENGTH);
+            ++num;
+        }
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_CertIndexMac(proc, buffer, buffer_len - SHA256_DIGEST_LENGTH,
+            buffer + buffer_len - SHA256_DIGEST_LENGTH))
+        goto done;
+
+    snprintf(file_name, sizeof(file_name), "%s" SEC_CERTINDEX_FILENAME, proc->app_dir);
+    if (SEC_RESULT_SUCCESS != SecUtils_WriteFile(file_name, buffer, buffer_len))
+    {
+        SEC_LOG_ERROR("SecUtils_WriteFile failed");
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SEC_FREE(buffer);
+    return res;
+}
+
+/*
+ * writes and publishes the next generation.  An index that could not be written is removed rather
+ * than left stale, the in-memory copy stays valid and the other processors rebuild theirs.
+ */
+static Sec_Result _Sec_CertIndexSave(Sec_ProcessorHandle *proc, int fd)
+{
+    char file_name[SEC_MAX_FILE_PATH_LEN];
+    uint64_t generation = proc->cert_index_generation + 1;
+    Sec_Result res;
+
+    if (fd < 0)
+        return (proc->app_dir == NULL) ? SEC_RESULT_SUCCESS : SEC_RESULT_FAILURE;
+
+    res = _Sec_CertIndexWrite(proc, generation);
+    if (SEC_RESULT_SUCCESS != res)
+    {
+        SEC_LOG_ERROR("Could not write the certificate index, removing it");
+        snprintf(file_name, sizeof(file_name), "%s" SEC_CERTINDEX_FILENAME, proc->app_dir);
+        SecUtils_RmFile(file_name);
+    }
+
+    proc->cert_index_generation = generation;
+    if (NULL != proc->cert_index_shared)
+        __atomic_store_n(proc->cert_index_shared, generation, __ATOMIC_RELEASE);
+
+    return res;
+}
+
+/*
+ * brings the index in line with the store, only certificates whose store files changed are loaded.
+ * Returns SEC_TRUE if any persisted entry changed.
+ */
+static SEC_BOOL _Sec_CertIndexScan(Sec_ProcessorHandle *proc)
+{
+    SEC_OBJECTID *ids = NULL;
+    Sec_CertificateHandle *cert = NULL;
+    _Sec_CertIndexEntry **link;
+    _Sec_CertIndexEntry *entry;
+    SEC_BOOL changed = SEC_FALSE;
+    uint64_t stamp;
+    SEC_SIZE num;
+    SEC_SIZE i;
+
+    ids = calloc(SEC_CERTINDEX_MAX_CERTS, sizeof(SEC_OBJECTID));
+    if (NULL == ids)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_FALSE;
+    }
+
+    num = SecCertificate_List(proc, ids, SEC_CERTINDEX_MAX_CERTS);
+    for (i = 0; i < num; ++i)
+    {
+        /* RAM certificates are indexed as they are provisioned */
+        entry = _Sec_CertIndexPresent(proc, ids[i]);
+        if (entry != NULL && !entry->persistent)
+            continue;
+
+        stamp = _Sec_CertIndexFileStamp(proc, ids[i]);
+        if (entry != NULL && entry->stamp == stamp)
+            continue;
+
+        changed = SEC_TRUE;
+        _Sec_CertIndexRemove(proc, ids[i]);
+
+        if (SEC_RESULT_SUCCESS != SecCertificate_GetInstance(proc, ids[i], &cert))
+            continue;
+
+        _Sec_CertIndexAddCert(proc, ids[i], cert->cert_data.cert, cert->cert_data.cert_len,
+                cert->location != SEC_STORAGELOC_RAM, stamp);
+        SecCertificate_Release(cert);
+        cert = NULL;
+    }
+
+    /* drop the certificates that went away, unless the listing was cut short */
+    if (num < SEC_CERTINDEX_MAX_CERTS)
+    {
+        for (i = 0; i < SEC_CERTINDEX_BUCKETS; ++i)
+        {
+            link = &proc->cert_index[i];
+            while (*link != NULL)
+            {
+                entry = *link;
+                if (entry->persistent && SecUtils_ItemIndex(ids, num, entry->object_id) == -1)
+                {
+                    *link = entry->next;
+                    SEC_FREE(entry);
+                    changed = SEC_TRUE;
+                    continue;
+                }
+                link = &entry->next;
+            }
+        }
+    }
+
+    SEC_FREE(ids);
+
+    return changed;
 }
 
-Sec_Result SecRandom_Process(Sec_RandomHandle* randomHandle, SEC_BYTE* output,
-        SEC_SIZE outputSize)
+/* SEC_TRUE if no other processor changed the index since this one last loaded or saved it */
+static SEC_BOOL _Sec_CertIndexCurrent(Sec_ProcessorHandle *proc)
 {
-    CHECK_HANDLE(randomHandle);
+    if (!proc->cert_index_loaded)
+        return SEC_FALSE;
 
-    switch (randomHandle->algorithm)
+    if (proc->app_dir == NULL)
+        return SEC_TRUE;
+
+    return NULL != proc->cert_index_shared
+            && _Sec_CertIndexSharedGeneration(proc) == proc->cert_index_generation;
+}
+
+/*
+ * brings the in-memory index up to the published generation.  The first load checks the stamps
+ * of all certificates, later loads trust the file the other processor wrote.  fd is the held
+ * exclusive lock, -1 if the processor has no app_dir.
+ */
+static Sec_Result _Sec_CertIndexLoad(Sec_ProcessorHandle *proc, int fd)
+{
+    _Sec_RAMCertificateData *ram_cert;
+    SEC_BOOL first = !proc->cert_index_loaded;
+    SEC_BOOL changed;
+    uint64_t generation;
+
+    _Sec_CertIndexMapShared(proc, fd);
+
+    if (_Sec_CertIndexCurrent(proc))
+        return SEC_RESULT_SUCCESS;
+
+    if (first)
     {
-    case SEC_RANDOMALGORITHM_TRUE:
-            CHECK_EXACT(RAND_bytes(output, outputSize), 1, error);
-        break;
+        _Sec_CertIndexFreeEntries(proc, SEC_FALSE);
+        proc->cert_index_loaded = SEC_TRUE;
 
-    case SEC_RANDOMALGORITHM_PRNG:
-            CHECK_EXACT(RAND_bytes(output, outputSize), 1, error);
-        break;
+        for (ram_cert = proc->ram_certs; ram_cert != NULL; ram_cert = ram_cert->next)
+        {
+            _Sec_CertIndexAddCert(proc, ram_cert->object_id, ram_cert->cert_data.cert,
+                    ram_cert->cert_data.cert_len, SEC_FALSE, 0);
+        }
+    }
 
-    default:
-        SEC_LOG_ERROR("Unimplemented random algorithm");
-        goto unimplemented;
+    generation = _Sec_CertIndexSharedGeneration(proc);
+    if (fd >= 0 && SEC_RESULT_SUCCESS == _Sec_CertIndexRead(proc, generation))
+    {
+        if (!first)
+            return SEC_RESULT_SUCCESS;
+
+        changed = _Sec_CertIndexScan(proc);
+    }
+    else
+    {
+        /* a missing, invalid or stale file is rebuilt, the stamps tell which entries are still valid */
+        proc->cert_index_generation = generation;
+        changed = _Sec_CertIndexScan(proc) || fd >= 0;
     }
 
-    return SEC_RESULT_SUCCESS;
-    error: return SEC_RESULT_FAILURE;
-    unimplemented: return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+    if (!changed)
+        return SEC_RESULT_SUCCESS;
+
+    return _Sec_CertIndexSave(proc, fd);
 }
 
-Sec_Result SecRandom_Release(Sec_RandomHandle* randomHandle)
+/* brings the in-memory index up to date before a lookup */
+static Sec_Result _Sec_CertIndexSync(Sec_ProcessorHandle *proc)
 {
-    CHECK_HANDLE(randomHandle);
-    SEC_FREE(randomHandle);
-    return SEC_RESULT_SUCCESS;
+    Sec_Result res;
+    int fd;
+
+    /* nothing changed since the last lookup, which is the common case */
+    if (_Sec_CertIndexCurrent(proc))
+        return SEC_RESULT_SUCCESS;
+
+    fd = _Sec_CertIndexLock(proc, LOCK_EX);
+    res = _Sec_CertIndexLoad(proc, fd);
+    _Sec_CertIndexUnlock(fd);
+
+    return res;
 }
 
-SEC_SIZE SecCertificate_List(Sec_ProcessorHandle *proc, SEC_OBJECTID *items, SEC_SIZE maxNumItems)
+/* replaces the entries of object_id with those of cert, or removes them if cert is NULL */
+static Sec_Result _Sec_CertIndexUpdate(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id,
+        _Sec_CertificateData *cert, SEC_BOOL persistent)
 {
-    _Sec_RAMCertificateData *cert;
-    SEC_SIZE numItems = 0;
-
-    CHECK_HANDLE(proc);
+    Sec_Result res;
+    int fd;
 
-    /* look in RAM */
-    cert = proc->ram_certs;
-    while (cert != NULL)
+    /* RAM certificates are picked up when the index is first loaded */
+    if (!persistent)
     {
-        numItems = SecUtils_UpdateItemList(items, maxNumItems, numItems, cert->object_id);
-        cert = cert->next;
+        if (!proc->cert_index_loaded)
+            return SEC_RESULT_SUCCESS;
+
+        _Sec_CertIndexRemove(proc, object_id);
+        if (cert != NULL)
+            return _Sec_CertIndexAddCert(proc, object_id, cert->cert, cert->cert_len, SEC_FALSE, 0);
+        return SEC_RESULT_SUCCESS;
     }
 
-    /* look in file system */
-    if (proc->global_dir != NULL) {
-        numItems = SecUtils_UpdateItemListFromDir(items, maxNumItems, numItems, proc->global_dir, SEC_CERT_FILENAME_EXT);
+    fd = _Sec_CertIndexLock(proc, LOCK_EX);
+    if (fd < 0 && proc->app_dir != NULL)
+    {
+        /* without the lock the file cannot be kept in step, rebuild on the next lookup */
+        _Sec_CertIndexFreeEntries(proc, SEC_FALSE);
+        proc->cert_index_loaded = SEC_FALSE;
+        return SEC_RESULT_FAILURE;
     }
 
-    if (proc->app_dir != NULL) {
-        numItems = SecUtils_UpdateItemListFromDir(items, maxNumItems, numItems, proc->app_dir, SEC_CERT_FILENAME_EXT);
+    /* changes made by other processors are merged before this one is written */
+    if (SEC_RESULT_SUCCESS != _Sec_CertIndexLoad(proc, fd))
+        SEC_LOG_ERROR("_Sec_CertIndexLoad failed");
+
+    _Sec_CertIndexRemove(proc, object_id);
+    if (cert != NULL)
+    {
+        _Sec_CertIndexAddCert(proc, object_id, cert->cert, cert->cert_len, SEC_TRUE,
+                _Sec_CertIndexFileStamp(proc, object_id));
     }
 
-    return numItems;
+    /* publishing the new generation is what tells the other processors to reload */
+    res = _Sec_CertIndexSave(proc, fd);
+    _Sec_CertIndexUnlock(fd);
+
+    return res;
 }
 
-Sec_Result SecCertificate_GetInstance(Sec_ProcessorHandle* secProcHandle,
-        SEC_OBJECTID object_id, Sec_CertificateHandle** certHandle)
+Sec_Result SecCertificate_Find(Sec_ProcessorHandle* secProcHandle,
+        Sec_CertificateIndexType type, SEC_BYTE *value, SEC_SIZE value_len,
+        SEC_OBJECTID *items, SEC_SIZE maxNumItems, SEC_SIZE *numItems)
 {
-    Sec_Result result;
-    _Sec_CertificateData cert_data;
-    Sec_StorageLoc location;
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    _Sec_CertIndexEntry *entry;
 
     CHECK_HANDLE(secProcHandle);
 
-    if (object_id == SEC_OBJECTID_INVALID)
-    {
-        SEC_LOG_ERROR("Invalid object_id");
+    if (type >= SEC_CERTIFICATEINDEX_NUM || NULL == value || NULL == numItems)
         return SEC_RESULT_INVALID_PARAMETERS;
-    }
 
-    result = _Sec_RetrieveCertificateData(secProcHandle, object_id, &location,
-            &cert_data);
-    if (result != SEC_RESULT_SUCCESS)
-    {
-        return result;
-    }
+    *numItems = 0;
 
-    result = _Sec_ValidateCertificateData(secProcHandle, &cert_data);
-    if (result != SEC_RESULT_SUCCESS)
-    {
-        SEC_LOG_ERROR("_Sec_ValidateCertificateData failed");
-        return SEC_RESULT_VERIFICATION_FAILED;
-    }
+    /* a failure to persist the index leaves the in-memory copy usable */
+    if (SEC_RESULT_SUCCESS != _Sec_CertIndexSync(secProcHandle))
+        SEC_LOG_ERROR("_Sec_CertIndexSync failed");
 
-    *certHandle = calloc(1, sizeof(Sec_CertificateHandle));
-    if (NULL == *certHandle)
+    _Sec_CertIndexHash(type, value, value_len, hash);
+
+    for (entry = secProcHandle->cert_index[_Sec_CertIndexBucket(hash)]; entry != NULL; entry = entry->next)
     {
-        SEC_LOG_ERROR("malloc failed");
-        return SEC_RESULT_FAILURE;
+        if (entry->type != type || 0 != memcmp(entry->hash, hash, SHA256_DIGEST_LENGTH))
+            continue;
+
+        if (items != NULL)
+            *numItems = SecUtils_UpdateItemList(items, maxNumItems, *numItems, entry->object_id);
     }
-    (*certHandle)->object_id = object_id;
-    memcpy(&((*certHandle)->cert_data), &cert_data,
-            sizeof(_Sec_CertificateData));
-    (*certHandle)->location = location;
-    (*certHandle)->proc = secProcHandle;
 
-    return SEC_RESULT_SUCCESS;
+    return (*numItems > 0) ? SEC_RESULT_SUCCESS : SEC_RESULT_NO_SUCH_ITEM;
 }
 
 Sec_Result SecCertificate_Provision(Sec_ProcessorHandle* secProcHandle,
@@ -3711,8 +6502,21 @@ Sec_Result SecCertificate_Provision(Sec_ProcessorHandle* secProcHandle,
     if (SEC_RESULT_SUCCESS != result)
         return result;
 
-    return _Sec_StoreCertificateData(secProcHandle, object_id, location,
+    _Sec_CertVerifyCacheInvalidate(secProcHandle, object_id);
+
+    result = _Sec_StoreCertificateData(secProcHandle, object_id, location,
             &cert_data);
+    if (SEC_RESULT_SUCCESS != result)
+        return result;
+
+    /* the certificate is stored, an index that cannot be updated is dropped and rebuilt on lookup */
+    if (SEC_RESULT_SUCCESS != _Sec_CertIndexUpdate(secProcHandle, object_id, &cert_data,
+            location != SEC_STORAGELOC_RAM))
+    {
+        SEC_LOG_ERROR("_Sec_CertIndexUpdate failed");
+    }
+
+    return SEC_RESULT_SUCCESS;
 }
 
 Sec_Result SecCertificate_Delete(Sec_ProcessorHandle* secProcHandle,
@@ -3724,9 +6528,12 @@ Sec_Result SecCertificate_Delete(Sec_ProcessorHandle* secProcHandle,
     _Sec_RAMCertificateData *ram_cert_parent = NULL;
     SEC_SIZE certs_found = 0;
     SEC_SIZE certs_deleted = 0;
+    SEC_SIZE ram_certs_deleted;
 
     CHECK_HANDLE(secProcHandle);
 
+    _Sec_CertVerifyCacheInvalidate(secProcHandle, object_id);
+
     /* ram */
     _Sec_FindRAMCertificateData(secProcHandle, object_id, &ram_cert,
             &ram_cert_parent);
@@ -3744,6 +6551,7 @@ Sec_Result SecCertificate_Delete(Sec_ProcessorHandle* secProcHandle,
         ++certs_found;
         ++certs_deleted;
     }
+    ram_certs_deleted = certs_deleted;
 
     /* app_dir */
     if (secProcHandle->app_dir != NULL) {
@@ -3766,6 +6574,12 @@ Sec_Result SecCertificate_Delete(Sec_ProcessorHandle* secProcHandle,
         }
     }
 
+    if (certs_deleted > 0 && SEC_RESULT_SUCCESS != _Sec_CertIndexUpdate(secProcHandle, object_id, NULL,
+            certs_deleted > ram_certs_deleted))
+    {
+        SEC_LOG_ERROR("_Sec_CertIndexUpdate failed");
+    }
+
     if (certs_found == 0)
         return SEC_RESULT_NO_SUCH_ITEM;
 
@@ -3775,16 +6589,60 @@ Sec_Result SecCertificate_Delete(Sec_ProcessorHandle* secProcHandle,
     return SEC_RESULT_SUCCESS;
 }
 
+/* parses the certificate and its public key on first use, the results live until release */
+static Sec_Result _SecCertificate_Parse(Sec_CertificateHandle* cert_handle)
+{
+    if (cert_handle->pub_parsed)
+        return (cert_handle->x509 != NULL) ? SEC_RESULT_SUCCESS : SEC_RESULT_FAILURE;
+
+    cert_handle->pub_parsed = SEC_TRUE;
+    cert_handle->pub_type = SEC_KEYTYPE_NUM;
+
+    cert_handle->x509 = SecCertificate_DerToX509(cert_handle->cert_data.cert, cert_handle->cert_data.cert_len);
+    if (NULL == cert_handle->x509)
+    {
+        SEC_LOG_ERROR("SecCertificate_DerToX509 failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (SEC_RESULT_SUCCESS == _Pubops_ExtractRSAPubFromX509(cert_handle->x509, &cert_handle->rsa_pub))
+    {
+        switch (Sec_BEBytesToUint32(cert_handle->rsa_pub.modulus_len_be))
+        {
+            case 128:
+                cert_handle->pub_type = SEC_KEYTYPE_RSA_1024_PUBLIC;
+                break;
+            case 256:
+                cert_handle->pub_type = SEC_KEYTYPE_RSA_2048_PUBLIC;
+                break;
+            case 384:
+                cert_handle->pub_type = SEC_KEYTYPE_RSA_3072_PUBLIC;
+                break;
+            default:
+                SEC_LOG_ERROR("Invalid RSA modulus size encountered: %d", Sec_BEBytesToUint32(cert_handle->rsa_pub.modulus_len_be));
+                break;
+        }
+    }
+    else if (SEC_RESULT_SUCCESS == _Pubops_ExtractECCPubFromX509(cert_handle->x509, &cert_handle->ecc_pub))
+    {
+        cert_handle->pub_type = SEC_KEYTYPE_ECC_NISTP256_PUBLIC;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
 Sec_Result SecCertificate_ExtractRSAPublicKey(Sec_CertificateHandle* cert_handle,
         Sec_RSARawPublicKey *public_key)
 {
     CHECK_HANDLE(cert_handle);
 
-    if (SEC_RESULT_SUCCESS != _Pubops_ExtractRSAPubFromX509Der(cert_handle->cert_data.cert, cert_handle->cert_data.cert_len, public_key)) {
+    if (SEC_RESULT_SUCCESS != _SecCertificate_Parse(cert_handle) || !SecKey_IsPubRsa(cert_handle->pub_type)) {
         SEC_LOG_ERROR("SecCertificate_ExtractRSAPubFromX509Der failed");
         return SEC_RESULT_FAILURE;
     }
 
+    memcpy(public_key, &cert_handle->rsa_pub, sizeof(Sec_RSARawPublicKey));
+
     return SEC_RESULT_SUCCESS;
 }
 
@@ -3793,14 +6651,34 @@ Sec_Result SecCertificate_ExtractECCPublicKey(Sec_CertificateHandle* certHandle,
 {
     CHECK_HANDLE(certHandle);
 
-    if (SEC_RESULT_SUCCESS != _Pubops_ExtractECCPubFromX509Der(certHandle->cert_data.cert, certHandle->cert_data.cert_len, public_key)) {
+    if (SEC_RESULT_SUCCESS != _SecCertificate_Parse(certHandle) || !SecKey_IsPubEcc(certHandle->pub_type)) {
         SEC_LOG_ERROR("SecCertificate_ExtractECCPubFromX509Der failed");
         return SEC_RESULT_FAILURE;
     }
 
+    memcpy(public_key, &certHandle->ecc_pub, sizeof(Sec_ECCRawPublicKey));
+
     return SEC_RESULT_SUCCESS;
 }
 
+X509* SecCertificate_GetCachedX509(Sec_CertificateHandle *cert)
+{
+    if (NULL == cert || SEC_RESULT_SUCCESS != _SecCertificate_Parse(cert))
+    {
+        SEC_LOG_ERROR("_SecCertificate_Parse failed");
+        return NULL;
+    }
+
+    /* the caller owns a reference to the shared object, the handle keeps its own */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    CRYPTO_add(&cert->x509->references, 1, CRYPTO_LOCK_X509);
+#else
+    X509_up_ref(cert->x509);
+#endif
+
+    return cert->x509;
+}
+
 // Note that keyHandle can be a public or private key,
 // as all our private keys are supersets of public keys
 Sec_Result SecCertificate_Verify(Sec_CertificateHandle* certHandle,
@@ -3851,29 +6729,226 @@ Sec_Result SecCertificate_Verify(Sec_CertificateHandle* certHandle,
 Sec_Result SecCertificate_VerifyWithRawRSAPublicKey(
         Sec_CertificateHandle* cert_handle, Sec_RSARawPublicKey* public_key)
 {
+    SEC_BYTE cert_hash[SHA256_DIGEST_LENGTH];
+    SEC_BYTE pub_hash[SHA256_DIGEST_LENGTH];
+
+    CHECK_HANDLE(cert_handle);
+    CHECK_HANDLE(public_key);
+
+    _Sec_CertVerifyCacheHash('C', cert_handle->cert_data.cert, cert_handle->cert_data.cert_len, cert_hash);
+    _Pubops_HashRsaPub(public_key, pub_hash);
+
+    if (_Sec_CertVerifyCacheLookup(cert_handle->proc, cert_hash, pub_hash))
+        return SEC_RESULT_SUCCESS;
+
+    if (SEC_RESULT_SUCCESS != _SecCertificate_Parse(cert_handle)
+            || SEC_RESULT_SUCCESS != _Pubops_VerifyX509ObjWithPubRsa(cert_handle->x509, public_key)) {
+        SEC_LOG_ERROR("_Pubops_VerifyX509ObjWithPubRsa failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    _Sec_CertVerifyCacheInsert(cert_handle->proc, cert_handle->object_id, cert_hash, pub_hash);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecCertificate_VerifyWithRawECCPublicKey(
+        Sec_CertificateHandle* cert_handle, Sec_ECCRawPublicKey* public_key)
+{
+    SEC_BYTE cert_hash[SHA256_DIGEST_LENGTH];
+    SEC_BYTE pub_hash[SHA256_DIGEST_LENGTH];
+
     CHECK_HANDLE(cert_handle);
     CHECK_HANDLE(public_key);
 
-    if (SEC_RESULT_SUCCESS != _Pubops_VerifyX509WithPubRsa(cert_handle->cert_data.cert, cert_handle->cert_data.cert_len, public_key)) {
-        SEC_LOG_ERROR("_Pubops_VerifyX509WithPubRsa failed");
-        return SEC_RESULT_FAILURE;
+    _Sec_CertVerifyCacheHash('C', cert_handle->cert_data.cert, cert_handle->cert_data.cert_len, cert_hash);
+    _Pubops_HashEccPub(public_key, pub_hash);
+
+    if (_Sec_CertVerifyCacheLookup(cert_handle->proc, cert_hash, pub_hash))
+        return SEC_RESULT_SUCCESS;
+
+    if (SEC_RESULT_SUCCESS != _SecCertificate_Parse(cert_handle)
+            || SEC_RESULT_SUCCESS != _Pubops_VerifyX509ObjWithPubEcc(cert_handle->x509, public_key)) {
+        SEC_LOG_ERROR("_Pubops_VerifyX509ObjWithPubEcc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    _Sec_CertVerifyCacheInsert(cert_handle->proc, cert_handle->object_id, cert_hash, pub_hash);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+typedef struct
+{
+    Sec_CertificateHandle *cert;
+    Sec_CertificateHandle *issuer;
+    Sec_KeyHandle *root_key;
+    Sec_Result res;
+} _Sec_CertChainLink;
+
+static void *_SecCertificate_VerifyChainLink(void *arg)
+{
+    _Sec_CertChainLink *link = (_Sec_CertChainLink *) arg;
+
+    if (NULL != link->root_key)
+    {
+        link->res = SecCertificate_Verify(link->cert, link->root_key);
+    }
+    else if (SecKey_IsPubRsa(link->issuer->pub_type))
+    {
+        link->res = SecCertificate_VerifyWithRawRSAPublicKey(link->cert, &link->issuer->rsa_pub);
+    }
+    else if (SecKey_IsPubEcc(link->issuer->pub_type))
+    {
+        link->res = SecCertificate_VerifyWithRawECCPublicKey(link->cert, &link->issuer->ecc_pub);
+    }
+    else
+    {
+        SEC_LOG_ERROR("Unsupported issuer key type");
+        link->res = SEC_RESULT_FAILURE;
+    }
+
+    return NULL;
+}
+
+static SEC_BOOL _SecCertificate_IsTimeValid(X509 *x509)
+{
+    return X509_cmp_current_time(X509_get_notBefore(x509)) < 0
+        && X509_cmp_current_time(X509_get_notAfter(x509)) > 0;
+}
+
+/*
+ * An issuer must be a CA: basicConstraints CA:TRUE, keyCertSign if keyUsage is present
+ * (both checked by X509_check_ca) and a pathLen that allows the CAs below it.
+ */
+static SEC_BOOL _SecCertificate_IsValidIssuer(X509 *x509, SEC_SIZE cas_below)
+{
+    long pathlen;
+
+    if (1 != X509_check_ca(x509))
+        return SEC_FALSE;
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    pathlen = x509->ex_pathlen;
+#else
+    pathlen = X509_get_pathlen(x509);
+#endif
+
+    return pathlen < 0 || (long) cas_below <= pathlen;
+}
+
+Sec_Result SecCertificate_VerifyChain(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID *certIds, SEC_SIZE numCerts, Sec_KeyHandle* rootKey, SEC_SIZE flags)
+{
+    Sec_CertificateHandle *certs[SEC_CERTCHAIN_MAX_LEN];
+    _Sec_CertChainLink links[SEC_CERTCHAIN_MAX_LEN];
+    pthread_t threads[SEC_CERTCHAIN_MAX_LEN];
+    SEC_BOOL started[SEC_CERTCHAIN_MAX_LEN];
+    Sec_Result res = SEC_RESULT_FAILURE;
+    SEC_SIZE i;
+
+    CHECK_HANDLE(secProcHandle);
+
+    if (NULL == certIds || numCerts == 0 || numCerts > SEC_CERTCHAIN_MAX_LEN)
+    {
+        SEC_LOG_ERROR("Invalid chain length %d", numCerts);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    memset(certs, 0, sizeof(certs));
+    memset(started, 0, sizeof(started));
+
+    /* load and parse every certificate once */
+    for (i = 0; i < numCerts; ++i)
+    {
+        res = SecCertificate_GetInstance(secProcHandle, certIds[i], &certs[i]);
+        if (SEC_RESULT_SUCCESS != res)
+        {
+            SEC_LOG_ERROR("SecCertificate_GetInstance failed for %016llx", (unsigned long long) certIds[i]);
+            certs[i] = NULL;
+            goto done;
+        }
+
+        if (SEC_RESULT_SUCCESS != _SecCertificate_Parse(certs[i]))
+        {
+            SEC_LOG_ERROR("_SecCertificate_Parse failed for %016llx", (unsigned long long) certIds[i]);
+            res = SEC_RESULT_FAILURE;
+            goto done;
+        }
+    }
+
+    /* structural checks are cheap, do them before any signature work */
+    for (i = 0; i < numCerts; ++i)
+    {
+        X509 *issuer = (i + 1 < numCerts) ? certs[i + 1]->x509 : ((NULL == rootKey) ? certs[i]->x509 : NULL);
+
+        if (NULL != issuer
+                && 0 != X509_NAME_cmp(X509_get_issuer_name(certs[i]->x509), X509_get_subject_name(issuer)))
+        {
+            SEC_LOG_ERROR("Certificate %d is not issued by the next certificate in the chain", i);
+            res = SEC_RESULT_VERIFICATION_FAILED;
+            goto done;
+        }
+
+        /* every certificate that issues another one in the chain, with i - 1 CAs below it */
+        if (i > 0 && !_SecCertificate_IsValidIssuer(certs[i]->x509, i - 1))
+        {
+            SEC_LOG_ERROR("Certificate %d is not a CA allowed to issue the certificates below it", i);
+            res = SEC_RESULT_VERIFICATION_FAILED;
+            goto done;
+        }
+
+        if (!(flags & SEC_CERTCHAIN_FLAG_IGNORE_VALIDITY) && !_SecCertificate_IsTimeValid(certs[i]->x509))
+        {
+            SEC_LOG_ERROR("Certificate %d is outside of its validity period", i);
+            res = SEC_RESULT_VERIFICATION_FAILED;
+            goto done;
+        }
+    }
+
+    for (i = 0; i < numCerts; ++i)
+    {
+        links[i].cert = certs[i];
+        links[i].issuer = (i + 1 < numCerts) ? certs[i + 1] : certs[i];
+        links[i].root_key = (i + 1 < numCerts) ? NULL : rootKey;
+        links[i].res = SEC_RESULT_FAILURE;
+    }
+
+    /* the signatures are independent of each other, check them concurrently */
+    for (i = 1; i < numCerts; ++i)
+    {
+        if ((flags & SEC_CERTCHAIN_FLAG_SEQUENTIAL)
+                || 0 != pthread_create(&threads[i], NULL, _SecCertificate_VerifyChainLink, &links[i]))
+        {
+            _SecCertificate_VerifyChainLink(&links[i]);
+            continue;
+        }
+        started[i] = SEC_TRUE;
     }
 
-    return SEC_RESULT_SUCCESS;
-}
+    _SecCertificate_VerifyChainLink(&links[0]);
 
-Sec_Result SecCertificate_VerifyWithRawECCPublicKey(
-        Sec_CertificateHandle* cert_handle, Sec_ECCRawPublicKey* public_key)
-{
-    CHECK_HANDLE(cert_handle);
-    CHECK_HANDLE(public_key);
+    res = SEC_RESULT_SUCCESS;
+    for (i = 0; i < numCerts; ++i)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
 
-    if (SEC_RESULT_SUCCESS != _Pubops_VerifyX509WithPubEcc(cert_handle->cert_data.cert, cert_handle->cert_data.cert_len, public_key)) {
-        SEC_LOG_ERROR("_Pubops_VerifyX509WithPubEcc failed");
-        return SEC_RESULT_FAILURE;
+        if (SEC_RESULT_SUCCESS != links[i].res)
+        {
+            SEC_LOG_ERROR("Signature verification failed for certificate %d", i);
+            res = SEC_RESULT_VERIFICATION_FAILED;
+        }
     }
 
-    return SEC_RESULT_SUCCESS;
+done:
+    for (i = 0; i < numCerts; ++i)
+    {
+        if (NULL != certs[i])
+            SecCertificate_Release(certs[i]);
+    }
+
+    return res;
 }
 
 Sec_Result SecCertificate_Export(Sec_CertificateHandle* cert_handle,
@@ -3899,6 +6974,7 @@ Sec_Result SecCertificate_Export(Sec_CertificateHandle* cert_handle,
 Sec_Result SecCertificate_Release(Sec_CertificateHandle* certHandle)
 {
     CHECK_HANDLE(certHandle);
+    SEC_X509_FREE(certHandle->x509);
     SEC_FREE(certHandle);
     return SEC_RESULT_SUCCESS;
 }
@@ -3908,7 +6984,7 @@ SEC_SIZE SecKey_GetKeyLen(Sec_KeyHandle *keyHandle)
     return SecKey_GetKeyLenForKeyType(keyHandle->key_data.info.key_type);
 }
 
-Sec_Result SecKey_GetInstance(Sec_ProcessorHandle* secProcHandle,
+static Sec_Result _SecKey_GetInstance(Sec_ProcessorHandle* secProcHandle,
         SEC_OBJECTID object_id, Sec_KeyHandle **keyHandle)
 {
     Sec_Result result;
@@ -3925,6 +7001,8 @@ Sec_Result SecKey_GetInstance(Sec_ProcessorHandle* secProcHandle,
     if (result != SEC_RESULT_SUCCESS)
         return result;
 
+    SEC_TRACE_KEY_LOAD(object_id, location);
+
     *keyHandle = calloc(1, sizeof(Sec_KeyHandle));
     if (NULL == *keyHandle)
     {
@@ -3939,11 +7017,77 @@ Sec_Result SecKey_GetInstance(Sec_ProcessorHandle* secProcHandle,
     return SEC_RESULT_SUCCESS;
 }
 
+static Sec_Result _SecKey_Init(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID object_id, void *storage, SEC_SIZE storageSize,
+        Sec_KeyHandle **keyHandle)
+{
+    Sec_KeyHandle *key = (Sec_KeyHandle *) storage;
+    Sec_Result result;
+
+    CHECK_HANDLE(secProcHandle);
+
+    *keyHandle = NULL;
+
+    if (object_id == SEC_OBJECTID_INVALID)
+        return SEC_RESULT_INVALID_PARAMETERS;
+
+    result = _Sec_InitHandleStorage(storage, storageSize, sizeof(Sec_KeyHandle));
+    if (result != SEC_RESULT_SUCCESS)
+        return result;
+
+    /* retrieved straight into the caller's storage */
+    result = _Sec_RetrieveKeyData(secProcHandle, object_id, &key->location,
+            &key->key_data);
+    if (result != SEC_RESULT_SUCCESS)
+        return result;
+
+    SEC_TRACE_KEY_LOAD(object_id, key->location);
+
+    key->object_id = object_id;
+    key->proc = secProcHandle;
+    *keyHandle = key;
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecKey_GetInstance(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID object_id, Sec_KeyHandle **keyHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_KEY_GETINSTANCE, object_id);
+
+    res = _SecKey_GetInstance(secProcHandle, object_id, keyHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_KEY_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_KEY_GETINSTANCE, res);
+    return res;
+}
+
+Sec_Result SecKey_Init(Sec_ProcessorHandle* secProcHandle,
+        SEC_OBJECTID object_id, void *storage, SEC_SIZE storageSize,
+        Sec_KeyHandle **keyHandle)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_KEY_GETINSTANCE, object_id);
+
+    res = _SecKey_Init(secProcHandle, object_id, storage, storageSize, keyHandle);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_KEY_GETINSTANCE, start, res, 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_KEY_GETINSTANCE, res);
+    return res;
+}
+
 Sec_Result SecKey_ExtractRSAPublicKey(Sec_KeyHandle* keyHandle,
         Sec_RSARawPublicKey *public_key)
 {
     Sec_KeyType keyType;
+    SEC_SIZE key_len;
     RSA *rsa = NULL;
+    const BIGNUM *n = NULL;
+    const BIGNUM *e = NULL;
+    Sec_Result res = SEC_RESULT_FAILURE;
 
     CHECK_HANDLE(keyHandle);
 
@@ -3962,10 +7106,42 @@ Sec_Result SecKey_ExtractRSAPublicKey(Sec_KeyHandle* keyHandle,
         return SEC_RESULT_FAILURE;
     }
 
-    SecUtils_RSAToPubBinary(rsa, public_key);
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    n = rsa->n;
+    e = rsa->e;
+#else
+    RSA_get0_key(rsa, &n, &e, NULL);
+#endif
+
+    /* a modulus with leading zero bytes is left padded to the width of the key type */
+    key_len = SecKey_GetKeyLen(keyHandle);
+    if (key_len > sizeof(public_key->n))
+    {
+        SEC_LOG_ERROR("Invalid RSA key length %d", key_len);
+        goto done;
+    }
+
+    Sec_Memset(public_key, 0, sizeof(Sec_RSARawPublicKey));
+    Sec_Uint32ToBEBytes(key_len, public_key->modulus_len_be);
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    if (SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(n, public_key->n, key_len)
+            || SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(e, public_key->e, sizeof(public_key->e)))
+#else
+    if (BN_bn2binpad(n, public_key->n, key_len) < 0
+            || BN_bn2binpad(e, public_key->e, sizeof(public_key->e)) < 0)
+#endif
+    {
+        SEC_LOG_ERROR("RSA public key does not fit the key type");
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
     SEC_RSA_FREE(rsa);
 
-    return SEC_RESULT_SUCCESS;
+    return res;
 }
 
 Sec_Result SecKey_ExtractECCPublicKey(Sec_KeyHandle* keyHandle,
@@ -4002,17 +7178,86 @@ Sec_Result SecKey_ExtractECCPublicKey(Sec_KeyHandle* keyHandle,
     return SEC_RESULT_SUCCESS;
 }
 
+Sec_Result SecKey_ExtractCurve25519PublicKey(Sec_KeyHandle* keyHandle,
+                                             SEC_BYTE *public_key)
+{
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+    EVP_PKEY *evp_key = NULL;
+    size_t len = SEC_CURVE25519_KEY_LEN;
+
+    CHECK_HANDLE(keyHandle);
+    CHECK_HANDLE(public_key);
+
+    if (!SecKey_IsCurve25519(SecKey_GetKeyType(keyHandle)))
+    {
+        SEC_LOG_ERROR("Specified key is not X25519/Ed25519");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    evp_key = _Sec_Curve25519FromKeyHandle(keyHandle);
+    if (NULL == evp_key)
+    {
+        SEC_LOG_ERROR("_Sec_Curve25519FromKeyHandle failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (1 != EVP_PKEY_get_raw_public_key(evp_key, public_key, &len) || len != SEC_CURVE25519_KEY_LEN)
+    {
+        SEC_LOG_ERROR("EVP_PKEY_get_raw_public_key failed");
+        SEC_EVPPKEY_FREE(evp_key);
+        return SEC_RESULT_FAILURE;
+    }
+    SEC_EVPPKEY_FREE(evp_key);
+
+    return SEC_RESULT_SUCCESS;
+#else
+    SEC_LOG_ERROR("X25519/Ed25519 requires OpenSSL 1.1.1 or later");
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+#endif
+}
+
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+static EVP_PKEY *_Sec_Curve25519Generate(int pkey_id)
+{
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *evp_key = NULL;
+
+    pctx = EVP_PKEY_CTX_new_id(pkey_id, NULL);
+    if (NULL == pctx || 1 != EVP_PKEY_keygen_init(pctx) || 1 != EVP_PKEY_keygen(pctx, &evp_key))
+    {
+        SEC_LOG_ERROR("EVP_PKEY_keygen failed: %s", ERR_error_string(ERR_get_error(), NULL));
+        SEC_EVPPKEY_FREE(evp_key);
+    }
+
+    if (NULL != pctx)
+        EVP_PKEY_CTX_free(pctx);
+
+    return evp_key;
+}
+#endif
+
 Sec_Result SecKey_Generate(Sec_ProcessorHandle* secProcHandle,
         SEC_OBJECTID object_id, Sec_KeyType keyType, Sec_StorageLoc location)
 {
     EC_KEY *ec_key;
-    SEC_BYTE symetric_key[SEC_SYMETRIC_KEY_MAX_LEN];
+    RSA *rsa;
+    /* the generated clear key, whatever its type */
+    SEC_BYTE *clear_key = NULL;
     Sec_Result res = SEC_RESULT_FAILURE;
-    Sec_RSARawPrivateKey rsaPrivKey;
-    Sec_ECCRawPrivateKey ecPrivKey;
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+    EVP_PKEY *evp_key;
+    size_t key_len;
+#endif
 
     CHECK_HANDLE(secProcHandle);
 
+    clear_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == clear_key)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
     switch (keyType)
     {
     case SEC_KEYTYPE_AES_128:
@@ -4020,14 +7265,14 @@ Sec_Result SecKey_Generate(Sec_ProcessorHandle* secProcHandle,
     case SEC_KEYTYPE_HMAC_128:
     case SEC_KEYTYPE_HMAC_160:
     case SEC_KEYTYPE_HMAC_256:
-        if (1 != RAND_bytes(symetric_key, SecKey_GetKeyLenForKeyType(keyType)))
+        if (1 != RAND_bytes(clear_key, SecKey_GetKeyLenForKeyType(keyType)))
         {
             SEC_LOG_ERROR("RAND_bytes failed");
             goto done;
         }
         if (SEC_RESULT_SUCCESS
                 != SecKey_Provision(secProcHandle, object_id, location,
-                        SecKey_GetClearContainer(keyType), symetric_key,
+                        SecKey_GetClearContainer(keyType), clear_key,
                         SecKey_GetKeyLenForKeyType(keyType)))
         {
             SEC_LOG_ERROR("SecKey_Provision failed");
@@ -4038,14 +7283,34 @@ Sec_Result SecKey_Generate(Sec_ProcessorHandle* secProcHandle,
     case SEC_KEYTYPE_RSA_1024:
     case SEC_KEYTYPE_RSA_2048:
     case SEC_KEYTYPE_RSA_3072:
-        SEC_LOG_ERROR("RSA keys are not supported");
-        return SEC_RESULT_FAILURE;
+        /* prime search is slow, use a pre-generated key when one is ready */
+        rsa = _SecRSAPool_Take(keyType);
+        if (NULL == rsa)
+            rsa = _Sec_RSAGenerate(keyType);
+        if (NULL == rsa)
+        {
+            SEC_LOG_ERROR("_Sec_RSAGenerate failed");
+            goto done;
+        }
+
+        /* keep the factors so that the key is loaded in CRT form */
+        SecUtils_RSAToPrivFullBinary(rsa, (Sec_RSARawPrivateFullKey*) clear_key);
+        SEC_RSA_FREE(rsa);
+
+        if (SEC_RESULT_SUCCESS
+                != SecKey_Provision(secProcHandle, object_id, location,
+                        SecKey_GetClearContainer(keyType),
+                        clear_key, sizeof(Sec_RSARawPrivateFullKey)))
+        {
+            SEC_LOG_ERROR("SecKey_Provision failed");
+            goto done;
+        }
         break;
 
     case SEC_KEYTYPE_ECC_NISTP256:
-        ec_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1); // create ec_key structure with NIST p256 curve
+        ec_key = _Sec_NewP256Key(); // create ec_key structure on the shared NIST p256 group
 
-        if (1 != EC_KEY_generate_key(ec_key))
+        if (NULL == ec_key || 1 != EC_KEY_generate_key(ec_key))
         {
             SEC_LOG_ERROR("EC_KEY_generate_key: %s",
                     ERR_error_string(ERR_get_error(), NULL));
@@ -4054,7 +7319,7 @@ Sec_Result SecKey_Generate(Sec_ProcessorHandle* secProcHandle,
 
         /* write private */
         /* we're using nist p256 so the length is 32 bytes */
-        if (SEC_RESULT_SUCCESS != SecUtils_ECCToPrivBinary(ec_key, &ecPrivKey))
+        if (SEC_RESULT_SUCCESS != SecUtils_ECCToPrivBinary(ec_key, (Sec_ECCRawPrivateKey*) clear_key))
         {
             SEC_LOG_ERROR("SecUtils_ECCToPrivBinary failed");
             goto done;
@@ -4064,12 +7329,46 @@ Sec_Result SecKey_Generate(Sec_ProcessorHandle* secProcHandle,
         if (SEC_RESULT_SUCCESS
                 != SecKey_Provision(secProcHandle, object_id, location,
                         SecKey_GetClearContainer(keyType),
-                        (SEC_BYTE*) &ecPrivKey, sizeof(ecPrivKey)))
+                        clear_key, sizeof(Sec_ECCRawPrivateKey)))
+        {
+            SEC_LOG_ERROR("SecKey_Provision failed");
+            goto done;
+        }
+        break;
+
+    case SEC_KEYTYPE_X25519:
+    case SEC_KEYTYPE_ED25519:
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+        evp_key = _Sec_Curve25519Generate(_Sec_Curve25519PKeyId(keyType));
+        if (NULL == evp_key)
+        {
+            SEC_LOG_ERROR("_Sec_Curve25519Generate failed");
+            goto done;
+        }
+
+        key_len = SEC_CURVE25519_KEY_LEN;
+        if (1 != EVP_PKEY_get_raw_private_key(evp_key, clear_key, &key_len))
+        {
+            SEC_LOG_ERROR("EVP_PKEY_get_raw_private_key failed");
+            SEC_EVPPKEY_FREE(evp_key);
+            goto done;
+        }
+        SEC_EVPPKEY_FREE(evp_key);
+
+        if (SEC_RESULT_SUCCESS
+                != SecKey_Provision(secProcHandle, object_id, location,
+                        SecKey_GetClearContainer(keyType),
+                        clear_key, SEC_CURVE25519_KEY_LEN))
         {
             SEC_LOG_ERROR("SecKey_Provision failed");
             goto done;
         }
         break;
+#else
+        SEC_LOG_ERROR("X25519/Ed25519 requires OpenSSL 1.1.1 or later");
+        res = SEC_RESULT_UNIMPLEMENTED_FEATURE;
+        goto done;
+#endif
 
         /* new: add new key types, but not public ones */
 
@@ -4081,9 +7380,7 @@ Sec_Result SecKey_Generate(Sec_ProcessorHandle* secProcHandle,
 
     res = SEC_RESULT_SUCCESS;
 done:
-    Sec_Memset(symetric_key, 0, sizeof(symetric_key));
-    Sec_Memset(&ecPrivKey, 0, sizeof(ecPrivKey));
-    Sec_Memset(&rsaPrivKey, 0, sizeof(rsaPrivKey));
+    SecArena_Free(clear_key);
 
     return res;
 }
@@ -4108,6 +7405,60 @@ Sec_Result SecKey_Provision(Sec_ProcessorHandle* secProcHandle,
     return _Sec_StoreKeyData(secProcHandle, object_id, location, &key_data);
 }
 
+Sec_Result SecKey_CreateTransient(Sec_ProcessorHandle* secProcHandle,
+        Sec_KeyContainer data_type, SEC_BYTE *data, SEC_SIZE data_len,
+        Sec_KeyHandle** keyHandle)
+{
+    Sec_KeyType key_type;
+    Sec_Result result;
+
+    CHECK_HANDLE(secProcHandle);
+
+    *keyHandle = calloc(1, sizeof(Sec_KeyHandle));
+    if (NULL == *keyHandle)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+    (*keyHandle)->object_id = SEC_OBJECTID_OPENSSL_TRANSIENT;
+    (*keyHandle)->location = SEC_STORAGELOC_RAM;
+    (*keyHandle)->proc = secProcHandle;
+
+    /* a clear symmetric key never leaves the handle, so there is nothing to wrap it for */
+    key_type = SecKey_GetKeyTypeForClearKeyContainer(data_type);
+    if (SecKey_IsSymetric(key_type))
+    {
+        if (data_len != SecKey_GetKeyLenForKeyType(key_type))
+        {
+            SEC_LOG_ERROR("Invalid key container length");
+            result = SEC_RESULT_INVALID_PARAMETERS;
+            goto error;
+        }
+
+        (*keyHandle)->key_data.info.key_type = key_type;
+        (*keyHandle)->key_data.info.kc_type = SEC_OPENSSL_KEYCONTAINER_TRANSIENT;
+        memcpy((*keyHandle)->key_data.kc.buffer, data, data_len);
+        (*keyHandle)->key_data.kc_len = data_len;
+
+        return SEC_RESULT_SUCCESS;
+    }
+
+    result = SecOpenSSL_ProcessKeyContainer(secProcHandle, &((*keyHandle)->key_data),
+            data_type, data, data_len, SEC_OBJECTID_OPENSSL_TRANSIENT);
+    if (SEC_RESULT_SUCCESS != result)
+    {
+        SEC_LOG_ERROR("SecOpenSSL_ProcessKeyContainer failed");
+        goto error;
+    }
+
+    return SEC_RESULT_SUCCESS;
+
+error:
+    SecKey_Release(*keyHandle);
+    *keyHandle = NULL;
+    return result;
+}
+
 Sec_Result SecKey_Delete(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID object_id)
 {
     char file_name[SEC_MAX_FILE_PATH_LEN];
@@ -4119,6 +7470,10 @@ Sec_Result SecKey_Delete(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID object
 
     CHECK_HANDLE(secProcHandle);
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(SEC_PUBOPS_TOMCRYPT)
+    _SecProvider_DropKey(secProcHandle, object_id);
+#endif
+
     /* ram */
     _Sec_FindRAMKeyData(secProcHandle, object_id, &ram_key, &ram_key_parent);
     if (ram_key != NULL)
@@ -4170,6 +7525,7 @@ Sec_Result SecKey_ExportKey(Sec_KeyHandle* keyHandle, SEC_BYTE* derivationInput,
 {
     Sec_Result res = SEC_RESULT_FAILURE;
     _ExportedHeader header;
+    SEC_BYTE *key_data = NULL;
 
     *keyBytesWritten = 0;
 
@@ -4190,11 +7546,16 @@ Sec_Result SecKey_ExportKey(Sec_KeyHandle* keyHandle, SEC_BYTE* derivationInput,
         goto done;
     }
 
-    SEC_BYTE key_data[SEC_KEYCONTAINER_MAX_LEN];
+    key_data = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == key_data) {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     SEC_SIZE key_data_len;
     if (SecKey_IsSymetric(keyHandle->key_data.info.key_type)) {
         SEC_SIZE wr;
-        if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(keyHandle, key_data, sizeof(key_data), &wr))
+        if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(keyHandle, key_data, SEC_KEYCONTAINER_MAX_LEN, &wr))
         {
             SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
             goto done;
@@ -4207,9 +7568,14 @@ Sec_Result SecKey_ExportKey(Sec_KeyHandle* keyHandle, SEC_BYTE* derivationInput,
             goto done;
         }
 
-        SecUtils_RSAToPrivBinary(rsa_key, (Sec_RSARawPrivateKey *) key_data);
-
-        key_data_len = sizeof(Sec_ECCRawPrivateKey);
+        if (_Sec_RSAHasFactors(rsa_key)) {
+            SecUtils_RSAToPrivFullBinary(rsa_key, (Sec_RSARawPrivateFullKey *) key_data);
+            key_data_len = sizeof(Sec_RSARawPrivateFullKey);
+        } else {
+            SecUtils_RSAToPrivBinary(rsa_key, (Sec_RSARawPrivateKey *) key_data);
+            key_data_len = sizeof(Sec_RSARawPrivateKey);
+        }
+        SEC_RSA_FREE(rsa_key);
     } else {
         EC_KEY *ec_key = _Sec_ECCFromKeyHandle(keyHandle);
         if (ec_key == NULL) {
@@ -4234,19 +7600,93 @@ Sec_Result SecKey_ExportKey(Sec_KeyHandle* keyHandle, SEC_BYTE* derivationInput,
         SEC_LOG_ERROR("_store_exported failed");
         goto done;
     }
-
-    if (exportedKey != NULL) {
-        if (keyBufferLen < *keyBytesWritten) {
-            SEC_LOG_ERROR("Output buffer is too small, required %d", *keyBytesWritten);
+
+    if (exportedKey != NULL) {
+        if (keyBufferLen < *keyBytesWritten) {
+            SEC_LOG_ERROR("Output buffer is too small, required %d", *keyBytesWritten);
+            goto done;
+        }
+
+        memcpy(exportedKey, local_exported, *keyBytesWritten);
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SecArena_Free(key_data);
+    return res;
+}
+
+Sec_Result SecKey_Pin(Sec_KeyHandle* keyHandle)
+{
+    _Sec_PinnedKey *pinned = NULL;
+    BN_CTX *bn_ctx = NULL;
+    Sec_KeyType key_type;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    CHECK_HANDLE(keyHandle);
+
+    if (NULL != keyHandle->pinned)
+        return SEC_RESULT_SUCCESS;
+
+    key_type = SecKey_GetKeyType(keyHandle);
+    if (!SecKey_IsRsa(key_type) && !SecKey_IsEcc(key_type))
+    {
+        SEC_LOG_ERROR("Only RSA and ECC keys can be pinned");
+        return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+    }
+
+    pinned = calloc(1, sizeof(_Sec_PinnedKey));
+    if (NULL == pinned)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecKey_GetProperties(keyHandle, &pinned->props))
+    {
+        SEC_LOG_ERROR("SecKey_GetProperties failed");
+        goto done;
+    }
+
+    if (SecKey_IsRsa(key_type))
+    {
+        pinned->rsa = _Sec_RSAFromKeyHandle(keyHandle);
+        if (NULL == pinned->rsa)
+        {
+            SEC_LOG_ERROR("_Sec_RSAFromKeyHandle failed");
+            goto done;
+        }
+    }
+
+    if (SecKey_IsPrivRsa(key_type))
+    {
+        /* set up blinding now instead of on the first private key operation */
+        bn_ctx = BN_CTX_new();
+        if (NULL == bn_ctx || 1 != RSA_blinding_on(pinned->rsa, bn_ctx))
+        {
+            SEC_LOG_ERROR("RSA_blinding_on failed");
+            goto done;
+        }
+    }
+    else if (SecKey_IsEcc(key_type))
+    {
+        pinned->ec_key = _Sec_ECCFromKeyHandle(keyHandle);
+        if (NULL == pinned->ec_key)
+        {
+            SEC_LOG_ERROR("_Sec_ECCFromKeyHandle failed");
             goto done;
         }
-
-        memcpy(exportedKey, local_exported, *keyBytesWritten);
     }
 
+    keyHandle->pinned = pinned;
+    pinned = NULL;
     res = SEC_RESULT_SUCCESS;
 
 done:
+    BN_CTX_free(bn_ctx);
+    _Sec_UnpinKey(pinned);
+
     return res;
 }
 
@@ -4254,11 +7694,33 @@ Sec_Result SecKey_Release(Sec_KeyHandle* keyHandle)
 {
     CHECK_HANDLE(keyHandle);
 
+    _Sec_UnpinKey(keyHandle->pinned);
+    keyHandle->pinned = NULL;
+
+    if (keyHandle->object_id == SEC_OBJECTID_OPENSSL_TRANSIENT)
+        Sec_Memset(&keyHandle->key_data.kc, 0, keyHandle->key_data.kc_len);
+
     SEC_FREE(keyHandle);
 
     return SEC_RESULT_SUCCESS;
 }
 
+Sec_Result SecKey_Cleanup(Sec_KeyHandle* keyHandle)
+{
+    CHECK_HANDLE(keyHandle);
+
+    _Sec_UnpinKey(keyHandle->pinned);
+    keyHandle->pinned = NULL;
+
+    if (keyHandle->object_id == SEC_OBJECTID_OPENSSL_TRANSIENT)
+        Sec_Memset(&keyHandle->key_data.kc, 0, keyHandle->key_data.kc_len);
+
+    keyHandle->object_id = SEC_OBJECTID_INVALID;
+    keyHandle->proc = NULL;
+
+    return SEC_RESULT_SUCCESS;
+}
+
 Sec_KeyType _Sec_GetOutputMacKeyType(Sec_MacAlgorithm alg)
 {
     switch (alg)
@@ -4458,10 +7920,11 @@ Sec_Result SecKey_Derive_HKDF(Sec_ProcessorHandle* secProcHandle,
 
     Sec_Result res = SEC_RESULT_FAILURE;
     SEC_BYTE secret[16];
+    SEC_BYTE *out_key = NULL;
 
-    SEC_OBJECTID idDerived = SecKey_ObtainFreeObjectId(secProcHandle, SEC_OBJECTID_RESERVED_BASE, SEC_OBJECTID_RESERVED_TOP);
+    SEC_OBJECTID idDerived = _Sec_ReservedIdAcquire(secProcHandle);
     if (idDerived == SEC_OBJECTID_INVALID) {
-        SEC_LOG_ERROR("SecKey_ObtainFreeObjectId failed");
+        SEC_LOG_ERROR("_Sec_ReservedIdAcquire failed");
         goto done;
     }
 
@@ -4475,7 +7938,12 @@ Sec_Result SecKey_Derive_HKDF(Sec_ProcessorHandle* secProcHandle,
         goto done;
     }
 
-    SEC_BYTE out_key[SEC_KEYCONTAINER_MAX_LEN];
+    out_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == out_key) {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     SEC_BYTE out_key_len = SecKey_GetKeyLenForKeyType(type_derived);
     if (1 != _HKDF(out_key, out_key_len, secret, sizeof(secret), salt, saltSize, info, infoSize, macAlgorithm)) {
         SEC_LOG_ERROR("_HKDF failed");
@@ -4490,11 +7958,12 @@ Sec_Result SecKey_Derive_HKDF(Sec_ProcessorHandle* secProcHandle,
     res = SEC_RESULT_SUCCESS;
 
 done:
-    Sec_Memset(out_key, 0, sizeof(out_key));
+    SecArena_Free(out_key);
     Sec_Memset(secret, 0, sizeof(secret));
 
     if (idDerived != SEC_OBJECTID_INVALID) {
         SecKey_Delete(secProcHandle, idDerived);
+        _Sec_ReservedIdRelease(secProcHandle, idDerived);
     }
 
     return res;
@@ -4576,10 +8045,11 @@ Sec_Result SecKey_Derive_ConcatKDF(Sec_ProcessorHandle* secProcHandle,
 
     Sec_Result res = SEC_RESULT_FAILURE;
     SEC_BYTE secret[16];
+    SEC_BYTE *out_key = NULL;
 
-    SEC_OBJECTID idDerived = SecKey_ObtainFreeObjectId(secProcHandle, SEC_OBJECTID_RESERVED_BASE, SEC_OBJECTID_RESERVED_TOP);
+    SEC_OBJECTID idDerived = _Sec_ReservedIdAcquire(secProcHandle);
     if (idDerived == SEC_OBJECTID_INVALID) {
-        SEC_LOG_ERROR("SecKey_ObtainFreeObjectId failed");
+        SEC_LOG_ERROR("_Sec_ReservedIdAcquire failed");
         goto done;
     }
 
@@ -4593,7 +8063,12 @@ Sec_Result SecKey_Derive_ConcatKDF(Sec_ProcessorHandle* secProcHandle,
         goto done;
     }
 
-    SEC_BYTE out_key[SEC_KEYCONTAINER_MAX_LEN];
+    out_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == out_key) {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     SEC_BYTE out_key_length = SecKey_GetKeyLenForKeyType(type_derived);
     if (SEC_RESULT_SUCCESS != _ConcatKDF(secProcHandle,
             secret, sizeof(secret),
@@ -4610,11 +8085,12 @@ Sec_Result SecKey_Derive_ConcatKDF(Sec_ProcessorHandle* secProcHandle,
     res = SEC_RESULT_SUCCESS;
 
 done:
-    Sec_Memset(out_key, 0, sizeof(out_key));
+    SecArena_Free(out_key);
     Sec_Memset(secret, 0, sizeof(secret));
 
     if (idDerived != SEC_OBJECTID_INVALID) {
         SecKey_Delete(secProcHandle, idDerived);
+        _Sec_ReservedIdRelease(secProcHandle, idDerived);
     }
 
     return res;
@@ -4637,7 +8113,7 @@ Sec_Result SecKey_Derive_PBEKDF(Sec_ProcessorHandle* secProcHandle,
     SEC_SIZE mac1_len;
     SEC_SIZE mac2_len;
     SEC_SIZE cp_len;
-    SEC_BYTE out_key[SEC_AES_KEY_MAX_LEN];
+    SEC_BYTE *out_key = NULL;
     Sec_MacHandle *mac_handle = NULL;
     Sec_KeyHandle *base_key = NULL;
 
@@ -4647,6 +8123,13 @@ Sec_Result SecKey_Derive_PBEKDF(Sec_ProcessorHandle* secProcHandle,
         return SEC_RESULT_INVALID_PARAMETERS;
     }
 
+    out_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == out_key)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
     /* provision base key */
     CHECK_EXACT(_Sec_ProvisionBaseKey(secProcHandle, nonce), SEC_RESULT_SUCCESS,
             error);
@@ -4666,7 +8149,7 @@ Sec_Result SecKey_Derive_PBEKDF(Sec_ProcessorHandle* secProcHandle,
     {
         loop[3] = i;
 
-        if (i == l) {
+        if (i == l && key_length % digest_length != 0) {
             cp_len = key_length % digest_length;
         }
         else {
@@ -4725,7 +8208,7 @@ Sec_Result SecKey_Derive_PBEKDF(Sec_ProcessorHandle* secProcHandle,
             SecKey_Provision(secProcHandle, object_id_derived, loc_derived, SecKey_GetClearContainer(type_derived), out_key, key_length),
             SEC_RESULT_SUCCESS, error);
 
-    Sec_Memset(out_key, 0, sizeof(out_key));
+    SecArena_Free(out_key);
 
     return SEC_RESULT_SUCCESS;
 
@@ -4733,6 +8216,10 @@ Sec_Result SecKey_Derive_PBEKDF(Sec_ProcessorHandle* secProcHandle,
         SecMac_Release(mac_handle, mac1, &mac1_len);
     if (base_key != NULL)
         SecKey_Release(base_key);
+    SecArena_Free(out_key);
+    Sec_Memset(mac1, 0, sizeof(mac1));
+    Sec_Memset(mac2, 0, sizeof(mac2));
+    Sec_Memset(out, 0, sizeof(out));
 
     return SEC_RESULT_FAILURE;
 }
@@ -4811,12 +8298,11 @@ Sec_Result SecKey_Derive_CMAC_AES128(
     SEC_BYTE *counter,
     SEC_SIZE counterSize)
 {
-    SEC_BYTE full_key[16*4];
+    SEC_BYTE *full_key = NULL;
     SEC_SIZE key_length;
     SEC_SIZE mac_length = 16;
     Sec_KeyHandle *base_key = NULL;
     Sec_MacHandle *macHandle = NULL;
-    SEC_BYTE out_key[SEC_SYMETRIC_KEY_MAX_LEN];
     Sec_Result res = SEC_RESULT_FAILURE;
 
     if (!SecKey_IsSymetric(typeDerived)) {
@@ -4846,6 +8332,12 @@ Sec_Result SecKey_Derive_CMAC_AES128(
         return SEC_RESULT_INVALID_PARAMETERS;
     }
 
+    full_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == full_key) {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     CHECK_EXACT(SecKey_GetInstance(secProcHandle, derivationKey, &base_key), SEC_RESULT_SUCCESS, done);
 
     SEC_BYTE i;
@@ -4862,24 +8354,22 @@ Sec_Result SecKey_Derive_CMAC_AES128(
         macHandle = NULL;
     }
 
-    //slice
-    memcpy(out_key, full_key + ((*counter - 1) * 16), key_length);
-
-    /* store key */
+    /* store the slice selected by the counter */
     CHECK_EXACT(
-            SecKey_Provision(secProcHandle, idDerived, locDerived, SecKey_GetClearContainer(typeDerived), out_key, key_length),
+            SecKey_Provision(secProcHandle, idDerived, locDerived, SecKey_GetClearContainer(typeDerived), full_key + ((*counter - 1) * 16), key_length),
             SEC_RESULT_SUCCESS, done);
 
     res = SEC_RESULT_SUCCESS;
 
 done:
-    Sec_Memset(out_key, 0, sizeof(out_key));
     if (base_key != NULL)
         SecKey_Release(base_key);
 
     if (macHandle != NULL)
         SecMac_Release(macHandle, full_key, &key_length);
 
+    SecArena_Free(full_key);
+
     return res;
 }
 
@@ -4893,35 +8383,19 @@ Sec_KeyType SecKey_GetKeyType(Sec_KeyHandle* keyHandle)
 
 Sec_KeyType SecCertificate_GetKeyType(Sec_CertificateHandle* cert_handle)
 {
-    Sec_RSARawPublicKey pub_rsa;
-    if (SEC_RESULT_SUCCESS == _Pubops_ExtractRSAPubFromX509Der(cert_handle->cert_data.cert, cert_handle->cert_data.cert_len, &pub_rsa)) {
-        switch (Sec_BEBytesToUint32(pub_rsa.modulus_len_be)) {
-            case 128:
-                return SEC_KEYTYPE_RSA_1024_PUBLIC;
-            case 256:
-                return SEC_KEYTYPE_RSA_2048_PUBLIC;
-            case 384:
-                return SEC_KEYTYPE_RSA_3072_PUBLIC;
-            default:
-                SEC_LOG_ERROR("Invalid RSA modulus size encountered: %d", Sec_BEBytesToUint32(pub_rsa.modulus_len_be));
-                return SEC_KEYTYPE_NUM;
-        }
-    }
-
-    Sec_ECCRawPublicKey pub_ecc;
-    if (SEC_RESULT_SUCCESS == _Pubops_ExtractECCPubFromX509Der(cert_handle->cert_data.cert, cert_handle->cert_data.cert_len, &pub_ecc)) {
-        return SEC_KEYTYPE_ECC_NISTP256_PUBLIC;
+    if (SEC_RESULT_SUCCESS != _SecCertificate_Parse(cert_handle) || cert_handle->pub_type == SEC_KEYTYPE_NUM) {
+        SEC_LOG_ERROR("Could not find valid pub key in the certificate");
+        return SEC_KEYTYPE_NUM;
     }
 
-    SEC_LOG_ERROR("Could not find valid pub key in the certificate");
-    return SEC_KEYTYPE_NUM;
+    return cert_handle->pub_type;
 }
 
 Sec_Result SecKey_ComputeBaseKeyDigest(Sec_ProcessorHandle* secProcHandle, SEC_BYTE *nonce,
         Sec_DigestAlgorithm alg, SEC_BYTE *digest, SEC_SIZE *digest_len)
 {
     Sec_KeyHandle *base_key = NULL;
-    SEC_BYTE base_key_clear[SEC_SYMETRIC_KEY_MAX_LEN];
+    SEC_BYTE *base_key_clear = NULL;
     SEC_SIZE base_key_len;
     Sec_Result res;
 
@@ -4945,12 +8419,21 @@ Sec_Result SecKey_ComputeBaseKeyDigest(Sec_ProcessorHandle* secProcHandle, SEC_B
     }
 
     base_key_len = SecKey_GetKeyLen(base_key);
+    base_key_clear = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == base_key_clear)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        SecKey_Release(base_key);
+        return SEC_RESULT_FAILURE;
+    }
+
     SEC_SIZE wr;
-    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(base_key, base_key_clear, sizeof(base_key_clear), &wr))
+    if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyHandle(base_key, base_key_clear, SEC_KEYCONTAINER_MAX_LEN, &wr))
     {
         SEC_LOG_ERROR("_Sec_SymetricFromKeyHandle failed");
         SecKey_Release(base_key);
         base_key = NULL;
+        SecArena_Free(base_key_clear);
         return SEC_RESULT_FAILURE;
     }
     SecKey_Release(base_key);
@@ -4958,7 +8441,7 @@ Sec_Result SecKey_ComputeBaseKeyDigest(Sec_ProcessorHandle* secProcHandle, SEC_B
 
     res = SecDigest_SingleInput(secProcHandle, alg, base_key_clear, base_key_len, digest, digest_len);
 
-    Sec_Memset(base_key_clear, 0, sizeof(base_key_clear));
+    SecArena_Free(base_key_clear);
 
     return res;
 }
@@ -5010,93 +8493,80 @@ Sec_ProcessorHandle* SecKey_GetProcessor(Sec_KeyHandle* key)
  * The otherInfo is protocol dependent, and is therefore an input to the API.
  * For unit tests, can define this a priori.
  */
-Sec_Result SecKey_ECDHKeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
-        Sec_ECCRawPublicKey* otherPublicKey, Sec_KeyType type_derived,
-        SEC_OBJECTID id_derived, Sec_StorageLoc loc_derived,
-        Sec_Kdf kdf,
-        Sec_DigestAlgorithm digestAlgorithm, SEC_BYTE *otherInfo,
-        SEC_SIZE otherInfoSize)
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+static Sec_Result _Sec_X25519Derive(EVP_PKEY *priv, SEC_BYTE *otherPublicKey,
+        SEC_SIZE otherPublicKeySize, SEC_BYTE *secret, SEC_SIZE secret_len,
+        SEC_SIZE *written)
 {
-    EC_POINT *shared_secret = NULL;
     Sec_Result res = SEC_RESULT_FAILURE;
-    BN_CTX *ctx = BN_CTX_new();
-    EC_GROUP *group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
-    EC_POINT *other_ecpoint = EC_POINT_new(group);
-    BIGNUM *b1 = BN_new();
-    BIGNUM *b2 = BN_new();
-    Sec_DigestHandle *digestHandle = NULL;
-    Sec_KeyHandle *base_key = NULL;
-
-    if (kdf != SEC_KDF_CONCAT) {
-        SEC_LOG_ERROR("Invalid kdf parameter encountered: %d", kdf);
-        return SEC_RESULT_INVALID_PARAMETERS;
-    }
-
-    if (otherPublicKey->type != SEC_KEYTYPE_ECC_NISTP256_PUBLIC &&
-            otherPublicKey->type != SEC_KEYTYPE_ECC_NISTP256)
-    {
-        SEC_LOG_ERROR("Can only exchange ECC keys");
-        return SEC_RESULT_INVALID_PARAMETERS;
-    }
+    EVP_PKEY *peer = NULL;
+    EVP_PKEY_CTX *pctx = NULL;
+    size_t len = secret_len;
 
-    if (!SecKey_IsSymetric(type_derived))
+    if (otherPublicKeySize != SEC_CURVE25519_KEY_LEN)
     {
-        SEC_LOG_ERROR("Can only derive symetric keys");
+        SEC_LOG_ERROR("Invalid X25519 public key length: %d", otherPublicKeySize);
         return SEC_RESULT_INVALID_PARAMETERS;
     }
 
-    // Convert otherPublicKey's X and Y into an EC_POINT
-    if (0 == EC_POINT_set_affine_coordinates_GFp(group, other_ecpoint,
-                                                 BN_bin2bn(otherPublicKey->x, Sec_BEBytesToUint32(otherPublicKey->key_len), b1),
-                                                 BN_bin2bn(otherPublicKey->y, Sec_BEBytesToUint32(otherPublicKey->key_len), b2), ctx))
+    peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, otherPublicKey, otherPublicKeySize);
+    if (NULL == peer)
     {
-        SEC_LOG_ERROR("EC_POINT_set_affine_coordinates_GFp failed: %s",
-                      ERR_error_string(ERR_get_error(), NULL));
+        SEC_LOG_ERROR("EVP_PKEY_new_raw_public_key failed");
         goto done;
     }
 
-    const BIGNUM *our_priv = EC_KEY_get0_private_key(_Sec_ECCFromKeyHandle(keyHandle));
-    if (NULL == our_priv)
+    /* EVP_PKEY_derive rejects the all-zero output of small order points */
+    pctx = EVP_PKEY_CTX_new(priv, NULL);
+    if (NULL == pctx || 1 != EVP_PKEY_derive_init(pctx)
+            || 1 != EVP_PKEY_derive_set_peer(pctx, peer)
+            || 1 != EVP_PKEY_derive(pctx, secret, &len))
     {
-        SEC_LOG_ERROR("No private key is set in the ec_key");
+        SEC_LOG_ERROR("EVP_PKEY_derive failed: %s", ERR_error_string(ERR_get_error(), NULL));
         goto done;
     }
 
-    shared_secret = EC_POINT_new(group);
-    EC_POINT_mul(group, shared_secret, NULL, other_ecpoint, our_priv, ctx);
-
-    // Extract the X coordinate from the shared_secret EC point.
-    // It is the shared secret value
-    if (!EC_POINT_get_affine_coordinates_GF2m(group, shared_secret, b1, NULL, ctx)) {
-        SEC_LOG_ERROR("EC_POINT_get_affine_coordinates_GF2m failed");
-        goto done;
-    }
-
-    // convert the shared secret to an array and then provision it as an AES 256 bit key
-    unsigned char x_coord_as_array[SEC_ECC_NISTP256_KEY_LEN];
+    *written = (SEC_SIZE) len;
+    res = SEC_RESULT_SUCCESS;
 
-    if (SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(b1, x_coord_as_array, sizeof(x_coord_as_array))) {
-        SEC_LOG_ERROR("SecUtils_BigNumToBuffer failed");
-        goto done;
-    }
+done:
+    if (NULL != pctx)
+        EVP_PKEY_CTX_free(pctx);
+    SEC_EVPPKEY_FREE(peer);
+    return res;
+}
+#endif
 
+/* Concat KDF (SP800-56A Section 5.8.1) over a raw shared secret, provisioning the result */
+static Sec_Result _Sec_ConcatKdfProvision(Sec_ProcessorHandle *proc,
+        SEC_BYTE *secret, SEC_SIZE secret_len, Sec_KeyType type_derived,
+        SEC_OBJECTID id_derived, Sec_StorageLoc loc_derived,
+        Sec_DigestAlgorithm digestAlgorithm, SEC_BYTE *otherInfo,
+        SEC_SIZE otherInfoSize)
+{
+    Sec_Result res = SEC_RESULT_FAILURE;
+    Sec_DigestHandle *digestHandle = NULL;
+    SEC_BYTE digestStorage[SEC_DIGESTHANDLE_STORAGE_SIZE] __attribute__((aligned(SEC_HANDLE_STORAGE_ALIGN)));
+    Sec_KeyHandle *base_key = NULL;
     int i;
     SEC_BYTE counter[] = { 0, 0, 0, 0 };  // used as a 32 bit integer in the key
     SEC_BYTE hash[SEC_DIGEST_MAX_LEN];
     SEC_SIZE key_length;
     SEC_SIZE digest_length;
     int num_blocks;
-    SEC_BYTE out_key[SEC_SYMETRIC_KEY_MAX_LEN];
+    SEC_BYTE *out_key = NULL;
+
+    out_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == out_key)
+    {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        return SEC_RESULT_FAILURE;
+    }
 
-    // Assumes sizeof SEC_KEYCONTAINER_RAW_AES_256 == SEC_ECC_NISTP256_KEY_LEN
-    CHECK_EXACT(SecKey_Provision(keyHandle->proc,
-                       SEC_OBJECTID_OPENSSL_DERIVE_TMP, SEC_STORAGELOC_RAM,
-                       SEC_KEYCONTAINER_RAW_AES_256,
-                       x_coord_as_array, sizeof x_coord_as_array),
+    // Assumes sizeof SEC_KEYCONTAINER_RAW_AES_256 == secret_len
+    CHECK_EXACT(SecKey_CreateTransient(proc, SEC_KEYCONTAINER_RAW_AES_256,
+                       secret, secret_len, &base_key),
                        SEC_RESULT_SUCCESS, done);
-    CHECK_EXACT(SecKey_GetInstance(keyHandle->proc,
-            SEC_OBJECTID_OPENSSL_DERIVE_TMP, &base_key),
-            SEC_RESULT_SUCCESS, done);
 
     key_length = SecKey_GetKeyLenForKeyType(type_derived);
     digest_length = SecDigest_GetDigestLenForAlgorithm(digestAlgorithm);
@@ -5109,7 +8579,8 @@ Sec_Result SecKey_ECDHKeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
     {
         counter[3] = i;      // update counter as a 32-bit big endian int
 
-        CHECK_EXACT(SecDigest_GetInstance(keyHandle->proc, digestAlgorithm, &digestHandle),
+        CHECK_EXACT(SecDigest_Init(proc, digestAlgorithm, digestStorage,
+                    sizeof(digestStorage), &digestHandle),
                     SEC_RESULT_SUCCESS, done);
         CHECK_EXACT(SecDigest_UpdateWithKey(digestHandle, base_key),
                     SEC_RESULT_SUCCESS, done);
@@ -5119,9 +8590,9 @@ Sec_Result SecKey_ECDHKeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
                     SEC_RESULT_SUCCESS, done);
 
         if (SEC_RESULT_SUCCESS
-                != SecDigest_Release(digestHandle, hash, &digest_length))
+                != SecDigest_Cleanup(digestHandle, hash, &digest_length))
         {
-            SEC_LOG_ERROR("SecDigest_Release failed");
+            SEC_LOG_ERROR("SecDigest_Cleanup failed");
             digestHandle = NULL;
             goto done;
         }
@@ -5140,7 +8611,7 @@ Sec_Result SecKey_ECDHKeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
     }
 
     /* store key */
-    CHECK_EXACT(SecKey_Provision(keyHandle->proc, id_derived, loc_derived,
+    CHECK_EXACT(SecKey_Provision(proc, id_derived, loc_derived,
                                  SecKey_GetClearContainer(type_derived), out_key,
                                  key_length),
                 SEC_RESULT_SUCCESS, done);
@@ -5148,27 +8619,191 @@ Sec_Result SecKey_ECDHKeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
     res = SEC_RESULT_SUCCESS;
 
   done:
-    Sec_Memset(out_key, 0, sizeof(out_key));
-    if (b2 != NULL)
-        BN_free(b2);
+    SecArena_Free(out_key);
+    if (base_key != NULL)
+        SecKey_Release(base_key);
+    if (digestHandle != NULL)
+        SecDigest_Cleanup(digestHandle, hash, &digest_length);
+    Sec_Memset(hash, 0, sizeof(hash));
+
+    return res;
+}
+
+Sec_Result SecKey_ECDHKeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
+        Sec_ECCRawPublicKey* otherPublicKey, Sec_KeyType type_derived,
+        SEC_OBJECTID id_derived, Sec_StorageLoc loc_derived,
+        Sec_Kdf kdf,
+        Sec_DigestAlgorithm digestAlgorithm, SEC_BYTE *otherInfo,
+        SEC_SIZE otherInfoSize)
+{
+    EC_POINT *shared_secret = NULL;
+    Sec_Result res = SEC_RESULT_FAILURE;
+    const EC_GROUP *group = NULL;
+    EC_POINT *other_ecpoint = NULL;
+    EC_KEY *our_key = NULL;
+    BN_CTX *ctx = NULL;
+    BIGNUM *b1 = NULL;
+    unsigned char x_coord_as_array[SEC_ECC_NISTP256_KEY_LEN];
+
+    CHECK_HANDLE(keyHandle);
+
+    if (kdf != SEC_KDF_CONCAT) {
+        SEC_LOG_ERROR("Invalid kdf parameter encountered: %d", kdf);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (otherPublicKey->type != SEC_KEYTYPE_ECC_NISTP256_PUBLIC &&
+            otherPublicKey->type != SEC_KEYTYPE_ECC_NISTP256)
+    {
+        SEC_LOG_ERROR("Can only exchange ECC keys");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (!SecKey_IsSymetric(type_derived))
+    {
+        SEC_LOG_ERROR("Can only derive symetric keys");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    Sec_Memset(x_coord_as_array, 0, sizeof(x_coord_as_array));
+
+    group = _Sec_P256Group();
+    ctx = BN_CTX_new();
+    b1 = BN_new();
+    if (NULL == group || NULL == ctx || NULL == b1)
+    {
+        SEC_LOG_ERROR("Allocation failed");
+        goto done;
+    }
+
+    // Convert otherPublicKey's X and Y into an EC_POINT
+    other_ecpoint = _Sec_P256PointFromPubBinary(otherPublicKey, ctx);
+    if (NULL == other_ecpoint)
+    {
+        SEC_LOG_ERROR("_Sec_P256PointFromPubBinary failed");
+        goto done;
+    }
+
+    our_key = _Sec_ECCFromKeyHandle(keyHandle);
+    if (NULL == our_key || NULL == EC_KEY_get0_private_key(our_key))
+    {
+        SEC_LOG_ERROR("No private key is set in the ec_key");
+        goto done;
+    }
+
+    shared_secret = EC_POINT_new(group);
+    if (NULL == shared_secret
+            || 1 != EC_POINT_mul(group, shared_secret, NULL, other_ecpoint, EC_KEY_get0_private_key(our_key), ctx))
+    {
+        SEC_LOG_ERROR("EC_POINT_mul failed");
+        goto done;
+    }
+
+    // Extract the X coordinate from the shared_secret EC point.
+    // It is the shared secret value
+    if (!EC_POINT_get_affine_coordinates_GFp(group, shared_secret, b1, NULL, ctx)) {
+        SEC_LOG_ERROR("EC_POINT_get_affine_coordinates_GFp failed");
+        goto done;
+    }
+
+    // convert the shared secret to an array and then run it through the KDF
+    if (SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(b1, x_coord_as_array, sizeof(x_coord_as_array))) {
+        SEC_LOG_ERROR("SecUtils_BigNumToBuffer failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_ConcatKdfProvision(keyHandle->proc,
+            x_coord_as_array, sizeof(x_coord_as_array), type_derived, id_derived,
+            loc_derived, digestAlgorithm, otherInfo, otherInfoSize))
+    {
+        SEC_LOG_ERROR("_Sec_ConcatKdfProvision failed");
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+  done:
+    Sec_Memset(x_coord_as_array, 0, sizeof(x_coord_as_array));
     if (b1 != NULL)
-        BN_free(b1);
+        BN_clear_free(b1);
     if (other_ecpoint != NULL)
         EC_POINT_free(other_ecpoint);
     if (shared_secret != NULL)
-        EC_POINT_free(shared_secret);
-    if (group != NULL)
-        EC_GROUP_free(group);
+        EC_POINT_clear_free(shared_secret);
+    SEC_ECC_FREE(our_key);
     if (ctx != NULL)
         BN_CTX_free(ctx);
-    if (base_key != NULL)
-        SecKey_Release(base_key);
-    if (digestHandle != NULL)
-        SecDigest_Release(digestHandle, hash, &digest_length);
 
     return res;
 }
 
+Sec_Result SecKey_X25519KeyAgreementWithKDF(Sec_KeyHandle *keyHandle,
+        SEC_BYTE* otherPublicKey, SEC_SIZE otherPublicKeySize,
+        Sec_KeyType type_derived, SEC_OBJECTID id_derived,
+        Sec_StorageLoc loc_derived, Sec_Kdf kdf,
+        Sec_DigestAlgorithm digestAlgorithm, SEC_BYTE *otherInfo,
+        SEC_SIZE otherInfoSize)
+{
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+    Sec_Result res = SEC_RESULT_FAILURE;
+    EVP_PKEY *priv = NULL;
+    SEC_BYTE shared_secret[SEC_CURVE25519_KEY_LEN];
+    SEC_SIZE shared_secret_len = 0;
+
+    CHECK_HANDLE(keyHandle);
+    CHECK_HANDLE(otherPublicKey);
+
+    if (kdf != SEC_KDF_CONCAT) {
+        SEC_LOG_ERROR("Invalid kdf parameter encountered: %d", kdf);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (SecKey_GetKeyType(keyHandle) != SEC_KEYTYPE_X25519)
+    {
+        SEC_LOG_ERROR("Can only exchange X25519 keys");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (!SecKey_IsSymetric(type_derived))
+    {
+        SEC_LOG_ERROR("Can only derive symetric keys");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    priv = _Sec_Curve25519FromKeyHandle(keyHandle);
+    if (NULL == priv)
+    {
+        SEC_LOG_ERROR("_Sec_Curve25519FromKeyHandle failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_X25519Derive(priv, otherPublicKey, otherPublicKeySize,
+            shared_secret, sizeof(shared_secret), &shared_secret_len))
+    {
+        SEC_LOG_ERROR("_Sec_X25519Derive failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != _Sec_ConcatKdfProvision(keyHandle->proc,
+            shared_secret, shared_secret_len, type_derived, id_derived,
+            loc_derived, digestAlgorithm, otherInfo, otherInfoSize))
+    {
+        SEC_LOG_ERROR("_Sec_ConcatKdfProvision failed");
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    Sec_Memset(shared_secret, 0, sizeof(shared_secret));
+    SEC_EVPPKEY_FREE(priv);
+    return res;
+#else
+    SEC_LOG_ERROR("X25519 requires OpenSSL 1.1.1 or later");
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+#endif
+}
+
 Sec_Result SecBundle_GetInstance(Sec_ProcessorHandle* secProcHandle,
         SEC_OBJECTID object_id, Sec_BundleHandle **bundleHandle)
 {
@@ -5320,18 +8955,26 @@ Sec_Result SecKey_GetProperties(Sec_KeyHandle *keyHandle, Sec_KeyProperties *key
 {
     Sec_Result result = SEC_RESULT_FAILURE;
 
+    SEC_BYTE *key = NULL;
+
     memset(keyProps,0,sizeof(Sec_KeyProperties));
 
     if (keyHandle->key_data.info.kc_type == SEC_KEYCONTAINER_JTYPE) {
-        SEC_BYTE wrappedKey[SEC_KEYCONTAINER_MAX_LEN];
         SEC_SIZE written = 0;
         Sec_CipherAlgorithm wrappingAlg;
         SEC_BYTE iv[SEC_AES_BLOCK_SIZE];
 
+        key = (SEC_BYTE *) SecArena_Alloc();
+        if (NULL == key)
+        {
+            SEC_LOG_ERROR("SecArena_Alloc failed");
+            goto done;
+        }
+
         if (SEC_RESULT_SUCCESS != SecJType_ProcessKey(keyHandle->proc,
                 SEC_OBJECTID_COMCAST_XCALSESSIONMACKEY,
-                keyHandle->key_data.kc.buffer, keyHandle->key_data.kc_len, wrappedKey,
-                sizeof(wrappedKey), &written, keyProps,
+                keyHandle->key_data.kc.buffer, keyHandle->key_data.kc_len, key,
+                SEC_KEYCONTAINER_MAX_LEN, &written, keyProps,
                 &wrappingAlg, iv))
         {
             SEC_LOG_ERROR("SecJType_ProcessKey failed");
@@ -5339,15 +8982,21 @@ Sec_Result SecKey_GetProperties(Sec_KeyHandle *keyHandle, Sec_KeyProperties *key
         }
     } else if (keyHandle->key_data.info.kc_type == SEC_KEYCONTAINER_EXPORTED) {
         _ExportedHeader header;
-        SEC_BYTE skb[SEC_KEYCONTAINER_MAX_LEN];
         SEC_SIZE skb_len;
 
+        key = (SEC_BYTE *) SecArena_Alloc();
+        if (NULL == key)
+        {
+            SEC_LOG_ERROR("SecArena_Alloc failed");
+            goto done;
+        }
+
         if (SEC_RESULT_SUCCESS != _load_exported(keyHandle->proc,
                         &header,
-                        skb, sizeof(skb), &skb_len,
+                        key, SEC_KEYCONTAINER_MAX_LEN, &skb_len,
                         keyHandle->key_data.kc.buffer, keyHandle->key_data.kc_len)) {
             SEC_LOG_ERROR("_load_exported failed");
-            return SEC_RESULT_FAILURE;
+            goto done;
         }
 
         memcpy(keyProps, &header.properties, sizeof(Sec_KeyProperties));
@@ -5358,6 +9007,7 @@ Sec_Result SecKey_GetProperties(Sec_KeyHandle *keyHandle, Sec_KeyProperties *key
     result = SEC_RESULT_SUCCESS;
 
 done:
+    SecArena_Free(key);
     return result;
 }
 
@@ -5517,7 +9167,7 @@ Sec_Result SecSVP_SetTime(time_t time) {
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecCipher_ProcessOpaque(Sec_CipherHandle* cipherHandle,
+static Sec_Result _SecCipher_ProcessOpaque(Sec_CipherHandle* cipherHandle,
         Sec_OpaqueBufferHandle* inputHandle, Sec_OpaqueBufferHandle* outputHandle,
         SEC_SIZE inputSize, SEC_BOOL lastInput, SEC_SIZE *bytesWritten)
 {
@@ -5545,6 +9195,21 @@ done:
     return result;
 }
 
+Sec_Result SecCipher_ProcessOpaque(Sec_CipherHandle* cipherHandle,
+        Sec_OpaqueBufferHandle* inputHandle, Sec_OpaqueBufferHandle* outputHandle,
+        SEC_SIZE inputSize, SEC_BOOL lastInput, SEC_SIZE *bytesWritten)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_PROCESS, SEC_TRACE_KEY_ID(NULL != cipherHandle ? cipherHandle->key_handle : NULL));
+
+    res = _SecCipher_ProcessOpaque(cipherHandle, inputHandle, outputHandle, inputSize, lastInput, bytesWritten);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_PROCESS, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_PROCESS, res);
+    return res;
+}
+
 static Sec_Result _SecCipher_ProcessCtrWithDataShift(Sec_CipherHandle* cipherHandle, SEC_BYTE* input,
         SEC_SIZE inputSize, SEC_BYTE* output, SEC_SIZE outputSize, SEC_SIZE *bytesWritten,
         SEC_SIZE dataShift, SEC_BOOL isOpaqueBuffer) {
@@ -5605,12 +9270,20 @@ Sec_Result SecCipher_ProcessCtrWithDataShift(Sec_CipherHandle* cipherHandle, SEC
         SEC_SIZE inputSize, SEC_BYTE* output, SEC_SIZE outputSize, SEC_SIZE *bytesWritten,
         SEC_SIZE dataShift)
 {
-    return _SecCipher_ProcessCtrWithDataShift(cipherHandle, input, inputSize, output, outputSize,
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_PROCESS, SEC_TRACE_KEY_ID(NULL != cipherHandle ? cipherHandle->key_handle : NULL));
+
+    res = _SecCipher_ProcessCtrWithDataShift(cipherHandle, input, inputSize, output, outputSize,
             bytesWritten, dataShift, SEC_FALSE);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_PROCESS, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_PROCESS, res);
+    return res;
 }
 
 
-Sec_Result SecCipher_ProcessCtrWithOpaqueDataShift(Sec_CipherHandle* cipherHandle, Sec_OpaqueBufferHandle* inputHandle, Sec_OpaqueBufferHandle* outputHandle, SEC_SIZE inputSize, SEC_SIZE *bytesWritten, SEC_SIZE dataShift) {
+static Sec_Result _SecCipher_ProcessCtrWithOpaqueDataShift(Sec_CipherHandle* cipherHandle, Sec_OpaqueBufferHandle* inputHandle, Sec_OpaqueBufferHandle* outputHandle, SEC_SIZE inputSize, SEC_SIZE *bytesWritten, SEC_SIZE dataShift) {
     Sec_Result result = SEC_RESULT_FAILURE;
 
     if (NULL == inputHandle)
@@ -5635,6 +9308,19 @@ done:
     return result;
 }
 
+Sec_Result SecCipher_ProcessCtrWithOpaqueDataShift(Sec_CipherHandle* cipherHandle, Sec_OpaqueBufferHandle* inputHandle, Sec_OpaqueBufferHandle* outputHandle, SEC_SIZE inputSize, SEC_SIZE *bytesWritten, SEC_SIZE dataShift)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_CIPHER_PROCESS, SEC_TRACE_KEY_ID(NULL != cipherHandle ? cipherHandle->key_handle : NULL));
+
+    res = _SecCipher_ProcessCtrWithOpaqueDataShift(cipherHandle, inputHandle, outputHandle, inputSize, bytesWritten, dataShift);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_CIPHER_PROCESS, start, res, inputSize);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_CIPHER_PROCESS, res);
+    return res;
+}
+
 Sec_Result SecCipher_KeyCheckOpaque(Sec_CipherHandle* cipherHandle, Sec_OpaqueBufferHandle* inputHandle,
         SEC_SIZE checkLength, SEC_BYTE* expected)
 {
@@ -5719,11 +9405,256 @@ static DH* _DH_create(SEC_BYTE *p, SEC_SIZE p_len, SEC_BYTE *g, SEC_SIZE g_len)
     return dh;
 }
 
-static Sec_Result _DH_generate_key(DH* dh, SEC_BYTE* publicKey, SEC_SIZE pubKeySize) {
-    if (!DH_generate_key(dh)) {
-        SEC_LOG_ERROR("DH_generate_key failed");
-        DH_free(dh);
-        return SEC_RESULT_FAILURE;
+static EC_GROUP *g_p256_group = NULL;
+static pthread_once_t g_p256_group_once = PTHREAD_ONCE_INIT;
+
+static void _Sec_P256GroupInit(void)
+{
+    EC_GROUP *group = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1);
+
+    if (NULL == group)
+    {
+        SEC_LOG_ERROR("EC_GROUP_new_by_curve_name failed");
+        return;
+    }
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+    /* generator table, shared by every EC_KEY duplicated from this group */
+    if (1 != EC_GROUP_precompute_mult(group, NULL))
+    {
+        SEC_LOG_ERROR("EC_GROUP_precompute_mult failed");
+    }
+#endif
+
+    g_p256_group = group;
+}
+
+const EC_GROUP *_Sec_P256Group(void)
+{
+    pthread_once(&g_p256_group_once, _Sec_P256GroupInit);
+    return g_p256_group;
+}
+
+EC_KEY *_Sec_NewP256Key(void)
+{
+    const EC_GROUP *group = _Sec_P256Group();
+    EC_KEY *ec_key = NULL;
+
+    if (NULL == group)
+        return NULL;
+
+    ec_key = EC_KEY_new();
+    if (NULL == ec_key || 1 != EC_KEY_set_group(ec_key, group))
+    {
+        SEC_LOG_ERROR("EC_KEY_set_group failed");
+        SEC_ECC_FREE(ec_key);
+    }
+
+    return ec_key;
+}
+
+EC_POINT *_Sec_P256PointFromPubBinary(const Sec_ECCRawPublicKey *binary, BN_CTX *ctx)
+{
+    const EC_GROUP *group = _Sec_P256Group();
+    EC_POINT *point = NULL;
+    BIGNUM *x = NULL;
+    BIGNUM *y = NULL;
+
+    if (NULL == group)
+        return NULL;
+
+    if ((binary->type != SEC_KEYTYPE_ECC_NISTP256_PUBLIC && binary->type != SEC_KEYTYPE_ECC_NISTP256)
+            || Sec_BEBytesToUint32((SEC_BYTE *) binary->key_len) != SEC_ECC_NISTP256_KEY_LEN)
+    {
+        SEC_LOG_ERROR("Not a P-256 public key");
+        return NULL;
+    }
+
+    BN_CTX_start(ctx);
+    x = BN_CTX_get(ctx);
+    y = BN_CTX_get(ctx);
+    point = EC_POINT_new(group);
+
+    if (NULL == y || NULL == point
+            || NULL == BN_bin2bn(binary->x, SEC_ECC_NISTP256_KEY_LEN, x)
+            || NULL == BN_bin2bn(binary->y, SEC_ECC_NISTP256_KEY_LEN, y)
+            || 1 != EC_POINT_set_affine_coordinates_GFp(group, point, x, y, ctx)
+            || 1 != EC_POINT_is_on_curve(group, point, ctx))
+    {
+        SEC_LOG_ERROR("Invalid P-256 public key");
+        if (NULL != point)
+            EC_POINT_free(point);
+        point = NULL;
+    }
+
+    BN_CTX_end(ctx);
+    return point;
+}
+
+static _Sec_DHParamsEntry g_dh_params[SEC_DH_PARAMS_CACHE_SIZE];
+static SEC_SIZE g_dh_params_num = 0;
+static pthread_mutex_t g_dh_params_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+const _Sec_DHParamsEntry *_Sec_DHParamsGet(const Sec_DHParameters *params)
+{
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    SEC_BYTE len_be[4];
+    SHA256_CTX sha;
+    _Sec_DHParamsEntry *entry = NULL;
+    BN_CTX *ctx = NULL;
+    SEC_SIZE i;
+
+    if (params->pLen > sizeof(params->p) || params->gLen > sizeof(params->g))
+        return NULL;
+
+    SHA256_Init(&sha);
+    Sec_Uint32ToBEBytes(params->pLen, len_be);
+    SHA256_Update(&sha, len_be, sizeof(len_be));
+    SHA256_Update(&sha, params->p, params->pLen);
+    Sec_Uint32ToBEBytes(params->gLen, len_be);
+    SHA256_Update(&sha, len_be, sizeof(len_be));
+    SHA256_Update(&sha, params->g, params->gLen);
+    SHA256_Final(hash, &sha);
+
+    pthread_mutex_lock(&g_dh_params_mutex);
+
+    for (i = 0; i < g_dh_params_num; ++i)
+    {
+        if (0 == memcmp(g_dh_params[i].hash, hash, sizeof(hash)))
+        {
+            entry = &g_dh_params[i];
+            SEC_STATS_CACHE(SEC_STATS_CACHE_DH_PARAMS, SEC_TRUE);
+            goto done;
+        }
+    }
+
+    SEC_STATS_CACHE(SEC_STATS_CACHE_DH_PARAMS, SEC_FALSE);
+
+    if (g_dh_params_num >= SEC_DH_PARAMS_CACHE_SIZE)
+        goto done;
+
+    entry = &g_dh_params[g_dh_params_num];
+    memset(entry, 0, sizeof(_Sec_DHParamsEntry));
+
+    entry->params = _DH_create((SEC_BYTE *) params->p, params->pLen, (SEC_BYTE *) params->g, params->gLen);
+    entry->mont_p = BN_MONT_CTX_new();
+    ctx = BN_CTX_new();
+    if (NULL == entry->params || NULL == entry->mont_p || NULL == ctx)
+    {
+        SEC_LOG_ERROR("DH parameter cache allocation failed");
+        goto fail;
+    }
+
+    {
+        const BIGNUM *p = NULL;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        p = entry->params->p;
+#else
+        DH_get0_pqg(entry->params, &p, NULL, NULL);
+#endif
+        if (NULL == p || BN_is_zero(p) || !BN_is_odd(p) || 1 != BN_MONT_CTX_set(entry->mont_p, p, ctx))
+        {
+            SEC_LOG_ERROR("BN_MONT_CTX_set failed");
+            goto fail;
+        }
+    }
+
+    memcpy(entry->hash, hash, sizeof(hash));
+    g_dh_params_num++;
+    goto done;
+
+fail:
+    if (NULL != entry->params)
+        DH_free(entry->params);
+    if (NULL != entry->mont_p)
+        BN_MONT_CTX_free(entry->mont_p);
+    memset(entry, 0, sizeof(_Sec_DHParamsEntry));
+    entry = NULL;
+
+done:
+    pthread_mutex_unlock(&g_dh_params_mutex);
+    if (NULL != ctx)
+        BN_CTX_free(ctx);
+    return entry;
+}
+
+Sec_Result _Sec_DHGenerateKey(const _Sec_DHParamsEntry *entry, DH *dh)
+{
+    const BIGNUM *p = NULL;
+    const BIGNUM *g = NULL;
+    BIGNUM *priv_key = BN_new();
+    BIGNUM *pub_key = BN_new();
+    BN_CTX *ctx = BN_CTX_new();
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    p = entry->params->p;
+    g = entry->params->g;
+#else
+    DH_get0_pqg(entry->params, &p, NULL, &g);
+#endif
+
+    if (NULL == priv_key || NULL == pub_key || NULL == ctx)
+    {
+        SEC_LOG_ERROR("BN_new failed");
+        goto done;
+    }
+
+    /* same private exponent size as DH_generate_key without a length set */
+#if OPENSSL_VERSION_NUMBER < 0x10101000L
+    if (1 != BN_rand(priv_key, BN_num_bits(p) - 1, 0, 0))
+#else
+    if (1 != BN_priv_rand(priv_key, BN_num_bits(p) - 1, BN_RAND_TOP_ONE, BN_RAND_BOTTOM_ANY))
+#endif
+    {
+        SEC_LOG_ERROR("BN_priv_rand failed");
+        goto done;
+    }
+
+    if (1 != BN_mod_exp_mont_consttime(pub_key, g, priv_key, p, ctx, entry->mont_p))
+    {
+        SEC_LOG_ERROR("BN_mod_exp_mont_consttime failed");
+        goto done;
+    }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    BN_clear_free(dh->priv_key);
+    BN_free(dh->pub_key);
+    dh->priv_key = priv_key;
+    dh->pub_key = pub_key;
+#else
+    if (1 != DH_set0_key(dh, pub_key, priv_key))
+    {
+        SEC_LOG_ERROR("DH_set0_key failed");
+        goto done;
+    }
+#endif
+    priv_key = NULL;
+    pub_key = NULL;
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    if (NULL != priv_key)
+        BN_clear_free(priv_key);
+    if (NULL != pub_key)
+        BN_free(pub_key);
+    if (NULL != ctx)
+        BN_CTX_free(ctx);
+    return res;
+}
+
+static Sec_Result _DH_generate_key(DH* dh, const _Sec_DHParamsEntry *entry, SEC_BOOL pregenerated, SEC_BYTE* publicKey, SEC_SIZE pubKeySize) {
+    if (!pregenerated) {
+        if (entry != NULL) {
+            /* reuses the cached Montgomery context of p */
+            if (SEC_RESULT_SUCCESS != _Sec_DHGenerateKey(entry, dh)) {
+                SEC_LOG_ERROR("_Sec_DHGenerateKey failed");
+                return SEC_RESULT_FAILURE;
+            }
+        } else if (!DH_generate_key(dh)) {
+            SEC_LOG_ERROR("DH_generate_key failed");
+            return SEC_RESULT_FAILURE;
+        }
     }
 
     const BIGNUM *pub_key = NULL;
@@ -5746,7 +9677,58 @@ static Sec_Result _DH_generate_key(DH* dh, SEC_BYTE* publicKey, SEC_SIZE pubKeyS
     return SEC_RESULT_SUCCESS;
 }
 
-static Sec_Result _DH_compute(DH* dh, SEC_BYTE* pub_key, SEC_SIZE pub_key_len, SEC_BYTE* key, SEC_SIZE key_len, SEC_SIZE* written) {
+static int _DH_compute_cached(DH* dh, const _Sec_DHParamsEntry *entry, BIGNUM *pub_key_bn, SEC_BYTE* key) {
+    const BIGNUM *p = NULL;
+    const BIGNUM *priv_key = NULL;
+    BIGNUM *secret = NULL;
+    BN_CTX *ctx = NULL;
+    int codes = 0;
+    int written = -1;
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    p = entry->params->p;
+    priv_key = dh->priv_key;
+#else
+    DH_get0_pqg(entry->params, &p, NULL, NULL);
+    DH_get0_key(dh, NULL, &priv_key);
+#endif
+
+    if (priv_key == NULL) {
+        SEC_LOG_ERROR("No DH private key, call SecKeyExchange_GenerateKeys first");
+        return -1;
+    }
+
+    /* same peer key checks as DH_compute_key */
+    if (!DH_check_pub_key(entry->params, pub_key_bn, &codes) || codes != 0) {
+        SEC_LOG_ERROR("Invalid DH public key");
+        return -1;
+    }
+
+    secret = BN_new();
+    ctx = BN_CTX_new();
+    if (secret == NULL || ctx == NULL) {
+        SEC_LOG_ERROR("BN_new failed");
+        goto done;
+    }
+
+    if (1 != BN_mod_exp_mont_consttime(secret, pub_key_bn, priv_key, p, ctx, entry->mont_p)) {
+        SEC_LOG_ERROR("BN_mod_exp_mont_consttime failed");
+        goto done;
+    }
+
+    written = BN_bn2bin(secret, key);
+
+done:
+    if (secret != NULL)
+        BN_clear_free(secret);
+    if (ctx != NULL)
+        BN_CTX_free(ctx);
+    return written;
+}
+
+static Sec_Result _DH_compute(DH* dh, const _Sec_DHParamsEntry *entry, SEC_BYTE* pub_key, SEC_SIZE pub_key_len, SEC_BYTE* key, SEC_SIZE key_len, SEC_SIZE* written) {
+    int res;
+
     if (key_len < (SEC_SIZE) DH_size(dh)) {
         SEC_LOG_ERROR("key_len is not large enough to hold the computed DH key: %d", DH_size(dh));
         return SEC_RESULT_FAILURE;
@@ -5758,21 +9740,36 @@ static Sec_Result _DH_compute(DH* dh, SEC_BYTE* pub_key, SEC_SIZE pub_key_len, S
         return SEC_RESULT_FAILURE;
     }
 
-    *written = DH_compute_key(key, pub_key_bn, dh);
+    if (entry != NULL) {
+        res = _DH_compute_cached(dh, entry, pub_key_bn, key);
+    } else {
+        res = DH_compute_key(key, pub_key_bn, dh);
+    }
     BN_free(pub_key_bn);
     pub_key_bn = NULL;
-    if (*written <= 0) {
+    if (res <= 0) {
         SEC_LOG_ERROR("DH_compute_key failed");
         return SEC_RESULT_FAILURE;
     }
+    *written = res;
 
     return SEC_RESULT_SUCCESS;
 }
 
 Sec_KeyExchangeHandle* _DH_GetInstance(Sec_ProcessorHandle* proc, Sec_DHParameters *params) {
     Sec_KeyExchangeHandle *handle = NULL;
+    SEC_BOOL pregenerated = SEC_TRUE;
+    const _Sec_DHParamsEntry *entry = _Sec_DHParamsGet(params);
 
-    DH *dh = _DH_create(params->p, params->pLen, params->g, params->gLen);
+    DH *dh = (DH *) _SecKeyPool_Take(SEC_KEYEXCHANGE_DH, params);
+    if (dh == NULL) {
+        pregenerated = SEC_FALSE;
+        if (entry != NULL) {
+            dh = DHparams_dup(entry->params);
+        } else {
+            dh = _DH_create(params->p, params->pLen, params->g, params->gLen);
+        }
+    }
     if (dh == NULL) {
         SEC_LOG_ERROR("_generateDH failed");
         goto done;
@@ -5787,8 +9784,10 @@ Sec_KeyExchangeHandle* _DH_GetInstance(Sec_ProcessorHandle* proc, Sec_DHParamete
     memset(handle, 0, sizeof(Sec_KeyExchangeHandle));
 
     handle->dh = dh;
+    handle->dh_params = entry;
     handle->proc = proc;
     handle->alg = SEC_KEYEXCHANGE_DH;
+    handle->pregenerated = pregenerated;
 
 done:
     if (handle == NULL) {
@@ -5799,11 +9798,16 @@ done:
 
 static Sec_KeyExchangeHandle* _ECDH_GetInstance(Sec_ProcessorHandle* proc, EC_PARAMETERS *params) {
     Sec_KeyExchangeHandle *handle = NULL;
-    EC_KEY *key = NULL;
+    SEC_BOOL pregenerated = SEC_TRUE;
+    EC_KEY *key = (EC_KEY *) _SecKeyPool_Take(SEC_KEYEXCHANGE_ECDH, NULL);
 
-    /* Create an Elliptic Curve Key object and set it up to use the ANSI X9.62 Prime 256v1 curve */
-    if(NULL == (key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1))) {
-        SEC_LOG_ERROR("EC_KEY_new_by_curve_name failed");
+    if (NULL == key) {
+        pregenerated = SEC_FALSE;
+        /* Create an Elliptic Curve Key object on the shared ANSI X9.62 Prime 256v1 group */
+        key = _Sec_NewP256Key();
+    }
+    if (NULL == key) {
+        SEC_LOG_ERROR("_Sec_NewP256Key failed");
         goto done;
     }
 
@@ -5818,6 +9822,7 @@ static Sec_KeyExchangeHandle* _ECDH_GetInstance(Sec_ProcessorHandle* proc, EC_PA
     handle->ecdh_priv = key;
     handle->proc = proc;
     handle->alg = SEC_KEYEXCHANGE_ECDH;
+    handle->pregenerated = pregenerated;
 
 done:
     if (NULL == handle) {
@@ -5827,14 +9832,14 @@ done:
     return handle;
 }
 
-static Sec_Result _ECDH_generate_key(EC_KEY *priv, SEC_BYTE* publicKey, SEC_SIZE pubKeySize) {
+static Sec_Result _ECDH_generate_key(EC_KEY *priv, SEC_BOOL pregenerated, SEC_BYTE* publicKey, SEC_SIZE pubKeySize) {
     if (pubKeySize != sizeof(Sec_ECCRawPublicKey)) {
         SEC_LOG_ERROR("pub key size does not match the size of Sec_ECCRawPublicKey");
         return SEC_RESULT_FAILURE;
     }
 
     //generate ephemeral ec key
-    if (1 != EC_KEY_generate_key(priv)) {
+    if (!pregenerated && 1 != EC_KEY_generate_key(priv)) {
         SEC_LOG_ERROR("EC_KEY_generate_key failed");
         return SEC_RESULT_FAILURE;
     }
@@ -5850,39 +9855,102 @@ static Sec_Result _ECDH_generate_key(EC_KEY *priv, SEC_BYTE* publicKey, SEC_SIZE
 
 static Sec_Result _ECDH_compute(EC_KEY *priv, SEC_BYTE* pub_key, SEC_SIZE pub_key_len, SEC_BYTE* key, SEC_SIZE key_len, SEC_SIZE* written) {
     Sec_Result res = SEC_RESULT_FAILURE;
-    EC_KEY *ec_key_pub = NULL;
+    EC_POINT *pub_point = NULL;
+    BN_CTX *ctx = NULL;
+    int len;
 
     if (pub_key_len != sizeof(Sec_ECCRawPublicKey)) {
         SEC_LOG_ERROR("pub_key_len does not match size of Sec_ECCRawPublicKey");
         goto done;
     }
 
-    ec_key_pub = SecUtils_ECCFromPubBinary((Sec_ECCRawPublicKey*) pub_key);
-    if (ec_key_pub == NULL) {
-        SEC_LOG_ERROR("SecUtils_ECCFromPubBinary failed");
+    ctx = BN_CTX_new();
+    if (ctx == NULL) {
+        SEC_LOG_ERROR("BN_CTX_new failed");
+        goto done;
+    }
+
+    pub_point = _Sec_P256PointFromPubBinary((Sec_ECCRawPublicKey*) pub_key, ctx);
+    if (pub_point == NULL) {
+        SEC_LOG_ERROR("_Sec_P256PointFromPubBinary failed");
         goto done;
     }
 
     /* Derive the shared secret */
-    *written = ECDH_compute_key(key, key_len, EC_KEY_get0_public_key(ec_key_pub), priv, NULL);
-    if (*written <= 0) {
+    len = ECDH_compute_key(key, key_len, pub_point, priv, NULL);
+    if (len <= 0) {
         SEC_LOG_ERROR("ECDH_compute_key failed");
         goto done;
     }
+    *written = len;
 
     res = SEC_RESULT_SUCCESS;
 
 done:
-    SEC_ECC_FREE(ec_key_pub);
+    if (pub_point != NULL)
+        EC_POINT_free(pub_point);
+    if (ctx != NULL)
+        BN_CTX_free(ctx);
 
     return res;
 }
 
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+static Sec_KeyExchangeHandle* _X25519_GetInstance(Sec_ProcessorHandle* proc) {
+    Sec_KeyExchangeHandle *handle = NULL;
+
+    handle = malloc(sizeof(Sec_KeyExchangeHandle));
+    if (handle == NULL) {
+        SEC_LOG_ERROR("malloc failed");
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(Sec_KeyExchangeHandle));
+
+    handle->proc = proc;
+    handle->alg = SEC_KEYEXCHANGE_X25519;
+    handle->x25519_priv = (EVP_PKEY *) _SecKeyPool_Take(SEC_KEYEXCHANGE_X25519, NULL);
+    handle->pregenerated = handle->x25519_priv != NULL;
+
+    return handle;
+}
+
+static Sec_Result _X25519_generate_key(Sec_KeyExchangeHandle* handle, SEC_BOOL pregenerated, SEC_BYTE* publicKey, SEC_SIZE pubKeySize) {
+    size_t len = pubKeySize;
+
+    if (pubKeySize != SEC_CURVE25519_KEY_LEN) {
+        SEC_LOG_ERROR("pub key size does not match SEC_CURVE25519_KEY_LEN");
+        return SEC_RESULT_FAILURE;
+    }
+
+    //generate ephemeral x25519 key
+    if (!pregenerated) {
+        SEC_EVPPKEY_FREE(handle->x25519_priv);
+        handle->x25519_priv = _Sec_Curve25519Generate(EVP_PKEY_X25519);
+        if (handle->x25519_priv == NULL) {
+            SEC_LOG_ERROR("_Sec_Curve25519Generate failed");
+            return SEC_RESULT_FAILURE;
+        }
+    }
+
+    if (1 != EVP_PKEY_get_raw_public_key(handle->x25519_priv, publicKey, &len)) {
+        SEC_LOG_ERROR("EVP_PKEY_get_raw_public_key failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+#endif
+
 Sec_Result SecKeyExchange_GetInstance(Sec_ProcessorHandle* proc, Sec_KeyExchangeAlgorithm exchangeType, void* exchangeParameters, Sec_KeyExchangeHandle** keyExchangeHandle) {
     CHECK_HANDLE(proc);
-    CHECK_HANDLE(exchangeParameters);
     CHECK_HANDLE(keyExchangeHandle);
 
+    /* X25519 has a single fixed curve and takes no parameters */
+    if (exchangeType != SEC_KEYEXCHANGE_X25519) {
+        CHECK_HANDLE(exchangeParameters);
+    }
+
     *keyExchangeHandle = NULL;
 
     switch (exchangeType) {
@@ -5900,6 +9968,18 @@ Sec_Result SecKeyExchange_GetInstance(Sec_ProcessorHandle* proc, Sec_KeyExchange
             }
             break;
 
+        case SEC_KEYEXCHANGE_X25519:
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+            *keyExchangeHandle = _X25519_GetInstance(proc);
+            if (*keyExchangeHandle == NULL) {
+                SEC_LOG_ERROR("_X25519_GetInstance failed");
+            }
+#else
+            SEC_LOG_ERROR("X25519 requires OpenSSL 1.1.1 or later");
+            return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+#endif
+            break;
+
         default:
             SEC_LOG_ERROR("Unknown exchange_type encountered: %d", exchangeType);
             break;
@@ -5909,24 +9989,39 @@ Sec_Result SecKeyExchange_GetInstance(Sec_ProcessorHandle* proc, Sec_KeyExchange
 }
 
 Sec_Result SecKeyExchange_GenerateKeys(Sec_KeyExchangeHandle* keyExchangeHandle, SEC_BYTE* publicKey, SEC_SIZE pubKeySize) {
+    SEC_BOOL pregenerated;
+
     CHECK_HANDLE(keyExchangeHandle);
     CHECK_HANDLE(publicKey);
 
+    /* a key pair taken from the pool by GetInstance serves the first call */
+    pregenerated = keyExchangeHandle->pregenerated;
+    keyExchangeHandle->pregenerated = SEC_FALSE;
+
     switch (keyExchangeHandle->alg) {
         case SEC_KEYEXCHANGE_DH:
-            if (SEC_RESULT_SUCCESS != _DH_generate_key(keyExchangeHandle->dh, publicKey, pubKeySize)) {
+            if (SEC_RESULT_SUCCESS != _DH_generate_key(keyExchangeHandle->dh, keyExchangeHandle->dh_params, pregenerated, publicKey, pubKeySize)) {
                 SEC_LOG_ERROR("_DH_generate_key failed");
                 return SEC_RESULT_FAILURE;
             }
             break;
 
         case SEC_KEYEXCHANGE_ECDH:
-            if (SEC_RESULT_SUCCESS != _ECDH_generate_key(keyExchangeHandle->ecdh_priv, publicKey, pubKeySize)) {
+            if (SEC_RESULT_SUCCESS != _ECDH_generate_key(keyExchangeHandle->ecdh_priv, pregenerated, publicKey, pubKeySize)) {
                 SEC_LOG_ERROR("_ECDH_generate_key failed");
                 return SEC_RESULT_FAILURE;
             }
             break;
 
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+        case SEC_KEYEXCHANGE_X25519:
+            if (SEC_RESULT_SUCCESS != _X25519_generate_key(keyExchangeHandle, pregenerated, publicKey, pubKeySize)) {
+                SEC_LOG_ERROR("_X25519_generate_key failed");
+                return SEC_RESULT_FAILURE;
+            }
+            break;
+#endif
+
         default:
             SEC_LOG_ERROR("unknown alg encountered: %d", keyExchangeHandle->alg);
             return SEC_RESULT_FAILURE;
@@ -5950,7 +10045,7 @@ Sec_Result SecKeyExchange_ComputeSecret(Sec_KeyExchangeHandle* keyExchangeHandle
 
     switch (keyExchangeHandle->alg) {
         case SEC_KEYEXCHANGE_DH:
-            if (SEC_RESULT_SUCCESS != _DH_compute(keyExchangeHandle->dh, otherPublicKey, otherPublicKeySize, shared_secret, sizeof(shared_secret), &shared_secret_written)) {
+            if (SEC_RESULT_SUCCESS != _DH_compute(keyExchangeHandle->dh, keyExchangeHandle->dh_params, otherPublicKey, otherPublicKeySize, shared_secret, sizeof(shared_secret), &shared_secret_written)) {
                 SEC_LOG_ERROR("_DH_generate_key failed");
                 return SEC_RESULT_FAILURE;
             }
@@ -5963,6 +10058,20 @@ Sec_Result SecKeyExchange_ComputeSecret(Sec_KeyExchangeHandle* keyExchangeHandle
             }
             break;
 
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+        case SEC_KEYEXCHANGE_X25519:
+            if (keyExchangeHandle->x25519_priv == NULL) {
+                SEC_LOG_ERROR("SecKeyExchange_GenerateKeys has not been called");
+                return SEC_RESULT_FAILURE;
+            }
+
+            if (SEC_RESULT_SUCCESS != _Sec_X25519Derive(keyExchangeHandle->x25519_priv, otherPublicKey, otherPublicKeySize, shared_secret, sizeof(shared_secret), &shared_secret_written)) {
+                SEC_LOG_ERROR("_Sec_X25519Derive failed");
+                return SEC_RESULT_FAILURE;
+            }
+            break;
+#endif
+
         default:
             SEC_LOG_ERROR("unknown alg encountered: %d", keyExchangeHandle->alg);
             return SEC_RESULT_FAILURE;
@@ -5997,6 +10106,10 @@ Sec_Result SecKeyExchange_Release(Sec_KeyExchangeHandle* keyExchangeHandle) {
                 SEC_ECC_FREE(keyExchangeHandle->ecdh_priv);
                 break;
 
+            case SEC_KEYEXCHANGE_X25519:
+                SEC_EVPPKEY_FREE(keyExchangeHandle->x25519_priv);
+                break;
+
             default:
                 SEC_LOG_ERROR("unknown alg encountered: %d", keyExchangeHandle->alg);
                 return SEC_RESULT_FAILURE;
@@ -6024,7 +10137,7 @@ Sec_Result SecKey_Derive_BaseKey(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTI
     SEC_SIZE cipher_output_len;
     SEC_BYTE cipher_output[SEC_SYMETRIC_KEY_MAX_LEN];
     SEC_BYTE *cipher_key = secProcHandle->root_key;
-    SEC_OBJECTID temp_key_id = SEC_OBJECTID_INVALID;
+    Sec_KeyHandle *temp_key = NULL;
     SEC_BYTE c1[SEC_SYMETRIC_KEY_MAX_LEN];
     SEC_BYTE c2[SEC_SYMETRIC_KEY_MAX_LEN];
     SEC_BYTE c3[SEC_SYMETRIC_KEY_MAX_LEN];
@@ -6044,25 +10157,23 @@ Sec_Result SecKey_Derive_BaseKey(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTI
     for (i = 1; i <= 4; i++)
     {
         /* encrypt digest */
-        temp_key_id = SEC_OBJECTID_OPENSSL_DERIVE_TMP;
-
-        /* provision temp key */
-        res = SecKey_Provision(secProcHandle, temp_key_id, SEC_STORAGELOC_RAM, SEC_KEYCONTAINER_RAW_AES_128, cipher_key, keySize);
+        res = SecKey_CreateTransient(secProcHandle, SEC_KEYCONTAINER_RAW_AES_128, cipher_key, keySize, &temp_key);
         if (SEC_RESULT_SUCCESS != res)
         {
-            SEC_LOG_ERROR("SecKey_Provision failed");
+            SEC_LOG_ERROR("SecKey_CreateTransient failed");
             goto done;
         }
 
-        res = SecCipher_SingleInputId(secProcHandle, cipherAlgorithm, cipherMode, temp_key_id, NULL,
+        res = SecCipher_SingleInput(secProcHandle, cipherAlgorithm, cipherMode, temp_key, NULL,
                 c[i-1], keySize, cipher_output, sizeof(cipher_output), &cipher_output_len);
 
-        /* delete temp key */
-        SecKey_Delete(secProcHandle, temp_key_id);
+        /* release temp key */
+        SecKey_Release(temp_key);
+        temp_key = NULL;
 
         if (SEC_RESULT_SUCCESS != res)
         {
-            SEC_LOG_ERROR("SecCipher_SingleInputId failed");
+            SEC_LOG_ERROR("SecCipher_SingleInput failed");
             goto done;
         }
 
@@ -6088,16 +10199,24 @@ Sec_Result SecKey_Derive_HKDF_BaseKey(Sec_ProcessorHandle* secProcHandle, SEC_OB
         return SEC_RESULT_FAILURE;
     }
 
+    Sec_Result res = SEC_RESULT_FAILURE;
+    SEC_BYTE *out_key = NULL;
+
     //get secret from base key
     SEC_BYTE secret[16];
 
     if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyId(secProcHandle, baseKeyId, secret, sizeof(secret))) {
         SEC_LOG_ERROR("_Sec_SymetricFromKeyId failed");
-        return SEC_RESULT_FAILURE;
+        goto done;
     }
 
     //run kdf
-    SEC_BYTE out_key[SEC_SYMETRIC_KEY_MAX_LEN];
+    out_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == out_key) {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     SEC_SIZE out_key_len = SecKey_GetKeyLenForKeyType(typeDerived);
 
     if (1 != _HKDF(out_key, out_key_len,
@@ -6105,32 +10224,44 @@ Sec_Result SecKey_Derive_HKDF_BaseKey(Sec_ProcessorHandle* secProcHandle, SEC_OB
                             salt, saltSize,
                             info, infoSize, macAlgorithm)) {
         SEC_LOG_ERROR("_HKDF failed");
-        return SEC_RESULT_FAILURE;
+        goto done;
     }
 
     if (SEC_RESULT_SUCCESS != SecKey_Provision(secProcHandle, idDerived,
             locDerived, SecKey_GetClearContainer(typeDerived),
             out_key, out_key_len)) {
         SEC_LOG_ERROR("SecKey_Provision failed");
-        return SEC_RESULT_FAILURE;
+        goto done;
     }
 
-    Sec_Memset(out_key, 0, sizeof(out_key));
+    res = SEC_RESULT_SUCCESS;
 
-    return SEC_RESULT_SUCCESS;
+done:
+    SecArena_Free(out_key);
+    Sec_Memset(secret, 0, sizeof(secret));
+
+    return res;
 }
 
 Sec_Result SecKey_Derive_ConcatKDF_BaseKey(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID idDerived, Sec_KeyType typeDerived, Sec_StorageLoc locDerived, Sec_DigestAlgorithm digestAlgorithm, SEC_BYTE *otherInfo, SEC_SIZE otherInfoSize, SEC_OBJECTID baseKeyId) {
+    Sec_Result res = SEC_RESULT_FAILURE;
+    SEC_BYTE *out_key = NULL;
+
     //get secret from base key
     SEC_BYTE secret[16];
 
     if (SEC_RESULT_SUCCESS != _Sec_SymetricFromKeyId(secProcHandle, baseKeyId, secret, sizeof(secret))) {
         SEC_LOG_ERROR("_Sec_SymetricFromKeyId failed");
-        return SEC_RESULT_FAILURE;
+        goto done;
     }
 
     //run kdf
-    SEC_BYTE out_key[SEC_SYMETRIC_KEY_MAX_LEN];
+    out_key = (SEC_BYTE *) SecArena_Alloc();
+    if (NULL == out_key) {
+        SEC_LOG_ERROR("SecArena_Alloc failed");
+        goto done;
+    }
+
     SEC_SIZE out_key_len = SecKey_GetKeyLenForKeyType(typeDerived);
 
     if (SEC_RESULT_SUCCESS != _ConcatKDF(secProcHandle,
@@ -6140,17 +10271,22 @@ Sec_Result SecKey_Derive_ConcatKDF_BaseKey(Sec_ProcessorHandle* secProcHandle, S
         out_key, out_key_len)) {
 
         SEC_LOG_ERROR("_ConcatKDF failed");
-        return SEC_RESULT_SUCCESS;
+        res = SEC_RESULT_SUCCESS;
+        goto done;
     }
 
     if (SEC_RESULT_SUCCESS != SecKey_Provision(secProcHandle, idDerived,
             locDerived, SecKey_GetClearContainer(typeDerived),
             out_key, out_key_len)) {
         SEC_LOG_ERROR("SecKey_Provision failed");
-        return SEC_RESULT_FAILURE;
+        goto done;
     }
 
-    Sec_Memset(out_key, 0, sizeof(out_key));
+    res = SEC_RESULT_SUCCESS;
 
-    return SEC_RESULT_SUCCESS;
+done:
+    SecArena_Free(out_key);
+    Sec_Memset(secret, 0, sizeof(secret));
+
+    return res;
 }
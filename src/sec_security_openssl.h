@@ -30,6 +30,7 @@
 #include <openssl/ec.h>
 #include <openssl/ecdh.h>
 #include <openssl/ecdsa.h>
+#include <openssl/dh.h>
 #include <openssl/cmac.h>
 
 #ifdef __cplusplus
@@ -38,10 +39,56 @@ extern "C"
 #endif
 
 #define SEC_OPENSSL_KEYCONTAINER_DERIVED SEC_KEYCONTAINER_SOC_INTERNAL_0
+/* clear symmetric key held by a handle from SecKey_CreateTransient */
+#define SEC_OPENSSL_KEYCONTAINER_TRANSIENT SEC_KEYCONTAINER_SOC_INTERNAL_1
 
-#define SEC_OBJECTID_OPENSSL_DERIVE_TMP SEC_OBJECTID_RESERVEDPLATFORM_0
 #define SEC_OBJECTID_OPENSSL_EXPORT SEC_OBJECTID_RESERVEDPLATFORM_0
 #define SEC_OBJECTID_OPENSSL_EXPORT_MAC SEC_OBJECTID_RESERVEDPLATFORM_1
+#define SEC_OBJECTID_OPENSSL_TRANSIENT SEC_OBJECTID_RESERVEDPLATFORM_2
+
+#ifndef SEC_CERT_VERIFY_CACHE_SIZE
+    #define SEC_CERT_VERIFY_CACHE_SIZE 32
+#endif
+
+/* X25519 and Ed25519 need the raw EVP_PKEY interface added in OpenSSL 1.1.1 */
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    #define SEC_OPENSSL_HAVE_CURVE25519
+#endif
+
+/* number of distinct DH parameter sets kept by _Sec_DHParamsGet */
+#ifndef SEC_DH_PARAMS_CACHE_SIZE
+    #define SEC_DH_PARAMS_CACHE_SIZE 8
+#endif
+
+#define SEC_CERTINDEX_FILENAME "certificates.idx"
+#define SEC_CERTINDEX_LOCK_FILENAME "certificates.idx.lock"
+#define SEC_CERTINDEX_MAGIC "CIX3"
+#define SEC_CERTINDEX_BUCKETS 64
+/* magic, generation and record count, followed by the records and a HMAC-SHA256 */
+#define SEC_CERTINDEX_HEADER_LEN (4 + 8 + 4)
+#define SEC_CERTINDEX_MAX_FILE_LEN (16 * 1024 * 1024)
+/* most certificate ids listed by a rescan of the store */
+#define SEC_CERTINDEX_MAX_CERTS 4096
+/* entry type marking a certificate as indexed, its hash is derived from the object id */
+#define SEC_CERTINDEX_PRESENT ((Sec_CertificateIndexType) SEC_CERTIFICATEINDEX_NUM)
+
+/* lifetime of a cached positive certificate verification, in seconds */
+#ifndef SEC_CERT_VERIFY_CACHE_TTL
+    #define SEC_CERT_VERIFY_CACHE_TTL 300
+#endif
+
+/* temporary ids handed out by _Sec_ReservedIdAcquire, one per id in the reserved key space */
+#define SEC_RESERVEDID_NUM ((SEC_SIZE) (SEC_OBJECTID_RESERVED_TOP - SEC_OBJECTID_RESERVED_BASE))
+
+/* number of released reserved ids remembered for immediate reuse */
+#ifndef SEC_RESERVEDID_FREELIST_SIZE
+    #define SEC_RESERVEDID_FREELIST_SIZE 16
+#endif
+
+/* default number of released cipher and mac handles each processor keeps for reuse */
+#ifndef SEC_HANDLEPOOL_SIZE
+    #define SEC_HANDLEPOOL_SIZE 8
+#endif
 
 typedef struct
 {
@@ -98,12 +145,21 @@ struct Sec_BundleHandle_struct
     struct Sec_ProcessorHandle_struct *proc;
 };
 
+/* private key parsed once by SecKey_Pin and shared by all operations on the handle */
+typedef struct
+{
+    RSA *rsa;
+    EC_KEY *ec_key;
+    Sec_KeyProperties props;
+} _Sec_PinnedKey;
+
 struct Sec_KeyHandle_struct
 {
     SEC_OBJECTID object_id;
     Sec_StorageLoc location;
     _Sec_KeyData key_data;
     struct Sec_ProcessorHandle_struct *proc;
+    _Sec_PinnedKey *pinned;
 };
 
 typedef struct {
@@ -121,6 +177,11 @@ struct Sec_CipherHandle_struct
     EVP_CIPHER_CTX *evp_ctx;
     AesCtrState ctr_state;
     SEC_BOOL svp_required;
+    /* ElGamal encryption state for the key, created on first use */
+    struct SecUtils_ElGamalCtx_struct *elgamal_ctx;
+    /* handle pool of the processor, takes the handle back on release even after the processor is gone */
+    struct _Sec_HandlePool_struct *pool;
+    struct Sec_CipherHandle_struct *pool_next;
 };
 
 struct Sec_DigestHandle_struct
@@ -135,6 +196,9 @@ struct Sec_SignatureHandle_struct
     Sec_SignatureAlgorithm algorithm;
     Sec_SignatureMode mode;
     Sec_KeyHandle* key_handle;
+    Sec_DigestHandle* digest_handle;
+    /* digest_handle lives here while streaming input */
+    SEC_BYTE digest_storage[SEC_DIGESTHANDLE_STORAGE_SIZE] __attribute__((aligned(SEC_HANDLE_STORAGE_ALIGN)));
 };
 
 struct Sec_MacHandle_struct
@@ -146,6 +210,11 @@ struct Sec_MacHandle_struct
 #endif
     HMAC_CTX *hmac_ctx;
     CMAC_CTX *cmac_ctx;
+    /* handle pool of the processor, takes the handle back on release, NULL for caller storage */
+    struct _Sec_HandlePool_struct *pool;
+    struct Sec_MacHandle_struct *pool_next;
+    /* pooled handle lending its contexts to a handle in caller storage */
+    struct Sec_MacHandle_struct *ctx_owner;
 };
 
 struct Sec_CertificateHandle_struct
@@ -154,6 +223,12 @@ struct Sec_CertificateHandle_struct
     Sec_StorageLoc location;
     _Sec_CertificateData cert_data;
     struct Sec_ProcessorHandle_struct *proc;
+    /* lazily parsed certificate and its public key */
+    X509 *x509;
+    SEC_BOOL pub_parsed;
+    Sec_KeyType pub_type;
+    Sec_RSARawPublicKey rsa_pub;
+    Sec_ECCRawPublicKey ecc_pub;
 };
 
 struct Sec_RandomHandle_struct
@@ -189,6 +264,53 @@ typedef struct _Sec_RAMBundleData_struct
     struct _Sec_RAMBundleData_struct *next;
 } _Sec_RAMBundleData;
 
+typedef struct
+{
+    SEC_BOOL valid;
+    SEC_OBJECTID object_id;
+    SEC_BYTE cert_hash[SHA256_DIGEST_LENGTH];
+    SEC_BYTE pub_hash[SHA256_DIGEST_LENGTH];
+    SEC_SIZE expires;
+} _Sec_CertVerifyCacheEntry;
+
+typedef struct _Sec_CertIndexEntry_struct
+{
+    Sec_CertificateIndexType type;
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    SEC_OBJECTID object_id;
+    SEC_BOOL persistent;
+    /* stamp of the store files, set on the SEC_CERTINDEX_PRESENT entry of persisted certificates */
+    uint64_t stamp;
+    struct _Sec_CertIndexEntry_struct *next;
+} _Sec_CertIndexEntry;
+
+/* on disk layout of one index entry */
+typedef struct
+{
+    SEC_BYTE type;
+    SEC_BYTE reserved[7];
+    SEC_BYTE object_id[8];
+    SEC_BYTE stamp[8];
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+} _Sec_CertIndexRecord;
+
+/* released handles with their reset OpenSSL contexts, one free list per algorithm */
+typedef struct _Sec_HandlePool_struct
+{
+    Sec_CipherHandle *ciphers[SEC_CIPHERALGORITHM_NUM];
+    Sec_MacHandle *macs[SEC_MACALGORITHM_NUM];
+    /* limit on pooled handles of each kind, 0 disables pooling */
+    SEC_SIZE capacity;
+    SEC_SIZE ciphers_num;
+    SEC_SIZE macs_num;
+    SEC_SIZE ciphers_high_water;
+    SEC_SIZE macs_high_water;
+    /* releases that found the pool full */
+    uint64_t discarded;
+    /* held by the processor and by every handle given out, the last one frees the pool */
+    SEC_SIZE refs;
+} _Sec_HandlePool;
+
 struct Sec_ProcessorHandle_struct
 {
     SEC_BYTE device_id[SEC_DEVICEID_LEN];
@@ -199,14 +321,38 @@ struct Sec_ProcessorHandle_struct
     char *global_dir;
     char *app_dir;
     int device_settings_init_flag;
+    _Sec_CertVerifyCacheEntry cert_verify_cache[SEC_CERT_VERIFY_CACHE_SIZE];
+    _Sec_CertIndexEntry *cert_index[SEC_CERTINDEX_BUCKETS];
+    SEC_BOOL cert_index_loaded;
+    /* generation of certificates.idx the persisted entries were read from or written as */
+    uint64_t cert_index_generation;
+    /* generation published through the mapped certificates.idx.lock, NULL until it is mapped */
+    uint64_t *cert_index_shared;
+    /* a set bit marks a reserved id as taken */
+    SEC_BYTE reserved_ids[SEC_RESERVEDID_NUM / 8];
+    /* offsets of recently released reserved ids, used before the bitmap is searched */
+    SEC_BYTE reserved_free[SEC_RESERVEDID_FREELIST_SIZE];
+    SEC_SIZE reserved_free_num;
+    _Sec_HandlePool *handle_pool;
 };
 
+/* process-wide DH parameters, created once per distinct p/g and never modified or freed */
+typedef struct
+{
+    SEC_BYTE hash[SHA256_DIGEST_LENGTH];
+    DH *params;
+    BN_MONT_CTX *mont_p;
+} _Sec_DHParamsEntry;
+
 struct Sec_KeyExchangeHandle_struct
 {
     Sec_ProcessorHandle *proc;
     Sec_KeyExchangeAlgorithm alg;
     DH *dh;
+    const _Sec_DHParamsEntry *dh_params;
     EC_KEY *ecdh_priv;
+    EVP_PKEY *x25519_priv;
+    SEC_BOOL pregenerated;
 };
 
 struct Sec_OpaqueBufferHandle_struct
@@ -215,6 +361,60 @@ struct Sec_OpaqueBufferHandle_struct
     SEC_SIZE dataBufSize;
 };
 
+/* parse the clear private key material of a key handle into an OpenSSL object */
+RSA *_Sec_RSAFromKeyHandle(Sec_KeyHandle *key);
+EC_KEY *_Sec_ECCFromKeyHandle(Sec_KeyHandle *keyHandle);
+#ifdef SEC_OPENSSL_HAVE_CURVE25519
+EVP_PKEY *_Sec_Curve25519FromKeyHandle(Sec_KeyHandle *keyHandle);
+#endif
+
+/* shared, pre-initialized P-256 group and EC_KEY objects built from it */
+const EC_GROUP *_Sec_P256Group(void);
+EC_KEY *_Sec_NewP256Key(void);
+EC_POINT *_Sec_P256PointFromPubBinary(const Sec_ECCRawPublicKey *binary, BN_CTX *ctx);
+
+/* cached DH parameters and Montgomery context, NULL if the cache is full */
+const _Sec_DHParamsEntry *_Sec_DHParamsGet(const Sec_DHParameters *params);
+/* generate a fresh key pair into dh, which must carry entry's p and g */
+Sec_Result _Sec_DHGenerateKey(const _Sec_DHParamsEntry *entry, DH *dh);
+
+/* take a pre-generated ephemeral key pair (DH*, EC_KEY* or EVP_PKEY*) from the pool, NULL if none */
+void *_SecKeyPool_Take(Sec_KeyExchangeAlgorithm alg, const Sec_DHParameters *params);
+
+/* generate a new RSA key pair (e = 65537) of the size of keyType */
+RSA *_Sec_RSAGenerate(Sec_KeyType keyType);
+/* take a pre-generated RSA key pair of the size of keyType from the pool, NULL if none */
+RSA *_SecRSAPool_Take(Sec_KeyType keyType);
+/* fail the queued SecKey_GenerateAsync requests of a processor that is going away and wait for a running one */
+void _SecRSAPool_CancelJobs(Sec_ProcessorHandle *proc);
+
+/* take an unused id from the reserved key space without probing the key store, SEC_OBJECTID_INVALID if none is left */
+SEC_OBJECTID _Sec_ReservedIdAcquire(Sec_ProcessorHandle *proc);
+/* return an id taken with _Sec_ReservedIdAcquire, any key provisioned under it must be deleted first */
+void _Sec_ReservedIdRelease(Sec_ProcessorHandle *proc, SEC_OBJECTID id);
+
+/* create the handle pool of a new processor, holding the processor's reference */
+_Sec_HandlePool *_SecHandlePool_New(void);
+/* take a reference for a handle given out by the processor */
+_Sec_HandlePool *_SecHandlePool_Ref(_Sec_HandlePool *pool);
+/* take a released cipher handle of the algorithm from the pool, NULL if none */
+Sec_CipherHandle *_SecHandlePool_TakeCipher(_Sec_HandlePool *pool, Sec_CipherAlgorithm algorithm);
+/* give a scrubbed cipher handle and its reference back, SEC_FALSE if the caller has to free the handle */
+SEC_BOOL _SecHandlePool_PutCipher(_Sec_HandlePool *pool, Sec_CipherHandle *handle);
+/* take a released mac handle of the algorithm from the pool, NULL if none */
+Sec_MacHandle *_SecHandlePool_TakeMac(_Sec_HandlePool *pool, Sec_MacAlgorithm algorithm);
+/* give a scrubbed mac handle and its reference back, SEC_FALSE if the caller has to free the handle */
+SEC_BOOL _SecHandlePool_PutMac(_Sec_HandlePool *pool, Sec_MacHandle *handle);
+/* free all pooled handles and drop the processor's reference, NULL is ignored */
+void _SecHandlePool_Release(_Sec_HandlePool *pool);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(SEC_PUBOPS_TOMCRYPT)
+/* stop handing out the provider's pinned copy of a key that is being replaced or deleted */
+void _SecProvider_DropKey(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id);
+/* release the pinned keys of a processor that is going away, EVP_PKEY objects still using them fail */
+void _SecProvider_DropProcessor(Sec_ProcessorHandle *proc);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
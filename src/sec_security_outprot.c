@@ -19,6 +19,7 @@
 
 #include "sec_security_outprot.h"
 #include "sec_security_utils.h"
+#include "sec_security_stats.h"
 #include "outprot.h"
 #include <string.h>
 
@@ -146,12 +147,14 @@ Sec_Result SecOutprot_IsKeyAllowed(Sec_KeyProperties *props, Sec_KeyUsage use) {
     //check usage
     if (SEC_RESULT_SUCCESS != _CheckUsage(props, use)) {
         SEC_LOG_ERROR("_CheckUsage failed");
+        SEC_STATS_OUTPROT_DENIED();
         return SEC_RESULT_FAILURE;
     }
 
     //check validity time
     if (SEC_RESULT_SUCCESS != _CheckTime(props)) {
         SEC_LOG_ERROR("_CheckTime failed");
+        SEC_STATS_OUTPROT_DENIED();
         return SEC_RESULT_FAILURE;
     }
 
@@ -159,6 +162,7 @@ Sec_Result SecOutprot_IsKeyAllowed(Sec_KeyProperties *props, Sec_KeyUsage use) {
     if (use == SEC_KEYUSAGE_DATA || use == SEC_KEYUSAGE_DATA_KEY) {
         if (SEC_RESULT_SUCCESS != _CheckOPL(props)) {
             SEC_LOG_ERROR("_CheckOPL failed");
+            SEC_STATS_OUTPROT_DENIED();
             return SEC_RESULT_OPL_NOT_ENGAGED;
         }
     }
@@ -0,0 +1,1906 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(SEC_PUBOPS_TOMCRYPT)
+
+#include "sec_security.h"
+#include "sec_security_utils.h"
+#include "sec_version.h"
+#include <openssl/opensslv.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+#include <openssl/core.h>
+#include <openssl/core_dispatch.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/param_build.h>
+#include <openssl/provider.h>
+#include <openssl/evp.h>
+#include <openssl/ecdsa.h>
+#include <openssl/rand.h>
+#include <openssl/err.h>
+
+#define SEC_PROVIDER_PARAM_KEY_ENTRY "sec-key-entry"
+#define SEC_PROVIDER_RSA_NAMES "RSA:rsaEncryption:1.2.840.113549.1.1.1"
+#define SEC_PROVIDER_EC_NAMES "EC:id-ecPublicKey:1.2.840.10045.2.1"
+#define SEC_PROVIDER_ECDSA_NAMES "ECDSA"
+#define SEC_PROVIDER_EC_GROUP_NAME "prime256v1"
+/* SEQUENCE { INTEGER r, INTEGER s } with 33 byte integers */
+#define SEC_PROVIDER_ECDSA_MAX_DER_LEN (2 + 2 * (2 + SEC_ECC_NISTP256_KEY_LEN + 1))
+
+typedef struct
+{
+    SEC_BOOL is_ec;
+    SEC_SIZE key_len;
+    Sec_RSARawPublicKey rsa;
+    Sec_ECCRawPublicKey ecc;
+} _Sec_ProvPublicKey;
+
+/* A Security API key loaded once and shared by every EVP_PKEY referring to it */
+typedef struct _Sec_ProvKeyEntry_struct
+{
+    /* opaque id handed to EVP_PKEY_fromdata instead of the entry pointer */
+    uint64_t id;
+    /* proc and key are NULL once the processor is released */
+    Sec_ProcessorHandle *proc;
+    SEC_OBJECTID object_id;
+    Sec_KeyHandle *key;
+    _Sec_ProvPublicKey pub;
+    int refs;
+    /* no longer handed out, kept in the list until the last reference is gone */
+    SEC_BOOL dropped;
+    struct _Sec_ProvKeyEntry_struct *next;
+} _Sec_ProvKeyEntry;
+
+typedef struct
+{
+    const OSSL_CORE_HANDLE *handle;
+    OSSL_LIB_CTX *libctx;
+    pthread_mutex_t md_mutex;
+    EVP_MD *md[SEC_DIGESTALGORITHM_NUM];
+} _Sec_ProvCtx;
+
+typedef struct
+{
+    _Sec_ProvCtx *provctx;
+    SEC_BOOL is_ec;
+    /* public half, either from the Security API key or imported for comparison */
+    SEC_BOOL has_pub;
+    _Sec_ProvPublicKey pub;
+    /* NULL for public only keys */
+    _Sec_ProvKeyEntry *entry;
+} _Sec_ProvKey;
+
+typedef struct
+{
+    _Sec_ProvCtx *provctx;
+    SEC_BOOL is_ec;
+    SEC_BOOL verify;
+    _Sec_ProvKeyEntry *entry;
+    Sec_DigestAlgorithm digest;
+    Sec_DigestAlgorithm mgf1_digest;
+    int pad_mode;
+    int salt_len;
+    EVP_MD_CTX *md_ctx;
+} _Sec_ProvSigCtx;
+
+typedef struct
+{
+    _Sec_ProvCtx *provctx;
+    _Sec_ProvKeyEntry *entry;
+    int pad_mode;
+    Sec_DigestAlgorithm oaep_digest;
+    Sec_DigestAlgorithm mgf1_digest;
+    unsigned int client_version;
+    unsigned int alt_version;
+} _Sec_ProvCipherCtx;
+
+static _Sec_ProvKeyEntry *g_sec_prov_keys = NULL;
+static uint64_t g_sec_prov_keys_next_id = 1;
+static pthread_mutex_t g_sec_prov_keys_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Pinned key cache
+ */
+
+static _Sec_ProvKeyEntry *_SecProvider_AcquireKey(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id)
+{
+    _Sec_ProvKeyEntry *entry = NULL;
+    Sec_KeyType key_type;
+
+    pthread_mutex_lock(&g_sec_prov_keys_mutex);
+
+    for (entry = g_sec_prov_keys; entry != NULL; entry = entry->next)
+    {
+        if (!entry->dropped && entry->proc == proc && entry->object_id == object_id)
+        {
+            ++entry->refs;
+            goto done;
+        }
+    }
+
+    entry = calloc(1, sizeof(_Sec_ProvKeyEntry));
+    if (NULL == entry)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecKey_GetInstance(proc, object_id, &entry->key))
+    {
+        SEC_LOG_ERROR("SecKey_GetInstance failed for key %016llx", (unsigned long long) object_id);
+        SEC_FREE(entry);
+        goto done;
+    }
+
+    key_type = SecKey_GetKeyType(entry->key);
+    entry->pub.key_len = SecKey_GetKeyLen(entry->key);
+
+    if (SecKey_IsPrivRsa(key_type))
+    {
+        if (SEC_RESULT_SUCCESS != SecKey_ExtractRSAPublicKey(entry->key, &entry->pub.rsa))
+        {
+            SEC_LOG_ERROR("SecKey_ExtractRSAPublicKey failed");
+            SecKey_Release(entry->key);
+            SEC_FREE(entry);
+            goto done;
+        }
+    }
+    else if (SecKey_IsPrivEcc(key_type))
+    {
+        entry->pub.is_ec = SEC_TRUE;
+        if (SEC_RESULT_SUCCESS != SecKey_ExtractECCPublicKey(entry->key, &entry->pub.ecc))
+        {
+            SEC_LOG_ERROR("SecKey_ExtractECCPublicKey failed");
+            SecKey_Release(entry->key);
+            SEC_FREE(entry);
+            goto done;
+        }
+    }
+    else
+    {
+        SEC_LOG_ERROR("Key %016llx is not an RSA or ECC private key", (unsigned long long) object_id);
+        SecKey_Release(entry->key);
+        SEC_FREE(entry);
+        goto done;
+    }
+
+    /* the entry lives across handshakes, so the private key is parsed only once */
+    if (SEC_RESULT_SUCCESS != SecKey_Pin(entry->key))
+    {
+        SEC_LOG_ERROR("SecKey_Pin failed");
+        SecKey_Release(entry->key);
+        SEC_FREE(entry);
+        goto done;
+    }
+
+    entry->id = g_sec_prov_keys_next_id++;
+    entry->proc = proc;
+    entry->object_id = object_id;
+    entry->refs = 1;
+    entry->next = g_sec_prov_keys;
+    g_sec_prov_keys = entry;
+
+done:
+    pthread_mutex_unlock(&g_sec_prov_keys_mutex);
+    return entry;
+}
+
+static void _SecProvider_RefKey(_Sec_ProvKeyEntry *entry)
+{
+    pthread_mutex_lock(&g_sec_prov_keys_mutex);
+    ++entry->refs;
+    pthread_mutex_unlock(&g_sec_prov_keys_mutex);
+}
+
+/* take a reference on the pinned entry with the given id, NULL if it is not (or no longer) pinned */
+static _Sec_ProvKeyEntry *_SecProvider_RefKeyById(uint64_t id)
+{
+    _Sec_ProvKeyEntry *entry;
+
+    pthread_mutex_lock(&g_sec_prov_keys_mutex);
+
+    for (entry = g_sec_prov_keys; entry != NULL; entry = entry->next)
+    {
+        if (!entry->dropped && entry->id == id)
+        {
+            ++entry->refs;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_sec_prov_keys_mutex);
+
+    return entry;
+}
+
+static void _SecProvider_ReleaseKey(_Sec_ProvKeyEntry *entry)
+{
+    _Sec_ProvKeyEntry **link;
+
+    if (NULL == entry)
+        return;
+
+    pthread_mutex_lock(&g_sec_prov_keys_mutex);
+
+    if (--entry->refs > 0)
+    {
+        pthread_mutex_unlock(&g_sec_prov_keys_mutex);
+        return;
+    }
+
+    for (link = &g_sec_prov_keys; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == entry)
+        {
+            *link = entry->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_sec_prov_keys_mutex);
+
+    if (NULL != entry->key)
+        SecKey_Release(entry->key);
+    SEC_FREE(entry);
+}
+
+void _SecProvider_DropKey(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id)
+{
+    _Sec_ProvKeyEntry *entry;
+
+    pthread_mutex_lock(&g_sec_prov_keys_mutex);
+
+    /*
+     * Dropped entries are no longer handed out. Live EVP_PKEY objects keep their
+     * reference and the entry is freed by the last _SecProvider_ReleaseKey.
+     */
+    for (entry = g_sec_prov_keys; entry != NULL; entry = entry->next)
+    {
+        if (entry->proc == proc && entry->object_id == object_id)
+            entry->dropped = SEC_TRUE;
+    }
+
+    pthread_mutex_unlock(&g_sec_prov_keys_mutex);
+}
+
+void _SecProvider_DropProcessor(Sec_ProcessorHandle *proc)
+{
+    _Sec_ProvKeyEntry *entry;
+
+    pthread_mutex_lock(&g_sec_prov_keys_mutex);
+
+    /* a later processor at the same address must not match, and live EVP_PKEY objects fail from now on */
+    for (entry = g_sec_prov_keys; entry != NULL; entry = entry->next)
+    {
+        if (entry->proc != proc)
+            continue;
+
+        entry->dropped = SEC_TRUE;
+        SecKey_Release(entry->key);
+        entry->key = NULL;
+        entry->proc = NULL;
+    }
+
+    pthread_mutex_unlock(&g_sec_prov_keys_mutex);
+}
+
+/* SEC_FALSE if the processor of the entry has been released */
+static SEC_BOOL _SecProvider_KeyAlive(const _Sec_ProvKeyEntry *entry)
+{
+    if (NULL == entry->key)
+    {
+        SEC_LOG_ERROR("Key %016llx was released with its processor", (unsigned long long) entry->object_id);
+        return SEC_FALSE;
+    }
+
+    return SEC_TRUE;
+}
+
+static int _SecProvider_SecurityBits(const _Sec_ProvPublicKey *pub)
+{
+    if (pub->is_ec)
+        return 128;
+
+    if (pub->key_len >= 384)
+        return 128;
+    if (pub->key_len >= 256)
+        return 112;
+
+    return 80;
+}
+
+static int _SecProvider_MaxSignatureSize(const _Sec_ProvPublicKey *pub)
+{
+    if (pub->is_ec)
+        return SEC_PROVIDER_ECDSA_MAX_DER_LEN;
+
+    return pub->key_len;
+}
+
+static SEC_SIZE _SecProvider_EncodeEcPoint(const _Sec_ProvPublicKey *pub, SEC_BYTE *out)
+{
+    SEC_SIZE coord_len = Sec_BEBytesToUint32((SEC_BYTE *) pub->ecc.key_len);
+
+    out[0] = 0x04;
+    memcpy(&out[1], pub->ecc.x, coord_len);
+    memcpy(&out[1 + coord_len], pub->ecc.y, coord_len);
+
+    return 1 + 2 * coord_len;
+}
+
+static SEC_BOOL _SecProvider_PublicKeyEqual(const _Sec_ProvPublicKey *pub1, const _Sec_ProvPublicKey *pub2)
+{
+    if (pub1->is_ec != pub2->is_ec || pub1->key_len != pub2->key_len)
+        return SEC_FALSE;
+
+    if (pub1->is_ec)
+        return 0 == Sec_Memcmp(pub1->ecc.x, pub2->ecc.x, pub1->key_len)
+                && 0 == Sec_Memcmp(pub1->ecc.y, pub2->ecc.y, pub1->key_len);
+
+    return 0 == Sec_Memcmp(pub1->rsa.n, pub2->rsa.n, pub1->key_len)
+            && 0 == Sec_Memcmp(pub1->rsa.e, pub2->rsa.e, sizeof(pub1->rsa.e));
+}
+
+/* Public key handed over by another provider, used when comparing against a certificate */
+static int _SecProvider_ImportPublicKey(_Sec_ProvKey *pkey, const OSSL_PARAM params[])
+{
+    const OSSL_PARAM *p;
+    const char *group = NULL;
+    const void *point = NULL;
+    size_t point_len = 0;
+    BIGNUM *n = NULL;
+    BIGNUM *e = NULL;
+    int ret = 0;
+
+    Sec_Memset(&pkey->pub, 0, sizeof(_Sec_ProvPublicKey));
+    pkey->pub.is_ec = pkey->is_ec;
+
+    if (pkey->is_ec)
+    {
+        p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_GROUP_NAME);
+        if (NULL == p || !OSSL_PARAM_get_utf8_string_ptr(p, &group)
+                || (0 != strcmp(group, SEC_PROVIDER_EC_GROUP_NAME) && 0 != strcasecmp(group, "P-256")))
+            goto done;
+
+        p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_PUB_KEY);
+        if (NULL == p || !OSSL_PARAM_get_octet_string_ptr(p, &point, &point_len)
+                || point_len != 1 + 2 * SEC_ECC_NISTP256_KEY_LEN || ((const SEC_BYTE *) point)[0] != 0x04)
+            goto done;
+
+        pkey->pub.key_len = SEC_ECC_NISTP256_KEY_LEN;
+        pkey->pub.ecc.type = SEC_KEYTYPE_ECC_NISTP256_PUBLIC;
+        Sec_Uint32ToBEBytes(SEC_ECC_NISTP256_KEY_LEN, pkey->pub.ecc.key_len);
+        memcpy(pkey->pub.ecc.x, (const SEC_BYTE *) point + 1, SEC_ECC_NISTP256_KEY_LEN);
+        memcpy(pkey->pub.ecc.y, (const SEC_BYTE *) point + 1 + SEC_ECC_NISTP256_KEY_LEN, SEC_ECC_NISTP256_KEY_LEN);
+    }
+    else
+    {
+        p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_RSA_N);
+        if (NULL == p || !OSSL_PARAM_get_BN(p, &n))
+            goto done;
+
+        p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_RSA_E);
+        if (NULL == p || !OSSL_PARAM_get_BN(p, &e))
+            goto done;
+
+        if (BN_num_bytes(n) > (int) sizeof(pkey->pub.rsa.n) || BN_num_bytes(e) > (int) sizeof(pkey->pub.rsa.e))
+            goto done;
+
+        pkey->pub.key_len = BN_num_bytes(n);
+        Sec_Uint32ToBEBytes(pkey->pub.key_len, pkey->pub.rsa.modulus_len_be);
+        SecUtils_BigNumToBuffer(n, pkey->pub.rsa.n, pkey->pub.key_len);
+        SecUtils_BigNumToBuffer(e, pkey->pub.rsa.e, sizeof(pkey->pub.rsa.e));
+    }
+
+    pkey->has_pub = SEC_TRUE;
+    ret = 1;
+
+done:
+    BN_free(n);
+    BN_free(e);
+
+    return ret;
+}
+
+/*
+ * Digest helpers
+ */
+
+static Sec_DigestAlgorithm _SecProvider_DigestFromName(const char *name)
+{
+    if (NULL == name)
+        return SEC_DIGESTALGORITHM_NUM;
+
+    if (0 == strcasecmp(name, "SHA1") || 0 == strcasecmp(name, "SHA-1"))
+        return SEC_DIGESTALGORITHM_SHA1;
+
+    if (0 == strcasecmp(name, "SHA256") || 0 == strcasecmp(name, "SHA2-256")
+            || 0 == strcasecmp(name, "SHA-256"))
+        return SEC_DIGESTALGORITHM_SHA256;
+
+    return SEC_DIGESTALGORITHM_NUM;
+}
+
+static const char *_SecProvider_DigestName(Sec_DigestAlgorithm digest)
+{
+    return (digest == SEC_DIGESTALGORITHM_SHA1) ? "SHA1" : "SHA2-256";
+}
+
+static int _SecProvider_GetDigestParam(const OSSL_PARAM *p, Sec_DigestAlgorithm *digest)
+{
+    const char *name = NULL;
+
+    if (!OSSL_PARAM_get_utf8_string_ptr(p, &name))
+        return 0;
+
+    *digest = _SecProvider_DigestFromName(name);
+    if (*digest == SEC_DIGESTALGORITHM_NUM)
+    {
+        SEC_LOG_ERROR("Unsupported digest %s", name);
+        return 0;
+    }
+
+    return 1;
+}
+
+static EVP_MD *_SecProvider_FetchDigest(_Sec_ProvCtx *provctx, Sec_DigestAlgorithm digest)
+{
+    EVP_MD *md;
+
+    pthread_mutex_lock(&provctx->md_mutex);
+    if (NULL == provctx->md[digest])
+        provctx->md[digest] = EVP_MD_fetch(provctx->libctx, _SecProvider_DigestName(digest), NULL);
+    md = provctx->md[digest];
+    pthread_mutex_unlock(&provctx->md_mutex);
+
+    return md;
+}
+
+/*
+ * Key management
+ */
+
+static void *_SecProvKeymgmt_New(void *provctx)
+{
+    _Sec_ProvKey *pkey = calloc(1, sizeof(_Sec_ProvKey));
+
+    if (NULL == pkey)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return NULL;
+    }
+
+    pkey->provctx = (_Sec_ProvCtx *) provctx;
+
+    return pkey;
+}
+
+static void *_SecProvKeymgmt_NewRsa(void *provctx)
+{
+    return _SecProvKeymgmt_New(provctx);
+}
+
+static void *_SecProvKeymgmt_NewEc(void *provctx)
+{
+    _Sec_ProvKey *pkey = _SecProvKeymgmt_New(provctx);
+
+    if (NULL != pkey)
+        pkey->is_ec = SEC_TRUE;
+
+    return pkey;
+}
+
+static void _SecProvKeymgmt_Free(void *keydata)
+{
+    _Sec_ProvKey *pkey = (_Sec_ProvKey *) keydata;
+
+    if (NULL == pkey)
+        return;
+
+    _SecProvider_ReleaseKey(pkey->entry);
+    SEC_FREE(pkey);
+}
+
+static int _SecProvKeymgmt_Has(const void *keydata, int selection)
+{
+    const _Sec_ProvKey *pkey = (const _Sec_ProvKey *) keydata;
+
+    if (NULL == pkey)
+        return 0;
+
+    if ((selection & OSSL_KEYMGMT_SELECT_PRIVATE_KEY) != 0 && NULL == pkey->entry)
+        return 0;
+
+    if ((selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY) != 0 && !pkey->has_pub)
+        return 0;
+
+    return 1;
+}
+
+static int _SecProvKeymgmt_Import(void *keydata, int selection, const OSSL_PARAM params[])
+{
+    _Sec_ProvKey *pkey = (_Sec_ProvKey *) keydata;
+    const OSSL_PARAM *p;
+    uint64_t id = 0;
+    _Sec_ProvKeyEntry *entry;
+
+    if (NULL == pkey || NULL != pkey->entry || pkey->has_pub)
+        return 0;
+
+    /* private keys can only come from SecKey_ToProviderPKey */
+    p = OSSL_PARAM_locate_const(params, SEC_PROVIDER_PARAM_KEY_ENTRY);
+    if (NULL == p)
+    {
+        if ((selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY) == 0)
+            return 0;
+
+        return _SecProvider_ImportPublicKey(pkey, params);
+    }
+
+    if (!OSSL_PARAM_get_uint64(p, &id))
+        return 0;
+
+    entry = _SecProvider_RefKeyById(id);
+    if (NULL == entry)
+        return 0;
+
+    if (entry->pub.is_ec != pkey->is_ec)
+    {
+        _SecProvider_ReleaseKey(entry);
+        return 0;
+    }
+
+    pkey->entry = entry;
+    pkey->pub = entry->pub;
+    pkey->has_pub = SEC_TRUE;
+
+    return 1;
+}
+
+static const OSSL_PARAM *_SecProvKeymgmt_ImportTypesRsa(int selection)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_uint64(SEC_PROVIDER_PARAM_KEY_ENTRY, NULL),
+        OSSL_PARAM_BN(OSSL_PKEY_PARAM_RSA_N, NULL, 0),
+        OSSL_PARAM_BN(OSSL_PKEY_PARAM_RSA_E, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static const OSSL_PARAM *_SecProvKeymgmt_ImportTypesEc(int selection)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_uint64(SEC_PROVIDER_PARAM_KEY_ENTRY, NULL),
+        OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME, NULL, 0),
+        OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_PUB_KEY, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static int _SecProvKeymgmt_Export(void *keydata, int selection, OSSL_CALLBACK *param_cb, void *cbarg)
+{
+    _Sec_ProvKey *pkey = (_Sec_ProvKey *) keydata;
+    OSSL_PARAM_BLD *bld = NULL;
+    OSSL_PARAM *params = NULL;
+    BIGNUM *n = NULL;
+    BIGNUM *e = NULL;
+    SEC_BYTE point[1 + 2 * SEC_EC_KEY_MAX_LEN];
+    SEC_SIZE point_len;
+    int ret = 0;
+
+    if (NULL == pkey || !pkey->has_pub)
+        return 0;
+
+    /*
+     * The private half never leaves the Security API.  Refusing the export also keeps
+     * OpenSSL from moving the key to another provider for private key operations.
+     */
+    if ((selection & OSSL_KEYMGMT_SELECT_PRIVATE_KEY) != 0)
+        return 0;
+
+    bld = OSSL_PARAM_BLD_new();
+    if (NULL == bld)
+        goto done;
+
+    if (pkey->is_ec)
+    {
+        if ((selection & OSSL_KEYMGMT_SELECT_ALL_PARAMETERS) != 0
+                && !OSSL_PARAM_BLD_push_utf8_string(bld, OSSL_PKEY_PARAM_GROUP_NAME, SEC_PROVIDER_EC_GROUP_NAME, 0))
+            goto done;
+
+        if ((selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY) != 0)
+        {
+            point_len = _SecProvider_EncodeEcPoint(&pkey->pub, point);
+            if (!OSSL_PARAM_BLD_push_octet_string(bld, OSSL_PKEY_PARAM_PUB_KEY, point, point_len))
+                goto done;
+        }
+    }
+    else if ((selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY) != 0)
+    {
+        n = BN_bin2bn(pkey->pub.rsa.n, pkey->pub.key_len, NULL);
+        e = BN_bin2bn(pkey->pub.rsa.e, sizeof(pkey->pub.rsa.e), NULL);
+        if (NULL == n || NULL == e
+                || !OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_N, n)
+                || !OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_E, e))
+            goto done;
+    }
+
+    params = OSSL_PARAM_BLD_to_param(bld);
+    if (NULL == params)
+        goto done;
+
+    ret = param_cb(params, cbarg);
+
+done:
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(bld);
+    BN_free(n);
+    BN_free(e);
+
+    return ret;
+}
+
+static const OSSL_PARAM *_SecProvKeymgmt_ExportTypesRsa(int selection)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_BN(OSSL_PKEY_PARAM_RSA_N, NULL, 0),
+        OSSL_PARAM_BN(OSSL_PKEY_PARAM_RSA_E, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static const OSSL_PARAM *_SecProvKeymgmt_ExportTypesEc(int selection)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME, NULL, 0),
+        OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_PUB_KEY, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static int _SecProvKeymgmt_GetParams(void *keydata, OSSL_PARAM params[])
+{
+    _Sec_ProvKey *pkey = (_Sec_ProvKey *) keydata;
+    OSSL_PARAM *p;
+    BIGNUM *bn = NULL;
+    SEC_BYTE point[1 + 2 * SEC_EC_KEY_MAX_LEN];
+    SEC_SIZE point_len;
+    int ret = 0;
+
+    if (NULL == pkey || !pkey->has_pub)
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_BITS);
+    if (NULL != p && !OSSL_PARAM_set_int(p, pkey->pub.key_len * 8))
+        goto done;
+
+    p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_SECURITY_BITS);
+    if (NULL != p && !OSSL_PARAM_set_int(p, _SecProvider_SecurityBits(&pkey->pub)))
+        goto done;
+
+    p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_MAX_SIZE);
+    if (NULL != p && !OSSL_PARAM_set_int(p, _SecProvider_MaxSignatureSize(&pkey->pub)))
+        goto done;
+
+    p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_DEFAULT_DIGEST);
+    if (NULL != p && !OSSL_PARAM_set_utf8_string(p, "SHA256"))
+        goto done;
+
+    if (pkey->is_ec)
+    {
+        p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_GROUP_NAME);
+        if (NULL != p && !OSSL_PARAM_set_utf8_string(p, SEC_PROVIDER_EC_GROUP_NAME))
+            goto done;
+
+        p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_PUB_KEY);
+        if (NULL == p)
+            p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY);
+        if (NULL != p)
+        {
+            point_len = _SecProvider_EncodeEcPoint(&pkey->pub, point);
+            if (!OSSL_PARAM_set_octet_string(p, point, point_len))
+                goto done;
+        }
+    }
+    else
+    {
+        p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_RSA_N);
+        if (NULL != p)
+        {
+            bn = BN_bin2bn(pkey->pub.rsa.n, pkey->pub.key_len, NULL);
+            if (NULL == bn || !OSSL_PARAM_set_BN(p, bn))
+                goto done;
+            BN_free(bn);
+            bn = NULL;
+        }
+
+        p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_RSA_E);
+        if (NULL != p)
+        {
+            bn = BN_bin2bn(pkey->pub.rsa.e, sizeof(pkey->pub.rsa.e), NULL);
+            if (NULL == bn || !OSSL_PARAM_set_BN(p, bn))
+                goto done;
+        }
+    }
+
+    ret = 1;
+
+done:
+    BN_free(bn);
+    return ret;
+}
+
+static const OSSL_PARAM *_SecProvKeymgmt_GettableParamsRsa(void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_int(OSSL_PKEY_PARAM_BITS, NULL),
+        OSSL_PARAM_int(OSSL_PKEY_PARAM_SECURITY_BITS, NULL),
+        OSSL_PARAM_int(OSSL_PKEY_PARAM_MAX_SIZE, NULL),
+        OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_DEFAULT_DIGEST, NULL, 0),
+        OSSL_PARAM_BN(OSSL_PKEY_PARAM_RSA_N, NULL, 0),
+        OSSL_PARAM_BN(OSSL_PKEY_PARAM_RSA_E, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static const OSSL_PARAM *_SecProvKeymgmt_GettableParamsEc(void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_int(OSSL_PKEY_PARAM_BITS, NULL),
+        OSSL_PARAM_int(OSSL_PKEY_PARAM_SECURITY_BITS, NULL),
+        OSSL_PARAM_int(OSSL_PKEY_PARAM_MAX_SIZE, NULL),
+        OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_DEFAULT_DIGEST, NULL, 0),
+        OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME, NULL, 0),
+        OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_PUB_KEY, NULL, 0),
+        OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static int _SecProvKeymgmt_Match(const void *keydata1, const void *keydata2, int selection)
+{
+    const _Sec_ProvKey *pkey1 = (const _Sec_ProvKey *) keydata1;
+    const _Sec_ProvKey *pkey2 = (const _Sec_ProvKey *) keydata2;
+
+    if (NULL == pkey1 || NULL == pkey2 || !pkey1->has_pub || !pkey2->has_pub)
+        return 0;
+
+    if (NULL != pkey1->entry && pkey1->entry == pkey2->entry)
+        return 1;
+
+    return _SecProvider_PublicKeyEqual(&pkey1->pub, &pkey2->pub);
+}
+
+static const char *_SecProvKeymgmt_QueryOperationNameEc(int operation_id)
+{
+    return (operation_id == OSSL_OP_SIGNATURE) ? SEC_PROVIDER_ECDSA_NAMES : NULL;
+}
+
+static const OSSL_DISPATCH g_sec_prov_keymgmt_rsa[] = {
+    { OSSL_FUNC_KEYMGMT_NEW, (void (*)(void)) _SecProvKeymgmt_NewRsa },
+    { OSSL_FUNC_KEYMGMT_FREE, (void (*)(void)) _SecProvKeymgmt_Free },
+    { OSSL_FUNC_KEYMGMT_HAS, (void (*)(void)) _SecProvKeymgmt_Has },
+    { OSSL_FUNC_KEYMGMT_MATCH, (void (*)(void)) _SecProvKeymgmt_Match },
+    { OSSL_FUNC_KEYMGMT_IMPORT, (void (*)(void)) _SecProvKeymgmt_Import },
+    { OSSL_FUNC_KEYMGMT_IMPORT_TYPES, (void (*)(void)) _SecProvKeymgmt_ImportTypesRsa },
+    { OSSL_FUNC_KEYMGMT_EXPORT, (void (*)(void)) _SecProvKeymgmt_Export },
+    { OSSL_FUNC_KEYMGMT_EXPORT_TYPES, (void (*)(void)) _SecProvKeymgmt_ExportTypesRsa },
+    { OSSL_FUNC_KEYMGMT_GET_PARAMS, (void (*)(void)) _SecProvKeymgmt_GetParams },
+    { OSSL_FUNC_KEYMGMT_GETTABLE_PARAMS, (void (*)(void)) _SecProvKeymgmt_GettableParamsRsa },
+    { 0, NULL }
+};
+
+static const OSSL_DISPATCH g_sec_prov_keymgmt_ec[] = {
+    { OSSL_FUNC_KEYMGMT_NEW, (void (*)(void)) _SecProvKeymgmt_NewEc },
+    { OSSL_FUNC_KEYMGMT_FREE, (void (*)(void)) _SecProvKeymgmt_Free },
+    { OSSL_FUNC_KEYMGMT_HAS, (void (*)(void)) _SecProvKeymgmt_Has },
+    { OSSL_FUNC_KEYMGMT_MATCH, (void (*)(void)) _SecProvKeymgmt_Match },
+    { OSSL_FUNC_KEYMGMT_IMPORT, (void (*)(void)) _SecProvKeymgmt_Import },
+    { OSSL_FUNC_KEYMGMT_IMPORT_TYPES, (void (*)(void)) _SecProvKeymgmt_ImportTypesEc },
+    { OSSL_FUNC_KEYMGMT_EXPORT, (void (*)(void)) _SecProvKeymgmt_Export },
+    { OSSL_FUNC_KEYMGMT_EXPORT_TYPES, (void (*)(void)) _SecProvKeymgmt_ExportTypesEc },
+    { OSSL_FUNC_KEYMGMT_GET_PARAMS, (void (*)(void)) _SecProvKeymgmt_GetParams },
+    { OSSL_FUNC_KEYMGMT_GETTABLE_PARAMS, (void (*)(void)) _SecProvKeymgmt_GettableParamsEc },
+    { OSSL_FUNC_KEYMGMT_QUERY_OPERATION_NAME, (void (*)(void)) _SecProvKeymgmt_QueryOperationNameEc },
+    { 0, NULL }
+};
+
+/*
+ * Signature
+ */
+
+static void *_SecProvSig_NewCtx(void *provctx, SEC_BOOL is_ec)
+{
+    _Sec_ProvSigCtx *ctx = calloc(1, sizeof(_Sec_ProvSigCtx));
+
+    if (NULL == ctx)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return NULL;
+    }
+
+    ctx->provctx = (_Sec_ProvCtx *) provctx;
+    ctx->is_ec = is_ec;
+    ctx->digest = SEC_DIGESTALGORITHM_NUM;
+    ctx->mgf1_digest = SEC_DIGESTALGORITHM_NUM;
+    ctx->pad_mode = RSA_PKCS1_PADDING;
+    ctx->salt_len = RSA_PSS_SALTLEN_DIGEST;
+
+    return ctx;
+}
+
+static void *_SecProvSig_NewCtxRsa(void *provctx, const char *propq)
+{
+    return _SecProvSig_NewCtx(provctx, SEC_FALSE);
+}
+
+static void *_SecProvSig_NewCtxEc(void *provctx, const char *propq)
+{
+    return _SecProvSig_NewCtx(provctx, SEC_TRUE);
+}
+
+static void _SecProvSig_FreeCtx(void *vctx)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+
+    if (NULL == ctx)
+        return;
+
+    EVP_MD_CTX_free(ctx->md_ctx);
+    _SecProvider_ReleaseKey(ctx->entry);
+    SEC_FREE(ctx);
+}
+
+static void *_SecProvSig_DupCtx(void *vctx)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    _Sec_ProvSigCtx *dup = calloc(1, sizeof(_Sec_ProvSigCtx));
+
+    if (NULL == dup)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return NULL;
+    }
+
+    *dup = *ctx;
+    dup->md_ctx = NULL;
+
+    if (NULL != ctx->md_ctx)
+    {
+        dup->md_ctx = EVP_MD_CTX_new();
+        if (NULL == dup->md_ctx || !EVP_MD_CTX_copy_ex(dup->md_ctx, ctx->md_ctx))
+        {
+            EVP_MD_CTX_free(dup->md_ctx);
+            SEC_FREE(dup);
+            return NULL;
+        }
+    }
+
+    if (NULL != dup->entry)
+        _SecProvider_RefKey(dup->entry);
+
+    return dup;
+}
+
+static int _SecProvSig_GetSaltParam(const OSSL_PARAM *p, int *salt_len)
+{
+    if (p->data_type == OSSL_PARAM_UTF8_STRING)
+    {
+        if (0 == strcmp(p->data, OSSL_PKEY_RSA_PSS_SALT_LEN_DIGEST))
+            *salt_len = RSA_PSS_SALTLEN_DIGEST;
+        else if (0 == strcmp(p->data, OSSL_PKEY_RSA_PSS_SALT_LEN_AUTO))
+            *salt_len = RSA_PSS_SALTLEN_AUTO;
+        else if (0 == strcmp(p->data, OSSL_PKEY_RSA_PSS_SALT_LEN_MAX))
+            *salt_len = RSA_PSS_SALTLEN_MAX;
+        else
+            *salt_len = atoi(p->data);
+
+        return 1;
+    }
+
+    return OSSL_PARAM_get_int(p, salt_len);
+}
+
+static int _SecProvider_GetPadParam(const OSSL_PARAM *p, int *pad_mode)
+{
+    if (p->data_type == OSSL_PARAM_UTF8_STRING)
+    {
+        if (0 == strcmp(p->data, OSSL_PKEY_RSA_PAD_MODE_PKCSV15))
+            *pad_mode = RSA_PKCS1_PADDING;
+        else if (0 == strcmp(p->data, OSSL_PKEY_RSA_PAD_MODE_OAEP))
+            *pad_mode = RSA_PKCS1_OAEP_PADDING;
+        else if (0 == strcmp(p->data, OSSL_PKEY_RSA_PAD_MODE_PSS))
+            *pad_mode = RSA_PKCS1_PSS_PADDING;
+        else
+            return 0;
+
+        return 1;
+    }
+
+    return OSSL_PARAM_get_int(p, pad_mode);
+}
+
+static int _SecProvSig_SetCtxParams(void *vctx, const OSSL_PARAM params[])
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    const OSSL_PARAM *p;
+
+    if (NULL == params)
+        return 1;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_SIGNATURE_PARAM_DIGEST);
+    if (NULL != p)
+    {
+        if (!_SecProvider_GetDigestParam(p, &ctx->digest))
+            return 0;
+
+        /* the Security API only offers P-256 with SHA-256 */
+        if (ctx->is_ec && ctx->digest != SEC_DIGESTALGORITHM_SHA256)
+            return 0;
+    }
+
+    if (ctx->is_ec)
+        return 1;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_SIGNATURE_PARAM_PAD_MODE);
+    if (NULL != p)
+    {
+        if (!_SecProvider_GetPadParam(p, &ctx->pad_mode))
+            return 0;
+
+        if (ctx->pad_mode != RSA_PKCS1_PADDING && ctx->pad_mode != RSA_PKCS1_PSS_PADDING)
+        {
+            SEC_LOG_ERROR("Unsupported padding mode %d", ctx->pad_mode);
+            return 0;
+        }
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_SIGNATURE_PARAM_PSS_SALTLEN);
+    if (NULL != p && !_SecProvSig_GetSaltParam(p, &ctx->salt_len))
+        return 0;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_SIGNATURE_PARAM_MGF1_DIGEST);
+    if (NULL != p && !_SecProvider_GetDigestParam(p, &ctx->mgf1_digest))
+        return 0;
+
+    return 1;
+}
+
+static const OSSL_PARAM *_SecProvSig_SettableCtxParamsRsa(void *vctx, void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_DIGEST, NULL, 0),
+        OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_PAD_MODE, NULL, 0),
+        OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_PSS_SALTLEN, NULL, 0),
+        OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_MGF1_DIGEST, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static const OSSL_PARAM *_SecProvSig_SettableCtxParamsEc(void *vctx, void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_DIGEST, NULL, 0),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+/* DER encoded AlgorithmIdentifier values needed when signing certificates and CMS */
+static const SEC_BYTE g_sec_prov_algid_ecdsa_sha256[] = {
+    0x30, 0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x02
+};
+static const SEC_BYTE g_sec_prov_algid_rsa_sha1[] = {
+    0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x05, 0x05, 0x00
+};
+static const SEC_BYTE g_sec_prov_algid_rsa_sha256[] = {
+    0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00
+};
+
+static int _SecProvSig_GetCtxParams(void *vctx, OSSL_PARAM params[])
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_SIGNATURE_PARAM_ALGORITHM_ID);
+    if (NULL != p)
+    {
+        if (ctx->is_ec && ctx->digest == SEC_DIGESTALGORITHM_SHA256)
+        {
+            if (!OSSL_PARAM_set_octet_string(p, g_sec_prov_algid_ecdsa_sha256, sizeof(g_sec_prov_algid_ecdsa_sha256)))
+                return 0;
+        }
+        else if (!ctx->is_ec && ctx->pad_mode == RSA_PKCS1_PADDING && ctx->digest == SEC_DIGESTALGORITHM_SHA1)
+        {
+            if (!OSSL_PARAM_set_octet_string(p, g_sec_prov_algid_rsa_sha1, sizeof(g_sec_prov_algid_rsa_sha1)))
+                return 0;
+        }
+        else if (!ctx->is_ec && ctx->pad_mode == RSA_PKCS1_PADDING && ctx->digest == SEC_DIGESTALGORITHM_SHA256)
+        {
+            if (!OSSL_PARAM_set_octet_string(p, g_sec_prov_algid_rsa_sha256, sizeof(g_sec_prov_algid_rsa_sha256)))
+                return 0;
+        }
+    }
+
+    p = OSSL_PARAM_locate(params, OSSL_SIGNATURE_PARAM_DIGEST);
+    if (NULL != p && ctx->digest != SEC_DIGESTALGORITHM_NUM
+            && !OSSL_PARAM_set_utf8_string(p, _SecProvider_DigestName(ctx->digest)))
+        return 0;
+
+    if (!ctx->is_ec)
+    {
+        p = OSSL_PARAM_locate(params, OSSL_SIGNATURE_PARAM_PAD_MODE);
+        if (NULL != p && !OSSL_PARAM_set_int(p, ctx->pad_mode))
+            return 0;
+    }
+
+    return 1;
+}
+
+static const OSSL_PARAM *_SecProvSig_GettableCtxParams(void *vctx, void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_octet_string(OSSL_SIGNATURE_PARAM_ALGORITHM_ID, NULL, 0),
+        OSSL_PARAM_utf8_string(OSSL_SIGNATURE_PARAM_DIGEST, NULL, 0),
+        OSSL_PARAM_int(OSSL_SIGNATURE_PARAM_PAD_MODE, NULL),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static int _SecProvSig_Init(void *vctx, void *provkey, const OSSL_PARAM params[], SEC_BOOL verify)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    _Sec_ProvKey *pkey = (_Sec_ProvKey *) provkey;
+
+    if (NULL == ctx)
+        return 0;
+
+    if (NULL != pkey)
+    {
+        if (NULL == pkey->entry || pkey->is_ec != ctx->is_ec)
+            return 0;
+
+        _SecProvider_RefKey(pkey->entry);
+        _SecProvider_ReleaseKey(ctx->entry);
+        ctx->entry = pkey->entry;
+    }
+    else if (NULL == ctx->entry)
+    {
+        return 0;
+    }
+
+    ctx->verify = verify;
+
+    return _SecProvSig_SetCtxParams(ctx, params);
+}
+
+static int _SecProvSig_SignInit(void *vctx, void *provkey, const OSSL_PARAM params[])
+{
+    return _SecProvSig_Init(vctx, provkey, params, SEC_FALSE);
+}
+
+static int _SecProvSig_VerifyInit(void *vctx, void *provkey, const OSSL_PARAM params[])
+{
+    return _SecProvSig_Init(vctx, provkey, params, SEC_TRUE);
+}
+
+/* Map the context state to one of the Security API pre-hashed signature algorithms */
+static int _SecProvSig_Algorithm(_Sec_ProvSigCtx *ctx, SEC_SIZE digest_len,
+        Sec_SignatureAlgorithm *alg)
+{
+    Sec_DigestAlgorithm digest = ctx->digest;
+    SEC_SIZE md_len;
+
+    if (digest == SEC_DIGESTALGORITHM_NUM)
+    {
+        if (digest_len == 20)
+            digest = SEC_DIGESTALGORITHM_SHA1;
+        else if (digest_len == 32)
+            digest = SEC_DIGESTALGORITHM_SHA256;
+        else
+            return 0;
+    }
+
+    md_len = (digest == SEC_DIGESTALGORITHM_SHA1) ? 20 : 32;
+    if (digest_len != md_len)
+        return 0;
+
+    if (ctx->is_ec)
+    {
+        if (digest != SEC_DIGESTALGORITHM_SHA256)
+            return 0;
+
+        *alg = SEC_SIGNATUREALGORITHM_ECDSA_NISTP256_DIGEST;
+        return 1;
+    }
+
+    if (ctx->pad_mode == RSA_PKCS1_PADDING)
+    {
+        *alg = (digest == SEC_DIGESTALGORITHM_SHA1) ? SEC_SIGNATUREALGORITHM_RSA_SHA1_PKCS_DIGEST
+                : SEC_SIGNATUREALGORITHM_RSA_SHA256_PKCS_DIGEST;
+        return 1;
+    }
+
+    /* PSS is always done with MGF1 over the same digest and a digest sized salt */
+    if (ctx->mgf1_digest != SEC_DIGESTALGORITHM_NUM && ctx->mgf1_digest != digest)
+        return 0;
+
+    if (ctx->salt_len != RSA_PSS_SALTLEN_DIGEST && ctx->salt_len != (int) md_len
+            && !(ctx->verify && ctx->salt_len == RSA_PSS_SALTLEN_AUTO))
+        return 0;
+
+    *alg = (digest == SEC_DIGESTALGORITHM_SHA1) ? SEC_SIGNATUREALGORITHM_RSA_SHA1_PSS_DIGEST
+            : SEC_SIGNATUREALGORITHM_RSA_SHA256_PSS_DIGEST;
+    return 1;
+}
+
+static int _SecProvSig_Sign(void *vctx, unsigned char *sig, size_t *siglen, size_t sigsize,
+        const unsigned char *tbs, size_t tbslen)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    SEC_BYTE sig_storage[SEC_SIGNATUREHANDLE_STORAGE_SIZE] __attribute__((aligned(SEC_HANDLE_STORAGE_ALIGN)));
+    Sec_SignatureHandle *sig_handle = NULL;
+    Sec_SignatureAlgorithm alg;
+    SEC_BYTE raw[SEC_SIGNATURE_MAX_LEN];
+    SEC_SIZE raw_len = 0;
+    ECDSA_SIG *esig = NULL;
+    BIGNUM *r = NULL;
+    BIGNUM *s = NULL;
+    unsigned char *der;
+    int der_len;
+    int ret = 0;
+
+    if (NULL == ctx || NULL == ctx->entry)
+        return 0;
+
+    if (NULL == sig)
+    {
+        *siglen = _SecProvider_MaxSignatureSize(&ctx->entry->pub);
+        return 1;
+    }
+
+    if (!_SecProvSig_Algorithm(ctx, tbslen, &alg))
+    {
+        SEC_LOG_ERROR("Unsupported signature parameters");
+        return 0;
+    }
+
+    if (!_SecProvider_KeyAlive(ctx->entry))
+        return 0;
+
+    if (ctx->entry->pub.key_len > sizeof(raw) || sigsize < (size_t) (ctx->is_ec ? SEC_ECC_NISTP256_KEY_LEN * 2 : ctx->entry->pub.key_len))
+    {
+        SEC_LOG_ERROR("Signature buffer too small");
+        return 0;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecSignature_Init(ctx->entry->proc, alg, SEC_SIGNATUREMODE_SIGN,
+            ctx->entry->key, sig_storage, sizeof(sig_storage), &sig_handle))
+    {
+        SEC_LOG_ERROR("SecSignature_Init failed");
+        goto done;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecSignature_Process(sig_handle, (SEC_BYTE *) tbs, tbslen, raw, &raw_len))
+    {
+        SEC_LOG_ERROR("SecSignature_Process failed");
+        goto done;
+    }
+
+    if (!ctx->is_ec)
+    {
+        memcpy(sig, raw, raw_len);
+        *siglen = raw_len;
+        ret = 1;
+        goto done;
+    }
+
+    /* TLS and X509 expect DER encoded ECDSA signatures, the Security API returns r || s */
+    esig = ECDSA_SIG_new();
+    r = BN_bin2bn(&raw[0], SEC_ECC_NISTP256_KEY_LEN, NULL);
+    s = BN_bin2bn(&raw[SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN, NULL);
+    if (NULL == esig || NULL == r || NULL == s || !ECDSA_SIG_set0(esig, r, s))
+    {
+        SEC_LOG_ERROR("ECDSA_SIG_set0 failed");
+        BN_free(r);
+        BN_free(s);
+        goto done;
+    }
+
+    der_len = i2d_ECDSA_SIG(esig, NULL);
+    if (der_len <= 0 || (size_t) der_len > sigsize)
+    {
+        SEC_LOG_ERROR("Signature buffer too small");
+        goto done;
+    }
+
+    der = sig;
+    *siglen = i2d_ECDSA_SIG(esig, &der);
+    ret = 1;
+
+done:
+    if (NULL != sig_handle)
+        SecSignature_Cleanup(sig_handle);
+    ECDSA_SIG_free(esig);
+    Sec_Memset(raw, 0, sizeof(raw));
+
+    return ret;
+}
+
+static int _SecProvSig_Verify(void *vctx, const unsigned char *sig, size_t siglen,
+        const unsigned char *tbs, size_t tbslen)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    Sec_SignatureAlgorithm alg;
+    SEC_BYTE raw[SEC_SIGNATURE_MAX_LEN];
+    SEC_SIZE raw_len;
+    ECDSA_SIG *esig = NULL;
+    const BIGNUM *r = NULL;
+    const BIGNUM *s = NULL;
+    const unsigned char *der = sig;
+    int ret = 0;
+
+    if (NULL == ctx || NULL == ctx->entry || !_SecProvSig_Algorithm(ctx, tbslen, &alg))
+        return 0;
+
+    if (!_SecProvider_KeyAlive(ctx->entry))
+        return 0;
+
+    if (ctx->is_ec)
+    {
+        esig = d2i_ECDSA_SIG(NULL, &der, siglen);
+        if (NULL == esig)
+            goto done;
+
+        ECDSA_SIG_get0(esig, &r, &s);
+        if (BN_num_bytes(r) > SEC_ECC_NISTP256_KEY_LEN || BN_num_bytes(s) > SEC_ECC_NISTP256_KEY_LEN)
+            goto done;
+
+        SecUtils_BigNumToBuffer((BIGNUM *) r, &raw[0], SEC_ECC_NISTP256_KEY_LEN);
+        SecUtils_BigNumToBuffer((BIGNUM *) s, &raw[SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN);
+        raw_len = SEC_ECC_NISTP256_KEY_LEN * 2;
+    }
+    else
+    {
+        if (siglen > sizeof(raw))
+            goto done;
+
+        memcpy(raw, sig, siglen);
+        raw_len = siglen;
+    }
+
+    if (SEC_RESULT_SUCCESS == SecSignature_SingleInput(ctx->entry->proc, alg,
+            SEC_SIGNATUREMODE_VERIFY, ctx->entry->key, (SEC_BYTE *) tbs, tbslen, raw, &raw_len))
+        ret = 1;
+
+done:
+    ECDSA_SIG_free(esig);
+
+    return ret;
+}
+
+static int _SecProvSig_DigestInit(void *vctx, const char *mdname, void *provkey,
+        const OSSL_PARAM params[], SEC_BOOL verify)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    EVP_MD *md;
+
+    if (!_SecProvSig_Init(vctx, provkey, params, verify))
+        return 0;
+
+    if (NULL != mdname)
+    {
+        ctx->digest = _SecProvider_DigestFromName(mdname);
+        if (ctx->digest == SEC_DIGESTALGORITHM_NUM)
+        {
+            SEC_LOG_ERROR("Unsupported digest %s", mdname);
+            return 0;
+        }
+    }
+    else if (ctx->digest == SEC_DIGESTALGORITHM_NUM)
+    {
+        ctx->digest = SEC_DIGESTALGORITHM_SHA256;
+    }
+
+    if (ctx->is_ec && ctx->digest != SEC_DIGESTALGORITHM_SHA256)
+        return 0;
+
+    md = _SecProvider_FetchDigest(ctx->provctx, ctx->digest);
+    if (NULL == md)
+    {
+        SEC_LOG_ERROR("EVP_MD_fetch failed");
+        return 0;
+    }
+
+    if (NULL == ctx->md_ctx)
+    {
+        ctx->md_ctx = EVP_MD_CTX_new();
+        if (NULL == ctx->md_ctx)
+            return 0;
+    }
+
+    return EVP_DigestInit_ex2(ctx->md_ctx, md, NULL);
+}
+
+static int _SecProvSig_DigestSignInit(void *vctx, const char *mdname, void *provkey,
+        const OSSL_PARAM params[])
+{
+    return _SecProvSig_DigestInit(vctx, mdname, provkey, params, SEC_FALSE);
+}
+
+static int _SecProvSig_DigestVerifyInit(void *vctx, const char *mdname, void *provkey,
+        const OSSL_PARAM params[])
+{
+    return _SecProvSig_DigestInit(vctx, mdname, provkey, params, SEC_TRUE);
+}
+
+static int _SecProvSig_DigestUpdate(void *vctx, const unsigned char *data, size_t datalen)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+
+    if (NULL == ctx || NULL == ctx->md_ctx)
+        return 0;
+
+    return EVP_DigestUpdate(ctx->md_ctx, data, datalen);
+}
+
+static int _SecProvSig_DigestSignFinal(void *vctx, unsigned char *sig, size_t *siglen, size_t sigsize)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+
+    if (NULL == ctx || NULL == ctx->md_ctx)
+        return 0;
+
+    if (NULL == sig)
+        return _SecProvSig_Sign(vctx, NULL, siglen, 0, NULL, 0);
+
+    if (!EVP_DigestFinal_ex(ctx->md_ctx, digest, &digest_len))
+        return 0;
+
+    return _SecProvSig_Sign(vctx, sig, siglen, sigsize, digest, digest_len);
+}
+
+static int _SecProvSig_DigestVerifyFinal(void *vctx, const unsigned char *sig, size_t siglen)
+{
+    _Sec_ProvSigCtx *ctx = (_Sec_ProvSigCtx *) vctx;
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+
+    if (NULL == ctx || NULL == ctx->md_ctx)
+        return 0;
+
+    if (!EVP_DigestFinal_ex(ctx->md_ctx, digest, &digest_len))
+        return 0;
+
+    return _SecProvSig_Verify(vctx, sig, siglen, digest, digest_len);
+}
+
+#define SEC_PROVIDER_SIGNATURE_FUNCTIONS \
+    { OSSL_FUNC_SIGNATURE_FREECTX, (void (*)(void)) _SecProvSig_FreeCtx }, \
+    { OSSL_FUNC_SIGNATURE_DUPCTX, (void (*)(void)) _SecProvSig_DupCtx }, \
+    { OSSL_FUNC_SIGNATURE_SIGN_INIT, (void (*)(void)) _SecProvSig_SignInit }, \
+    { OSSL_FUNC_SIGNATURE_SIGN, (void (*)(void)) _SecProvSig_Sign }, \
+    { OSSL_FUNC_SIGNATURE_VERIFY_INIT, (void (*)(void)) _SecProvSig_VerifyInit }, \
+    { OSSL_FUNC_SIGNATURE_VERIFY, (void (*)(void)) _SecProvSig_Verify }, \
+    { OSSL_FUNC_SIGNATURE_DIGEST_SIGN_INIT, (void (*)(void)) _SecProvSig_DigestSignInit }, \
+    { OSSL_FUNC_SIGNATURE_DIGEST_SIGN_UPDATE, (void (*)(void)) _SecProvSig_DigestUpdate }, \
+    { OSSL_FUNC_SIGNATURE_DIGEST_SIGN_FINAL, (void (*)(void)) _SecProvSig_DigestSignFinal }, \
+    { OSSL_FUNC_SIGNATURE_DIGEST_VERIFY_INIT, (void (*)(void)) _SecProvSig_DigestVerifyInit }, \
+    { OSSL_FUNC_SIGNATURE_DIGEST_VERIFY_UPDATE, (void (*)(void)) _SecProvSig_DigestUpdate }, \
+    { OSSL_FUNC_SIGNATURE_DIGEST_VERIFY_FINAL, (void (*)(void)) _SecProvSig_DigestVerifyFinal }, \
+    { OSSL_FUNC_SIGNATURE_GET_CTX_PARAMS, (void (*)(void)) _SecProvSig_GetCtxParams }, \
+    { OSSL_FUNC_SIGNATURE_GETTABLE_CTX_PARAMS, (void (*)(void)) _SecProvSig_GettableCtxParams }, \
+    { OSSL_FUNC_SIGNATURE_SET_CTX_PARAMS, (void (*)(void)) _SecProvSig_SetCtxParams }
+
+static const OSSL_DISPATCH g_sec_prov_signature_rsa[] = {
+    { OSSL_FUNC_SIGNATURE_NEWCTX, (void (*)(void)) _SecProvSig_NewCtxRsa },
+    { OSSL_FUNC_SIGNATURE_SETTABLE_CTX_PARAMS, (void (*)(void)) _SecProvSig_SettableCtxParamsRsa },
+    SEC_PROVIDER_SIGNATURE_FUNCTIONS,
+    { 0, NULL }
+};
+
+static const OSSL_DISPATCH g_sec_prov_signature_ecdsa[] = {
+    { OSSL_FUNC_SIGNATURE_NEWCTX, (void (*)(void)) _SecProvSig_NewCtxEc },
+    { OSSL_FUNC_SIGNATURE_SETTABLE_CTX_PARAMS, (void (*)(void)) _SecProvSig_SettableCtxParamsEc },
+    SEC_PROVIDER_SIGNATURE_FUNCTIONS,
+    { 0, NULL }
+};
+
+/*
+ * Asymmetric cipher (RSA only)
+ */
+
+static void *_SecProvCipher_NewCtx(void *provctx)
+{
+    _Sec_ProvCipherCtx *ctx = calloc(1, sizeof(_Sec_ProvCipherCtx));
+
+    if (NULL == ctx)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return NULL;
+    }
+
+    ctx->provctx = (_Sec_ProvCtx *) provctx;
+    ctx->pad_mode = RSA_PKCS1_PADDING;
+    ctx->oaep_digest = SEC_DIGESTALGORITHM_SHA1;
+    ctx->mgf1_digest = SEC_DIGESTALGORITHM_SHA1;
+
+    return ctx;
+}
+
+static void _SecProvCipher_FreeCtx(void *vctx)
+{
+    _Sec_ProvCipherCtx *ctx = (_Sec_ProvCipherCtx *) vctx;
+
+    if (NULL == ctx)
+        return;
+
+    _SecProvider_ReleaseKey(ctx->entry);
+    SEC_FREE(ctx);
+}
+
+static void *_SecProvCipher_DupCtx(void *vctx)
+{
+    _Sec_ProvCipherCtx *ctx = (_Sec_ProvCipherCtx *) vctx;
+    _Sec_ProvCipherCtx *dup = calloc(1, sizeof(_Sec_ProvCipherCtx));
+
+    if (NULL == dup)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return NULL;
+    }
+
+    *dup = *ctx;
+    if (NULL != dup->entry)
+        _SecProvider_RefKey(dup->entry);
+
+    return dup;
+}
+
+static int _SecProvCipher_SetCtxParams(void *vctx, const OSSL_PARAM params[])
+{
+    _Sec_ProvCipherCtx *ctx = (_Sec_ProvCipherCtx *) vctx;
+    const OSSL_PARAM *p;
+
+    if (NULL == params)
+        return 1;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_ASYM_CIPHER_PARAM_PAD_MODE);
+    if (NULL != p)
+    {
+        if (!_SecProvider_GetPadParam(p, &ctx->pad_mode))
+            return 0;
+
+        if (ctx->pad_mode != RSA_PKCS1_PADDING && ctx->pad_mode != RSA_PKCS1_OAEP_PADDING
+                && ctx->pad_mode != RSA_PKCS1_WITH_TLS_PADDING)
+        {
+            SEC_LOG_ERROR("Unsupported padding mode %d", ctx->pad_mode);
+            return 0;
+        }
+    }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_ASYM_CIPHER_PARAM_OAEP_DIGEST);
+    if (NULL != p && !_SecProvider_GetDigestParam(p, &ctx->oaep_digest))
+        return 0;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_ASYM_CIPHER_PARAM_MGF1_DIGEST);
+    if (NULL != p && !_SecProvider_GetDigestParam(p, &ctx->mgf1_digest))
+        return 0;
+
+    /* the Security API OAEP implementation does not take a label */
+    p = OSSL_PARAM_locate_const(params, OSSL_ASYM_CIPHER_PARAM_OAEP_LABEL);
+    if (NULL != p && p->data_size != 0)
+        return 0;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_ASYM_CIPHER_PARAM_TLS_CLIENT_VERSION);
+    if (NULL != p && !OSSL_PARAM_get_uint(p, &ctx->client_version))
+        return 0;
+
+    p = OSSL_PARAM_locate_const(params, OSSL_ASYM_CIPHER_PARAM_TLS_NEGOTIATED_VERSION);
+    if (NULL != p && !OSSL_PARAM_get_uint(p, &ctx->alt_version))
+        return 0;
+
+    return 1;
+}
+
+static const OSSL_PARAM *_SecProvCipher_SettableCtxParams(void *vctx, void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_utf8_string(OSSL_ASYM_CIPHER_PARAM_PAD_MODE, NULL, 0),
+        OSSL_PARAM_utf8_string(OSSL_ASYM_CIPHER_PARAM_OAEP_DIGEST, NULL, 0),
+        OSSL_PARAM_utf8_string(OSSL_ASYM_CIPHER_PARAM_MGF1_DIGEST, NULL, 0),
+        OSSL_PARAM_octet_string(OSSL_ASYM_CIPHER_PARAM_OAEP_LABEL, NULL, 0),
+        OSSL_PARAM_uint(OSSL_ASYM_CIPHER_PARAM_TLS_CLIENT_VERSION, NULL),
+        OSSL_PARAM_uint(OSSL_ASYM_CIPHER_PARAM_TLS_NEGOTIATED_VERSION, NULL),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static int _SecProvCipher_GetCtxParams(void *vctx, OSSL_PARAM params[])
+{
+    _Sec_ProvCipherCtx *ctx = (_Sec_ProvCipherCtx *) vctx;
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_ASYM_CIPHER_PARAM_PAD_MODE);
+    if (NULL != p && !OSSL_PARAM_set_int(p, ctx->pad_mode))
+        return 0;
+
+    return 1;
+}
+
+static const OSSL_PARAM *_SecProvCipher_GettableCtxParams(void *vctx, void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_int(OSSL_ASYM_CIPHER_PARAM_PAD_MODE, NULL),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static int _SecProvCipher_Init(void *vctx, void *provkey, const OSSL_PARAM params[])
+{
+    _Sec_ProvCipherCtx *ctx = (_Sec_ProvCipherCtx *) vctx;
+    _Sec_ProvKey *pkey = (_Sec_ProvKey *) provkey;
+
+    if (NULL == ctx || NULL == pkey || NULL == pkey->entry || pkey->is_ec)
+        return 0;
+
+    _SecProvider_RefKey(pkey->entry);
+    _SecProvider_ReleaseKey(ctx->entry);
+    ctx->entry = pkey->entry;
+
+    return _SecProvCipher_SetCtxParams(ctx, params);
+}
+
+static int _SecProvCipher_Algorithm(_Sec_ProvCipherCtx *ctx, Sec_CipherAlgorithm *alg)
+{
+    if (ctx->pad_mode == RSA_PKCS1_OAEP_PADDING)
+    {
+        if (ctx->oaep_digest != SEC_DIGESTALGORITHM_SHA1 || ctx->mgf1_digest != SEC_DIGESTALGORITHM_SHA1)
+        {
+            SEC_LOG_ERROR("Only SHA-1 OAEP is supported");
+            return 0;
+        }
+
+        *alg = SEC_CIPHERALGORITHM_RSA_OAEP_PADDING;
+        return 1;
+    }
+
+    *alg = SEC_CIPHERALGORITHM_RSA_PKCS1_PADDING;
+    return 1;
+}
+
+static int _SecProvCipher_Process(_Sec_ProvCipherCtx *ctx, Sec_CipherMode mode,
+        unsigned char *out, size_t *outlen, size_t outsize, const unsigned char *in, size_t inlen)
+{
+    Sec_CipherAlgorithm alg;
+    SEC_SIZE written = 0;
+
+    if (NULL == ctx || NULL == ctx->entry || !_SecProvCipher_Algorithm(ctx, &alg))
+        return 0;
+
+    if (NULL == out)
+    {
+        *outlen = ctx->entry->pub.key_len;
+        return 1;
+    }
+
+    if (!_SecProvider_KeyAlive(ctx->entry))
+        return 0;
+
+    if (SEC_RESULT_SUCCESS != SecCipher_SingleInput(ctx->entry->proc, alg, mode,
+            ctx->entry->key, NULL, (SEC_BYTE *) in, inlen, out, outsize, &written))
+    {
+        SEC_LOG_ERROR("SecCipher_SingleInput failed");
+        return 0;
+    }
+
+    *outlen = written;
+    return 1;
+}
+
+static int _SecProvCipher_Encrypt(void *vctx, unsigned char *out, size_t *outlen, size_t outsize,
+        const unsigned char *in, size_t inlen)
+{
+    return _SecProvCipher_Process((_Sec_ProvCipherCtx *) vctx, SEC_CIPHERMODE_ENCRYPT,
+            out, outlen, outsize, in, inlen);
+}
+
+/*
+ * RSA key exchange premaster secret decryption.  SecCipher_DecryptTlsPremaster replaces a bad
+ * padding or version by a random secret in constant time, so nothing here may branch on it.
+ */
+static int _SecProvCipher_DecryptTls(_Sec_ProvCipherCtx *ctx, unsigned char *out, size_t *outlen,
+        size_t outsize, const unsigned char *in, size_t inlen)
+{
+    if (outsize < SEC_TLS_PREMASTER_LEN || ctx->client_version == 0 || !_SecProvider_KeyAlive(ctx->entry))
+        return 0;
+
+    if (SEC_RESULT_SUCCESS != SecCipher_DecryptTlsPremaster(ctx->entry->key, (SEC_BYTE *) in,
+            inlen, ctx->client_version, ctx->alt_version, out))
+        return 0;
+
+    *outlen = SEC_TLS_PREMASTER_LEN;
+    return 1;
+}
+
+static int _SecProvCipher_Decrypt(void *vctx, unsigned char *out, size_t *outlen, size_t outsize,
+        const unsigned char *in, size_t inlen)
+{
+    _Sec_ProvCipherCtx *ctx = (_Sec_ProvCipherCtx *) vctx;
+
+    if (NULL != ctx && NULL != ctx->entry && ctx->pad_mode == RSA_PKCS1_WITH_TLS_PADDING)
+    {
+        if (NULL == out)
+        {
+            *outlen = SEC_TLS_PREMASTER_LEN;
+            return 1;
+        }
+
+        return _SecProvCipher_DecryptTls(ctx, out, outlen, outsize, in, inlen);
+    }
+
+    return _SecProvCipher_Process(ctx, SEC_CIPHERMODE_DECRYPT, out, outlen, outsize, in, inlen);
+}
+
+static const OSSL_DISPATCH g_sec_prov_asym_cipher_rsa[] = {
+    { OSSL_FUNC_ASYM_CIPHER_NEWCTX, (void (*)(void)) _SecProvCipher_NewCtx },
+    { OSSL_FUNC_ASYM_CIPHER_FREECTX, (void (*)(void)) _SecProvCipher_FreeCtx },
+    { OSSL_FUNC_ASYM_CIPHER_DUPCTX, (void (*)(void)) _SecProvCipher_DupCtx },
+    { OSSL_FUNC_ASYM_CIPHER_ENCRYPT_INIT, (void (*)(void)) _SecProvCipher_Init },
+    { OSSL_FUNC_ASYM_CIPHER_ENCRYPT, (void (*)(void)) _SecProvCipher_Encrypt },
+    { OSSL_FUNC_ASYM_CIPHER_DECRYPT_INIT, (void (*)(void)) _SecProvCipher_Init },
+    { OSSL_FUNC_ASYM_CIPHER_DECRYPT, (void (*)(void)) _SecProvCipher_Decrypt },
+    { OSSL_FUNC_ASYM_CIPHER_GET_CTX_PARAMS, (void (*)(void)) _SecProvCipher_GetCtxParams },
+    { OSSL_FUNC_ASYM_CIPHER_GETTABLE_CTX_PARAMS, (void (*)(void)) _SecProvCipher_GettableCtxParams },
+    { OSSL_FUNC_ASYM_CIPHER_SET_CTX_PARAMS, (void (*)(void)) _SecProvCipher_SetCtxParams },
+    { OSSL_FUNC_ASYM_CIPHER_SETTABLE_CTX_PARAMS, (void (*)(void)) _SecProvCipher_SettableCtxParams },
+    { 0, NULL }
+};
+
+/*
+ * Provider
+ */
+
+static const OSSL_ALGORITHM g_sec_prov_keymgmt[] = {
+    { SEC_PROVIDER_RSA_NAMES, SEC_PROVIDER_PROPQ, g_sec_prov_keymgmt_rsa, "Security API RSA keys" },
+    { SEC_PROVIDER_EC_NAMES, SEC_PROVIDER_PROPQ, g_sec_prov_keymgmt_ec, "Security API ECC keys" },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const OSSL_ALGORITHM g_sec_prov_signature[] = {
+    { SEC_PROVIDER_RSA_NAMES, SEC_PROVIDER_PROPQ, g_sec_prov_signature_rsa, "Security API RSA signatures" },
+    { SEC_PROVIDER_ECDSA_NAMES, SEC_PROVIDER_PROPQ, g_sec_prov_signature_ecdsa, "Security API ECDSA signatures" },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const OSSL_ALGORITHM g_sec_prov_asym_cipher[] = {
+    { SEC_PROVIDER_RSA_NAMES, SEC_PROVIDER_PROPQ, g_sec_prov_asym_cipher_rsa, "Security API RSA cipher" },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const OSSL_ALGORITHM *_SecProvider_Query(void *provctx, int operation_id, int *no_cache)
+{
+    *no_cache = 0;
+
+    switch (operation_id)
+    {
+        case OSSL_OP_KEYMGMT:
+            return g_sec_prov_keymgmt;
+        case OSSL_OP_SIGNATURE:
+            return g_sec_prov_signature;
+        case OSSL_OP_ASYM_CIPHER:
+            return g_sec_prov_asym_cipher;
+        default:
+            return NULL;
+    }
+}
+
+static const OSSL_PARAM *_SecProvider_GettableParams(void *provctx)
+{
+    static const OSSL_PARAM types[] = {
+        OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_NAME, NULL, 0),
+        OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_VERSION, NULL, 0),
+        OSSL_PARAM_int(OSSL_PROV_PARAM_STATUS, NULL),
+        OSSL_PARAM_END
+    };
+
+    return types;
+}
+
+static int _SecProvider_GetParams(void *provctx, OSSL_PARAM params[])
+{
+    OSSL_PARAM *p;
+
+    p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_NAME);
+    if (NULL != p && !OSSL_PARAM_set_utf8_ptr(p, "Security API provider"))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_VERSION);
+    if (NULL != p && !OSSL_PARAM_set_utf8_ptr(p, SEC_API_VERSION))
+        return 0;
+
+    p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_STATUS);
+    if (NULL != p && !OSSL_PARAM_set_int(p, 1))
+        return 0;
+
+    return 1;
+}
+
+static void _SecProvider_Teardown(void *vprovctx)
+{
+    _Sec_ProvCtx *provctx = (_Sec_ProvCtx *) vprovctx;
+    int i;
+
+    if (NULL == provctx)
+        return;
+
+    for (i = 0; i < SEC_DIGESTALGORITHM_NUM; ++i)
+        EVP_MD_free(provctx->md[i]);
+
+    OSSL_LIB_CTX_free(provctx->libctx);
+    pthread_mutex_destroy(&provctx->md_mutex);
+    SEC_FREE(provctx);
+}
+
+static const OSSL_DISPATCH g_sec_prov_dispatch[] = {
+    { OSSL_FUNC_PROVIDER_TEARDOWN, (void (*)(void)) _SecProvider_Teardown },
+    { OSSL_FUNC_PROVIDER_QUERY_OPERATION, (void (*)(void)) _SecProvider_Query },
+    { OSSL_FUNC_PROVIDER_GETTABLE_PARAMS, (void (*)(void)) _SecProvider_GettableParams },
+    { OSSL_FUNC_PROVIDER_GET_PARAMS, (void (*)(void)) _SecProvider_GetParams },
+    { 0, NULL }
+};
+
+static int _SecProvider_Init(const OSSL_CORE_HANDLE *handle, const OSSL_DISPATCH *in,
+        const OSSL_DISPATCH **out, void **provctx)
+{
+    _Sec_ProvCtx *ctx = calloc(1, sizeof(_Sec_ProvCtx));
+
+    if (NULL == ctx)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return 0;
+    }
+
+    /* digests for DigestSign are fetched from the application's library context */
+    ctx->libctx = OSSL_LIB_CTX_new_child(handle, in);
+    if (NULL == ctx->libctx)
+    {
+        SEC_LOG_ERROR("OSSL_LIB_CTX_new_child failed");
+        SEC_FREE(ctx);
+        return 0;
+    }
+
+    ctx->handle = handle;
+    pthread_mutex_init(&ctx->md_mutex, NULL);
+
+    *out = g_sec_prov_dispatch;
+    *provctx = ctx;
+
+    return 1;
+}
+
+Sec_Result SecProvider_Load(OSSL_LIB_CTX *libctx)
+{
+    static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    pthread_mutex_lock(&load_mutex);
+
+    if (OSSL_PROVIDER_available(libctx, SEC_PROVIDER_NAME))
+    {
+        res = SEC_RESULT_SUCCESS;
+        goto done;
+    }
+
+    /* explicitly loading a provider stops the default one from being loaded implicitly */
+    if (!OSSL_PROVIDER_available(libctx, "default") && !OSSL_PROVIDER_available(libctx, "fips")
+            && NULL == OSSL_PROVIDER_load(libctx, "default"))
+    {
+        SEC_LOG_ERROR("OSSL_PROVIDER_load failed for the default provider");
+        goto done;
+    }
+
+    if (!OSSL_PROVIDER_add_builtin(libctx, SEC_PROVIDER_NAME, _SecProvider_Init))
+    {
+        SEC_LOG_ERROR("OSSL_PROVIDER_add_builtin failed");
+        goto done;
+    }
+
+    if (NULL == OSSL_PROVIDER_load(libctx, SEC_PROVIDER_NAME))
+    {
+        SEC_LOG_ERROR("OSSL_PROVIDER_load failed: %s", ERR_error_string(ERR_get_error(), NULL));
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    pthread_mutex_unlock(&load_mutex);
+    return res;
+}
+
+EVP_PKEY* SecKey_ToProviderPKey(Sec_ProcessorHandle *proc, SEC_OBJECTID object_id, OSSL_LIB_CTX *libctx)
+{
+    _Sec_ProvKeyEntry *entry = NULL;
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    OSSL_PARAM params[2];
+
+    if (SEC_RESULT_SUCCESS != SecProvider_Load(libctx))
+        return NULL;
+
+    entry = _SecProvider_AcquireKey(proc, object_id);
+    if (NULL == entry)
+        return NULL;
+
+    pctx = EVP_PKEY_CTX_new_from_name(libctx,
+            entry->pub.is_ec ? "EC" : "RSA", SEC_PROVIDER_PROPQ);
+    if (NULL == pctx || 1 != EVP_PKEY_fromdata_init(pctx))
+    {
+        SEC_LOG_ERROR("EVP_PKEY_fromdata_init failed");
+        goto done;
+    }
+
+    params[0] = OSSL_PARAM_construct_uint64(SEC_PROVIDER_PARAM_KEY_ENTRY, &entry->id);
+    params[1] = OSSL_PARAM_construct_end();
+
+    if (1 != EVP_PKEY_fromdata(pctx, &pkey, EVP_PKEY_KEYPAIR, params))
+    {
+        SEC_LOG_ERROR("EVP_PKEY_fromdata failed");
+        pkey = NULL;
+    }
+
+done:
+    EVP_PKEY_CTX_free(pctx);
+    _SecProvider_ReleaseKey(entry);
+
+    return pkey;
+}
+
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
+#endif
@@ -0,0 +1,450 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* needed for SCHED_IDLE */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "sec_security_openssl.h"
+#include "sec_security_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sched.h>
+#include <pthread.h>
+
+/* maximum number of pre-generated key pairs per modulus size */
+#ifndef SEC_RSAPOOL_MAX_DEPTH
+    #define SEC_RSAPOOL_MAX_DEPTH 16
+#endif
+
+/* number of low priority generator threads */
+#ifndef SEC_RSAPOOL_THREADS
+    #define SEC_RSAPOOL_THREADS 2
+#endif
+
+/* one pool per modulus size: 1024, 2048 and 3072 */
+#define SEC_RSAPOOL_NUM 3
+
+typedef struct
+{
+    Sec_KeyType key_type;
+    RSA *keys[SEC_RSAPOOL_MAX_DEPTH];
+    SEC_SIZE count;
+    SEC_SIZE depth;
+    /* keys being generated for this pool right now */
+    SEC_SIZE pending;
+} _Sec_RSAPool;
+
+typedef struct _Sec_GenerateJob_struct
+{
+    Sec_ProcessorHandle *proc;
+    SEC_OBJECTID object_id;
+    Sec_KeyType key_type;
+    Sec_StorageLoc location;
+    SecKey_GenerateCallback callback;
+    void *user_data;
+    struct _Sec_GenerateJob_struct *next;
+} _Sec_GenerateJob;
+
+static _Sec_RSAPool g_rsa_pools[SEC_RSAPOOL_NUM] = {
+    { SEC_KEYTYPE_RSA_1024 },
+    { SEC_KEYTYPE_RSA_2048 },
+    { SEC_KEYTYPE_RSA_3072 },
+};
+static _Sec_GenerateJob *g_rsa_jobs_head = NULL;
+static _Sec_GenerateJob *g_rsa_jobs_tail = NULL;
+static pthread_mutex_t g_rsa_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_rsa_pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t g_rsa_pool_threads[SEC_RSAPOOL_THREADS];
+static SEC_SIZE g_rsa_pool_threads_num = 0;
+/* processor each worker is running a job for, jobs for the same processor never run concurrently */
+static Sec_ProcessorHandle *g_rsa_pool_busy[SEC_RSAPOOL_THREADS];
+static SEC_BOOL g_rsa_pool_stop = SEC_FALSE;
+
+static _Sec_RSAPool *_SecRSAPool_Find(Sec_KeyType keyType)
+{
+    SEC_SIZE i;
+
+    for (i = 0; i < SEC_RSAPOOL_NUM; ++i)
+    {
+        if (g_rsa_pools[i].key_type == keyType)
+            return &g_rsa_pools[i];
+    }
+
+    return NULL;
+}
+
+/* called with the pool mutex held */
+static _Sec_GenerateJob *_SecRSAPool_NextJob(void)
+{
+    _Sec_GenerateJob **link;
+    _Sec_GenerateJob *prev = NULL;
+    SEC_SIZE i;
+
+    for (link = &g_rsa_jobs_head; *link != NULL; prev = *link, link = &(*link)->next)
+    {
+        _Sec_GenerateJob *job = *link;
+
+        for (i = 0; i < SEC_RSAPOOL_THREADS; ++i)
+        {
+            if (g_rsa_pool_busy[i] == job->proc)
+                break;
+        }
+
+        if (i < SEC_RSAPOOL_THREADS)
+            continue;
+
+        *link = job->next;
+        if (g_rsa_jobs_tail == job)
+            g_rsa_jobs_tail = prev;
+
+        return job;
+    }
+
+    return NULL;
+}
+
+static void _SecRSAPool_RunJob(_Sec_GenerateJob *job)
+{
+    Sec_Result res;
+
+    res = SecKey_Generate(job->proc, job->object_id, job->key_type, job->location);
+    if (SEC_RESULT_SUCCESS != res)
+        SEC_LOG_ERROR("SecKey_Generate failed for object id %016llx", (unsigned long long) job->object_id);
+
+    if (NULL != job->callback)
+        job->callback(res, job->object_id, job->user_data);
+
+    SEC_FREE(job);
+}
+
+static void *_SecRSAPool_Worker(void *arg)
+{
+    SEC_SIZE slot = (SEC_SIZE) (uintptr_t) arg;
+
+#ifdef SCHED_IDLE
+    struct sched_param param;
+
+    /* only run on otherwise idle cores */
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    pthread_mutex_lock(&g_rsa_pool_mutex);
+
+    while (!g_rsa_pool_stop)
+    {
+        _Sec_GenerateJob *job = _SecRSAPool_NextJob();
+        _Sec_RSAPool *pool = NULL;
+        RSA *rsa;
+        SEC_SIZE i;
+
+        /* queued requests have someone waiting on them, serve them first */
+        if (NULL != job)
+        {
+            g_rsa_pool_busy[slot] = job->proc;
+
+            pthread_mutex_unlock(&g_rsa_pool_mutex);
+            _SecRSAPool_RunJob(job);
+            pthread_mutex_lock(&g_rsa_pool_mutex);
+
+            /* another worker may be waiting for a job queued for the same processor */
+            g_rsa_pool_busy[slot] = NULL;
+            pthread_cond_broadcast(&g_rsa_pool_cond);
+            continue;
+        }
+
+        for (i = 0; i < SEC_RSAPOOL_NUM; ++i)
+        {
+            if (g_rsa_pools[i].count + g_rsa_pools[i].pending < g_rsa_pools[i].depth)
+            {
+                pool = &g_rsa_pools[i];
+                break;
+            }
+        }
+
+        if (NULL == pool)
+        {
+            pthread_cond_wait(&g_rsa_pool_cond, &g_rsa_pool_mutex);
+            continue;
+        }
+
+        pool->pending++;
+
+        /* the prime search runs without the lock */
+        pthread_mutex_unlock(&g_rsa_pool_mutex);
+        rsa = _Sec_RSAGenerate(pool->key_type);
+        pthread_mutex_lock(&g_rsa_pool_mutex);
+
+        pool->pending--;
+
+        if (NULL == rsa)
+        {
+            /* do not spin on a persistent failure, wait for the next request */
+            pthread_cond_wait(&g_rsa_pool_cond, &g_rsa_pool_mutex);
+            continue;
+        }
+
+        if (pool->count < pool->depth)
+            pool->keys[pool->count++] = rsa;
+        else
+            SEC_RSA_FREE(rsa);
+    }
+
+    pthread_mutex_unlock(&g_rsa_pool_mutex);
+    return NULL;
+}
+
+/* called with the pool mutex held */
+static Sec_Result _SecRSAPool_StartThreads(void)
+{
+    while (g_rsa_pool_threads_num < SEC_RSAPOOL_THREADS)
+    {
+        if (0 != pthread_create(&g_rsa_pool_threads[g_rsa_pool_threads_num], NULL, _SecRSAPool_Worker,
+                (void *) (uintptr_t) g_rsa_pool_threads_num))
+        {
+            SEC_LOG_ERROR("pthread_create failed");
+            return g_rsa_pool_threads_num > 0 ? SEC_RESULT_SUCCESS : SEC_RESULT_FAILURE;
+        }
+        g_rsa_pool_threads_num++;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
+RSA *_SecRSAPool_Take(Sec_KeyType keyType)
+{
+    _Sec_RSAPool *pool;
+    RSA *rsa = NULL;
+
+    pthread_mutex_lock(&g_rsa_pool_mutex);
+
+    pool = _SecRSAPool_Find(keyType);
+    if (NULL != pool && pool->count > 0)
+    {
+        rsa = pool->keys[--pool->count];
+        pool->keys[pool->count] = NULL;
+        pthread_cond_signal(&g_rsa_pool_cond);
+    }
+
+    /* only sizes with a started pool are counted */
+    if (NULL != pool && pool->depth > 0)
+        SEC_STATS_CACHE(SEC_STATS_CACHE_RSA_POOL, NULL != rsa);
+
+    pthread_mutex_unlock(&g_rsa_pool_mutex);
+
+    return rsa;
+}
+
+Sec_Result SecKey_StartPool(Sec_KeyType keyType, SEC_SIZE depth)
+{
+    _Sec_RSAPool *pool;
+    Sec_Result res;
+
+    pool = _SecRSAPool_Find(keyType);
+    if (NULL == pool)
+    {
+        SEC_LOG_ERROR("Only RSA private keys can be pooled: %d", keyType);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    if (depth == 0 || depth > SEC_RSAPOOL_MAX_DEPTH)
+    {
+        SEC_LOG_ERROR("Invalid pool depth %d, max is %d", depth, SEC_RSAPOOL_MAX_DEPTH);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    pthread_mutex_lock(&g_rsa_pool_mutex);
+
+    /* extra keys above a reduced depth are handed out before new ones are made */
+    pool->depth = depth;
+
+    res = _SecRSAPool_StartThreads();
+    if (SEC_RESULT_SUCCESS == res)
+        pthread_cond_broadcast(&g_rsa_pool_cond);
+
+    pthread_mutex_unlock(&g_rsa_pool_mutex);
+
+    return res;
+}
+
+Sec_Result SecKey_StopPool(void)
+{
+    _Sec_GenerateJob *jobs;
+    SEC_SIZE threads;
+    SEC_SIZE i, j;
+
+    pthread_mutex_lock(&g_rsa_pool_mutex);
+    threads = g_rsa_pool_threads_num;
+
+    /* a worker cannot join itself, e.g. from a SecKey_GenerateAsync callback */
+    for (i = 0; i < threads; ++i)
+    {
+        if (pthread_equal(pthread_self(), g_rsa_pool_threads[i]))
+        {
+            pthread_mutex_unlock(&g_rsa_pool_mutex);
+            SEC_LOG_ERROR("SecKey_StopPool cannot be called from a pool thread");
+            return SEC_RESULT_FAILURE;
+        }
+    }
+
+    g_rsa_pool_stop = SEC_TRUE;
+    pthread_cond_broadcast(&g_rsa_pool_cond);
+    pthread_mutex_unlock(&g_rsa_pool_mutex);
+
+    for (i = 0; i < threads; ++i)
+        pthread_join(g_rsa_pool_threads[i], NULL);
+
+    pthread_mutex_lock(&g_rsa_pool_mutex);
+    for (i = 0; i < SEC_RSAPOOL_NUM; ++i)
+    {
+        for (j = 0; j < g_rsa_pools[i].count; ++j)
+            SEC_RSA_FREE(g_rsa_pools[i].keys[j]);
+
+        g_rsa_pools[i].count = 0;
+        g_rsa_pools[i].depth = 0;
+        g_rsa_pools[i].pending = 0;
+    }
+    jobs = g_rsa_jobs_head;
+    g_rsa_jobs_head = NULL;
+    g_rsa_jobs_tail = NULL;
+    g_rsa_pool_threads_num = 0;
+    g_rsa_pool_stop = SEC_FALSE;
+    pthread_mutex_unlock(&g_rsa_pool_mutex);
+
+    /* callbacks run without the lock so that they may restart the pool */
+    while (NULL != jobs)
+    {
+        _Sec_GenerateJob *next = jobs->next;
+
+        if (NULL != jobs->callback)
+            jobs->callback(SEC_RESULT_FAILURE, jobs->object_id, jobs->user_data);
+        SEC_FREE(jobs);
+
+        jobs = next;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
+void _SecRSAPool_CancelJobs(Sec_ProcessorHandle *proc)
+{
+    _Sec_GenerateJob *jobs = NULL;
+    _Sec_GenerateJob **link;
+    SEC_SIZE i;
+
+    pthread_mutex_lock(&g_rsa_pool_mutex);
+
+    link = &g_rsa_jobs_head;
+    g_rsa_jobs_tail = NULL;
+    while (NULL != *link)
+    {
+        _Sec_GenerateJob *job = *link;
+
+        if (job->proc != proc)
+        {
+            g_rsa_jobs_tail = job;
+            link = &job->next;
+            continue;
+        }
+
+        *link = job->next;
+        job->next = jobs;
+        jobs = job;
+    }
+
+    /* a job running for the processor has to finish first, unless its callback is the caller */
+    for (;;)
+    {
+        for (i = 0; i < g_rsa_pool_threads_num; ++i)
+        {
+            if (g_rsa_pool_busy[i] == proc && !pthread_equal(pthread_self(), g_rsa_pool_threads[i]))
+                break;
+        }
+
+        if (i == g_rsa_pool_threads_num)
+            break;
+
+        pthread_cond_wait(&g_rsa_pool_cond, &g_rsa_pool_mutex);
+    }
+
+    pthread_mutex_unlock(&g_rsa_pool_mutex);
+
+    while (NULL != jobs)
+    {
+        _Sec_GenerateJob *next = jobs->next;
+
+        if (NULL != jobs->callback)
+            jobs->callback(SEC_RESULT_FAILURE, jobs->object_id, jobs->user_data);
+        SEC_FREE(jobs);
+
+        jobs = next;
+    }
+}
+
+Sec_Result SecKey_GenerateAsync(Sec_ProcessorHandle* secProcHandle, SEC_OBJECTID object_id,
+        Sec_KeyType keyType, Sec_StorageLoc location, SecKey_GenerateCallback callback, void *userData)
+{
+    _Sec_GenerateJob *job;
+    Sec_Result res;
+
+    if (NULL == secProcHandle)
+    {
+        SEC_LOG_ERROR("Invalid handle");
+        return SEC_RESULT_INVALID_HANDLE;
+    }
+
+    job = (_Sec_GenerateJob *) calloc(1, sizeof(_Sec_GenerateJob));
+    if (NULL == job)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    job->proc = secProcHandle;
+    job->object_id = object_id;
+    job->key_type = keyType;
+    job->location = location;
+    job->callback = callback;
+    job->user_data = userData;
+
+    pthread_mutex_lock(&g_rsa_pool_mutex);
+
+    res = _SecRSAPool_StartThreads();
+    if (SEC_RESULT_SUCCESS == res)
+    {
+        if (NULL == g_rsa_jobs_tail)
+            g_rsa_jobs_head = job;
+        else
+            g_rsa_jobs_tail->next = job;
+        g_rsa_jobs_tail = job;
+
+        pthread_cond_signal(&g_rsa_pool_cond);
+    }
+    else
+    {
+        SEC_FREE(job);
+    }
+
+    pthread_mutex_unlock(&g_rsa_pool_mutex);
+
+    return res;
+}
@@ -0,0 +1,332 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sec_security_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* the first 4 buckets hold 0..3 ns, after that there are 4 buckets per power of two */
+static SEC_SIZE _SecStats_Bucket(uint64_t ns)
+{
+    SEC_SIZE msb;
+    SEC_SIZE bucket;
+
+    if (ns < 4)
+        return (SEC_SIZE) ns;
+
+    msb = 63 - __builtin_clzll(ns);
+    bucket = (msb - 1) * 4 + (SEC_SIZE) ((ns >> (msb - 2)) & 3);
+
+    return SEC_MIN(bucket, SEC_STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+/* exclusive upper bound of a bucket in ns */
+static uint64_t _SecStats_BucketLimit(SEC_SIZE bucket)
+{
+    SEC_SIZE next = bucket + 1;
+
+    if (next < 4)
+        return next;
+
+    return ((uint64_t) (4 + next % 4)) << (next / 4 - 1);
+}
+
+uint64_t SecStats_GetPercentile(const Sec_StatsOpData *data, double percentile)
+{
+    uint64_t target;
+    uint64_t seen = 0;
+    SEC_SIZE i;
+
+    if (NULL == data || data->count == 0)
+        return 0;
+
+    if (percentile < 0)
+        percentile = 0;
+    if (percentile > 100)
+        percentile = 100;
+
+    target = (uint64_t) (data->count * percentile / 100.0 + 0.5);
+    if (target == 0)
+        target = 1;
+
+    for (i = 0; i < SEC_STATS_HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += data->histogram[i];
+        if (seen >= target)
+            return _SecStats_BucketLimit(i);
+    }
+
+    return _SecStats_BucketLimit(SEC_STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+#if SEC_ENABLE_STATS
+
+#define SEC_STATS_CACHE_LINE 64
+
+/* each thread only writes its own counters, readers merge them under g_stats_mutex */
+#define SEC_STATS_ADD(field, value) __atomic_store_n(&(field), (field) + (value), __ATOMIC_RELAXED)
+#define SEC_STATS_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+typedef struct
+{
+    Sec_StatsOpData data;
+} __attribute__((aligned(SEC_STATS_CACHE_LINE))) _Sec_StatsOpSlot;
+
+typedef struct _Sec_StatsThread_struct
+{
+    _Sec_StatsOpSlot ops[SEC_STATS_OP_NUM];
+    Sec_StatsCacheData caches[SEC_STATS_CACHE_NUM] __attribute__((aligned(SEC_STATS_CACHE_LINE)));
+    uint64_t results[SEC_RESULT_NUM];
+    uint64_t outprot_denials;
+    struct _Sec_StatsThread_struct *prev;
+    struct _Sec_StatsThread_struct *next;
+} _Sec_StatsThread;
+
+static pthread_mutex_t g_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_stats_key;
+static _Sec_StatsThread *g_stats_threads = NULL;
+/* counters of threads that have exited */
+static Sec_Stats g_stats_retired;
+/* totals at the last SecStats_Reset */
+static Sec_Stats g_stats_baseline;
+static __thread _Sec_StatsThread *t_stats = NULL;
+
+/* must be called with g_stats_mutex held */
+static void _SecStats_AddThread(Sec_Stats *total, _Sec_StatsThread *thread)
+{
+    SEC_SIZE i, j;
+
+    for (i = 0; i < SEC_STATS_OP_NUM; ++i)
+    {
+        Sec_StatsOpData *dst = &total->ops[i];
+        Sec_StatsOpData *src = &thread->ops[i].data;
+
+        dst->count += SEC_STATS_LOAD(src->count);
+        dst->errors += SEC_STATS_LOAD(src->errors);
+        dst->bytes += SEC_STATS_LOAD(src->bytes);
+        dst->total_ns += SEC_STATS_LOAD(src->total_ns);
+        for (j = 0; j < SEC_STATS_HISTOGRAM_BUCKETS; ++j)
+            dst->histogram[j] += SEC_STATS_LOAD(src->histogram[j]);
+    }
+
+    for (i = 0; i < SEC_STATS_CACHE_NUM; ++i)
+    {
+        total->caches[i].hits += SEC_STATS_LOAD(thread->caches[i].hits);
+        total->caches[i].misses += SEC_STATS_LOAD(thread->caches[i].misses);
+    }
+
+    for (i = 0; i < SEC_RESULT_NUM; ++i)
+        total->results[i] += SEC_STATS_LOAD(thread->results[i]);
+
+    total->outprot_denials += SEC_STATS_LOAD(thread->outprot_denials);
+}
+
+/* must be called with g_stats_mutex held */
+static void _SecStats_Total(Sec_Stats *total)
+{
+    _Sec_StatsThread *thread;
+
+    memcpy(total, &g_stats_retired, sizeof(Sec_Stats));
+    for (thread = g_stats_threads; thread != NULL; thread = thread->next)
+        _SecStats_AddThread(total, thread);
+}
+
+static void _SecStats_ThreadExit(void *arg)
+{
+    _Sec_StatsThread *thread = (_Sec_StatsThread *) arg;
+
+    pthread_mutex_lock(&g_stats_mutex);
+    _SecStats_AddThread(&g_stats_retired, thread);
+    if (NULL != thread->prev)
+        thread->prev->next = thread->next;
+    else
+        g_stats_threads = thread->next;
+    if (NULL != thread->next)
+        thread->next->prev = thread->prev;
+    pthread_mutex_unlock(&g_stats_mutex);
+
+    free(thread);
+}
+
+static void _SecStats_Init(void)
+{
+    pthread_key_create(&g_stats_key, _SecStats_ThreadExit);
+}
+
+static _Sec_StatsThread *_SecStats_Thread(void)
+{
+    _Sec_StatsThread *thread = t_stats;
+
+    if (NULL != thread)
+        return thread;
+
+    pthread_once(&g_stats_once, _SecStats_Init);
+
+    if (0 != posix_memalign((void **) &thread, SEC_STATS_CACHE_LINE, sizeof(_Sec_StatsThread)))
+        return NULL;
+    memset(thread, 0, sizeof(_Sec_StatsThread));
+
+    pthread_mutex_lock(&g_stats_mutex);
+    thread->next = g_stats_threads;
+    if (NULL != g_stats_threads)
+        g_stats_threads->prev = thread;
+    g_stats_threads = thread;
+    pthread_mutex_unlock(&g_stats_mutex);
+
+    /* merged into g_stats_retired when the thread exits */
+    pthread_setspecific(g_stats_key, thread);
+    t_stats = thread;
+
+    return thread;
+}
+
+uint64_t SecStats_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void SecStats_Record(Sec_StatsOp op, uint64_t start, Sec_Result result, SEC_SIZE bytes)
+{
+    _Sec_StatsThread *thread;
+    Sec_StatsOpData *data;
+    uint64_t ns;
+
+    if ((SEC_SIZE) op >= SEC_STATS_OP_NUM)
+        return;
+
+    ns = SecStats_Now() - start;
+
+    thread = _SecStats_Thread();
+    if (NULL == thread)
+        return;
+
+    data = &thread->ops[op].data;
+    SEC_STATS_ADD(data->count, 1);
+    if (SEC_RESULT_SUCCESS != result)
+        SEC_STATS_ADD(data->errors, 1);
+    SEC_STATS_ADD(data->bytes, bytes);
+    SEC_STATS_ADD(data->total_ns, ns);
+    SEC_STATS_ADD(data->histogram[_SecStats_Bucket(ns)], 1);
+    if ((SEC_SIZE) result < SEC_RESULT_NUM)
+        SEC_STATS_ADD(thread->results[result], 1);
+}
+
+void SecStats_Cache(Sec_StatsCache cache, SEC_BOOL hit)
+{
+    _Sec_StatsThread *thread;
+
+    if ((SEC_SIZE) cache >= SEC_STATS_CACHE_NUM)
+        return;
+
+    thread = _SecStats_Thread();
+    if (NULL == thread)
+        return;
+
+    if (hit)
+        SEC_STATS_ADD(thread->caches[cache].hits, 1);
+    else
+        SEC_STATS_ADD(thread->caches[cache].misses, 1);
+}
+
+void SecStats_OutprotDenied(void)
+{
+    _Sec_StatsThread *thread = _SecStats_Thread();
+
+    if (NULL != thread)
+        SEC_STATS_ADD(thread->outprot_denials, 1);
+}
+
+void SecStats_Total(Sec_Stats *stats)
+{
+    pthread_mutex_lock(&g_stats_mutex);
+    _SecStats_Total(stats);
+    pthread_mutex_unlock(&g_stats_mutex);
+}
+
+Sec_Result SecStats_Snapshot(Sec_Stats *stats)
+{
+    SEC_SIZE i, j;
+
+    if (NULL == stats)
+    {
+        SEC_LOG_ERROR("Invalid stats");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    pthread_mutex_lock(&g_stats_mutex);
+    _SecStats_Total(stats);
+
+    for (i = 0; i < SEC_STATS_OP_NUM; ++i)
+    {
+        Sec_StatsOpData *dst = &stats->ops[i];
+        Sec_StatsOpData *base = &g_stats_baseline.ops[i];
+
+        dst->count -= base->count;
+        dst->errors -= base->errors;
+        dst->bytes -= base->bytes;
+        dst->total_ns -= base->total_ns;
+        for (j = 0; j < SEC_STATS_HISTOGRAM_BUCKETS; ++j)
+            dst->histogram[j] -= base->histogram[j];
+    }
+
+    for (i = 0; i < SEC_STATS_CACHE_NUM; ++i)
+    {
+        stats->caches[i].hits -= g_stats_baseline.caches[i].hits;
+        stats->caches[i].misses -= g_stats_baseline.caches[i].misses;
+    }
+
+    for (i = 0; i < SEC_RESULT_NUM; ++i)
+        stats->results[i] -= g_stats_baseline.results[i];
+
+    stats->outprot_denials -= g_stats_baseline.outprot_denials;
+    pthread_mutex_unlock(&g_stats_mutex);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecStats_Reset(void)
+{
+    /* counters are only ever written by their own thread, so a reset moves the baseline */
+    pthread_mutex_lock(&g_stats_mutex);
+    _SecStats_Total(&g_stats_baseline);
+    pthread_mutex_unlock(&g_stats_mutex);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+#else
+
+Sec_Result SecStats_Snapshot(Sec_Stats *stats)
+{
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+Sec_Result SecStats_Reset(void)
+{
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+#endif
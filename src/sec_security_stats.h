@@ -0,0 +1,62 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEC_SECURITY_STATS_H_
+#define SEC_SECURITY_STATS_H_
+
+#include "sec_security.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* set to 0 to compile all statistics collection out */
+#ifndef SEC_ENABLE_STATS
+    #define SEC_ENABLE_STATS 1
+#endif
+
+#if SEC_ENABLE_STATS
+
+#define SEC_STATS_START(start) uint64_t start = SecStats_Now()
+#define SEC_STATS_RECORD(op, start, result, bytes) SecStats_Record((op), (start), (result), (bytes))
+#define SEC_STATS_CACHE(cache, hit) SecStats_Cache((cache), (hit))
+#define SEC_STATS_OUTPROT_DENIED() SecStats_OutprotDenied()
+
+uint64_t SecStats_Now(void);
+void SecStats_Record(Sec_StatsOp op, uint64_t start, Sec_Result result, SEC_SIZE bytes);
+void SecStats_Cache(Sec_StatsCache cache, SEC_BOOL hit);
+void SecStats_OutprotDenied(void);
+/* totals since the process started, ignores SecStats_Reset */
+void SecStats_Total(Sec_Stats *stats);
+
+#else
+
+#define SEC_STATS_START(start)
+#define SEC_STATS_RECORD(op, start, result, bytes) do { } while (0)
+#define SEC_STATS_CACHE(cache, hit) do { } while (0)
+#define SEC_STATS_OUTPROT_DENIED() do { } while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEC_SECURITY_STATS_H_ */
@@ -19,6 +19,8 @@
 
 #include "sec_security_store.h"
 #include "sec_pubops.h"
+#include "sec_security_stats.h"
+#include "sec_security_trace.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -272,6 +274,8 @@ Sec_Result SecStore_RetrieveData(Sec_ProcessorHandle *proc, SEC_BOOL require_mac
         void *data, SEC_SIZE data_len, void *store, SEC_SIZE storeLen)
 {
     Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_STORE_RETRIEVE, SEC_OBJECTID_STORE_AES_KEY);
 
     res = SecStore_RetrieveDataWithKey(proc,
         SEC_OBJECTID_STORE_AES_KEY, SEC_OBJECTID_STORE_MACKEYGEN_KEY, require_mac,
@@ -282,6 +286,8 @@ Sec_Result SecStore_RetrieveData(Sec_ProcessorHandle *proc, SEC_BOOL require_mac
         SEC_LOG_ERROR("SecStore_RetrieveDataWithKey failed");
     }
 
+    SEC_STATS_RECORD(SEC_STATS_OP_STORE_RETRIEVE, start, res, storeLen);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_STORE_RETRIEVE, res);
     return res;
 }
 
@@ -333,6 +339,7 @@ Sec_Result SecStore_RetrieveDataWithKey(Sec_ProcessorHandle *proc,
     /* decrypt container */
     if (SecStore_GetHeader(copy)->flags & SEC_STORE_FLAG_IS_ENCRYPTED)
     {
+        SEC_TRACE_STORE_DECRYPT(aesKeyId, SecStore_GetStoreLen(copy));
         if (SEC_RESULT_SUCCESS != SecStore_Decrypt(proc, aesKeyId, copy, SecStore_GetStoreLen(copy)))
         {
             SEC_LOG_ERROR("SecStore_Decrypt failed");
@@ -0,0 +1,171 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sec_security_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if SEC_ENABLE_TRACEPOINTS
+
+#if (SEC_TRACE_RING_SIZE & (SEC_TRACE_RING_SIZE - 1)) != 0
+#error SEC_TRACE_RING_SIZE must be a power of two
+#endif
+
+typedef struct
+{
+    /* index + 1 of the record stored in the slot, 0 while it is being written */
+    uint64_t seq;
+    Sec_TraceRecord record;
+} _Sec_TraceSlot;
+
+int g_sec_trace_enabled = 0;
+
+static _Sec_TraceSlot g_trace_ring[SEC_TRACE_RING_SIZE];
+static uint64_t g_trace_head = 0;
+static __thread uint32_t t_trace_tid = 0;
+
+static const char *g_trace_event_names[SEC_TRACE_EVENT_NUM] = {
+    "api_enter",
+    "api_exit",
+    "key_load",
+    "store_decrypt",
+    "mutex_lock",
+    "mutex_locked",
+    "mutex_unlock",
+};
+
+void SecTrace_Record(Sec_TraceEvent event, SEC_SIZE op, SEC_OBJECTID objectId, uint64_t arg)
+{
+    struct timespec ts;
+    _Sec_TraceSlot *slot;
+    uint64_t idx;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    if (t_trace_tid == 0)
+        t_trace_tid = (uint32_t) syscall(SYS_gettid);
+
+    idx = __atomic_fetch_add(&g_trace_head, 1, __ATOMIC_RELAXED);
+    slot = &g_trace_ring[idx & (SEC_TRACE_RING_SIZE - 1)];
+
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->record.timestamp = (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+    slot->record.object_id = objectId;
+    slot->record.arg = arg;
+    slot->record.tid = t_trace_tid;
+    slot->record.event = (uint16_t) event;
+    slot->record.op = (uint16_t) op;
+
+    __atomic_store_n(&slot->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+Sec_Result SecTrace_Enable(SEC_BOOL enable)
+{
+    __atomic_store_n(&g_sec_trace_enabled, enable ? 1 : 0, __ATOMIC_RELAXED);
+
+    return SEC_RESULT_SUCCESS;
+}
+
+Sec_Result SecTrace_Dump(Sec_TraceRecord *records, SEC_SIZE maxRecords, SEC_SIZE *written)
+{
+    uint64_t head;
+    uint64_t idx;
+    SEC_SIZE count = 0;
+
+    if (NULL == records || NULL == written)
+    {
+        SEC_LOG_ERROR("Invalid parameters");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    head = __atomic_load_n(&g_trace_head, __ATOMIC_ACQUIRE);
+    idx = head > SEC_TRACE_RING_SIZE ? head - SEC_TRACE_RING_SIZE : 0;
+    if (head - idx > maxRecords)
+        idx = head - maxRecords;
+
+    /* records overwritten or still being written while we copy are skipped */
+    for (; idx < head; ++idx)
+    {
+        _Sec_TraceSlot *slot = &g_trace_ring[idx & (SEC_TRACE_RING_SIZE - 1)];
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != idx + 1)
+            continue;
+
+        memcpy(&records[count], &slot->record, sizeof(Sec_TraceRecord));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == idx + 1)
+            count++;
+    }
+
+    *written = count;
+
+    return SEC_RESULT_SUCCESS;
+}
+
+void SecTrace_Print(void)
+{
+    Sec_TraceRecord *records;
+    SEC_SIZE written = 0;
+    SEC_SIZE i;
+
+    records = (Sec_TraceRecord *) malloc(sizeof(Sec_TraceRecord) * SEC_TRACE_RING_SIZE);
+    if (NULL == records)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return;
+    }
+
+    if (SEC_RESULT_SUCCESS == SecTrace_Dump(records, SEC_TRACE_RING_SIZE, &written))
+    {
+        for (i = 0; i < written; ++i)
+        {
+            SEC_PRINT("%llu.%09llu %u %s op %u object %016llx arg %llu\n",
+                    (unsigned long long) (records[i].timestamp / 1000000000ULL),
+                    (unsigned long long) (records[i].timestamp % 1000000000ULL),
+                    records[i].tid,
+                    records[i].event < SEC_TRACE_EVENT_NUM ? g_trace_event_names[records[i].event] : "unknown",
+                    records[i].op, (unsigned long long) records[i].object_id,
+                    (unsigned long long) records[i].arg);
+        }
+    }
+
+    SEC_FREE(records);
+}
+
+#else
+
+Sec_Result SecTrace_Enable(SEC_BOOL enable)
+{
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+Sec_Result SecTrace_Dump(Sec_TraceRecord *records, SEC_SIZE maxRecords, SEC_SIZE *written)
+{
+    return SEC_RESULT_UNIMPLEMENTED_FEATURE;
+}
+
+void SecTrace_Print(void)
+{
+}
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEC_SECURITY_TRACE_H_
+#define SEC_SECURITY_TRACE_H_
+
+#include "sec_security.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* set to 0 to compile all tracepoints out */
+#ifndef SEC_ENABLE_TRACEPOINTS
+    #define SEC_ENABLE_TRACEPOINTS 1
+#endif
+
+/* static probes for perf, bpftrace and systemtap, enabled when <sys/sdt.h> is available */
+#ifndef SEC_ENABLE_USDT
+    #if defined(__has_include)
+        #if __has_include(<sys/sdt.h>)
+            #define SEC_ENABLE_USDT 1
+        #endif
+    #endif
+#endif
+
+#ifndef SEC_ENABLE_USDT
+    #define SEC_ENABLE_USDT 0
+#endif
+
+/* number of records kept by the ring buffer, must be a power of two */
+#ifndef SEC_TRACE_RING_SIZE
+    #define SEC_TRACE_RING_SIZE 4096
+#endif
+
+#if SEC_ENABLE_TRACEPOINTS
+
+#if SEC_ENABLE_USDT
+#include <sys/sdt.h>
+#define SEC_USDT_PROBE(name, op, objectId, arg) DTRACE_PROBE3(sec_api, name, op, objectId, arg)
+#else
+#define SEC_USDT_PROBE(name, op, objectId, arg) do { } while (0)
+#endif
+
+extern int g_sec_trace_enabled;
+
+/* the ring buffer costs a single relaxed load while tracing is switched off */
+#define SEC_TRACEPOINT(name, event, op, objectId, arg) \
+    do { \
+        SEC_USDT_PROBE(name, (op), (objectId), (arg)); \
+        if (__builtin_expect(__atomic_load_n(&g_sec_trace_enabled, __ATOMIC_RELAXED), 0)) \
+        { \
+            SecTrace_Record((event), (op), (objectId), (arg)); \
+        } \
+    } while (0)
+
+#define SEC_TRACE_API_ENTER(traceId, op, objectId) \
+    SEC_OBJECTID traceId = (objectId); \
+    SEC_TRACEPOINT(api_enter, SEC_TRACE_EVENT_API_ENTER, (op), traceId, 0)
+#define SEC_TRACE_API_EXIT(traceId, op, result) SEC_TRACEPOINT(api_exit, SEC_TRACE_EVENT_API_EXIT, (op), traceId, (result))
+#define SEC_TRACE_KEY_LOAD(objectId, location) SEC_TRACEPOINT(key_load, SEC_TRACE_EVENT_KEY_LOAD, 0, (objectId), (location))
+#define SEC_TRACE_STORE_DECRYPT(objectId, len) SEC_TRACEPOINT(store_decrypt, SEC_TRACE_EVENT_STORE_DECRYPT, 0, (objectId), (len))
+#define SEC_TRACE_MUTEX_LOCK(mutex) SEC_TRACEPOINT(mutex_lock, SEC_TRACE_EVENT_MUTEX_LOCK, 0, (uintptr_t) (mutex), 0)
+#define SEC_TRACE_MUTEX_LOCKED(mutex) SEC_TRACEPOINT(mutex_locked, SEC_TRACE_EVENT_MUTEX_LOCKED, 0, (uintptr_t) (mutex), 0)
+#define SEC_TRACE_MUTEX_UNLOCK(mutex) SEC_TRACEPOINT(mutex_unlock, SEC_TRACE_EVENT_MUTEX_UNLOCK, 0, (uintptr_t) (mutex), 0)
+
+void SecTrace_Record(Sec_TraceEvent event, SEC_SIZE op, SEC_OBJECTID objectId, uint64_t arg);
+
+#else
+
+#define SEC_TRACE_API_ENTER(traceId, op, objectId)
+#define SEC_TRACE_API_EXIT(traceId, op, result) do { } while (0)
+#define SEC_TRACE_KEY_LOAD(objectId, location) do { } while (0)
+#define SEC_TRACE_STORE_DECRYPT(objectId, len) do { } while (0)
+#define SEC_TRACE_MUTEX_LOCK(mutex) do { } while (0)
+#define SEC_TRACE_MUTEX_LOCKED(mutex) do { } while (0)
+#define SEC_TRACE_MUTEX_UNLOCK(mutex) do { } while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEC_SECURITY_TRACE_H_ */
@@ -0,0 +1,500 @@
+/**
+ * If not stated otherwise in this file or this component's Licenses.txt file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2019 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sec_security.h"
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* domain separation prefixes for leaf and interior nodes (RFC 6962 style) */
+#define SEC_TREEHASH_LEAF_PREFIX 0x00
+#define SEC_TREEHASH_NODE_PREFIX 0x01
+
+typedef struct
+{
+    Sec_ProcessorHandle *proc;
+    const SEC_BYTE *input;
+    size_t input_len;
+    SEC_SIZE leaf_size;
+    SEC_SIZE first_leaf;
+    SEC_SIZE last_leaf;
+    SEC_SIZE stride;
+    SEC_SIZE start;
+    SEC_BYTE *leaves;
+    Sec_Result res;
+} _Sec_TreeHashWork;
+
+static Sec_Result _SecDigest_TreeHashLeaf(Sec_ProcessorHandle *proc,
+        const SEC_BYTE *data, SEC_SIZE data_len, SEC_BYTE *out)
+{
+    Sec_DigestHandle *digest_handle = NULL;
+    SEC_BYTE prefix = SEC_TREEHASH_LEAF_PREFIX;
+    SEC_SIZE digest_len;
+
+    if (SEC_RESULT_SUCCESS != SecDigest_GetInstance(proc, SEC_DIGESTALGORITHM_SHA256, &digest_handle))
+    {
+        SEC_LOG_ERROR("SecDigest_GetInstance failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (SEC_RESULT_SUCCESS != SecDigest_Update(digest_handle, &prefix, sizeof(prefix))
+            || SEC_RESULT_SUCCESS != SecDigest_Update(digest_handle, (SEC_BYTE *) data, data_len))
+    {
+        SEC_LOG_ERROR("SecDigest_Update failed");
+        SecDigest_Release(digest_handle, out, &digest_len);
+        return SEC_RESULT_FAILURE;
+    }
+
+    return SecDigest_Release(digest_handle, out, &digest_len);
+}
+
+static Sec_Result _SecDigest_TreeHashNode(Sec_ProcessorHandle *proc,
+        const SEC_BYTE *left, const SEC_BYTE *right, SEC_BYTE *out)
+{
+    SEC_BYTE node[1 + 2 * SEC_DIGEST_MAX_LEN];
+    SEC_SIZE digest_len;
+
+    node[0] = SEC_TREEHASH_NODE_PREFIX;
+    memcpy(&node[1], left, SEC_TREEHASH_DIGEST_LEN);
+    memcpy(&node[1 + SEC_TREEHASH_DIGEST_LEN], right, SEC_TREEHASH_DIGEST_LEN);
+
+    return SecDigest_SingleInput(proc, SEC_DIGESTALGORITHM_SHA256, node,
+            1 + 2 * SEC_TREEHASH_DIGEST_LEN, out, &digest_len);
+}
+
+static void *_SecDigest_TreeHashWorker(void *arg)
+{
+    _Sec_TreeHashWork *work = (_Sec_TreeHashWork *) arg;
+    SEC_SIZE i;
+
+    work->res = SEC_RESULT_SUCCESS;
+
+    /* leaves are striped across the workers so no coordination is needed */
+    for (i = work->first_leaf + work->start; i <= work->last_leaf; i += work->stride)
+    {
+        size_t offset = (size_t) i * work->leaf_size;
+        size_t len = work->input_len - offset;
+
+        if (len > work->leaf_size)
+            len = work->leaf_size;
+
+        if (SEC_RESULT_SUCCESS != _SecDigest_TreeHashLeaf(work->proc, work->input + offset,
+                (SEC_SIZE) len, &work->leaves[(size_t) i * SEC_TREEHASH_DIGEST_LEN]))
+        {
+            work->res = SEC_RESULT_FAILURE;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static SEC_SIZE _SecDigest_TreeHashNumThreads(SEC_SIZE requested, SEC_SIZE num_leaves)
+{
+    long cpus;
+
+    if (requested == 0)
+    {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        requested = (cpus > 0) ? (SEC_SIZE) cpus : 1;
+    }
+
+    if (requested > SEC_TREEHASH_MAX_THREADS)
+        requested = SEC_TREEHASH_MAX_THREADS;
+
+    if (requested > num_leaves)
+        requested = num_leaves;
+
+    return (requested == 0) ? 1 : requested;
+}
+
+static SEC_SIZE _SecDigest_TreeHashNumLeaves(size_t input_len, SEC_SIZE leaf_size)
+{
+    if (input_len == 0)
+        return 1;
+
+    return (SEC_SIZE) ((input_len + leaf_size - 1) / leaf_size);
+}
+
+/* hash leaves [first_leaf, last_leaf] of the input into the leaves array */
+static Sec_Result _SecDigest_TreeHashLeaves(Sec_ProcessorHandle *proc,
+        const SEC_BYTE *input, size_t input_len, SEC_SIZE leaf_size,
+        SEC_SIZE first_leaf, SEC_SIZE last_leaf, SEC_SIZE num_threads, SEC_BYTE *leaves)
+{
+    _Sec_TreeHashWork work[SEC_TREEHASH_MAX_THREADS];
+    pthread_t threads[SEC_TREEHASH_MAX_THREADS];
+    SEC_BOOL started[SEC_TREEHASH_MAX_THREADS];
+    Sec_Result res = SEC_RESULT_SUCCESS;
+    SEC_SIZE i;
+
+    num_threads = _SecDigest_TreeHashNumThreads(num_threads, last_leaf - first_leaf + 1);
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        work[i].proc = proc;
+        work[i].input = input;
+        work[i].input_len = input_len;
+        work[i].leaf_size = leaf_size;
+        work[i].first_leaf = first_leaf;
+        work[i].last_leaf = last_leaf;
+        work[i].stride = num_threads;
+        work[i].start = i;
+        work[i].leaves = leaves;
+        work[i].res = SEC_RESULT_FAILURE;
+        started[i] = SEC_FALSE;
+    }
+
+    /* the calling thread works on the first stripe itself */
+    for (i = 1; i < num_threads; ++i)
+    {
+        if (0 != pthread_create(&threads[i], NULL, _SecDigest_TreeHashWorker, &work[i]))
+        {
+            SEC_LOG_ERROR("pthread_create failed, hashing stripe %d inline", i);
+            _SecDigest_TreeHashWorker(&work[i]);
+            continue;
+        }
+        started[i] = SEC_TRUE;
+    }
+
+    _SecDigest_TreeHashWorker(&work[0]);
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+
+        if (SEC_RESULT_SUCCESS != work[i].res)
+            res = SEC_RESULT_FAILURE;
+    }
+
+    return res;
+}
+
+static Sec_Result _SecDigest_TreeHashRoot(Sec_ProcessorHandle *proc,
+        const SEC_BYTE *leaves, SEC_SIZE num_leaves, SEC_BYTE *root)
+{
+    SEC_BYTE *level = NULL;
+    SEC_SIZE count = num_leaves;
+    SEC_SIZE i;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    level = malloc((size_t) num_leaves * SEC_TREEHASH_DIGEST_LEN);
+    if (NULL == level)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+    memcpy(level, leaves, (size_t) num_leaves * SEC_TREEHASH_DIGEST_LEN);
+
+    /* combine pairs in place, promoting an odd trailing node unchanged */
+    while (count > 1)
+    {
+        for (i = 0; i < count / 2; ++i)
+        {
+            if (SEC_RESULT_SUCCESS != _SecDigest_TreeHashNode(proc,
+                    &level[(2 * i) * SEC_TREEHASH_DIGEST_LEN],
+                    &level[(2 * i + 1) * SEC_TREEHASH_DIGEST_LEN],
+                    &level[i * SEC_TREEHASH_DIGEST_LEN]))
+            {
+                SEC_LOG_ERROR("_SecDigest_TreeHashNode failed");
+                goto done;
+            }
+        }
+
+        if (count % 2)
+        {
+            memmove(&level[i * SEC_TREEHASH_DIGEST_LEN],
+                    &level[(count - 1) * SEC_TREEHASH_DIGEST_LEN], SEC_TREEHASH_DIGEST_LEN);
+            ++i;
+        }
+
+        count = i;
+    }
+
+    memcpy(root, level, SEC_TREEHASH_DIGEST_LEN);
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SEC_FREE(level);
+    return res;
+}
+
+static Sec_Result _SecDigest_TreeHash(Sec_ProcessorHandle *proc,
+        const SEC_BYTE *input, size_t input_len, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE leaves_len, SEC_SIZE *num_leaves, SEC_BYTE *root)
+{
+    SEC_BYTE *tmp_leaves = NULL;
+    SEC_SIZE n;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    if (leaf_size == 0)
+        leaf_size = SEC_TREEHASH_DEFAULT_LEAF_SIZE;
+
+    if (input_len / leaf_size >= (size_t) (SEC_SIZE) -1 / SEC_TREEHASH_DIGEST_LEN)
+    {
+        SEC_LOG_ERROR("Input is too large for leaf size %d", leaf_size);
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    n = _SecDigest_TreeHashNumLeaves(input_len, leaf_size);
+    if (num_leaves != NULL)
+        *num_leaves = n;
+
+    if (leaves != NULL && leaves_len < n * SEC_TREEHASH_DIGEST_LEN)
+    {
+        SEC_LOG_ERROR("Leaf manifest buffer is too small, needed %d", n * SEC_TREEHASH_DIGEST_LEN);
+        return SEC_RESULT_BUFFER_TOO_SMALL;
+    }
+
+    if (leaves == NULL)
+    {
+        tmp_leaves = malloc((size_t) n * SEC_TREEHASH_DIGEST_LEN);
+        if (NULL == tmp_leaves)
+        {
+            SEC_LOG_ERROR("malloc failed");
+            return SEC_RESULT_FAILURE;
+        }
+        leaves = tmp_leaves;
+    }
+
+    if (SEC_RESULT_SUCCESS != _SecDigest_TreeHashLeaves(proc, input, input_len, leaf_size,
+            0, n - 1, num_threads, leaves))
+    {
+        SEC_LOG_ERROR("_SecDigest_TreeHashLeaves failed");
+        goto done;
+    }
+
+    if (root != NULL && SEC_RESULT_SUCCESS != _SecDigest_TreeHashRoot(proc, leaves, n, root))
+    {
+        SEC_LOG_ERROR("_SecDigest_TreeHashRoot failed");
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SEC_FREE(tmp_leaves);
+    return res;
+}
+
+static Sec_Result _SecDigest_TreeHashVerify(Sec_ProcessorHandle *proc,
+        const SEC_BYTE *input, size_t input_len, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        const SEC_BYTE *leaves, SEC_SIZE num_leaves, const SEC_BYTE *root,
+        uint64_t offset, uint64_t length)
+{
+    SEC_BYTE *computed = NULL;
+    SEC_BYTE manifest_root[SEC_TREEHASH_DIGEST_LEN];
+    SEC_SIZE first_leaf;
+    SEC_SIZE last_leaf;
+    Sec_Result res = SEC_RESULT_FAILURE;
+
+    if (leaf_size == 0)
+        leaf_size = SEC_TREEHASH_DEFAULT_LEAF_SIZE;
+
+    if (leaves == NULL || root == NULL
+            || num_leaves != _SecDigest_TreeHashNumLeaves(input_len, leaf_size))
+    {
+        SEC_LOG_ERROR("Leaf manifest does not match the input");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+
+    /* the manifest itself must hash up to the trusted root */
+    if (SEC_RESULT_SUCCESS != _SecDigest_TreeHashRoot(proc, leaves, num_leaves, manifest_root))
+    {
+        SEC_LOG_ERROR("_SecDigest_TreeHashRoot failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (Sec_Memcmp(manifest_root, root, SEC_TREEHASH_DIGEST_LEN) != 0)
+    {
+        SEC_LOG_ERROR("Leaf manifest does not match the root");
+        return SEC_RESULT_VERIFICATION_FAILED;
+    }
+
+    if (length == 0)
+    {
+        /* zero length verifies the whole input */
+        offset = 0;
+        length = input_len;
+    }
+
+    if (input_len == 0)
+    {
+        /* empty input has a single empty leaf */
+        first_leaf = 0;
+        last_leaf = 0;
+    }
+    else if (offset >= (uint64_t) input_len)
+    {
+        SEC_LOG_ERROR("Verification range is outside of the input");
+        return SEC_RESULT_INVALID_PARAMETERS;
+    }
+    else
+    {
+        if (length > (uint64_t) input_len - offset)
+            length = (uint64_t) input_len - offset;
+
+        first_leaf = (SEC_SIZE) (offset / leaf_size);
+        last_leaf = (SEC_SIZE) ((offset + length - 1) / leaf_size);
+    }
+
+    /* only the leaves covering the requested range are re-hashed */
+    computed = malloc((size_t) num_leaves * SEC_TREEHASH_DIGEST_LEN);
+    if (NULL == computed)
+    {
+        SEC_LOG_ERROR("malloc failed");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (SEC_RESULT_SUCCESS != _SecDigest_TreeHashLeaves(proc, input, input_len, leaf_size,
+            first_leaf, last_leaf, num_threads, computed))
+    {
+        SEC_LOG_ERROR("_SecDigest_TreeHashLeaves failed");
+        goto done;
+    }
+
+    if (Sec_Memcmp(&computed[(size_t) first_leaf * SEC_TREEHASH_DIGEST_LEN],
+            &leaves[(size_t) first_leaf * SEC_TREEHASH_DIGEST_LEN],
+            (size_t) (last_leaf - first_leaf + 1) * SEC_TREEHASH_DIGEST_LEN) != 0)
+    {
+        SEC_LOG_ERROR("Leaf digest mismatch in range %d-%d", first_leaf, last_leaf);
+        res = SEC_RESULT_VERIFICATION_FAILED;
+        goto done;
+    }
+
+    res = SEC_RESULT_SUCCESS;
+
+done:
+    SEC_FREE(computed);
+    return res;
+}
+
+static Sec_Result _SecDigest_TreeHashMapFile(const char *path, SEC_BYTE **data, size_t *data_len)
+{
+    struct stat st;
+    int fd;
+
+    *data = NULL;
+    *data_len = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        SEC_LOG_ERROR("Could not open file %s, errno %d", path, errno);
+        return SEC_RESULT_NO_SUCH_ITEM;
+    }
+
+    if (0 != fstat(fd, &st))
+    {
+        SEC_LOG_ERROR("fstat failed on %s, errno %d", path, errno);
+        close(fd);
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (st.st_size > 0)
+    {
+        *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*data == MAP_FAILED)
+        {
+            SEC_LOG_ERROR("mmap failed on %s, errno %d", path, errno);
+            *data = NULL;
+            close(fd);
+            return SEC_RESULT_FAILURE;
+        }
+
+        madvise(*data, (size_t) st.st_size, MADV_WILLNEED);
+        *data_len = (size_t) st.st_size;
+    }
+
+    close(fd);
+    return SEC_RESULT_SUCCESS;
+}
+
+static void _SecDigest_TreeHashUnmapFile(SEC_BYTE *data, size_t data_len)
+{
+    if (data != NULL)
+        munmap(data, data_len);
+}
+
+Sec_Result SecDigest_TreeHashBuffer(Sec_ProcessorHandle *proc,
+        SEC_BYTE *input, SEC_SIZE input_len, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE leaves_len, SEC_SIZE *num_leaves, SEC_BYTE *root)
+{
+    if (input == NULL && input_len != 0)
+        return SEC_RESULT_INVALID_PARAMETERS;
+
+    return _SecDigest_TreeHash(proc, input, input_len, leaf_size, num_threads,
+            leaves, leaves_len, num_leaves, root);
+}
+
+Sec_Result SecDigest_TreeHashFile(Sec_ProcessorHandle *proc,
+        const char *path, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE leaves_len, SEC_SIZE *num_leaves, SEC_BYTE *root)
+{
+    SEC_BYTE *data = NULL;
+    size_t data_len = 0;
+    Sec_Result res;
+
+    res = _SecDigest_TreeHashMapFile(path, &data, &data_len);
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
+    res = _SecDigest_TreeHash(proc, data, data_len, leaf_size, num_threads,
+            leaves, leaves_len, num_leaves, root);
+
+    _SecDigest_TreeHashUnmapFile(data, data_len);
+    return res;
+}
+
+Sec_Result SecDigest_TreeHashVerifyBuffer(Sec_ProcessorHandle *proc,
+        SEC_BYTE *input, SEC_SIZE input_len, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE num_leaves, SEC_BYTE *root,
+        uint64_t offset, uint64_t length)
+{
+    if (input == NULL && input_len != 0)
+        return SEC_RESULT_INVALID_PARAMETERS;
+
+    return _SecDigest_TreeHashVerify(proc, input, input_len, leaf_size, num_threads,
+            leaves, num_leaves, root, offset, length);
+}
+
+Sec_Result SecDigest_TreeHashVerifyFile(Sec_ProcessorHandle *proc,
+        const char *path, SEC_SIZE leaf_size, SEC_SIZE num_threads,
+        SEC_BYTE *leaves, SEC_SIZE num_leaves, SEC_BYTE *root,
+        uint64_t offset, uint64_t length)
+{
+    SEC_BYTE *data = NULL;
+    size_t data_len = 0;
+    Sec_Result res;
+
+    res = _SecDigest_TreeHashMapFile(path, &data, &data_len);
+    if (SEC_RESULT_SUCCESS != res)
+        return res;
+
+    res = _SecDigest_TreeHashVerify(proc, data, data_len, leaf_size, num_threads,
+            leaves, num_leaves, root, offset, length);
+
+    _SecDigest_TreeHashUnmapFile(data, data_len);
+    return res;
+}
@@ -19,6 +19,8 @@
 
 #include "sec_security_utils.h"
 #include "sec_security_store.h"
+#include "sec_security_stats.h"
+#include "sec_security_trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -105,7 +107,7 @@ Sec_Result SecUtils_ValidateKeyStore(Sec_ProcessorHandle *proc,
     return SEC_RESULT_SUCCESS;
 }
 
-Sec_Result SecUtils_ReadFile(const char *path, void *data, SEC_SIZE data_len,
+static Sec_Result _SecUtils_ReadFile(const char *path, void *data, SEC_SIZE data_len,
                              SEC_SIZE *data_read)
 {
     FILE *f = NULL;
@@ -156,6 +158,20 @@ cleanup:
     return sec_res;
 }
 
+Sec_Result SecUtils_ReadFile(const char *path, void *data, SEC_SIZE data_len,
+                             SEC_SIZE *data_read)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_FILE_READ, SEC_OBJECTID_INVALID);
+
+    res = _SecUtils_ReadFile(path, data, data_len, data_read);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_FILE_READ, start, res, (SEC_RESULT_SUCCESS == res && NULL != data_read) ? *data_read : 0);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_FILE_READ, res);
+    return res;
+}
+
 static long SecUtils_GetFileLen(const char *path) {
     FILE *f = NULL;
     long len = -1;
@@ -221,7 +237,7 @@ cleanup:
     return res;
 }
 
-Sec_Result SecUtils_WriteFile(const char *path, void *data, SEC_SIZE data_len)
+static Sec_Result _SecUtils_WriteFile(const char *path, void *data, SEC_SIZE data_len)
 {
     Sec_Result sec_res = SEC_RESULT_FAILURE;
     FILE *f = NULL;
@@ -324,6 +340,19 @@ cleanup:
     return sec_res;
 }
 
+Sec_Result SecUtils_WriteFile(const char *path, void *data, SEC_SIZE data_len)
+{
+    Sec_Result res;
+    SEC_STATS_START(start);
+    SEC_TRACE_API_ENTER(trace_id, SEC_STATS_OP_FILE_WRITE, SEC_OBJECTID_INVALID);
+
+    res = _SecUtils_WriteFile(path, data, data_len);
+
+    SEC_STATS_RECORD(SEC_STATS_OP_FILE_WRITE, start, res, data_len);
+    SEC_TRACE_API_EXIT(trace_id, SEC_STATS_OP_FILE_WRITE, res);
+    return res;
+}
+
 Sec_Result SecUtils_MkDir(const char *path)
 {
     char tmp[SEC_MAX_FILE_PATH_LEN];
@@ -2008,7 +2037,7 @@ SEC_SIZE SecUtils_UpdateItemListFromDir(SEC_OBJECTID *items, SEC_SIZE maxNumItem
 
 SEC_BOOL SecUtils_BitmapGet(SEC_BYTE *bitmap, SEC_SIZE bitNo)
 {
-    return SEC_BIT_READ(bitmap[bitNo/8], bitNo%8) != 0;
+    return SEC_BIT_READ(bitNo % 8, bitmap[bitNo / 8]) != 0;
 }
 
 void SecUtils_BitmapSet(SEC_BYTE *bitmap, SEC_SIZE bitNo, SEC_BOOL val)
@@ -2445,6 +2474,239 @@ int SecUtils_ElGamal_Encrypt(EC_KEY *ec_key,
 }
 #endif
 
+#if !defined(SEC_PUBOPS_TOMCRYPT)
+struct SecUtils_ElGamalCtx_struct
+{
+    // the curve with precomputed multiples of the base point
+    EC_GROUP *group;
+    // the same curve with the recipient's public point as the generator, so
+    // that r * Precipient also uses precomputed multiples
+    EC_GROUP *recipient_group;
+    const BIGNUM *order;
+    BN_CTX *bn_ctx;
+    BIGNUM *m;
+    BIGNUM *r;
+    BIGNUM *x;
+    BIGNUM *y;
+    EC_POINT *key_2_wrap_point;
+    EC_POINT *sender_share;
+    EC_POINT *shared_secret;
+    EC_POINT *wrapped_key;
+};
+
+void SecUtils_ElGamal_FreeCtx(SecUtils_ElGamalCtx *ctx)
+{
+    if (NULL == ctx)
+        return;
+
+    if (NULL != ctx->key_2_wrap_point)
+        EC_POINT_clear_free(ctx->key_2_wrap_point);
+    if (NULL != ctx->sender_share)
+        EC_POINT_free(ctx->sender_share);
+    if (NULL != ctx->shared_secret)
+        EC_POINT_clear_free(ctx->shared_secret);
+    if (NULL != ctx->wrapped_key)
+        EC_POINT_free(ctx->wrapped_key);
+    if (NULL != ctx->m)
+        BN_clear_free(ctx->m);
+    if (NULL != ctx->r)
+        BN_clear_free(ctx->r);
+    if (NULL != ctx->x)
+        BN_free(ctx->x);
+    if (NULL != ctx->y)
+        BN_free(ctx->y);
+    if (NULL != ctx->bn_ctx)
+        BN_CTX_free(ctx->bn_ctx);
+    if (NULL != ctx->recipient_group)
+        EC_GROUP_free(ctx->recipient_group);
+    if (NULL != ctx->group)
+        EC_GROUP_free(ctx->group);
+
+    free(ctx);
+}
+
+// ec_key is the other side's public ECC key
+SecUtils_ElGamalCtx *SecUtils_ElGamal_NewCtx(EC_KEY *ec_key)
+{
+    SecUtils_ElGamalCtx *ctx = NULL;
+    const EC_GROUP *src_group = NULL;
+    const EC_POINT *PK_recipient = NULL;
+
+    src_group = EC_KEY_get0_group(ec_key);
+    PK_recipient = EC_KEY_get0_public_key(ec_key);
+    if (NULL == src_group || NULL == PK_recipient)
+    {
+        SEC_LOG_ERROR("EC_KEY has no group or public key");
+        return NULL;
+    }
+
+    ctx = (SecUtils_ElGamalCtx *) calloc(1, sizeof(SecUtils_ElGamalCtx));
+    if (NULL == ctx)
+    {
+        SEC_LOG_ERROR("calloc failed");
+        return NULL;
+    }
+
+    ctx->bn_ctx = BN_CTX_new();
+    ctx->group = EC_GROUP_dup(src_group);
+    ctx->recipient_group = EC_GROUP_dup(src_group);
+    if (NULL == ctx->bn_ctx || NULL == ctx->group || NULL == ctx->recipient_group)
+    {
+        SEC_LOG_ERROR("Allocation failed");
+        goto fail;
+    }
+
+    ctx->order = EC_GROUP_get0_order(ctx->group);
+    if (NULL == ctx->order
+            || EC_POINT_is_at_infinity(src_group, PK_recipient)
+            || 1 != EC_POINT_is_on_curve(src_group, PK_recipient, ctx->bn_ctx))
+    {
+        SEC_LOG_ERROR("Invalid recipient public key");
+        goto fail;
+    }
+
+    if (1 != EC_GROUP_set_generator(ctx->recipient_group, PK_recipient, ctx->order,
+            EC_GROUP_get0_cofactor(ctx->group)))
+    {
+        SEC_LOG_ERROR("EC_GROUP_set_generator failed. Error: %s",
+                      ERR_error_string(ERR_get_error(), NULL));
+        goto fail;
+    }
+
+    if (1 != EC_GROUP_precompute_mult(ctx->group, ctx->bn_ctx)
+            || 1 != EC_GROUP_precompute_mult(ctx->recipient_group, ctx->bn_ctx))
+    {
+        SEC_LOG_ERROR("EC_GROUP_precompute_mult failed. Error: %s",
+                      ERR_error_string(ERR_get_error(), NULL));
+        goto fail;
+    }
+
+    ctx->m = BN_new();
+    ctx->r = BN_new();
+    ctx->x = BN_new();
+    ctx->y = BN_new();
+    ctx->key_2_wrap_point = EC_POINT_new(ctx->group);
+    ctx->sender_share = EC_POINT_new(ctx->group);
+    ctx->shared_secret = EC_POINT_new(ctx->recipient_group);
+    ctx->wrapped_key = EC_POINT_new(ctx->group);
+    if (NULL == ctx->m || NULL == ctx->r || NULL == ctx->x || NULL == ctx->y
+            || NULL == ctx->key_2_wrap_point || NULL == ctx->sender_share
+            || NULL == ctx->shared_secret || NULL == ctx->wrapped_key)
+    {
+        SEC_LOG_ERROR("Allocation failed");
+        goto fail;
+    }
+
+    return ctx;
+
+fail:
+    SecUtils_ElGamal_FreeCtx(ctx);
+    return NULL;
+}
+
+static Sec_Result _SecUtils_ElGamal_EncryptBlock(SecUtils_ElGamalCtx *ctx,
+                                                 SEC_BYTE* input, SEC_BYTE* output)
+{
+    // Generate random number 'w' (multiplier) for the sender
+    do
+    {
+        if (1 != BN_priv_rand_range(ctx->r, ctx->order))
+        {
+            SEC_LOG_ERROR("BN_priv_rand_range failed");
+            return SEC_RESULT_FAILURE;
+        }
+    } while (BN_is_zero(ctx->r));
+
+    if (BN_bin2bn(input, SEC_ECC_NISTP256_KEY_LEN, ctx->m) == NULL)
+    {
+        SEC_LOG_ERROR("BN_bin2bn failed. Error: %s",
+                      ERR_error_string(ERR_get_error(), NULL));
+        return SEC_RESULT_FAILURE;
+    }
+
+    // Convert the X coordinate to an EC Point, see SecUtils_ElGamal_Encrypt_Rand
+    if (!EC_POINT_set_compressed_coordinates_GFp(ctx->group, ctx->key_2_wrap_point, ctx->m, 0, ctx->bn_ctx))
+    {
+        // Don't print an error message if the error is "point not on curve" 100A906E, but still fail
+        if (ERR_get_error() != 0x100A906E)
+        {
+            SEC_LOG_ERROR("Set EC_POINT_set_compressed_coordinates_GFp failed. Error: %s",
+                          ERR_error_string(ERR_get_error(), NULL));
+        }
+        return SEC_RESULT_FAILURE;
+    }
+
+    // 'wP' from the base point table and 'wRr' from the recipient point table
+    if (1 != EC_POINT_mul(ctx->group, ctx->sender_share, ctx->r, NULL, NULL, ctx->bn_ctx)
+            || 1 != EC_POINT_mul(ctx->recipient_group, ctx->shared_secret, ctx->r, NULL, NULL, ctx->bn_ctx)
+            || 1 != EC_POINT_add(ctx->group, ctx->wrapped_key, ctx->key_2_wrap_point, ctx->shared_secret, ctx->bn_ctx))
+    {
+        SEC_LOG_ERROR("EC_POINT_mul failed. Error: %s",
+                      ERR_error_string(ERR_get_error(), NULL));
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (1 != EC_POINT_get_affine_coordinates_GFp(ctx->group, ctx->sender_share, ctx->x, ctx->y, ctx->bn_ctx)
+            || SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(ctx->x, &output[0 * SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN)
+            || SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(ctx->y, &output[1 * SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN))
+    {
+        SEC_LOG_ERROR("Failed to output the sender share");
+        return SEC_RESULT_FAILURE;
+    }
+
+    if (1 != EC_POINT_get_affine_coordinates_GFp(ctx->group, ctx->wrapped_key, ctx->x, ctx->y, ctx->bn_ctx)
+            || SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(ctx->x, &output[2 * SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN)
+            || SEC_RESULT_SUCCESS != SecUtils_BigNumToBuffer(ctx->y, &output[3 * SEC_ECC_NISTP256_KEY_LEN], SEC_ECC_NISTP256_KEY_LEN))
+    {
+        SEC_LOG_ERROR("Failed to output the wrapped key");
+        return SEC_RESULT_FAILURE;
+    }
+
+    return SEC_RESULT_SUCCESS;
+}
+
+int SecUtils_ElGamal_EncryptBatch(SecUtils_ElGamalCtx *ctx,
+                                  SEC_BYTE* input, SEC_SIZE inputSize,
+                                  SEC_BYTE* output, SEC_SIZE outputSize)
+{
+    SEC_SIZE i;
+    int res = -1;
+
+    if (NULL == ctx)
+    {
+        SEC_LOG_ERROR("Invalid ElGamal context");
+        return -1;
+    }
+
+    if (inputSize == 0 || inputSize % SEC_ECC_NISTP256_KEY_LEN != 0)
+    {
+        SEC_LOG_ERROR("Input size is not a multiple of one BIGNUM");
+        return -1;
+    }
+
+    if (outputSize < 4 * inputSize)
+    {
+        SEC_LOG_ERROR("Output size needed < Four BIGNUMs per block");
+        return -1;
+    }
+
+    for (i = 0; i < inputSize / SEC_ECC_NISTP256_KEY_LEN; ++i)
+    {
+        if (SEC_RESULT_SUCCESS != _SecUtils_ElGamal_EncryptBlock(ctx,
+                &input[i * SEC_ECC_NISTP256_KEY_LEN], &output[i * 4 * SEC_ECC_NISTP256_KEY_LEN]))
+            goto done;
+    }
+
+    res = 4 * inputSize;
+
+done:
+    BN_clear(ctx->r);
+    BN_clear(ctx->m);
+
+    return res;
+}
+#endif
+
 #if !defined(SEC_PUBOPS_TOMCRYPT)
 // ec_key is our private ECC key
 // Returns the number of bytes in the encrypted output or
@@ -39,13 +39,13 @@ typedef struct
 #define SEC_UTILS_KEYSTORE_MAGIC "KST0"
 
 /* create a bit mask for a specified bit */
-#define SEC_BIT_MASK(bit) (1 << bit)
+#define SEC_BIT_MASK(bit) (1 << (bit))
 
 /* read a specified bit */
-#define SEC_BIT_READ(bit, input) ((input >> bit) & 1)
+#define SEC_BIT_READ(bit, input) (((input) >> (bit)) & 1)
 
 /* write a specified value at the specific bit position */
-#define SEC_BIT_WRITE(bit, input, val) ((~SEC_BIT_MASK(bit) | input) | ((val & 1) << bit))
+#define SEC_BIT_WRITE(bit, input, val) ((~SEC_BIT_MASK(bit) & (input)) | (((val) & 1) << (bit)))
 
 #define SEC_INVALID_EPOCH (SEC_SIZE)-1
 
@@ -217,6 +217,32 @@ int SecUtils_ElGamal_Encrypt_Rand(EC_KEY *ec_key, SEC_BYTE* input, SEC_SIZE inpu
 int SecUtils_ElGamal_Encrypt(EC_KEY *ec_key, SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* output, SEC_SIZE outputSize);
 int SecUtils_ElGamal_Decrypt(EC_KEY *ec_key, SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* output, SEC_SIZE outputSize);
 
+/**
+ * @brief Reusable state for ElGamal encryption to a single recipient
+ *
+ * Holds the curve group and the recipient point with precomputed multiples,
+ * plus the scratch BIGNUMs and points used per block, so that wrapping many
+ * blocks to the same recipient does not redo the setup.  Not thread safe.
+ */
+typedef struct SecUtils_ElGamalCtx_struct SecUtils_ElGamalCtx;
+
+/**
+ * @brief Create an ElGamal encryption context for the recipient's public key
+ */
+SecUtils_ElGamalCtx *SecUtils_ElGamal_NewCtx(EC_KEY *ec_key);
+
+void SecUtils_ElGamal_FreeCtx(SecUtils_ElGamalCtx *ctx);
+
+/**
+ * @brief Encrypt consecutive 32 byte blocks, each with a fresh random multiplier
+ *
+ * inputSize must be a multiple of SEC_ECC_NISTP256_KEY_LEN and outputSize at
+ * least four times inputSize.
+ *
+ * @return the number of bytes written or -1 if there was an error
+ */
+int SecUtils_ElGamal_EncryptBatch(SecUtils_ElGamalCtx *ctx, SEC_BYTE* input, SEC_SIZE inputSize, SEC_BYTE* output, SEC_SIZE outputSize);
+
 #endif
 
 /**
@@ -228,6 +254,13 @@ X509 * SecUtils_DerToX509(SEC_BYTE *der, SEC_SIZE der_len);
 
 SEC_SIZE SecUtils_X509ToDerLen(X509 *x509, void *mem, SEC_SIZE mem_len);
 
+/**
+ * @brief Platform hook for SecCertificate_ToX509 returning a new reference to the
+ * X509 object cached on the handle, or NULL when the platform does not cache one.
+ * Every platform implementation provides it.
+ */
+X509* SecCertificate_GetCachedX509(Sec_CertificateHandle *cert);
+
 /**
  * @brief Verify X509 certificate with public RSA key
  */
@@ -319,6 +352,21 @@ SEC_SIZE SecUtils_UpdateItemList(SEC_OBJECTID *items, SEC_SIZE maxNumItems, SEC_
  */
 SEC_SIZE SecUtils_UpdateItemListFromDir(SEC_OBJECTID *items, SEC_SIZE maxNumItems, SEC_SIZE numItems, const char* dir, const char* ext);
 
+/**
+ * @brief read a bit from a bitmap.
+ */
+SEC_BOOL SecUtils_BitmapGet(SEC_BYTE *bitmap, SEC_SIZE bitNo);
+
+/**
+ * @brief write a bit in a bitmap.
+ */
+void SecUtils_BitmapSet(SEC_BYTE *bitmap, SEC_SIZE bitNo, SEC_BOOL val);
+
+/**
+ * @brief find the first bit with the specified value, (SEC_SIZE) -1 if there is none.
+ */
+SEC_SIZE SecUtils_BitmapGetFirst(SEC_BYTE *bitmap, SEC_SIZE num_bytes, SEC_BOOL val);
+
 Sec_Result SecUtils_WrapSymetric(Sec_ProcessorHandle *proc,
                                  SEC_OBJECTID wrappingKey,
                                  Sec_CipherAlgorithm wrappingAlg, SEC_BYTE *iv,